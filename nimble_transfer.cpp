@@ -2,6 +2,7 @@
 #include "audio_handler.h"
 #include "camera_config.h"
 #include "sd_card.h"
+#include "crc32.h"
 #include <NimBLEDevice.h>
 
 NimBLEServer *pServer = nullptr;
@@ -110,9 +111,12 @@ void sendImageViaBLE(camera_fb_t *fb)
         return;
     }
 
-    // Send image size first
-    uint32_t imageSize = fb->len;
-    pCameraCharacteristic->setValue((uint8_t *)&imageSize, sizeof(imageSize));
+    // Send image size and CRC-32 first; the phone checks the reassembled
+    // image against it instead of looking for an end marker
+    uint32_t header[2];
+    header[0] = fb->len;
+    header[1] = crc32Update(0, fb->buf, fb->len);
+    pCameraCharacteristic->setValue((uint8_t *)header, sizeof(header));
     pCameraCharacteristic->notify();
     vTaskDelay(2);
 
@@ -120,25 +124,9 @@ void sendImageViaBLE(camera_fb_t *fb)
     for (int i = 0; i < fb->len; i += chunkSize)
     {
         int currentChunkSize = min(chunkSize, (int)(fb->len - i));
-        bool isLastChunk = (i + currentChunkSize >= fb->len);
-
-        if (isLastChunk)
-        {
-            static uint8_t buffer[chunkSize + 2];
-            memcpy(buffer, &fb->buf[i], currentChunkSize);
-            buffer[currentChunkSize] = 255;     // 0xFF
-            buffer[currentChunkSize + 1] = 217; // 0xD9
-
-            pCameraCharacteristic->setValue(buffer, currentChunkSize + 2);
-            pCameraCharacteristic->notify();
-            vTaskDelay(10);
-        }
-        else
-        {
-            pCameraCharacteristic->setValue(&fb->buf[i], currentChunkSize);
-            pCameraCharacteristic->notify();
-            vTaskDelay(5);
-        }
+        pCameraCharacteristic->setValue(&fb->buf[i], currentChunkSize);
+        pCameraCharacteristic->notify();
+        vTaskDelay(5);
     }
 }
 
@@ -0,0 +1,31 @@
+import 'dart:ffi';
+
+import 'phone_native.dart';
+
+// Bindings for phone_app/native/capture_seal.h
+class CaptureSealBindings {
+  final Pointer<Uint8> Function() key;
+  final Pointer<Uint8> Function(int capacity) buffer;
+  final int Function(int len) open;
+
+  CaptureSealBindings(DynamicLibrary lib)
+      : key = lib.lookupFunction<Pointer<Uint8> Function(),
+            Pointer<Uint8> Function()>('seal_key'),
+        buffer = lib.lookupFunction<Pointer<Uint8> Function(Uint32),
+            Pointer<Uint8> Function(int)>('seal_buffer'),
+        open = lib.lookupFunction<Int32 Function(Uint32), int Function(int)>(
+            'seal_open');
+
+  static final CaptureSealBindings? instance = _load();
+
+  static CaptureSealBindings? _load() {
+    final lib = phoneNative;
+    if (lib == null) return null;
+    try {
+      return CaptureSealBindings(lib);
+    } catch (e) {
+      print('Native capture seal unavailable: $e');
+      return null;
+    }
+  }
+}
@@ -0,0 +1,75 @@
+import 'dart:ffi';
+
+import 'phone_native.dart';
+
+// Bindings for phone_app/native/imu_fusion.h
+final class NativeImuFusion extends Opaque {}
+
+final class NativeImuResult extends Struct {
+  @Double()
+  external double accelVariance;
+  @Double()
+  external double gyroVariance;
+  @Double()
+  external double motionMagnitude;
+  @Double()
+  external double qw;
+  @Double()
+  external double qx;
+  @Double()
+  external double qy;
+  @Double()
+  external double qz;
+  @Int64()
+  external int timestampUs;
+  @Int32()
+  external int behavior;
+  @Int32()
+  external int samples;
+}
+
+typedef _AddC = Void Function(
+    Pointer<NativeImuFusion>, Int64, Float, Float, Float);
+typedef _AddDart = void Function(
+    Pointer<NativeImuFusion>, int, double, double, double);
+
+class ImuFusionBindings {
+  final Pointer<NativeImuFusion> Function(int windowMs, int maxRateHz) create;
+  final void Function(Pointer<NativeImuFusion>) destroy;
+  final _AddDart addAccel;
+  final _AddDart addGyro;
+  final _AddDart addMag;
+  final int Function(Pointer<NativeImuFusion>, int nowUs, int intervalMs)
+      evaluate;
+  final Pointer<NativeImuResult> Function(Pointer<NativeImuFusion>) result;
+
+  ImuFusionBindings(DynamicLibrary lib)
+      : create = lib.lookupFunction<
+            Pointer<NativeImuFusion> Function(Uint32, Uint32),
+            Pointer<NativeImuFusion> Function(int, int)>('imu_create'),
+        destroy = lib.lookupFunction<Void Function(Pointer<NativeImuFusion>),
+            void Function(Pointer<NativeImuFusion>)>('imu_destroy'),
+        addAccel = lib.lookupFunction<_AddC, _AddDart>('imu_add_accel'),
+        addGyro = lib.lookupFunction<_AddC, _AddDart>('imu_add_gyro'),
+        addMag = lib.lookupFunction<_AddC, _AddDart>('imu_add_mag'),
+        evaluate = lib.lookupFunction<
+            Int32 Function(Pointer<NativeImuFusion>, Int64, Uint32),
+            int Function(Pointer<NativeImuFusion>, int, int)>('imu_evaluate'),
+        result = lib.lookupFunction<
+            Pointer<NativeImuResult> Function(Pointer<NativeImuFusion>),
+            Pointer<NativeImuResult> Function(
+                Pointer<NativeImuFusion>)>('imu_result');
+
+  static final ImuFusionBindings? instance = _load();
+
+  static ImuFusionBindings? _load() {
+    final lib = phoneNative;
+    if (lib == null) return null;
+    try {
+      return ImuFusionBindings(lib);
+    } catch (e) {
+      print('Native IMU fusion unavailable: $e');
+      return null;
+    }
+  }
+}
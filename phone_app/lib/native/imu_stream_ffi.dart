@@ -0,0 +1,65 @@
+import 'dart:ffi';
+
+import 'phone_native.dart';
+
+// Bindings for phone_app/native/imu_stream.h
+final class NativeImuStream extends Opaque {}
+
+final class NativeImuStreamBatch extends Struct {
+  @Uint32()
+  external int count;
+  @Uint32()
+  external int timeMs;
+  @Uint32()
+  external int periodUs;
+  @Uint32()
+  external int lost;
+  @Uint32()
+  external int totalLost;
+}
+
+class ImuStreamBindings {
+  final Pointer<NativeImuStream> Function() create;
+  final void Function(Pointer<NativeImuStream>) destroy;
+  final Pointer<Uint8> Function(Pointer<NativeImuStream>) staging;
+  final int Function() stagingCapacity;
+  final int Function(Pointer<NativeImuStream>, int len) pushStaged;
+  final Pointer<Float> Function(Pointer<NativeImuStream>) samples;
+  final Pointer<NativeImuStreamBatch> Function(Pointer<NativeImuStream>) batch;
+
+  ImuStreamBindings(DynamicLibrary lib)
+      : create = lib.lookupFunction<Pointer<NativeImuStream> Function(),
+            Pointer<NativeImuStream> Function()>('imu_stream_create'),
+        destroy = lib.lookupFunction<Void Function(Pointer<NativeImuStream>),
+            void Function(Pointer<NativeImuStream>)>('imu_stream_destroy'),
+        staging = lib.lookupFunction<
+            Pointer<Uint8> Function(Pointer<NativeImuStream>),
+            Pointer<Uint8> Function(
+                Pointer<NativeImuStream>)>('imu_stream_staging'),
+        stagingCapacity = lib.lookupFunction<Uint32 Function(), int Function()>(
+            'imu_stream_staging_capacity'),
+        pushStaged = lib.lookupFunction<
+            Int32 Function(Pointer<NativeImuStream>, Uint32),
+            int Function(Pointer<NativeImuStream>, int)>('imu_stream_push_staged'),
+        samples = lib.lookupFunction<
+            Pointer<Float> Function(Pointer<NativeImuStream>),
+            Pointer<Float> Function(
+                Pointer<NativeImuStream>)>('imu_stream_samples'),
+        batch = lib.lookupFunction<
+            Pointer<NativeImuStreamBatch> Function(Pointer<NativeImuStream>),
+            Pointer<NativeImuStreamBatch> Function(
+                Pointer<NativeImuStream>)>('imu_stream_batch');
+
+  static final ImuStreamBindings? instance = _load();
+
+  static ImuStreamBindings? _load() {
+    final lib = phoneNative;
+    if (lib == null) return null;
+    try {
+      return ImuStreamBindings(lib);
+    } catch (e) {
+      print('Native IMU stream unavailable: $e');
+      return null;
+    }
+  }
+}
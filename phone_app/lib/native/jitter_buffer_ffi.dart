@@ -0,0 +1,80 @@
+import 'dart:ffi';
+
+import 'phone_native.dart';
+
+// Bindings for phone_app/native/jitter_buffer.h
+final class NativeJitterBuffer extends Opaque {}
+
+final class NativeJitterStats extends Struct {
+  @Uint32()
+  external int pushed;
+  @Uint32()
+  external int played;
+  @Uint32()
+  external int concealed;
+  @Uint32()
+  external int late;
+  @Uint32()
+  external int skipped;
+  @Uint32()
+  external int targetMs;
+  @Uint32()
+  external int bufferedMs;
+  @Uint32()
+  external int jitterMs;
+  @Uint32()
+  external int earDelayMs;
+}
+
+class JitterBufferBindings {
+  final Pointer<NativeJitterBuffer> Function(
+      int frameSamples, int frameMs, int minDelayMs, int maxDelayMs) create;
+  final void Function(Pointer<NativeJitterBuffer>) destroy;
+  final Pointer<Uint8> Function(Pointer<NativeJitterBuffer>) staging;
+  final int Function() stagingCapacity;
+  final int Function(Pointer<NativeJitterBuffer>, int len, int arrivalMs)
+      pushStaged;
+  final int Function(Pointer<NativeJitterBuffer>, int nowMs) pull;
+  final Pointer<Int16> Function(Pointer<NativeJitterBuffer>) output;
+  final Pointer<NativeJitterStats> Function(Pointer<NativeJitterBuffer>) stats;
+
+  JitterBufferBindings(DynamicLibrary lib)
+      : create = lib.lookupFunction<
+            Pointer<NativeJitterBuffer> Function(Uint32, Uint32, Uint32, Uint32),
+            Pointer<NativeJitterBuffer> Function(
+                int, int, int, int)>('jb_create'),
+        destroy = lib.lookupFunction<Void Function(Pointer<NativeJitterBuffer>),
+            void Function(Pointer<NativeJitterBuffer>)>('jb_destroy'),
+        staging = lib.lookupFunction<
+            Pointer<Uint8> Function(Pointer<NativeJitterBuffer>),
+            Pointer<Uint8> Function(Pointer<NativeJitterBuffer>)>('jb_staging'),
+        stagingCapacity = lib.lookupFunction<Uint32 Function(), int Function()>(
+            'jb_staging_capacity'),
+        pushStaged = lib.lookupFunction<
+            Int32 Function(Pointer<NativeJitterBuffer>, Uint32, Uint32),
+            int Function(
+                Pointer<NativeJitterBuffer>, int, int)>('jb_push_staged'),
+        pull = lib.lookupFunction<
+            Int32 Function(Pointer<NativeJitterBuffer>, Uint32),
+            int Function(Pointer<NativeJitterBuffer>, int)>('jb_pull'),
+        output = lib.lookupFunction<
+            Pointer<Int16> Function(Pointer<NativeJitterBuffer>),
+            Pointer<Int16> Function(Pointer<NativeJitterBuffer>)>('jb_output'),
+        stats = lib.lookupFunction<
+            Pointer<NativeJitterStats> Function(Pointer<NativeJitterBuffer>),
+            Pointer<NativeJitterStats> Function(
+                Pointer<NativeJitterBuffer>)>('jb_stats');
+
+  static final JitterBufferBindings? instance = _load();
+
+  static JitterBufferBindings? _load() {
+    final lib = phoneNative;
+    if (lib == null) return null;
+    try {
+      return JitterBufferBindings(lib);
+    } catch (e) {
+      print('Native jitter buffer unavailable: $e');
+      return null;
+    }
+  }
+}
@@ -0,0 +1,23 @@
+import 'dart:ffi';
+import 'dart:io';
+
+// The app's native helpers (phone_app/native), or null where they are not
+// bundled; callers then fall back to their Dart implementations.
+final DynamicLibrary? phoneNative = _open();
+
+DynamicLibrary? _open() {
+  try {
+    if (Platform.isLinux || Platform.isAndroid) {
+      return DynamicLibrary.open('libphone_native.so');
+    }
+    if (Platform.isWindows) {
+      return DynamicLibrary.open('phone_native.dll');
+    }
+    if (Platform.isMacOS || Platform.isIOS) {
+      return DynamicLibrary.process();
+    }
+  } catch (e) {
+    print('Native helpers unavailable: $e');
+  }
+  return null;
+}
@@ -0,0 +1,72 @@
+import 'dart:ffi';
+
+import 'phone_native.dart';
+
+// Bindings for phone_app/native/reassembly.h
+final class NativeReassembler extends Opaque {}
+
+class ReassemblyBindings {
+  final Pointer<NativeReassembler> Function(int size, int packets, int crc)
+      create;
+  final void Function(Pointer<NativeReassembler>) destroy;
+  final Pointer<Uint8> Function(Pointer<NativeReassembler>) staging;
+  final int Function() stagingCapacity;
+  final int Function(Pointer<NativeReassembler>, int len) addStaged;
+  final int Function(Pointer<NativeReassembler>) received;
+  final int Function(Pointer<NativeReassembler>) ackedPackets;
+  final Pointer<Uint8> Function(Pointer<NativeReassembler>) data;
+  final int Function(Pointer<NativeReassembler>) size;
+  final Pointer<Uint8> Function(Pointer<NativeReassembler>) reply;
+  final int Function(Pointer<NativeReassembler>) replyLength;
+  final int Function(Pointer<NativeReassembler>, int objectId) buildResume;
+
+  ReassemblyBindings(DynamicLibrary lib)
+      : create = lib.lookupFunction<
+            Pointer<NativeReassembler> Function(Uint32, Uint32, Uint32),
+            Pointer<NativeReassembler> Function(
+                int, int, int)>('reasm_create'),
+        destroy = lib.lookupFunction<Void Function(Pointer<NativeReassembler>),
+            void Function(Pointer<NativeReassembler>)>('reasm_destroy'),
+        staging = lib.lookupFunction<
+            Pointer<Uint8> Function(Pointer<NativeReassembler>),
+            Pointer<Uint8> Function(
+                Pointer<NativeReassembler>)>('reasm_staging'),
+        stagingCapacity = lib.lookupFunction<Uint32 Function(), int Function()>(
+            'reasm_staging_capacity'),
+        addStaged = lib.lookupFunction<
+            Int32 Function(Pointer<NativeReassembler>, Uint32),
+            int Function(Pointer<NativeReassembler>, int)>('reasm_add_staged'),
+        received = lib.lookupFunction<Uint32 Function(Pointer<NativeReassembler>),
+            int Function(Pointer<NativeReassembler>)>('reasm_received'),
+        ackedPackets = lib.lookupFunction<
+            Uint32 Function(Pointer<NativeReassembler>),
+            int Function(Pointer<NativeReassembler>)>('reasm_acked_packets'),
+        data = lib.lookupFunction<
+            Pointer<Uint8> Function(Pointer<NativeReassembler>),
+            Pointer<Uint8> Function(Pointer<NativeReassembler>)>('reasm_data'),
+        size = lib.lookupFunction<Uint32 Function(Pointer<NativeReassembler>),
+            int Function(Pointer<NativeReassembler>)>('reasm_size'),
+        reply = lib.lookupFunction<
+            Pointer<Uint8> Function(Pointer<NativeReassembler>),
+            Pointer<Uint8> Function(Pointer<NativeReassembler>)>('reasm_reply'),
+        replyLength = lib.lookupFunction<
+            Uint32 Function(Pointer<NativeReassembler>),
+            int Function(Pointer<NativeReassembler>)>('reasm_reply_length'),
+        buildResume = lib.lookupFunction<
+            Uint32 Function(Pointer<NativeReassembler>, Uint32),
+            int Function(
+                Pointer<NativeReassembler>, int)>('reasm_build_resume');
+
+  static final ReassemblyBindings? instance = _load();
+
+  static ReassemblyBindings? _load() {
+    final lib = phoneNative;
+    if (lib == null) return null;
+    try {
+      return ReassemblyBindings(lib);
+    } catch (e) {
+      print('Native reassembly unavailable: $e');
+      return null;
+    }
+  }
+}
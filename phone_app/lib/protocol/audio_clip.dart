@@ -0,0 +1,79 @@
+import 'dart:typed_data';
+
+import 'wire_format.dart';
+
+// Receiver side of recorded clips on the audio stream: an AudioChunk
+// prefix on every payload, an AudioHeader to start a clip, then the
+// clip's bytes tagged with their offset. Bytes are taken in order only;
+// anything else is dropped and the device goes back to what we last
+// acknowledged. Mirrors pullAudio() in ble_transfer.cpp.
+class AudioClipReceiver {
+  Uint8List? _clip;
+  int _held = 0;
+  int _ackedAt = 0;
+  int _lastClipSize = 0;
+  bool _sealed = false;
+
+  // "AUDIO_ACK:<bytes held>" to write back after the last add(), if any
+  String? reply;
+
+  // Whether the clip completed by the last add() is sealed
+  bool get sealed => _sealed;
+
+  // A connection drop loses the partial clip; the device starts over
+  void reset() {
+    _clip = null;
+    _held = 0;
+    _ackedAt = 0;
+    _lastClipSize = 0;
+    reply = null;
+  }
+
+  // The whole clip once its last byte is here, otherwise null
+  Uint8List? add(List<int> payload, [int at = 0]) {
+    reply = null;
+    if (!AudioChunk.fits(payload, at)) return null;
+    final offset = AudioChunk(payload, at).offset;
+    final data = at + AudioChunk.size;
+
+    if (offset == Wire.audioHeaderOffset) {
+      if (!AudioHeader.fits(payload, data)) return null;
+      final header = AudioHeader(payload, data);
+      _clip = Uint8List(header.size);
+      _sealed = (header.flags & Wire.audioFlagSealed) != 0;
+      _held = 0;
+      _ackedAt = 0;
+      return _clip!.isEmpty ? _finish() : null;
+    }
+
+    final clip = _clip;
+    final len = payload.length - data;
+    if (clip == null) {
+      // Our final ACK was lost: the device is repeating the last clip
+      if (offset + len <= _lastClipSize) reply = 'AUDIO_ACK:$_lastClipSize';
+      return null;
+    }
+    if (offset != _held || offset + len > clip.length) {
+      // Repeated or out of order: say again where we are
+      if (offset < _held) reply = 'AUDIO_ACK:$_held';
+      return null;
+    }
+
+    clip.setRange(offset, offset + len, payload, data);
+    _held += len;
+    if (_held == clip.length) return _finish();
+    if (_held - _ackedAt >= Wire.audioAckEvery) {
+      _ackedAt = _held;
+      reply = 'AUDIO_ACK:$_held';
+    }
+    return null;
+  }
+
+  Uint8List _finish() {
+    final clip = _clip!;
+    reply = 'AUDIO_ACK:${clip.length}';
+    _lastClipSize = clip.length;
+    _clip = null;
+    return clip;
+  }
+}
@@ -0,0 +1,36 @@
+import 'dart:ffi';
+import 'dart:typed_data';
+
+import '../native/capture_seal_ffi.dart';
+
+// Captures the device sealed with its master key (header flag
+// Wire.imageFlagSealed). Opening needs the native library; where it is not
+// bundled, sealed objects cannot be shown and open() returns null.
+class CaptureSeal {
+  static const int keySize = 32;
+
+  static bool get available => CaptureSealBindings.instance != null;
+
+  static bool _haveKey = false;
+  static bool get haveKey => _haveKey;
+
+  static void setKey(List<int> key) {
+    final b = CaptureSealBindings.instance;
+    if (b == null || key.length != keySize) return;
+    b.key().asTypedList(keySize).setAll(0, key);
+    _haveKey = true;
+  }
+
+  // The plaintext, or null if the tag does not verify (wrong key,
+  // corrupted or not sealed)
+  static Uint8List? open(Uint8List sealed) {
+    final b = CaptureSealBindings.instance;
+    if (b == null || !_haveKey) return null;
+    final buffer = b.buffer(sealed.length);
+    if (buffer == nullptr) return null;
+    buffer.asTypedList(sealed.length).setAll(0, sealed);
+    final len = b.open(sealed.length);
+    if (len < 0) return null;
+    return Uint8List.fromList(buffer.asTypedList(len));
+  }
+}
@@ -0,0 +1,81 @@
+import 'wire_format.dart';
+
+// One capture on the device's card, as listed by QUERY
+class CatalogEntry {
+  final int id;
+  final DateTime time;
+  final int type; // Wire.capturePhoto / captureAudio / captureVideo
+  final int size;
+  final int flags;
+
+  CatalogEntry(this.id, this.time, this.type, this.size, this.flags);
+
+  // Not finished (or never stored): no file to fetch
+  bool get pending => (flags & Wire.catalogFlagPending) != 0;
+
+  // Taken before the device's clock was set; filed under the time of
+  // the capture before it
+  bool get timeEstimated => (flags & Wire.catalogFlagEstimated) != 0;
+
+  bool get duplicate => (flags & Wire.catalogFlagDuplicate) != 0;
+
+  // Names the device stores it under
+  String get path {
+    final n = id.toString().padLeft(6, '0');
+    final base = switch (type) {
+      Wire.capturePhoto => '/photo_$n.jpg',
+      Wire.captureAudio => '/audio_$n.wav',
+      _ => '/clip_$n.avi',
+    };
+    return duplicate ? base.replaceFirst(RegExp(r'\.\w+$'), '.ref') : base;
+  }
+
+  static CatalogEntry? parse(String item) {
+    final f = item.split(',');
+    if (f.length != 5) return null;
+    final v = f.map(int.tryParse).toList();
+    if (v.contains(null)) return null;
+    return CatalogEntry(
+        v[0]!,
+        DateTime.fromMillisecondsSinceEpoch(v[1]! * 1000, isUtc: true),
+        v[2]!,
+        v[3]!,
+        v[4]!);
+  }
+}
+
+// One QUERY reply: "CATALOG:<total>:<skip>:<n>", then n records over
+// one or more "CAT:<id>,<time>,<type>,<size>,<flags>;..." lines. total
+// counts the whole range; ask again with skip + entries.length for more.
+class CatalogPage {
+  final int total;
+  final int skip;
+  final int expected;
+  final List<CatalogEntry> entries = [];
+
+  CatalogPage._(this.total, this.skip, this.expected);
+
+  bool get complete => entries.length >= expected;
+
+  bool get hasMore => skip + entries.length < total;
+
+  // A page starts at its CATALOG: line; null for anything else
+  static CatalogPage? start(String text) {
+    if (!text.startsWith('CATALOG:')) return null;
+    final f = text.substring(8).split(':');
+    if (f.length != 3) return null;
+    final v = f.map(int.tryParse).toList();
+    if (v.contains(null)) return null;
+    return CatalogPage._(v[0]!, v[1]!, v[2]!);
+  }
+
+  // Takes a CAT: line; false for other status text
+  bool add(String text) {
+    if (!text.startsWith('CAT:')) return false;
+    for (final item in text.substring(4).split(';')) {
+      final e = CatalogEntry.parse(item);
+      if (e != null) entries.add(e);
+    }
+    return true;
+  }
+}
@@ -0,0 +1,28 @@
+import 'dart:typed_data';
+
+// Standard CRC-32 (IEEE 802.3 / zlib), matching crc32Update() on the
+// device. Chain calls by passing the previous result as [crc].
+class Crc32 {
+  static final Uint32List _table = _buildTable();
+
+  static Uint32List _buildTable() {
+    final table = Uint32List(256);
+    for (int i = 0; i < 256; i++) {
+      int c = i;
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) != 0 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      }
+      table[i] = c;
+    }
+    return table;
+  }
+
+  static int update(int crc, List<int> data, [int start = 0, int? end]) {
+    int c = crc ^ 0xFFFFFFFF;
+    final stop = end ?? data.length;
+    for (int i = start; i < stop; i++) {
+      c = _table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFF;
+  }
+}
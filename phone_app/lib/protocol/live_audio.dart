@@ -0,0 +1,104 @@
+import 'dart:async';
+import 'dart:ffi';
+import 'dart:typed_data';
+
+import '../native/jitter_buffer_ffi.dart';
+import 'wire_format.dart';
+
+class LiveAudioStats {
+  final int played;
+  final int concealed;
+  final int late;
+  final int skipped;
+  final int targetMs;
+  final int bufferedMs;
+  final int jitterMs;
+
+  // Mouth-to-ear delay of the last played frame, above the link's
+  // fastest one-way trip
+  final int earDelayMs;
+
+  LiveAudioStats(NativeJitterStats s)
+      : played = s.played,
+        concealed = s.concealed,
+        late = s.late,
+        skipped = s.skipped,
+        targetMs = s.targetMs,
+        bufferedMs = s.bufferedMs,
+        jitterMs = s.jitterMs,
+        earDelayMs = s.earDelayMs;
+}
+
+// Plays out the device's live audio (LIVE_AUDIO:1): live stream payloads
+// go into the native jitter buffer as they arrive, and one frame of
+// 16 kHz PCM is pulled per frame period, lost frames concealed. Needs
+// the native library; create() returns null where it is not bundled.
+class LiveAudioReceiver {
+  // LIVE_FRAME_MS / LIVE_FRAME_SAMPLES on the device
+  static const int frameMs = 20;
+  static const int frameSamples = 320;
+  static const int sampleRate = 16000;
+  static const int minDelayMs = 40;
+  static const int maxDelayMs = 400;
+
+  final JitterBufferBindings _b;
+  Pointer<NativeJitterBuffer> _jb;
+  late final Uint8List _staging =
+      _b.staging(_jb).asTypedList(_b.stagingCapacity());
+  late final Int16List _output = _b.output(_jb).asTypedList(frameSamples);
+  final Stopwatch _clock = Stopwatch()..start();
+  final StreamController<Int16List> _frames =
+      StreamController<Int16List>.broadcast();
+  Timer? _timer;
+  int _pulled = 0;
+
+  LiveAudioReceiver._(this._b, this._jb);
+
+  static LiveAudioReceiver? create() {
+    final b = JitterBufferBindings.instance;
+    if (b == null) return null;
+    final jb = b.create(frameSamples, frameMs, minDelayMs, maxDelayMs);
+    if (jb == nullptr) return null;
+    final receiver = LiveAudioReceiver._(b, jb);
+    receiver._timer = Timer.periodic(
+        const Duration(milliseconds: frameMs), (_) => receiver._pullDue());
+    return receiver;
+  }
+
+  // PCM frames in playout order, frameSamples each
+  Stream<Int16List> get frames => _frames.stream;
+
+  // One payload from the live stream; other live kinds are ignored
+  void add(Uint8List payload) {
+    if (_jb == nullptr ||
+        !LiveAudioFrame.fits(payload) ||
+        LiveAudioFrame(payload).kind != Wire.liveKindAudio ||
+        payload.length > _staging.length) {
+      return;
+    }
+    _staging.setRange(0, payload.length, payload);
+    _b.pushStaged(_jb, payload.length, _clock.elapsedMilliseconds);
+  }
+
+  LiveAudioStats get stats => LiveAudioStats(_b.stats(_jb).ref);
+
+  // Timer ticks drift, so frames are pulled by elapsed time: as many as
+  // the clock says are due
+  void _pullDue() {
+    if (_jb == nullptr) return;
+    final now = _clock.elapsedMilliseconds;
+    while ((_pulled + 1) * frameMs <= now) {
+      _b.pull(_jb, now);
+      _frames.add(Int16List.fromList(_output));
+      _pulled++;
+    }
+  }
+
+  void dispose() {
+    _timer?.cancel();
+    _frames.close();
+    if (_jb == nullptr) return;
+    _b.destroy(_jb);
+    _jb = nullptr;
+  }
+}
@@ -0,0 +1,70 @@
+import 'dart:async';
+import 'dart:ffi';
+import 'dart:typed_data';
+
+import '../native/imu_stream_ffi.dart';
+import 'wire_format.dart';
+
+// One decoded batch of device IMU samples
+class ImuBatch {
+  // 6 values per sample: accel x y z (m/s^2), gyro x y z (rad/s)
+  final Float32List samples;
+  final int timeMs; // device time of the first sample
+  final int periodUs;
+  final int lost; // batches missing just before this one
+
+  ImuBatch(this.samples, this.timeMs, this.periodUs, this.lost);
+
+  int get length => samples.length ~/ 6;
+
+  int sampleTimeUs(int i) => timeMs * 1000 + i * periodUs;
+}
+
+// Decodes the device's live IMU batches (kind Wire.liveKindImu) through
+// the native codec; create() returns null where it is not bundled.
+class LiveImuReceiver {
+  final ImuStreamBindings _b;
+  Pointer<NativeImuStream> _s;
+  late final Uint8List _staging =
+      _b.staging(_s).asTypedList(_b.stagingCapacity());
+  final StreamController<ImuBatch> _batches =
+      StreamController<ImuBatch>.broadcast();
+
+  LiveImuReceiver._(this._b, this._s);
+
+  static LiveImuReceiver? create() {
+    final b = ImuStreamBindings.instance;
+    if (b == null) return null;
+    final s = b.create();
+    if (s == nullptr) return null;
+    return LiveImuReceiver._(b, s);
+  }
+
+  Stream<ImuBatch> get batches => _batches.stream;
+
+  // One payload from the live stream; other live kinds are ignored
+  void add(Uint8List payload) {
+    if (_s == nullptr ||
+        !ImuBatchHeader.fits(payload) ||
+        ImuBatchHeader(payload).kind != Wire.liveKindImu ||
+        payload.length > _staging.length) {
+      return;
+    }
+    _staging.setRange(0, payload.length, payload);
+    final n = _b.pushStaged(_s, payload.length);
+    if (n < 0) return;
+    final batch = _b.batch(_s).ref;
+    _batches.add(ImuBatch(
+        Float32List.fromList(_b.samples(_s).asTypedList(n * 6)),
+        batch.timeMs,
+        batch.periodUs,
+        batch.lost));
+  }
+
+  void dispose() {
+    _batches.close();
+    if (_s == nullptr) return;
+    _b.destroy(_s);
+    _s = nullptr;
+  }
+}
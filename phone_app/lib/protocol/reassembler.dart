@@ -0,0 +1,205 @@
+import 'dart:convert';
+import 'dart:ffi';
+import 'dart:typed_data';
+
+import '../native/reassembly_ffi.dart';
+import 'crc32.dart';
+import 'wire_format.dart';
+
+// Outcome of one received image packet (ReassemblyStatus in reassembly.h)
+enum ReassemblyStatus { accepted, duplicate, complete, badPacket, badObject }
+
+// Collects the packets of one object into a buffer sized up front,
+// tracking them in a bitmap, and builds the reply for the device. Uses
+// the native library where it is bundled (Linux), the Dart version below
+// elsewhere; both follow the same rules.
+abstract class PacketReassembler {
+  // Ranges the device will queue at once (SESSION_MAX_RANGES)
+  static const int maxRanges = 8;
+
+  factory PacketReassembler(int size, int packets, int objectCrc) {
+    final bindings = ReassemblyBindings.instance;
+    if (bindings != null) {
+      final native = bindings.create(size, packets, objectCrc);
+      if (native != nullptr) {
+        return _NativePacketReassembler(bindings, native);
+      }
+    }
+    return _DartPacketReassembler(size, packets, objectCrc);
+  }
+
+  // [packet] from [start] to [end]: ImagePacket | payload | trailer
+  ReassemblyStatus add(List<int> packet, int start, int end);
+
+  // ACK / RESEND text for the last add()
+  String get reply;
+
+  // RESUME:<id>:<missing ranges> for a header repeated after a reconnect
+  String resumeCommand(int objectId);
+
+  int get received;
+
+  // Packets 0..ackedPackets-1 are all held
+  int get ackedPackets;
+
+  // The assembled object, once add() returned complete
+  Uint8List takeObject();
+
+  void dispose();
+}
+
+class _NativePacketReassembler implements PacketReassembler {
+  final ReassemblyBindings _b;
+  Pointer<NativeReassembler> _r;
+  late final Uint8List _staging =
+      _b.staging(_r).asTypedList(_b.stagingCapacity());
+
+  _NativePacketReassembler(this._b, this._r);
+
+  @override
+  ReassemblyStatus add(List<int> packet, int start, int end) {
+    final len = end - start;
+    if (len > _staging.length) return ReassemblyStatus.badPacket;
+    _staging.setRange(0, len, packet, start);
+    return ReassemblyStatus.values[_b.addStaged(_r, len)];
+  }
+
+  String _replyText() =>
+      latin1.decode(_b.reply(_r).asTypedList(_b.replyLength(_r)));
+
+  @override
+  String get reply => _replyText();
+
+  @override
+  String resumeCommand(int objectId) {
+    _b.buildResume(_r, objectId);
+    return _replyText();
+  }
+
+  @override
+  int get received => _b.received(_r);
+
+  @override
+  int get ackedPackets => _b.ackedPackets(_r);
+
+  @override
+  Uint8List takeObject() =>
+      Uint8List.fromList(_b.data(_r).asTypedList(_b.size(_r)));
+
+  @override
+  void dispose() {
+    if (_r == nullptr) return;
+    _b.destroy(_r);
+    _r = nullptr;
+  }
+}
+
+class _DartPacketReassembler implements PacketReassembler {
+  final int size;
+  final int packets;
+  final int objectCrc;
+  final Uint8List _data;
+  final Uint8List _held;
+  int _received = 0;
+  int _chunk = 0;
+  int _firstMissing = 0;
+  String _reply = '';
+
+  _DartPacketReassembler(this.size, this.packets, this.objectCrc)
+      : _data = Uint8List(size),
+        _held = Uint8List(packets);
+
+  @override
+  ReassemblyStatus add(List<int> packet, int start, int end) {
+    const head = ImagePacket.size;
+    const tail = ImagePacketTrailer.size;
+    final len = end - start;
+    if (len <= head + tail) {
+      _reply = '';
+      return ReassemblyStatus.badPacket;
+    }
+
+    final seq = ImagePacket(packet, start).seq;
+    final payloadLen = len - head - tail;
+    final crcAt = end - tail;
+    final sent = ImagePacketTrailer(packet, crcAt).crc;
+
+    // Only the last packet may be short; it ends at the object size
+    final last = seq == packets - 1;
+    final offset = last ? size - payloadLen : seq * payloadLen;
+    final fits = seq < packets &&
+        payloadLen <= size &&
+        (last || _chunk == 0 || payloadLen == _chunk) &&
+        (!last || _chunk == 0 || offset == seq * _chunk) &&
+        offset + payloadLen <= size;
+
+    if (!fits || Crc32.update(0, packet, start, crcAt) != sent) {
+      // The seq may be the corrupted part: ask for the lowest packet
+      // still missing; the device repeats its packet in flight with it
+      _reply = _firstMissing < packets
+          ? 'RESEND:$_firstMissing-$_firstMissing'
+          : '';
+      return ReassemblyStatus.badPacket;
+    }
+
+    _reply = 'ACK:${seq + 1}';
+    if (_held[seq] != 0) return ReassemblyStatus.duplicate;
+
+    if (!last) _chunk = payloadLen;
+    _data.setRange(offset, offset + payloadLen, packet, start + head);
+    _held[seq] = 1;
+    _received++;
+    while (_firstMissing < packets && _held[_firstMissing] != 0) {
+      _firstMissing++;
+    }
+
+    if (_received < packets) return ReassemblyStatus.accepted;
+
+    if (objectCrc != 0 && Crc32.update(0, _data) != objectCrc) {
+      // Every packet checked out, so the loss is in reassembly: start over
+      _held.fillRange(0, packets, 0);
+      _received = 0;
+      _firstMissing = 0;
+      _reply = 'RESEND:0-${packets - 1}';
+      return ReassemblyStatus.badObject;
+    }
+    return ReassemblyStatus.complete;
+  }
+
+  @override
+  String get reply => _reply;
+
+  @override
+  String resumeCommand(int objectId) {
+    final ranges = <List<int>>[];
+    int i = _firstMissing;
+    while (i < packets) {
+      if (_held[i] != 0) {
+        i++;
+        continue;
+      }
+      final from = i;
+      while (i < packets && _held[i] == 0) {
+        i++;
+      }
+      if (ranges.length == PacketReassembler.maxRanges) {
+        ranges.last[1] = packets - 1;
+        break;
+      }
+      ranges.add([from, i - 1]);
+    }
+    return 'RESUME:$objectId:${ranges.map((r) => '${r[0]}-${r[1]}').join(',')}';
+  }
+
+  @override
+  int get received => _received;
+
+  @override
+  int get ackedPackets => _firstMissing;
+
+  @override
+  Uint8List takeObject() => _data;
+
+  @override
+  void dispose() {}
+}
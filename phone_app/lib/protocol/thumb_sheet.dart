@@ -0,0 +1,50 @@
+import 'dart:typed_data';
+
+import 'capture_seal.dart';
+import 'wire_format.dart';
+
+// One photo's thumbnail from a sheet, keyed like the catalog
+class SheetThumbnail {
+  final int id;
+  final DateTime time;
+  final int flags;
+
+  // JPEG; null if it was sealed and could not be opened
+  final Uint8List? jpg;
+
+  SheetThumbnail(this.id, this.time, this.flags, this.jpg);
+}
+
+// A THUMBS reply (image kind SHEET): the thumbnails of consecutive
+// photos on the card. Ask for the next sheet with THUMBS:<nextId> unless
+// nextId is 0.
+class ThumbSheet {
+  final List<SheetThumbnail> thumbnails;
+  final int nextId;
+
+  ThumbSheet(this.thumbnails, this.nextId);
+
+  // Null if the bytes do not hold a whole sheet
+  static ThumbSheet? parse(Uint8List bytes) {
+    if (!ThumbSheetHeader.fits(bytes)) return null;
+    final header = ThumbSheetHeader(bytes);
+    final thumbnails = <SheetThumbnail>[];
+    var at = ThumbSheetHeader.size;
+    for (var i = 0; i < header.count; i++) {
+      if (!ThumbSheetEntry.fits(bytes, at)) return null;
+      final entry = ThumbSheetEntry(bytes, at);
+      final start = at + ThumbSheetEntry.size;
+      final end = start + entry.length;
+      if (end > bytes.length) return null;
+      final body = Uint8List.sublistView(bytes, start, end);
+      final sealed = (entry.flags & Wire.catalogFlagSealed) != 0;
+      thumbnails.add(SheetThumbnail(
+          entry.id,
+          DateTime.fromMillisecondsSinceEpoch(entry.time * 1000, isUtc: true),
+          entry.flags,
+          sealed ? CaptureSeal.open(body) : Uint8List.fromList(body)));
+      at = end;
+    }
+    return ThumbSheet(thumbnails, header.nextId);
+  }
+}
@@ -0,0 +1,83 @@
+import 'dart:collection';
+
+import 'reassembler.dart';
+
+// Receiver side of one object transfer, kept across disconnects so a
+// reconnect can ask the device for the missing packets only. Mirrors
+// TransferSession in the firmware (transfer_session.h).
+class TransferSession {
+  final int objectId;
+  final int kind;
+  final int size;
+  final int packets;
+  final int hash;
+  final int crc;
+  final PacketReassembler reassembler;
+
+  TransferSession(
+      this.objectId, this.kind, this.size, this.packets, this.hash, this.crc)
+      : reassembler = PacketReassembler(size, packets, crc);
+
+  bool matches(int kind, int size, int packets, int hash, int crc) =>
+      this.kind == kind &&
+      this.size == size &&
+      this.packets == packets &&
+      this.hash == hash &&
+      this.crc == crc;
+
+  // Packets 0..ackedPackets-1 are all held
+  int get ackedPackets => reassembler.ackedPackets;
+
+  // "RESUME:<id>:a-b,c-d" (an empty list: everything is here)
+  String resumeCommand() => reassembler.resumeCommand(objectId);
+}
+
+// Partial transfers by object ID, plus the IDs finished recently so a
+// header repeated after a reconnect is answered without a resend.
+class TransferSessionStore {
+  static const int _partialLimit = 4;
+  static const int _completedLimit = 32;
+
+  final LinkedHashMap<int, TransferSession> _partial =
+      LinkedHashMap<int, TransferSession>();
+  final LinkedHashSet<int> _completed = LinkedHashSet<int>();
+
+  // Session to resume for this header, or null if the object is new to us
+  TransferSession? resumable(
+      int objectId, int kind, int size, int packets, int hash, int crc) {
+    if (objectId == 0) return null;
+    final session = _partial[objectId];
+    if (session == null || !session.matches(kind, size, packets, hash, crc)) {
+      return null;
+    }
+    return session;
+  }
+
+  bool isCompleted(int objectId) =>
+      objectId != 0 && _completed.contains(objectId);
+
+  TransferSession begin(
+      int objectId, int kind, int size, int packets, int hash, int crc) {
+    final session = TransferSession(objectId, kind, size, packets, hash, crc);
+    if (objectId != 0) {
+      _partial.remove(objectId)?.reassembler.dispose();
+      _partial[objectId] = session;
+      if (_partial.length > _partialLimit) {
+        _partial.remove(_partial.keys.first)?.reassembler.dispose();
+      }
+    }
+    return session;
+  }
+
+  // Releases the session's buffer; take the object out first
+  void complete(TransferSession session) {
+    _partial.remove(session.objectId);
+    session.reassembler.dispose();
+    if (session.objectId == 0) return;
+    _completed.remove(session.objectId);
+    _completed.add(session.objectId);
+    if (_completed.length > _completedLimit) {
+      _completed.remove(_completed.first);
+    }
+  }
+}
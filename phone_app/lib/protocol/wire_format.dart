@@ -0,0 +1,400 @@
+// Generated by protocol/gen_wire.py from protocol/messages.json. Do not edit.
+
+// Views read fields straight out of the received bytes (no ByteData,
+// no copies); writers fill a preallocated buffer.
+
+class Wire {
+  static const int imageMagic = 0xFF;
+  static const int imageKindFull = 0xFF;
+  static const int imageKindPreview = 0xFE;
+  static const int imageKindDuplicate = 0xFD;
+  static const int imageKindSheet = 0xFC;
+  static const int imageFlagSealed = 0x01;
+  static const int audioFlagSealed = 0x01;
+  static const int audioHeaderOffset = 0xFFFFFFFF;
+  static const int audioWindow = 0x800;
+  static const int audioAckEvery = 0x400;
+  static const int liveKindAudio = 0x01;
+  static const int liveKindImu = 0x02;
+  static const int capturePhoto = 0x01;
+  static const int captureAudio = 0x02;
+  static const int captureVideo = 0x03;
+  static const int catalogFlagPending = 0x01;
+  static const int catalogFlagEstimated = 0x02;
+  static const int catalogFlagDuplicate = 0x04;
+  static const int catalogFlagSealed = 0x08;
+  static const int streamControl = 0x00;
+  static const int streamLive = 0x01;
+  static const int streamImage = 0x02;
+  static const int streamAudio = 0x03;
+}
+
+// Prefix of every notification: the stream the payload belongs to
+class MuxFrame {
+  static const int size = 1;
+  static const int streamOffset = 0;
+
+  final List<int> _b;
+  final int _o;
+  const MuxFrame(this._b, [this._o = 0]);
+
+  // True if [bytes] from [offset] hold a whole MuxFrame
+  static bool fits(List<int> bytes, [int offset = 0]) =>
+      bytes.length - offset >= size;
+
+  int get stream => _b[_o + streamOffset];
+  set stream(int v) {
+    _b[_o + streamOffset] = v & 0xFF;
+  }
+}
+
+// Starts an image transfer on the image stream
+class ImageHeader {
+  static const int size = 25;
+  static const int magicOffset = 0;
+  static const int kindOffset = 1;
+  static const int lengthOffset = 2;
+  static const int packetsOffset = 6;
+  static const int hashOffset = 8;
+  static const int crcOffset = 16;
+  static const int objectIdOffset = 20;
+  static const int flagsOffset = 24;
+
+  final List<int> _b;
+  final int _o;
+  const ImageHeader(this._b, [this._o = 0]);
+
+  // True if [bytes] from [offset] hold a whole ImageHeader
+  static bool fits(List<int> bytes, [int offset = 0]) =>
+      bytes.length - offset >= size;
+
+  int get magic => _b[_o + magicOffset];
+  set magic(int v) {
+    _b[_o + magicOffset] = v & 0xFF;
+  }
+
+  int get kind => _b[_o + kindOffset];
+  set kind(int v) {
+    _b[_o + kindOffset] = v & 0xFF;
+  }
+
+  int get length => _b[_o + lengthOffset] | (_b[_o + lengthOffset + 1] << 8) | (_b[_o + lengthOffset + 2] << 16) | (_b[_o + lengthOffset + 3] << 24);
+  set length(int v) {
+    _b[_o + lengthOffset] = v & 0xFF;
+    _b[_o + lengthOffset + 1] = (v >> 8) & 0xFF;
+    _b[_o + lengthOffset + 2] = (v >> 16) & 0xFF;
+    _b[_o + lengthOffset + 3] = (v >> 24) & 0xFF;
+  }
+
+  int get packets => _b[_o + packetsOffset] | (_b[_o + packetsOffset + 1] << 8);
+  set packets(int v) {
+    _b[_o + packetsOffset] = v & 0xFF;
+    _b[_o + packetsOffset + 1] = (v >> 8) & 0xFF;
+  }
+
+  int get hash => _b[_o + hashOffset] | (_b[_o + hashOffset + 1] << 8) | (_b[_o + hashOffset + 2] << 16) | (_b[_o + hashOffset + 3] << 24) | (_b[_o + hashOffset + 4] << 32) | (_b[_o + hashOffset + 5] << 40) | (_b[_o + hashOffset + 6] << 48) | (_b[_o + hashOffset + 7] << 56);
+  set hash(int v) {
+    _b[_o + hashOffset] = v & 0xFF;
+    _b[_o + hashOffset + 1] = (v >> 8) & 0xFF;
+    _b[_o + hashOffset + 2] = (v >> 16) & 0xFF;
+    _b[_o + hashOffset + 3] = (v >> 24) & 0xFF;
+    _b[_o + hashOffset + 4] = (v >> 32) & 0xFF;
+    _b[_o + hashOffset + 5] = (v >> 40) & 0xFF;
+    _b[_o + hashOffset + 6] = (v >> 48) & 0xFF;
+    _b[_o + hashOffset + 7] = (v >> 56) & 0xFF;
+  }
+
+  int get crc => _b[_o + crcOffset] | (_b[_o + crcOffset + 1] << 8) | (_b[_o + crcOffset + 2] << 16) | (_b[_o + crcOffset + 3] << 24);
+  set crc(int v) {
+    _b[_o + crcOffset] = v & 0xFF;
+    _b[_o + crcOffset + 1] = (v >> 8) & 0xFF;
+    _b[_o + crcOffset + 2] = (v >> 16) & 0xFF;
+    _b[_o + crcOffset + 3] = (v >> 24) & 0xFF;
+  }
+
+  int get objectId => _b[_o + objectIdOffset] | (_b[_o + objectIdOffset + 1] << 8) | (_b[_o + objectIdOffset + 2] << 16) | (_b[_o + objectIdOffset + 3] << 24);
+  set objectId(int v) {
+    _b[_o + objectIdOffset] = v & 0xFF;
+    _b[_o + objectIdOffset + 1] = (v >> 8) & 0xFF;
+    _b[_o + objectIdOffset + 2] = (v >> 16) & 0xFF;
+    _b[_o + objectIdOffset + 3] = (v >> 24) & 0xFF;
+  }
+
+  int get flags => _b[_o + flagsOffset];
+  set flags(int v) {
+    _b[_o + flagsOffset] = v & 0xFF;
+  }
+}
+
+// Prefix of an image data packet; the payload and an ImagePacketTrailer follow
+class ImagePacket {
+  static const int size = 2;
+  static const int seqOffset = 0;
+
+  final List<int> _b;
+  final int _o;
+  const ImagePacket(this._b, [this._o = 0]);
+
+  // True if [bytes] from [offset] hold a whole ImagePacket
+  static bool fits(List<int> bytes, [int offset = 0]) =>
+      bytes.length - offset >= size;
+
+  int get seq => _b[_o + seqOffset + 1] | (_b[_o + seqOffset] << 8);
+  set seq(int v) {
+    _b[_o + seqOffset] = (v >> 8) & 0xFF;
+    _b[_o + seqOffset + 1] = v & 0xFF;
+  }
+}
+
+// Ends an image data packet: CRC-32 of the ImagePacket prefix and the payload
+class ImagePacketTrailer {
+  static const int size = 4;
+  static const int crcOffset = 0;
+
+  final List<int> _b;
+  final int _o;
+  const ImagePacketTrailer(this._b, [this._o = 0]);
+
+  // True if [bytes] from [offset] hold a whole ImagePacketTrailer
+  static bool fits(List<int> bytes, [int offset = 0]) =>
+      bytes.length - offset >= size;
+
+  int get crc => _b[_o + crcOffset] | (_b[_o + crcOffset + 1] << 8) | (_b[_o + crcOffset + 2] << 16) | (_b[_o + crcOffset + 3] << 24);
+  set crc(int v) {
+    _b[_o + crcOffset] = v & 0xFF;
+    _b[_o + crcOffset + 1] = (v >> 8) & 0xFF;
+    _b[_o + crcOffset + 2] = (v >> 16) & 0xFF;
+    _b[_o + crcOffset + 3] = (v >> 24) & 0xFF;
+  }
+}
+
+// Prefix of every audio stream payload: the clip offset of the bytes that follow, or AUDIO_HEADER_OFFSET before an AudioHeader. The phone answers AUDIO_ACK:<bytes held> every AUDIO_ACK_EVERY bytes and at the end; the device keeps at most AUDIO_WINDOW bytes unacknowledged
+class AudioChunk {
+  static const int size = 4;
+  static const int offsetOffset = 0;
+
+  final List<int> _b;
+  final int _o;
+  const AudioChunk(this._b, [this._o = 0]);
+
+  // True if [bytes] from [offset] hold a whole AudioChunk
+  static bool fits(List<int> bytes, [int offset = 0]) =>
+      bytes.length - offset >= size;
+
+  int get offset => _b[_o + offsetOffset] | (_b[_o + offsetOffset + 1] << 8) | (_b[_o + offsetOffset + 2] << 16) | (_b[_o + offsetOffset + 3] << 24);
+  set offset(int v) {
+    _b[_o + offsetOffset] = v & 0xFF;
+    _b[_o + offsetOffset + 1] = (v >> 8) & 0xFF;
+    _b[_o + offsetOffset + 2] = (v >> 16) & 0xFF;
+    _b[_o + offsetOffset + 3] = (v >> 24) & 0xFF;
+  }
+}
+
+// Starts a recorded clip (IMA ADPCM WAV of the voiced segments) on the audio stream; sent again, from offset 0, after a reconnect
+class AudioHeader {
+  static const int size = 5;
+  static const int sizeOffset = 0;
+  static const int flagsOffset = 4;
+
+  final List<int> _b;
+  final int _o;
+  const AudioHeader(this._b, [this._o = 0]);
+
+  // True if [bytes] from [offset] hold a whole AudioHeader
+  static bool fits(List<int> bytes, [int offset = 0]) =>
+      bytes.length - offset >= size;
+
+  int get size => _b[_o + sizeOffset] | (_b[_o + sizeOffset + 1] << 8) | (_b[_o + sizeOffset + 2] << 16) | (_b[_o + sizeOffset + 3] << 24);
+  set size(int v) {
+    _b[_o + sizeOffset] = v & 0xFF;
+    _b[_o + sizeOffset + 1] = (v >> 8) & 0xFF;
+    _b[_o + sizeOffset + 2] = (v >> 16) & 0xFF;
+    _b[_o + sizeOffset + 3] = (v >> 24) & 0xFF;
+  }
+
+  int get flags => _b[_o + flagsOffset];
+  set flags(int v) {
+    _b[_o + flagsOffset] = v & 0xFF;
+  }
+}
+
+// One live audio frame on the live stream; a single IMA ADPCM block (adpcm.h layout) of `samples` samples follows
+class LiveAudioFrame {
+  static const int size = 9;
+  static const int kindOffset = 0;
+  static const int seqOffset = 1;
+  static const int timeMsOffset = 3;
+  static const int samplesOffset = 7;
+
+  final List<int> _b;
+  final int _o;
+  const LiveAudioFrame(this._b, [this._o = 0]);
+
+  // True if [bytes] from [offset] hold a whole LiveAudioFrame
+  static bool fits(List<int> bytes, [int offset = 0]) =>
+      bytes.length - offset >= size;
+
+  int get kind => _b[_o + kindOffset];
+  set kind(int v) {
+    _b[_o + kindOffset] = v & 0xFF;
+  }
+
+  int get seq => _b[_o + seqOffset] | (_b[_o + seqOffset + 1] << 8);
+  set seq(int v) {
+    _b[_o + seqOffset] = v & 0xFF;
+    _b[_o + seqOffset + 1] = (v >> 8) & 0xFF;
+  }
+
+  int get timeMs => _b[_o + timeMsOffset] | (_b[_o + timeMsOffset + 1] << 8) | (_b[_o + timeMsOffset + 2] << 16) | (_b[_o + timeMsOffset + 3] << 24);
+  set timeMs(int v) {
+    _b[_o + timeMsOffset] = v & 0xFF;
+    _b[_o + timeMsOffset + 1] = (v >> 8) & 0xFF;
+    _b[_o + timeMsOffset + 2] = (v >> 16) & 0xFF;
+    _b[_o + timeMsOffset + 3] = (v >> 24) & 0xFF;
+  }
+
+  int get samples => _b[_o + samplesOffset] | (_b[_o + samplesOffset + 1] << 8);
+  set samples(int v) {
+    _b[_o + samplesOffset] = v & 0xFF;
+    _b[_o + samplesOffset + 1] = (v >> 8) & 0xFF;
+  }
+}
+
+// A batch of IMU samples on the live stream (imu_batch.h): `count` samples `period_us` apart from time_ms, each six raw counts (accel x y z, gyro x y z) as zigzag varint deltas against the previous sample
+class ImuBatchHeader {
+  static const int size = 16;
+  static const int kindOffset = 0;
+  static const int seqOffset = 1;
+  static const int timeMsOffset = 3;
+  static const int periodUsOffset = 7;
+  static const int countOffset = 11;
+  static const int accelLsbPerGOffset = 12;
+  static const int gyroLsbPerDpsX10Offset = 14;
+
+  final List<int> _b;
+  final int _o;
+  const ImuBatchHeader(this._b, [this._o = 0]);
+
+  // True if [bytes] from [offset] hold a whole ImuBatchHeader
+  static bool fits(List<int> bytes, [int offset = 0]) =>
+      bytes.length - offset >= size;
+
+  int get kind => _b[_o + kindOffset];
+  set kind(int v) {
+    _b[_o + kindOffset] = v & 0xFF;
+  }
+
+  int get seq => _b[_o + seqOffset] | (_b[_o + seqOffset + 1] << 8);
+  set seq(int v) {
+    _b[_o + seqOffset] = v & 0xFF;
+    _b[_o + seqOffset + 1] = (v >> 8) & 0xFF;
+  }
+
+  int get timeMs => _b[_o + timeMsOffset] | (_b[_o + timeMsOffset + 1] << 8) | (_b[_o + timeMsOffset + 2] << 16) | (_b[_o + timeMsOffset + 3] << 24);
+  set timeMs(int v) {
+    _b[_o + timeMsOffset] = v & 0xFF;
+    _b[_o + timeMsOffset + 1] = (v >> 8) & 0xFF;
+    _b[_o + timeMsOffset + 2] = (v >> 16) & 0xFF;
+    _b[_o + timeMsOffset + 3] = (v >> 24) & 0xFF;
+  }
+
+  int get periodUs => _b[_o + periodUsOffset] | (_b[_o + periodUsOffset + 1] << 8) | (_b[_o + periodUsOffset + 2] << 16) | (_b[_o + periodUsOffset + 3] << 24);
+  set periodUs(int v) {
+    _b[_o + periodUsOffset] = v & 0xFF;
+    _b[_o + periodUsOffset + 1] = (v >> 8) & 0xFF;
+    _b[_o + periodUsOffset + 2] = (v >> 16) & 0xFF;
+    _b[_o + periodUsOffset + 3] = (v >> 24) & 0xFF;
+  }
+
+  int get count => _b[_o + countOffset];
+  set count(int v) {
+    _b[_o + countOffset] = v & 0xFF;
+  }
+
+  int get accelLsbPerG => _b[_o + accelLsbPerGOffset] | (_b[_o + accelLsbPerGOffset + 1] << 8);
+  set accelLsbPerG(int v) {
+    _b[_o + accelLsbPerGOffset] = v & 0xFF;
+    _b[_o + accelLsbPerGOffset + 1] = (v >> 8) & 0xFF;
+  }
+
+  int get gyroLsbPerDpsX10 => _b[_o + gyroLsbPerDpsX10Offset] | (_b[_o + gyroLsbPerDpsX10Offset + 1] << 8);
+  set gyroLsbPerDpsX10(int v) {
+    _b[_o + gyroLsbPerDpsX10Offset] = v & 0xFF;
+    _b[_o + gyroLsbPerDpsX10Offset + 1] = (v >> 8) & 0xFF;
+  }
+}
+
+// Starts a thumbnail sheet (image kind SHEET): `count` entries follow, each a ThumbSheetEntry and its thumbnail; the next sheet starts at next_id
+class ThumbSheetHeader {
+  static const int size = 6;
+  static const int countOffset = 0;
+  static const int nextIdOffset = 2;
+
+  final List<int> _b;
+  final int _o;
+  const ThumbSheetHeader(this._b, [this._o = 0]);
+
+  // True if [bytes] from [offset] hold a whole ThumbSheetHeader
+  static bool fits(List<int> bytes, [int offset = 0]) =>
+      bytes.length - offset >= size;
+
+  int get count => _b[_o + countOffset] | (_b[_o + countOffset + 1] << 8);
+  set count(int v) {
+    _b[_o + countOffset] = v & 0xFF;
+    _b[_o + countOffset + 1] = (v >> 8) & 0xFF;
+  }
+
+  int get nextId => _b[_o + nextIdOffset] | (_b[_o + nextIdOffset + 1] << 8) | (_b[_o + nextIdOffset + 2] << 16) | (_b[_o + nextIdOffset + 3] << 24);
+  set nextId(int v) {
+    _b[_o + nextIdOffset] = v & 0xFF;
+    _b[_o + nextIdOffset + 1] = (v >> 8) & 0xFF;
+    _b[_o + nextIdOffset + 2] = (v >> 16) & 0xFF;
+    _b[_o + nextIdOffset + 3] = (v >> 24) & 0xFF;
+  }
+}
+
+// One thumbnail in a sheet: the capture's catalog record, then `length` bytes of JPEG (sealed when flags has CATALOG_FLAG_SEALED)
+class ThumbSheetEntry {
+  static const int size = 13;
+  static const int idOffset = 0;
+  static const int timeOffset = 4;
+  static const int flagsOffset = 8;
+  static const int lengthOffset = 9;
+
+  final List<int> _b;
+  final int _o;
+  const ThumbSheetEntry(this._b, [this._o = 0]);
+
+  // True if [bytes] from [offset] hold a whole ThumbSheetEntry
+  static bool fits(List<int> bytes, [int offset = 0]) =>
+      bytes.length - offset >= size;
+
+  int get id => _b[_o + idOffset] | (_b[_o + idOffset + 1] << 8) | (_b[_o + idOffset + 2] << 16) | (_b[_o + idOffset + 3] << 24);
+  set id(int v) {
+    _b[_o + idOffset] = v & 0xFF;
+    _b[_o + idOffset + 1] = (v >> 8) & 0xFF;
+    _b[_o + idOffset + 2] = (v >> 16) & 0xFF;
+    _b[_o + idOffset + 3] = (v >> 24) & 0xFF;
+  }
+
+  int get time => _b[_o + timeOffset] | (_b[_o + timeOffset + 1] << 8) | (_b[_o + timeOffset + 2] << 16) | (_b[_o + timeOffset + 3] << 24);
+  set time(int v) {
+    _b[_o + timeOffset] = v & 0xFF;
+    _b[_o + timeOffset + 1] = (v >> 8) & 0xFF;
+    _b[_o + timeOffset + 2] = (v >> 16) & 0xFF;
+    _b[_o + timeOffset + 3] = (v >> 24) & 0xFF;
+  }
+
+  int get flags => _b[_o + flagsOffset];
+  set flags(int v) {
+    _b[_o + flagsOffset] = v & 0xFF;
+  }
+
+  int get length => _b[_o + lengthOffset] | (_b[_o + lengthOffset + 1] << 8) | (_b[_o + lengthOffset + 2] << 16) | (_b[_o + lengthOffset + 3] << 24);
+  set length(int v) {
+    _b[_o + lengthOffset] = v & 0xFF;
+    _b[_o + lengthOffset + 1] = (v >> 8) & 0xFF;
+    _b[_o + lengthOffset + 2] = (v >> 16) & 0xFF;
+    _b[_o + lengthOffset + 3] = (v >> 24) & 0xFF;
+  }
+}
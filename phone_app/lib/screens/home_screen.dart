@@ -957,6 +957,23 @@ A6 02 D2 52 B8 05 25 02 16 92 98 C2 96 81 0E A5 A0 0F FF D9
       });
     });
 
+    _bleService.statusStream.listen((status) {
+      if (status.startsWith('SKIP:') && mounted) {
+        ScaffoldMessenger.of(context).showSnackBar(
+          const SnackBar(
+            content: Text('Capture skipped: scene unchanged'),
+            duration: Duration(seconds: 2),
+          ),
+        );
+      }
+    });
+
+    _bleService.previewStream.listen((data) {
+      if (data.isNotEmpty) {
+        _handlePreviewImage(data);
+      }
+    });
+
     _bleService.imageStream.listen((data) {
       if (data.length > 0) {
         print(data);
@@ -993,6 +1010,22 @@ A6 02 D2 52 B8 05 25 02 16 92 98 C2 96 81 0E A5 A0 0F FF D9
     });
   }
 
+  // Show the thumbnail right away; it is replaced when the full frame
+  // of the same shot arrives and is saved.
+  Future<void> _handlePreviewImage(Uint8List previewData) async {
+    try {
+      final directory = await getTemporaryDirectory();
+      final file = File(
+          '${directory.path}/preview_${DateTime.now().millisecondsSinceEpoch}.jpg');
+      await file.writeAsBytes(previewData, flush: true);
+      setState(() {
+        currentImagePath = file.path;
+      });
+    } catch (e) {
+      print('Error showing preview: $e');
+    }
+  }
+
   Future<void> _handleCompleteImage(Uint8List imageData) async {
     setState(() {
       _currentImageData = imageData;
@@ -1,8 +1,19 @@
 import 'dart:async';
 import 'dart:convert';
+import 'dart:io' show Platform;
 import 'dart:typed_data';
 import 'package:flutter_blue_plus/flutter_blue_plus.dart';
 import 'package:permission_handler/permission_handler.dart';
+import '../protocol/audio_clip.dart';
+import '../protocol/capture_seal.dart';
+import '../protocol/catalog.dart';
+import '../protocol/live_audio.dart';
+import '../protocol/live_imu.dart';
+import '../protocol/reassembler.dart';
+import '../protocol/thumb_sheet.dart';
+import '../protocol/transfer_session.dart';
+import '../protocol/wire_format.dart';
+import 'recent_image_cache.dart';
 
 class BLEService {
   static final BLEService _instance = BLEService._internal();
@@ -19,19 +30,64 @@ class BLEService {
   BluetoothDevice? _device;
   BluetoothCharacteristic? _commandCharacteristic;
   bool receivingImage = false;
+  bool receivingPreview = false;
+  bool receivingSheet = false;
   int expectedPackets = 0;
   int receivedPackets = 0;
   final List<int> _rxBuffer = [];
-  final Map<int, Uint8List> packetBuffer = {};
   int imageSize = 0;
+  int imageHash = 0;
+  int imageCrc = 0;
+  bool imageSealed = false;
+
+  // Transfers survive a disconnect: the device repeats the header of the
+  // object it was sending and we answer with the packets still missing.
+  final TransferSessionStore _sessions = TransferSessionStore();
+  TransferSession? _session;
+
+  // Recently received full frames by device content hash, so a
+  // duplicate reference (header kind 0xFD) can be served locally.
+  final RecentImageCache _recentImages = RecentImageCache();
   final StreamController<Uint8List> _imageStreamController =
       StreamController<Uint8List>.broadcast();
   Stream<Uint8List> get imageStream => _imageStreamController.stream;
 
+  // Thumbnail of a shot, delivered before the full frame of that shot
+  final StreamController<Uint8List> _previewStreamController =
+      StreamController<Uint8List>.broadcast();
+  Stream<Uint8List> get previewStream => _previewStreamController.stream;
+
+  // Thumbnail sheets asked for with requestThumbnails
+  final StreamController<ThumbSheet> _thumbSheetStreamController =
+      StreamController<ThumbSheet>.broadcast();
+  Stream<ThumbSheet> get thumbSheetStream =>
+      _thumbSheetStreamController.stream;
+
+  // Recorded clips (IMA ADPCM WAV), whole and opened if sealed
+  final AudioClipReceiver _audioClips = AudioClipReceiver();
   final StreamController<Uint8List> _audioStreamController =
       StreamController<Uint8List>.broadcast();
   Stream<Uint8List> get audioStream => _audioStreamController.stream;
 
+  // Live audio / IMU features, interleaved with bulk transfers
+  final StreamController<Uint8List> _liveStreamController =
+      StreamController<Uint8List>.broadcast();
+  Stream<Uint8List> get liveStream => _liveStreamController.stream;
+
+  // Live microphone audio after the jitter buffer, while it is on
+  LiveAudioReceiver? _liveAudio;
+  Stream<Int16List>? get liveAudioFrames => _liveAudio?.frames;
+  LiveAudioStats? get liveAudioStats => _liveAudio?.stats;
+
+  // Device IMU batches decoded to SI units; null without the native codec
+  late final LiveImuReceiver? _liveImu = LiveImuReceiver.create();
+  Stream<ImuBatch>? get liveImuBatches => _liveImu?.batches;
+
+  // Text replies from the device (e.g. METRICS)
+  final StreamController<String> _statusStreamController =
+      StreamController<String>.broadcast();
+  Stream<String> get statusStream => _statusStreamController.stream;
+
   bool _isConnected = false;
   bool get isConnected => _isConnected;
 
@@ -87,6 +143,12 @@ class BLEService {
       _device = device;
       await device.connect();
       _isConnected = true;
+      // A transfer cut off by the disconnect stays in _sessions; its
+      // header will arrive again.
+      receivingImage = false;
+      _session = null;
+      // A clip cut off by the disconnect is sent again from the start
+      _audioClips.reset();
       // Discover services
       List<BluetoothService> services = await device.discoverServices();
       for (var service in services) {
@@ -94,22 +156,130 @@ class BLEService {
           if (characteristic.uuid.toString() == CAMERA_CHARACTERISTIC_UUID) {
             _commandCharacteristic = characteristic;
             await characteristic.setNotifyValue(true);
-            characteristic.onValueReceived.listen((value) async {
-              // Convert the received value to a hex string
-              // print(value);
-              if (value.isEmpty) return;
+            // Tells the device we are subscribed, so it can repeat the
+            // header of a transfer the disconnect interrupted
+            await characteristic.write(utf8.encode("SYNC"),
+                withoutResponse: true);
+            // The device has no clock of its own; captures are filed
+            // under the time it gets here
+            await characteristic.write(utf8.encode(_timeCommand()),
+                withoutResponse: true);
+            characteristic.onValueReceived.listen((frame) async {
+              // Every notification is a multiplexed frame: MuxFrame, then
+              // the stream's payload from [at]. Layouts are generated from
+              // protocol/messages.json; fields are read in place.
+              const at = MuxFrame.size;
+              if (frame.length <= at) return;
+              final stream = MuxFrame(frame).stream;
+
+              // -------- RECORDED CLIP --------
+              // AudioChunk | AudioHeader or clip bytes; acknowledged as
+              // they arrive so the device can keep sending
+              if (stream == Wire.streamAudio) {
+                final clip = _audioClips.add(frame, at);
+                final reply = _audioClips.reply;
+                if (reply != null) {
+                  await characteristic.write(utf8.encode(reply),
+                      withoutResponse: true);
+                }
+                if (clip == null) return;
+                final audioBytes =
+                    _audioClips.sealed ? CaptureSeal.open(clip) : clip;
+                if (audioBytes == null) {
+                  print("Sealed audio clip could not be opened");
+                  return;
+                }
+                print("Audio clip complete: ${audioBytes.length} bytes");
+                _audioStreamController.add(audioBytes);
+                return;
+              }
+              if (stream == Wire.streamLive) {
+                final payload = Uint8List.fromList(frame.sublist(at));
+                _liveAudio?.add(payload);
+                _liveImu?.add(payload);
+                _liveStreamController.add(payload);
+                return;
+              }
+
+              // -------- STATUS TEXT --------
+              if (stream == Wire.streamControl) {
+                final text = utf8.decode(frame.sublist(at), allowMalformed: true);
+                print("Device status: $text");
+                if (text.startsWith('FETCH:GONE:')) {
+                  // The original of a reference is no longer on the card
+                  print("Duplicate image ${text.substring(11)} is lost");
+                }
+                _statusStreamController.add(text);
+                return;
+              }
+
+              if (stream != Wire.streamImage) return;
 
               // -------- HEADER --------
+              // Kind: full frame, preview thumbnail, thumbnail sheet, or
+              // duplicate of an earlier frame (no packets). Object ID 0:
+              // no resume.
+              final header = ImageHeader(frame, at);
+              final kind = ImageHeader.fits(frame, at) ? header.kind : -1;
               if (!receivingImage &&
-                  value.length == 8 &&
-                  value[0] == 0xFF &&
-                  value[1] == 0xFF) {
-                final data = ByteData.sublistView(Uint8List.fromList(value));
-                imageSize = data.getUint32(2, Endian.little);
-                expectedPackets = data.getUint16(6, Endian.little);
-
-                packetBuffer.clear();
+                  header.magic == Wire.imageMagic &&
+                  (kind == Wire.imageKindFull ||
+                      kind == Wire.imageKindPreview ||
+                      kind == Wire.imageKindSheet ||
+                      kind == Wire.imageKindDuplicate)) {
+                imageSize = header.length;
+                expectedPackets = header.packets;
+                imageHash = header.hash;
+                imageCrc = header.crc;
+                imageSealed = (header.flags & Wire.imageFlagSealed) != 0;
+                final objectId = header.objectId;
+
+                if (kind == Wire.imageKindDuplicate) {
+                  final hex = RecentImageCache.hex(imageHash);
+                  final cached = await _recentImages.lookup(imageHash);
+                  if (cached != null) {
+                    print("Duplicate image $hex");
+                    _imageStreamController.add(cached);
+                  } else {
+                    // Not kept here (any more): the device sends the
+                    // original from its card as a full frame
+                    print("Duplicate of unknown image $hex, fetching");
+                    await characteristic.write(
+                      utf8.encode("FETCH:$hex:$imageSize"),
+                      withoutResponse: true,
+                    );
+                  }
+                  return;
+                }
+
+                if (_sessions.isCompleted(objectId)) {
+                  // Finished here, but the last ACK never reached the device
+                  await characteristic.write(
+                    utf8.encode("RESUME:$objectId:"),
+                    withoutResponse: true,
+                  );
+                  return;
+                }
+
                 receivingImage = true;
+                receivingPreview = kind == Wire.imageKindPreview;
+                receivingSheet = kind == Wire.imageKindSheet;
+
+                final partial = _sessions.resumable(objectId, kind,
+                    imageSize, expectedPackets, imageHash, imageCrc);
+                if (partial != null) {
+                  _session = partial;
+                  print("Image resume: object $objectId, "
+                      "${partial.ackedPackets}/$expectedPackets packets held");
+                  await characteristic.write(
+                    utf8.encode(partial.resumeCommand()),
+                    withoutResponse: true,
+                  );
+                  return;
+                }
+
+                _session = _sessions.begin(objectId, kind, imageSize,
+                    expectedPackets, imageHash, imageCrc);
 
                 await characteristic.write(
                   utf8.encode("ACK:0"),
@@ -122,45 +292,68 @@ class BLEService {
               }
 
               // -------- DATA --------
-              if (receivingImage && value.length > 2) {
-                final seq = (value[0] << 8) | value[1];
-                final payload = Uint8List.fromList(value.sublist(2));
-
-                packetBuffer[seq] = payload;
-                final int ackN = seq + 1;
-                print("SEND ACK");
-                print(ackN);
-                await characteristic.write(
-                  utf8.encode("ACK:$ackN"),
-                );
-                bool allPacketsReceived = true;
-                for (int i = 0; i < expectedPackets; i++) {
-                  if (!packetBuffer.containsKey(i)) {
-                    allPacketsReceived = false;
-                    break;
+              // ImagePacket | payload | ImagePacketTrailer; checked and
+              // placed by the session's reassembler, which also words
+              // the reply (ACK, or RESEND for a bad packet / object)
+              final session = _session;
+              if (receivingImage &&
+                  session != null &&
+                  frame.length >
+                      at + ImagePacket.size + ImagePacketTrailer.size) {
+                final reassembler = session.reassembler;
+                final status = reassembler.add(frame, at, frame.length);
+                final reply = reassembler.reply;
+
+                if (status == ReassemblyStatus.badPacket) {
+                  print("Packet failed CRC, requesting resend ($reply)");
+                  if (reply.isNotEmpty) {
+                    await characteristic.write(utf8.encode(reply));
                   }
+                  return;
                 }
-                if (allPacketsReceived) {
-                  final builder = BytesBuilder();
-                  for (int i = 0; i < expectedPackets; i++) {
-                    builder.add(packetBuffer[i]!);
-                  }
+                if (status == ReassemblyStatus.badObject) {
+                  print("Image failed CRC, requesting all packets");
+                  await characteristic.write(utf8.encode(reply));
+                  return;
+                }
+
+                if (status == ReassemblyStatus.complete) {
+                  final received = reassembler.takeObject();
+                  final imageBytes =
+                      imageSealed ? CaptureSeal.open(received) : received;
 
-                  final imageBytes = builder.toBytes();
-                  _imageStreamController.add( Uint8List.fromList([...imageBytes, 0xFF, 0xD9]));
+                  if (imageBytes == null) {
+                    // Still acknowledged: resending would not help
+                    final why = CaptureSeal.available
+                        ? 'wrong key or corrupted'
+                        : 'no native support';
+                    print("Sealed image could not be opened ($why)");
+                  } else if (receivingPreview) {
+                    _previewStreamController.add(imageBytes);
+                  } else if (receivingSheet) {
+                    final sheet = ThumbSheet.parse(imageBytes);
+                    if (sheet != null) {
+                      _thumbSheetStreamController.add(sheet);
+                    } else {
+                      print("Malformed thumbnail sheet");
+                    }
+                  } else {
+                    if (imageHash != 0) {
+                      await _recentImages.store(imageHash, imageBytes);
+                    }
+                    _imageStreamController.add(imageBytes);
+                  }
 
                   receivingImage = false;
-                  packetBuffer.clear();
+                  _sessions.complete(session);
+                  _session = null;
 
                   print("Image complete");
                 }
+                print("SEND $reply");
+                await characteristic.write(utf8.encode(reply));
               }
             });
-          } else if (characteristic.uuid.toString() ==
-              AUDIO_CHARACTERISTIC_UUID) {
-            characteristic.onValueReceived.listen((value) {
-              _audioStreamController.add(Uint8List.fromList(value));
-            });
           }
         }
       }
@@ -211,8 +404,171 @@ class BLEService {
     await sendCommand('STOP_AUDIO');
   }
 
+  Future<void> setCaptureBudget(Duration budget) async {
+    await sendCommand('CAMERA_BUDGET:${budget.inMilliseconds}');
+  }
+
+  Future<void> setPreviewEnabled(bool enabled) async {
+    await sendCommand('CAMERA_PREVIEW:${enabled ? 1 : 0}');
+  }
+
+  // Keep the camera streaming between shots (fastest shutter, more
+  // power) instead of putting it in standby when idle
+  Future<void> setCameraWarm(bool warm) async {
+    await sendCommand('CAMERA_WARM:${warm ? 1 : 0}');
+  }
+
+  // Record an MJPEG clip to the device's card. Previews of every few
+  // frames arrive on previewStream while it runs; the end is reported on
+  // statusStream as "VIDEO:DONE:<frames>:<ms>".
+  Future<void> startVideoClip(int seconds,
+      {int fps = 0, bool withAudio = false}) async {
+    await sendCommand('VIDEO:$seconds:$fps:${withAudio ? 1 : 0}');
+  }
+
+  Future<void> stopVideoClip() async {
+    await sendCommand('VIDEO_STOP');
+  }
+
+  // Streams the microphone as it is captured, 20 ms frames played out
+  // through liveAudioFrames. False where the native jitter buffer is not
+  // bundled.
+  Future<bool> startLiveAudio() async {
+    _liveAudio ??= LiveAudioReceiver.create();
+    if (_liveAudio == null) return false;
+    await sendCommand('LIVE_AUDIO:1');
+    return true;
+  }
+
+  Future<void> stopLiveAudio() async {
+    await sendCommand('LIVE_AUDIO:0');
+    _liveAudio?.dispose();
+    _liveAudio = null;
+  }
+
+  // Sets the format of the next recordings; fields left null keep their
+  // current value. The device stores it and answers on statusStream with
+  // "AUDIO_CONFIG:rate=..,bits=..,gain=..,secs=..,codec=.." (or BAD /
+  // BUSY / FAILED). Live audio needs a 16 kHz rate.
+  Future<void> setAudioConfig(
+      {int? sampleRate,
+      int? bits,
+      int? gain,
+      int? maxSeconds,
+      bool? adpcm}) async {
+    final fields = <String>[
+      if (sampleRate != null) 'rate=$sampleRate',
+      if (bits != null) 'bits=$bits',
+      if (gain != null) 'gain=$gain',
+      if (maxSeconds != null) 'secs=$maxSeconds',
+      if (adpcm != null) 'codec=${adpcm ? 'adpcm' : 'pcm'}',
+    ];
+    if (fields.isEmpty) return;
+    await sendCommand('AUDIO_CONFIG:${fields.join(',')}');
+  }
+
+  Future<void> queryAudioConfig() async {
+    await sendCommand('AUDIO_CONFIG?');
+  }
+
+  // Let the device skip or downgrade captures of an unchanged scene;
+  // decisions arrive on statusStream as "SKIP:n/N" / "DOWNGRADE:n/N".
+  Future<void> setMotionGate(bool enabled) async {
+    await sendCommand('MOTION_GATE:${enabled ? 1 : 0}');
+  }
+
+  // Has the device seal every capture (SD card and BLE) under [key], 32
+  // bytes the app keeps; replies "CRYPTO_KEY:OK", then "CRYPTO:1". The
+  // device only takes these over an encrypted link: otherwise it replies
+  // "CRYPTO_KEY:INSECURE" / "CRYPTO:INSECURE" and asks to pair, and the
+  // call should be repeated once pairing is done.
+  Future<void> enableCaptureEncryption(List<int> key) async {
+    final hex = key.map((b) => b.toRadixString(16).padLeft(2, '0')).join();
+    await _bond();
+    CaptureSeal.setKey(key);
+    await sendCommand('CRYPTO_KEY:$hex');
+    await sendCommand('CRYPTO:1');
+  }
+
+  Future<void> disableCaptureEncryption() async {
+    await _bond();
+    await sendCommand('CRYPTO:0');
+  }
+
+  // Android pairs on request; iOS pairs when the device asks
+  Future<void> _bond() async {
+    final device = _device;
+    if (device == null || !Platform.isAndroid) return;
+    try {
+      await device.createBond();
+    } catch (e) {
+      print('Bonding failed: $e');
+    }
+  }
+
+  Future<void> requestMetrics() async {
+    await sendCommand('METRICS');
+  }
+
+  // "TASKS:<name>:<core>:<prio>:<cpu permille>:<min free stack>;..." on
+  // statusStream, one line per frame; core '*' is unpinned
+  Future<void> requestTaskReport() async {
+    await sendCommand('TASKS?');
+  }
+
+  // Thumbnails of the photos on the card from catalog ID [fromId] on,
+  // up to [count] (1 to 128) in one transfer. The sheet arrives on
+  // thumbSheetStream after "THUMBS:<count>:<nextId>" on statusStream;
+  // continue from sheet.nextId until it is 0.
+  Future<void> requestThumbnails(int fromId, {int count = 128}) async {
+    await sendCommand('THUMBS:$fromId:$count');
+  }
+
+  String _timeCommand() =>
+      'TIME:${DateTime.now().millisecondsSinceEpoch ~/ 1000}';
+
+  // Sets the device clock; sent on every connect. Replies "TIME:OK".
+  Future<void> syncTime() async {
+    await sendCommand(_timeCommand());
+  }
+
+  // Captures stored on the device between [from] and [to], both
+  // included, up to 32 per page; for the rest ask again with
+  // skip: page.skip + page.entries.length while page.hasMore. Null if
+  // the device has no card or the reply does not come.
+  Future<CatalogPage?> queryCaptures(DateTime from, DateTime to,
+      {int skip = 0,
+      Duration timeout = const Duration(seconds: 5)}) async {
+    CatalogPage? page;
+    final done = Completer<CatalogPage?>();
+    final sub = statusStream.listen((text) {
+      if (page == null) {
+        page = CatalogPage.start(text);
+        if (text == 'CATALOG:UNAVAILABLE') done.complete(null);
+      } else {
+        page!.add(text);
+      }
+      if (page != null && page!.complete && !done.isCompleted) {
+        done.complete(page);
+      }
+    });
+    try {
+      await sendCommand('QUERY:${from.millisecondsSinceEpoch ~/ 1000}:'
+          '${to.millisecondsSinceEpoch ~/ 1000}:$skip');
+      return await done.future.timeout(timeout, onTimeout: () => null);
+    } finally {
+      await sub.cancel();
+    }
+  }
+
   void dispose() {
     _imageStreamController.close();
+    _previewStreamController.close();
+    _thumbSheetStreamController.close();
     _audioStreamController.close();
+    _liveStreamController.close();
+    _liveAudio?.dispose();
+    _liveImu?.dispose();
+    _statusStreamController.close();
   }
 }
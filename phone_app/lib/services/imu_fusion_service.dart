@@ -1,7 +1,9 @@
 import 'dart:async';
 import 'dart:collection';
+import 'dart:ffi';
 import 'dart:math';
 import 'package:sensors_plus/sensors_plus.dart';
+import '../native/imu_fusion_ffi.dart';
 
 class IMUFusionService {
   static final IMUFusionService _instance = IMUFusionService._internal();
@@ -22,6 +24,16 @@ class IMUFusionService {
   Timer? _analysisTimer;
   bool _isAnalyzing = false;
 
+  // Native engine (phone_app/native/imu_fusion.cc) where it is bundled:
+  // windowed statistics plus orientation, evaluated as samples arrive and
+  // reported only on change. Otherwise the Dart analysis below runs on a
+  // timer.
+  static const int _maxSampleRateHz = 200;
+  static const int _evaluateIntervalMs = 100;
+  final ImuFusionBindings? _native = ImuFusionBindings.instance;
+  Pointer<NativeImuFusion> _engine = nullptr;
+  final Stopwatch _clock = Stopwatch()..start();
+
   // Set window size
   void setWindowSize(int milliseconds) {
     if (milliseconds > 0) {
@@ -38,6 +50,12 @@ class IMUFusionService {
     if (_isAnalyzing) return;
     _isAnalyzing = true;
 
+    final native = _native;
+    if (native != null) {
+      _engine = native.create(_windowSizeMs, _maxSampleRateHz);
+      if (_engine != nullptr) return;
+    }
+
     _analysisTimer = Timer.periodic(const Duration(milliseconds: 100), (timer) {
       _analyzeData();
     });
@@ -47,21 +65,41 @@ class IMUFusionService {
   void stopAnalysis() {
     _analysisTimer?.cancel();
     _analysisTimer = null;
+    if (_engine != nullptr) {
+      _native!.destroy(_engine);
+      _engine = nullptr;
+    }
     _isAnalyzing = false;
   }
 
   // Add new sensor data
   void addAccelerometerData(AccelerometerEvent event) {
+    if (_engine != nullptr) {
+      final now = _clock.elapsedMicroseconds;
+      _native!.addAccel(_engine, now, event.x, event.y, event.z);
+      _evaluateNative(now);
+      return;
+    }
     _accelBuffer.add(event);
     _trimBuffer(_accelBuffer);
   }
 
   void addGyroscopeData(GyroscopeEvent event) {
+    if (_engine != nullptr) {
+      _native!.addGyro(
+          _engine, _clock.elapsedMicroseconds, event.x, event.y, event.z);
+      return;
+    }
     _gyroBuffer.add(event);
     _trimBuffer(_gyroBuffer);
   }
 
   void addMagnetometerData(MagnetometerEvent event) {
+    if (_engine != nullptr) {
+      _native!.addMag(
+          _engine, _clock.elapsedMicroseconds, event.x, event.y, event.z);
+      return;
+    }
     _magBuffer.add(event);
     _trimBuffer(_magBuffer);
   }
@@ -75,6 +113,27 @@ class IMUFusionService {
     }
   }
 
+  static const List<String> _behaviorStates = [
+    "sitting_idle",
+    "light_activity",
+    "walking_with_phone",
+  ];
+
+  // Emits the native engine's result when it has moved since the last one
+  void _evaluateNative(int nowUs) {
+    if (_native!.evaluate(_engine, nowUs, _evaluateIntervalMs) == 0) return;
+
+    final r = _native!.result(_engine).ref;
+    _fusedDataController.add(FusedIMUData(
+      timestamp: DateTime.now(),
+      accelVariance: r.accelVariance,
+      gyroVariance: r.gyroVariance,
+      motionMagnitude: r.motionMagnitude,
+      behaviorState: _behaviorStates[r.behavior],
+      orientation: [r.qw, r.qx, r.qy, r.qz],
+    ));
+  }
+
   // Analyze data in the current window
   void _analyzeData() {
     if (_accelBuffer.isEmpty || _gyroBuffer.isEmpty) return;
@@ -210,6 +269,8 @@ class FusedIMUData {
   final double gyroVariance;
   final double motionMagnitude;
   final String behaviorState;
+  // Orientation quaternion (w, x, y, z); identity without the native engine
+  final List<double> orientation;
 
   FusedIMUData({
     required this.timestamp,
@@ -217,5 +278,6 @@ class FusedIMUData {
     required this.gyroVariance,
     required this.motionMagnitude,
     required this.behaviorState,
+    this.orientation = const [1.0, 0.0, 0.0, 0.0],
   });
 } 
\ No newline at end of file
@@ -0,0 +1,83 @@
+import 'dart:collection';
+import 'dart:io';
+import 'dart:typed_data';
+import 'package:path_provider/path_provider.dart';
+
+// Full frames the device may refer back to by content hash (header kind
+// 0xFD). Kept on disk so references still resolve after the app
+// restarts, and as many as the device indexes (DEDUP_RECORDS); anything
+// not here is fetched from the device's card with FETCH.
+class RecentImageCache {
+  static const int limit = 128;
+
+  // Least recently used first
+  final LinkedHashMap<int, File> _files = LinkedHashMap<int, File>();
+  Directory? _dir;
+  Future<void>? _opening;
+
+  // The hash as the device prints it: 16 hex digits
+  static String hex(int hash) =>
+      hash.toUnsigned(64).toRadixString(16).padLeft(16, '0');
+
+  Future<void> _open() => _opening ??= _load();
+
+  Future<void> _load() async {
+    final base = await getApplicationSupportDirectory();
+    final dir = Directory('${base.path}/recent_images');
+    await dir.create(recursive: true);
+
+    final found = <File, DateTime>{};
+    await for (final entry in dir.list()) {
+      if (entry is File && entry.path.endsWith('.jpg')) {
+        found[entry] = (await entry.stat()).modified;
+      }
+    }
+    final oldestFirst = found.keys.toList()
+      ..sort((a, b) => found[a]!.compareTo(found[b]!));
+    for (final file in oldestFirst) {
+      final name = file.uri.pathSegments.last;
+      final hash = BigInt.tryParse(name.substring(0, name.length - 4), radix: 16);
+      if (hash != null) {
+        _files[hash.toSigned(64).toInt()] = file;
+      }
+    }
+    _dir = dir;
+  }
+
+  Future<Uint8List?> lookup(int hash) async {
+    await _open();
+    final file = _files.remove(hash);
+    if (file == null) return null;
+    try {
+      final bytes = await file.readAsBytes();
+      _files[hash] = file;
+      await file.setLastModified(DateTime.now());
+      return bytes;
+    } on FileSystemException {
+      return null;
+    }
+  }
+
+  // Before the frame's last ACK: the device only refers back to frames
+  // it has seen acknowledged
+  Future<void> store(int hash, Uint8List bytes) async {
+    await _open();
+    final file = File('${_dir!.path}/${hex(hash)}.jpg');
+    _files.remove(hash);
+    try {
+      await file.writeAsBytes(bytes, flush: true);
+    } on FileSystemException catch (e) {
+      print('Recent image not cached: $e');
+      return;
+    }
+    _files[hash] = file;
+    while (_files.length > limit) {
+      final oldest = _files.remove(_files.keys.first)!;
+      try {
+        await oldest.delete();
+      } on FileSystemException {
+        // Gone already
+      }
+    }
+  }
+}
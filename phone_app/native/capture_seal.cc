@@ -0,0 +1,32 @@
+#include "capture_seal.h"
+
+#include <stdlib.h>
+
+#include "capture_crypto.h"
+
+namespace {
+
+uint8_t key[CRYPTO_KEY_SIZE];
+uint8_t* buffer = nullptr;
+uint32_t buffer_capacity = 0;
+
+}  // namespace
+
+uint8_t* seal_key(void) { return key; }
+
+uint8_t* seal_buffer(uint32_t capacity) {
+  if (capacity > buffer_capacity) {
+    uint8_t* grown = static_cast<uint8_t*>(realloc(buffer, capacity));
+    if (grown == nullptr) return nullptr;
+    buffer = grown;
+    buffer_capacity = capacity;
+  }
+  return buffer;
+}
+
+int32_t seal_open(uint32_t len) {
+  if (buffer == nullptr || len > buffer_capacity) return -1;
+  size_t plain_len = 0;
+  if (!cryptoOpen(key, buffer, len, &plain_len)) return -1;
+  return static_cast<int32_t>(plain_len);
+}
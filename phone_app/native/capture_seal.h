@@ -0,0 +1,32 @@
+#ifndef PHONE_NATIVE_CAPTURE_SEAL_H_
+#define PHONE_NATIVE_CAPTURE_SEAL_H_
+
+#include <stdint.h>
+
+#include "native_export.h"
+
+// Opens captures the device sealed with AES-256-GCM. The cipher itself is
+// the portable path of the firmware's capture_crypto.cpp, compiled in
+// here, so both ends share one implementation of the format:
+// ciphertext | salt[16] | tag[16] | "XSL1".
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The 32-byte master key slot; the caller writes the key into it
+PHONE_NATIVE_EXPORT uint8_t* seal_key(void);
+
+// Buffer of at least `capacity` bytes for one sealed object (reused and
+// grown as needed); NULL if it cannot be allocated
+PHONE_NATIVE_EXPORT uint8_t* seal_buffer(uint32_t capacity);
+
+// Opens the first `len` bytes of the buffer in place. Returns the
+// plaintext length, or -1 if the object is not sealed or fails its tag.
+PHONE_NATIVE_EXPORT int32_t seal_open(uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // PHONE_NATIVE_CAPTURE_SEAL_H_
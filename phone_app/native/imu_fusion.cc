@@ -0,0 +1,405 @@
+#include "imu_fusion.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace {
+
+// Behaviour thresholds, as calibrated for the Dart implementation
+constexpr double kHighMotion = 15.0;
+constexpr double kMediumMotion = 5.0;
+constexpr double kHighVariance = 10.0;
+constexpr double kMediumVariance = 3.0;
+
+// Reporting: a result counts as changed past these deltas
+constexpr double kVarianceEpsilon = 0.05;      // relative
+constexpr double kMagnitudeEpsilon = 0.2;      // m/s^2
+constexpr double kOrientationEpsilon = 1.5e-4; // 1 - |q.q'|, about 2 deg
+
+constexpr float kBeta = 0.1f;                  // Madgwick gain
+constexpr int64_t kMagFreshUs = 200000;
+constexpr uint32_t kRefreshEvery = 1024;       // running-sum resync
+
+#if defined(__GNUC__)
+typedef float v4sf __attribute__((vector_size(16)));
+
+inline v4sf load4(const float* p) {
+  v4sf v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+#endif
+
+// One sensor's samples in structure-of-arrays form
+struct Ring {
+  float* x;
+  float* y;
+  float* z;
+  int64_t* t;
+  uint32_t cap;
+  uint32_t head;   // oldest sample
+  uint32_t count;
+  double sum[3];
+  double sum_sq[3];
+  uint32_t since_refresh;
+};
+
+bool ring_init(Ring* r, uint32_t cap) {
+  memset(r, 0, sizeof(*r));
+  r->cap = cap;
+  r->x = static_cast<float*>(calloc(cap, sizeof(float)));
+  r->y = static_cast<float*>(calloc(cap, sizeof(float)));
+  r->z = static_cast<float*>(calloc(cap, sizeof(float)));
+  r->t = static_cast<int64_t*>(calloc(cap, sizeof(int64_t)));
+  return r->x && r->y && r->z && r->t;
+}
+
+void ring_free(Ring* r) {
+  free(r->x);
+  free(r->y);
+  free(r->z);
+  free(r->t);
+}
+
+void ring_evict(Ring* r) {
+  uint32_t i = r->head;
+  r->sum[0] -= r->x[i];
+  r->sum[1] -= r->y[i];
+  r->sum[2] -= r->z[i];
+  r->sum_sq[0] -= double(r->x[i]) * r->x[i];
+  r->sum_sq[1] -= double(r->y[i]) * r->y[i];
+  r->sum_sq[2] -= double(r->z[i]) * r->z[i];
+  r->head = (r->head + 1) % r->cap;
+  r->count--;
+}
+
+// Calls fn(begin, len) for the (at most two) contiguous runs of samples
+template <typename Fn>
+void ring_segments(const Ring* r, Fn fn) {
+  uint32_t first = r->cap - r->head < r->count ? r->cap - r->head : r->count;
+  fn(r->head, first);
+  if (first < r->count) fn(0, r->count - first);
+}
+
+// Sums and sums of squares from scratch, four lanes at a time
+void ring_refresh(Ring* r) {
+  double sum[3] = {0, 0, 0};
+  double sum_sq[3] = {0, 0, 0};
+  const float* axes[3] = {r->x, r->y, r->z};
+
+  ring_segments(r, [&](uint32_t begin, uint32_t len) {
+    for (int a = 0; a < 3; a++) {
+      const float* p = axes[a] + begin;
+      uint32_t i = 0;
+#if defined(__GNUC__)
+      // Blocks of 256 keep the float lanes well inside their precision
+      while (i + 4 <= len) {
+        v4sf s = {0, 0, 0, 0};
+        v4sf q = {0, 0, 0, 0};
+        uint32_t end = i + 256 < len ? i + 256 : len;
+        for (; i + 4 <= end; i += 4) {
+          v4sf v = load4(p + i);
+          s += v;
+          q += v * v;
+        }
+        sum[a] += double(s[0]) + s[1] + s[2] + s[3];
+        sum_sq[a] += double(q[0]) + q[1] + q[2] + q[3];
+      }
+#endif
+      for (; i < len; i++) {
+        sum[a] += p[i];
+        sum_sq[a] += double(p[i]) * p[i];
+      }
+    }
+  });
+
+  memcpy(r->sum, sum, sizeof(sum));
+  memcpy(r->sum_sq, sum_sq, sizeof(sum_sq));
+  r->since_refresh = 0;
+}
+
+void ring_push(Ring* r, int64_t t, float x, float y, float z) {
+  if (r->count == r->cap) ring_evict(r);
+  uint32_t i = (r->head + r->count) % r->cap;
+  r->x[i] = x;
+  r->y[i] = y;
+  r->z[i] = z;
+  r->t[i] = t;
+  r->count++;
+  r->sum[0] += x;
+  r->sum[1] += y;
+  r->sum[2] += z;
+  r->sum_sq[0] += double(x) * x;
+  r->sum_sq[1] += double(y) * y;
+  r->sum_sq[2] += double(z) * z;
+  if (++r->since_refresh >= kRefreshEvery) ring_refresh(r);
+}
+
+void ring_trim(Ring* r, int64_t oldest_us) {
+  while (r->count > 0 && r->t[r->head] < oldest_us) ring_evict(r);
+}
+
+// Mean of the per-axis variances over the window
+double ring_variance(const Ring* r) {
+  if (r->count == 0) return 0.0;
+  double n = r->count;
+  double total = 0;
+  for (int a = 0; a < 3; a++) {
+    double mean = r->sum[a] / n;
+    total += r->sum_sq[a] / n - mean * mean;
+  }
+  return total > 0 ? total / 3 : 0.0;
+}
+
+double ring_max_magnitude(const Ring* r) {
+  float best = 0;
+  ring_segments(r, [&](uint32_t begin, uint32_t len) {
+    const float* x = r->x + begin;
+    const float* y = r->y + begin;
+    const float* z = r->z + begin;
+    uint32_t i = 0;
+#if defined(__GNUC__)
+    v4sf m = {0, 0, 0, 0};
+    for (; i + 4 <= len; i += 4) {
+      v4sf vx = load4(x + i);
+      v4sf vy = load4(y + i);
+      v4sf vz = load4(z + i);
+      v4sf sq = vx * vx + vy * vy + vz * vz;
+      m = sq > m ? sq : m;
+    }
+    for (int k = 0; k < 4; k++) best = m[k] > best ? m[k] : best;
+#endif
+    for (; i < len; i++) {
+      float sq = x[i] * x[i] + y[i] * y[i] + z[i] * z[i];
+      best = sq > best ? sq : best;
+    }
+  });
+  return sqrt(double(best));
+}
+
+float inv_sqrt(float v) { return 1.0f / sqrtf(v); }
+
+}  // namespace
+
+struct ImuFusion {
+  Ring accel;
+  Ring gyro;
+  int64_t window_us;
+
+  // Latest samples feeding the orientation filter
+  float ax, ay, az;
+  float mx, my, mz;
+  int64_t mag_t;
+  int64_t last_gyro_t;
+  float q0, q1, q2, q3;
+
+  int64_t last_eval_us;
+  ImuResult result;
+  ImuResult reported;
+  bool has_reported;
+};
+
+// Madgwick's gradient-descent orientation filter; the magnetometer terms
+// are skipped when mx = my = mz = 0.
+static void madgwick_update(ImuFusion* f, float gx, float gy, float gz,
+                            float dt) {
+  float q0 = f->q0, q1 = f->q1, q2 = f->q2, q3 = f->q3;
+  float ax = f->ax, ay = f->ay, az = f->az;
+  float mx = f->mx, my = f->my, mz = f->mz;
+
+  float qd0 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+  float qd1 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+  float qd2 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
+  float qd3 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+  if (!(ax == 0.0f && ay == 0.0f && az == 0.0f)) {
+    float n = inv_sqrt(ax * ax + ay * ay + az * az);
+    ax *= n;
+    ay *= n;
+    az *= n;
+
+    float s0, s1, s2, s3;
+    if (mx == 0.0f && my == 0.0f && mz == 0.0f) {
+      float _2q0 = 2 * q0, _2q1 = 2 * q1, _2q2 = 2 * q2, _2q3 = 2 * q3;
+      float _4q0 = 4 * q0, _4q1 = 4 * q1, _4q2 = 4 * q2;
+      float _8q1 = 8 * q1, _8q2 = 8 * q2;
+      float q0q0 = q0 * q0, q1q1 = q1 * q1, q2q2 = q2 * q2, q3q3 = q3 * q3;
+      s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+      s1 = _4q1 * q3q3 - _2q3 * ax + 4 * q0q0 * q1 - _2q0 * ay - _4q1 +
+           _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+      s2 = 4 * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 +
+           _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+      s3 = 4 * q1q1 * q3 - _2q1 * ax + 4 * q2q2 * q3 - _2q2 * ay;
+    } else {
+      n = inv_sqrt(mx * mx + my * my + mz * mz);
+      mx *= n;
+      my *= n;
+      mz *= n;
+
+      float _2q0mx = 2 * q0 * mx, _2q0my = 2 * q0 * my, _2q0mz = 2 * q0 * mz;
+      float _2q1mx = 2 * q1 * mx;
+      float _2q0 = 2 * q0, _2q1 = 2 * q1, _2q2 = 2 * q2, _2q3 = 2 * q3;
+      float _2q0q2 = 2 * q0 * q2, _2q2q3 = 2 * q2 * q3;
+      float q0q0 = q0 * q0, q0q1 = q0 * q1, q0q2 = q0 * q2, q0q3 = q0 * q3;
+      float q1q1 = q1 * q1, q1q2 = q1 * q2, q1q3 = q1 * q3;
+      float q2q2 = q2 * q2, q2q3 = q2 * q3, q3q3 = q3 * q3;
+
+      // Earth's field direction from the current estimate
+      float hx = mx * q0q0 - _2q0my * q3 + _2q0mz * q2 + mx * q1q1 +
+                 _2q1 * my * q2 + _2q1 * mz * q3 - mx * q2q2 - mx * q3q3;
+      float hy = _2q0mx * q3 + my * q0q0 - _2q0mz * q1 + _2q1mx * q2 -
+                 my * q1q1 + my * q2q2 + _2q2 * mz * q3 - my * q3q3;
+      float _2bx = sqrtf(hx * hx + hy * hy);
+      float _2bz = -_2q0mx * q2 + _2q0my * q1 + mz * q0q0 + _2q1mx * q3 -
+                   mz * q1q1 + _2q2 * my * q3 - mz * q2q2 + mz * q3q3;
+      float _4bx = 2 * _2bx, _4bz = 2 * _2bz;
+
+      s0 = -_2q2 * (2 * q1q3 - _2q0q2 - ax) + _2q1 * (2 * q0q1 + _2q2q3 - ay) -
+           _2bz * q2 * (_2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx) +
+           (-_2bx * q3 + _2bz * q1) * (_2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my) +
+           _2bx * q2 * (_2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz);
+      s1 = _2q3 * (2 * q1q3 - _2q0q2 - ax) + _2q0 * (2 * q0q1 + _2q2q3 - ay) -
+           4 * q1 * (1 - 2 * q1q1 - 2 * q2q2 - az) +
+           _2bz * q3 * (_2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx) +
+           (_2bx * q2 + _2bz * q0) * (_2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my) +
+           (_2bx * q3 - _4bz * q1) * (_2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz);
+      s2 = -_2q0 * (2 * q1q3 - _2q0q2 - ax) + _2q3 * (2 * q0q1 + _2q2q3 - ay) -
+           4 * q2 * (1 - 2 * q1q1 - 2 * q2q2 - az) +
+           (-_4bx * q2 - _2bz * q0) * (_2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx) +
+           (_2bx * q1 + _2bz * q3) * (_2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my) +
+           (_2bx * q0 - _4bz * q2) * (_2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz);
+      s3 = _2q1 * (2 * q1q3 - _2q0q2 - ax) + _2q2 * (2 * q0q1 + _2q2q3 - ay) +
+           (-_4bx * q3 + _2bz * q1) * (_2bx * (0.5f - q2q2 - q3q3) + _2bz * (q1q3 - q0q2) - mx) +
+           (-_2bx * q0 + _2bz * q2) * (_2bx * (q1q2 - q0q3) + _2bz * (q0q1 + q2q3) - my) +
+           _2bx * q1 * (_2bx * (q0q2 + q1q3) + _2bz * (0.5f - q1q1 - q2q2) - mz);
+    }
+
+    float sn = s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3;
+    if (sn > 0) {
+      n = inv_sqrt(sn);
+      qd0 -= kBeta * s0 * n;
+      qd1 -= kBeta * s1 * n;
+      qd2 -= kBeta * s2 * n;
+      qd3 -= kBeta * s3 * n;
+    }
+  }
+
+  q0 += qd0 * dt;
+  q1 += qd1 * dt;
+  q2 += qd2 * dt;
+  q3 += qd3 * dt;
+  float n = inv_sqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+  f->q0 = q0 * n;
+  f->q1 = q1 * n;
+  f->q2 = q2 * n;
+  f->q3 = q3 * n;
+}
+
+ImuFusion* imu_create(uint32_t window_ms, uint32_t max_rate_hz) {
+  if (window_ms == 0 || max_rate_hz == 0) return nullptr;
+
+  // Room for the whole window at the highest rate, rounded to SIMD lanes
+  uint32_t cap = (uint32_t)((uint64_t)window_ms * max_rate_hz / 1000) + 1;
+  cap = (cap + 3) & ~3u;
+
+  ImuFusion* f = static_cast<ImuFusion*>(calloc(1, sizeof(ImuFusion)));
+  if (!f) return nullptr;
+  if (!ring_init(&f->accel, cap) || !ring_init(&f->gyro, cap)) {
+    imu_destroy(f);
+    return nullptr;
+  }
+  f->window_us = (int64_t)window_ms * 1000;
+  f->q0 = 1.0f;
+  f->result.qw = 1.0;
+  return f;
+}
+
+void imu_destroy(ImuFusion* f) {
+  if (!f) return;
+  ring_free(&f->accel);
+  ring_free(&f->gyro);
+  free(f);
+}
+
+void imu_add_accel(ImuFusion* f, int64_t t_us, float x, float y, float z) {
+  ring_push(&f->accel, t_us, x, y, z);
+  f->ax = x;
+  f->ay = y;
+  f->az = z;
+}
+
+void imu_add_gyro(ImuFusion* f, int64_t t_us, float x, float y, float z) {
+  ring_push(&f->gyro, t_us, x, y, z);
+
+  if (f->last_gyro_t != 0 && t_us > f->last_gyro_t) {
+    float dt = (t_us - f->last_gyro_t) * 1e-6f;
+    if (dt < 0.5f) {
+      if (t_us - f->mag_t > kMagFreshUs) f->mx = f->my = f->mz = 0;
+      madgwick_update(f, x, y, z, dt);
+    }
+  }
+  f->last_gyro_t = t_us;
+}
+
+void imu_add_mag(ImuFusion* f, int64_t t_us, float x, float y, float z) {
+  f->mx = x;
+  f->my = y;
+  f->mz = z;
+  f->mag_t = t_us;
+}
+
+static bool moved(double a, double b, double relative) {
+  double scale = fabs(a) > fabs(b) ? fabs(a) : fabs(b);
+  return fabs(a - b) > relative * (scale > 1e-3 ? scale : 1e-3);
+}
+
+static bool result_changed(const ImuResult& a, const ImuResult& b) {
+  if (a.behavior != b.behavior) return true;
+  if (moved(a.accel_variance, b.accel_variance, kVarianceEpsilon)) return true;
+  if (moved(a.gyro_variance, b.gyro_variance, kVarianceEpsilon)) return true;
+  if (fabs(a.motion_magnitude - b.motion_magnitude) > kMagnitudeEpsilon)
+    return true;
+  double dot = a.qw * b.qw + a.qx * b.qx + a.qy * b.qy + a.qz * b.qz;
+  return 1.0 - fabs(dot) > kOrientationEpsilon;
+}
+
+int32_t imu_evaluate(ImuFusion* f, int64_t now_us, uint32_t interval_ms) {
+  if (f->last_eval_us != 0 &&
+      now_us - f->last_eval_us < (int64_t)interval_ms * 1000)
+    return 0;
+  f->last_eval_us = now_us;
+
+  ring_trim(&f->accel, now_us - f->window_us);
+  ring_trim(&f->gyro, now_us - f->window_us);
+  if (f->accel.count == 0 || f->gyro.count == 0) return 0;
+
+  ImuResult& r = f->result;
+  r.accel_variance = ring_variance(&f->accel);
+  r.gyro_variance = ring_variance(&f->gyro);
+  r.motion_magnitude = ring_max_magnitude(&f->accel);
+  r.qw = f->q0;
+  r.qx = f->q1;
+  r.qy = f->q2;
+  r.qz = f->q3;
+  r.timestamp_us = now_us;
+  r.samples = f->accel.count;
+
+  if (r.motion_magnitude > kHighMotion || r.accel_variance > kHighVariance ||
+      r.gyro_variance > kHighVariance) {
+    r.behavior = IMU_WALKING_WITH_PHONE;
+  } else if (r.motion_magnitude > kMediumMotion ||
+             r.accel_variance > kMediumVariance ||
+             r.gyro_variance > kMediumVariance) {
+    r.behavior = IMU_LIGHT_ACTIVITY;
+  } else {
+    r.behavior = IMU_SITTING_IDLE;
+  }
+
+  if (f->has_reported && !result_changed(r, f->reported)) return 0;
+  f->reported = r;
+  f->has_reported = true;
+  return 1;
+}
+
+const ImuResult* imu_result(const ImuFusion* f) { return &f->result; }
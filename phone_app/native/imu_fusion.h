@@ -0,0 +1,62 @@
+#ifndef PHONE_NATIVE_IMU_FUSION_H_
+#define PHONE_NATIVE_IMU_FUSION_H_
+
+#include <stdint.h>
+
+#include "native_export.h"
+
+// Phone IMU analysis: accelerometer and gyroscope samples go into
+// structure-of-arrays rings sized for the analysis window, window
+// statistics are kept as running sums (recomputed with SIMD now and then
+// to shed rounding drift), and a Madgwick filter tracks orientation
+// (MARG when magnetometer samples are fresh, IMU otherwise).
+//
+// imu_evaluate() rate-limits itself and reports only when the result
+// moved, so callers can invoke it on every sample.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ImuFusion ImuFusion;
+
+enum ImuBehavior {
+  IMU_SITTING_IDLE = 0,
+  IMU_LIGHT_ACTIVITY = 1,
+  IMU_WALKING_WITH_PHONE = 2,
+};
+
+typedef struct ImuResult {
+  double accel_variance;
+  double gyro_variance;
+  double motion_magnitude;  // max |accel| over the window
+  double qw, qx, qy, qz;    // orientation quaternion
+  int64_t timestamp_us;
+  int32_t behavior;         // ImuBehavior
+  int32_t samples;          // accelerometer samples in the window
+} ImuResult;
+
+// window_ms: analysis window; max_rate_hz: highest sensor rate expected
+// (sizes the rings; samples beyond it push out the oldest early)
+PHONE_NATIVE_EXPORT ImuFusion* imu_create(uint32_t window_ms,
+                                          uint32_t max_rate_hz);
+PHONE_NATIVE_EXPORT void imu_destroy(ImuFusion* f);
+
+PHONE_NATIVE_EXPORT void imu_add_accel(ImuFusion* f, int64_t t_us, float x,
+                                       float y, float z);
+PHONE_NATIVE_EXPORT void imu_add_gyro(ImuFusion* f, int64_t t_us, float x,
+                                      float y, float z);
+PHONE_NATIVE_EXPORT void imu_add_mag(ImuFusion* f, int64_t t_us, float x,
+                                     float y, float z);
+
+// 1 if a new result differing from the last reported one is in
+// imu_result(), 0 otherwise (including when called within the interval)
+PHONE_NATIVE_EXPORT int32_t imu_evaluate(ImuFusion* f, int64_t now_us,
+                                         uint32_t interval_ms);
+PHONE_NATIVE_EXPORT const ImuResult* imu_result(const ImuFusion* f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // PHONE_NATIVE_IMU_FUSION_H_
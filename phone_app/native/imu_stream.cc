@@ -0,0 +1,67 @@
+#include "imu_stream.h"
+
+#include <stdlib.h>
+
+#include "imu_batch.h"
+#include "wire_format.h"
+
+namespace {
+
+constexpr uint32_t kStagingSize = 512;
+constexpr float kGravity = 9.80665f;
+constexpr float kRadPerDeg = 3.14159265f / 180.0f;
+
+}  // namespace
+
+struct ImuStream {
+  uint8_t staging[kStagingSize];
+  ImuSample raw[IMU_BATCH_MAX];
+  float samples[IMU_BATCH_MAX * IMU_AXES];
+  ImuStreamBatch batch;
+  uint16_t next_seq;
+  bool have_seq;
+};
+
+ImuStream* imu_stream_create(void) {
+  return static_cast<ImuStream*>(calloc(1, sizeof(ImuStream)));
+}
+
+void imu_stream_destroy(ImuStream* s) { free(s); }
+
+uint8_t* imu_stream_staging(ImuStream* s) { return s->staging; }
+
+uint32_t imu_stream_staging_capacity(void) { return kStagingSize; }
+
+int32_t imu_stream_push_staged(ImuStream* s, uint32_t len) {
+  if (len > kStagingSize) return -1;
+  ImuBatchInfo info;
+  int n = imuBatchDecode(s->staging, len, &info, s->raw, IMU_BATCH_MAX);
+  if (n < 0 || info.accelLsbPerG == 0 || info.gyroLsbPerDpsX10 == 0) {
+    return -1;
+  }
+
+  // A jump backwards or a long way forwards is a restarted stream
+  uint16_t gap = static_cast<uint16_t>(info.seq - s->next_seq);
+  s->batch.lost = s->have_seq && gap < 0x8000 ? gap : 0;
+  s->batch.total_lost += s->batch.lost;
+  s->next_seq = static_cast<uint16_t>(info.seq + 1);
+  s->have_seq = true;
+
+  const float accel = kGravity / info.accelLsbPerG;
+  const float gyro = 10.0f * kRadPerDeg / info.gyroLsbPerDpsX10;
+  for (int i = 0; i < n; i++) {
+    float* out = &s->samples[i * IMU_AXES];
+    for (int a = 0; a < 3; a++) out[a] = s->raw[i].v[a] * accel;
+    for (int a = 3; a < IMU_AXES; a++) out[a] = s->raw[i].v[a] * gyro;
+  }
+  s->batch.count = static_cast<uint32_t>(n);
+  s->batch.time_ms = info.timeMs;
+  s->batch.period_us = info.periodUs;
+  return n;
+}
+
+const float* imu_stream_samples(const ImuStream* s) { return s->samples; }
+
+const ImuStreamBatch* imu_stream_batch(const ImuStream* s) {
+  return &s->batch;
+}
@@ -0,0 +1,46 @@
+#ifndef PHONE_NATIVE_IMU_STREAM_H_
+#define PHONE_NATIVE_IMU_STREAM_H_
+
+#include <stdint.h>
+
+#include "native_export.h"
+
+// Receiver side of the device's live IMU batches (ImuBatchHeader,
+// protocol/messages.json), decoded with the firmware's imu_batch.cpp and
+// scaled to SI units with the batch's own sensor scale. Batches lost on
+// the way are counted from the sequence numbers.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ImuStream ImuStream;
+
+typedef struct ImuStreamBatch {
+  uint32_t count;       // samples in imu_stream_samples()
+  uint32_t time_ms;     // device time of the first one
+  uint32_t period_us;
+  uint32_t lost;        // batches missing before this one
+  uint32_t total_lost;
+} ImuStreamBatch;
+
+PHONE_NATIVE_EXPORT ImuStream* imu_stream_create(void);
+PHONE_NATIVE_EXPORT void imu_stream_destroy(ImuStream* s);
+
+// Scratch area the caller copies one live stream payload into
+PHONE_NATIVE_EXPORT uint8_t* imu_stream_staging(ImuStream* s);
+PHONE_NATIVE_EXPORT uint32_t imu_stream_staging_capacity(void);
+
+// Decodes the staged batch; returns its sample count, -1 if it is not
+// a well-formed IMU batch
+PHONE_NATIVE_EXPORT int32_t imu_stream_push_staged(ImuStream* s, uint32_t len);
+
+// 6 floats per sample: accel x y z in m/s^2, gyro x y z in rad/s
+PHONE_NATIVE_EXPORT const float* imu_stream_samples(const ImuStream* s);
+PHONE_NATIVE_EXPORT const ImuStreamBatch* imu_stream_batch(const ImuStream* s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // PHONE_NATIVE_IMU_STREAM_H_
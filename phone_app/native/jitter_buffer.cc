@@ -0,0 +1,234 @@
+#include "jitter_buffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "adpcm.h"
+#include "wire_format.h"
+
+namespace {
+
+constexpr uint32_t kSlots = 64;           // power of two; ~1.3 s of 20 ms frames
+constexpr uint32_t kMaxFrameSamples = ADPCM_SAMPLES_PER_BLOCK;
+constexpr uint32_t kStagingSize = 512;
+constexpr uint32_t kJitterWindow = 100;   // frames the percentile covers
+constexpr uint32_t kJitterPercentile = 95;
+constexpr uint32_t kConcealFrames = 5;    // then silence
+
+struct Slot {
+  int16_t pcm[kMaxFrameSamples];
+  uint32_t arrival_ms;
+  int32_t transit;   // arrival minus device time: clock offset + trip
+  uint16_t seq;
+  bool full;
+};
+
+}  // namespace
+
+struct JitterBuffer {
+  Slot slots[kSlots];
+  int16_t output[kMaxFrameSamples];
+  int16_t last[kMaxFrameSamples];
+  uint8_t staging[kStagingSize];
+  int32_t transits[kJitterWindow];
+  uint32_t transit_count;
+  uint32_t transit_next;
+  int32_t min_transit;
+  uint32_t frame_samples;
+  uint32_t frame_ms;
+  uint32_t min_delay_ms;
+  uint32_t max_delay_ms;
+  uint16_t next_seq;      // next frame to play
+  uint16_t highest_seq;   // newest frame held
+  bool have_seq;
+  bool started;           // playing, as opposed to filling up
+  bool have_last;
+  uint32_t conceal_run;
+  JitterStats stats;
+};
+
+static Slot* slot_for(JitterBuffer* jb, uint16_t seq) {
+  return &jb->slots[seq & (kSlots - 1)];
+}
+
+// Frames from the next to play through the newest held, holes included
+static uint32_t span(const JitterBuffer* jb) {
+  if (!jb->have_seq) return 0;
+  int32_t n = static_cast<int16_t>(jb->highest_seq - jb->next_seq) + 1;
+  return n > 0 ? static_cast<uint32_t>(n) : 0;
+}
+
+static void update_buffered(JitterBuffer* jb) {
+  jb->stats.buffered_ms = span(jb) * jb->frame_ms;
+}
+
+static void reset(JitterBuffer* jb, uint16_t seq) {
+  for (uint32_t i = 0; i < kSlots; i++) jb->slots[i].full = false;
+  jb->next_seq = seq;
+  jb->highest_seq = seq - 1;
+  jb->have_seq = true;
+  jb->started = false;
+}
+
+// Jitter is the spread of transit times: their 95th percentile above the
+// window's fastest frame
+static void record_transit(JitterBuffer* jb, int32_t transit) {
+  jb->transits[jb->transit_next] = transit;
+  jb->transit_next = (jb->transit_next + 1) % kJitterWindow;
+  if (jb->transit_count < kJitterWindow) jb->transit_count++;
+
+  int32_t sorted[kJitterWindow];
+  uint32_t n = jb->transit_count;
+  int32_t lowest = jb->transits[0];
+  for (uint32_t i = 0; i < n; i++) {
+    lowest = std::min(lowest, jb->transits[i]);
+  }
+  for (uint32_t i = 0; i < n; i++) sorted[i] = jb->transits[i] - lowest;
+  uint32_t k = (n - 1) * kJitterPercentile / 100;
+  std::nth_element(sorted, sorted + k, sorted + n);
+  jb->min_transit = lowest;
+  jb->stats.jitter_ms = static_cast<uint32_t>(sorted[k]);
+
+  // Whole frames of delay on top of the jitter
+  uint32_t target = jb->stats.jitter_ms + jb->frame_ms;
+  target = (target + jb->frame_ms - 1) / jb->frame_ms * jb->frame_ms;
+  jb->stats.target_ms =
+      std::max(jb->min_delay_ms, std::min(jb->max_delay_ms, target));
+}
+
+JitterBuffer* jb_create(uint32_t frame_samples, uint32_t frame_ms,
+                        uint32_t min_delay_ms, uint32_t max_delay_ms) {
+  if (frame_samples == 0 || frame_samples > kMaxFrameSamples ||
+      frame_ms == 0 || min_delay_ms > max_delay_ms) {
+    return nullptr;
+  }
+  if (LiveAudioFrame::SIZE + adpcmFrameSize(frame_samples) > kStagingSize) {
+    return nullptr;
+  }
+  JitterBuffer* jb =
+      static_cast<JitterBuffer*>(calloc(1, sizeof(JitterBuffer)));
+  if (!jb) return nullptr;
+  jb->frame_samples = frame_samples;
+  jb->frame_ms = frame_ms;
+  jb->min_delay_ms = min_delay_ms;
+  jb->max_delay_ms = max_delay_ms;
+  jb->stats.target_ms = std::max(min_delay_ms, frame_ms);
+  return jb;
+}
+
+void jb_destroy(JitterBuffer* jb) { free(jb); }
+
+uint8_t* jb_staging(JitterBuffer* jb) { return jb->staging; }
+
+uint32_t jb_staging_capacity(void) { return kStagingSize; }
+
+int32_t jb_push_staged(JitterBuffer* jb, uint32_t len, uint32_t arrival_ms) {
+  if (len < LiveAudioFrame::SIZE || len > kStagingSize) return JB_BAD_FRAME;
+  LiveAudioFrame::View header{jb->staging};
+  if (header.kind() != WIRE_LIVE_KIND_AUDIO ||
+      header.samples() != jb->frame_samples ||
+      len < LiveAudioFrame::SIZE + adpcmFrameSize(jb->frame_samples)) {
+    return JB_BAD_FRAME;
+  }
+
+  uint16_t seq = header.seq();
+  if (!jb->have_seq) reset(jb, seq);
+  int32_t ahead = static_cast<int16_t>(seq - jb->next_seq);
+  if (ahead >= static_cast<int32_t>(kSlots) ||
+      ahead < -static_cast<int32_t>(kSlots)) {
+    // The device restarted the stream, or we fell far behind: start over
+    reset(jb, seq);
+    ahead = 0;
+  }
+  if (ahead < 0) {
+    jb->stats.late++;
+    return JB_LATE;
+  }
+
+  Slot* slot = slot_for(jb, seq);
+  if (slot->full && slot->seq == seq) return JB_DUPLICATE;
+  adpcmDecodeBlock(jb->staging + LiveAudioFrame::SIZE, jb->frame_samples,
+                   slot->pcm);
+  slot->seq = seq;
+  slot->arrival_ms = arrival_ms;
+  slot->transit = static_cast<int32_t>(arrival_ms - header.timeMs());
+  slot->full = true;
+  if (static_cast<int16_t>(seq - jb->highest_seq) > 0) jb->highest_seq = seq;
+
+  record_transit(jb, slot->transit);
+  jb->stats.pushed++;
+  update_buffered(jb);
+  return JB_STORED;
+}
+
+// The last good frame again, fading out over kConcealFrames frames
+static void conceal(JitterBuffer* jb) {
+  int32_t n = static_cast<int32_t>(jb->frame_samples);
+  int32_t steps = static_cast<int32_t>(kConcealFrames) * n;
+  int32_t from = steps - static_cast<int32_t>(jb->conceal_run) * n;
+  for (int32_t i = 0; i < n; i++) {
+    jb->output[i] =
+        static_cast<int16_t>(static_cast<int32_t>(jb->last[i]) * (from - i) / steps);
+  }
+  jb->conceal_run++;
+  jb->stats.concealed++;
+}
+
+static int32_t silence(JitterBuffer* jb) {
+  memset(jb->output, 0, jb->frame_samples * sizeof(int16_t));
+  update_buffered(jb);
+  return JB_SILENCE;
+}
+
+int32_t jb_pull(JitterBuffer* jb, uint32_t now_ms) {
+  if (!jb->started) {
+    if (!jb->have_seq || span(jb) * jb->frame_ms < jb->stats.target_ms) {
+      // Refilling after an underrun: carry the last sound out first
+      if (!jb->have_last || jb->conceal_run >= kConcealFrames) return silence(jb);
+      conceal(jb);
+      update_buffered(jb);
+      return JB_CONCEALED;
+    }
+    jb->started = true;
+  }
+
+  // Running well past the target: drop one frame to catch up
+  if (span(jb) * jb->frame_ms > jb->stats.target_ms + 2 * jb->frame_ms) {
+    slot_for(jb, jb->next_seq)->full = false;
+    jb->next_seq++;
+    jb->stats.skipped++;
+  }
+
+  Slot* slot = slot_for(jb, jb->next_seq);
+  if (slot->full && slot->seq == jb->next_seq) {
+    memcpy(jb->output, slot->pcm, jb->frame_samples * sizeof(int16_t));
+    memcpy(jb->last, slot->pcm, jb->frame_samples * sizeof(int16_t));
+    slot->full = false;
+    jb->next_seq++;
+    jb->have_last = true;
+    jb->conceal_run = 0;
+    jb->stats.played++;
+    int32_t trip = std::max(0, slot->transit - jb->min_transit);
+    jb->stats.ear_delay_ms = jb->frame_ms + static_cast<uint32_t>(trip) +
+                             (now_ms - slot->arrival_ms);
+    update_buffered(jb);
+    return JB_PLAYED;
+  }
+
+  if (span(jb) == 0) {
+    // Nothing after the gap yet: refill before playing on
+    jb->started = false;
+  } else {
+    jb->next_seq++;   // lost, or too late to wait for
+  }
+  if (!jb->have_last || jb->conceal_run >= kConcealFrames) return silence(jb);
+  conceal(jb);
+  update_buffered(jb);
+  return JB_CONCEALED;
+}
+
+const int16_t* jb_output(const JitterBuffer* jb) { return jb->output; }
+
+const JitterStats* jb_stats(const JitterBuffer* jb) { return &jb->stats; }
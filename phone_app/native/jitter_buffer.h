@@ -0,0 +1,78 @@
+#ifndef PHONE_NATIVE_JITTER_BUFFER_H_
+#define PHONE_NATIVE_JITTER_BUFFER_H_
+
+#include <stdint.h>
+
+#include "native_export.h"
+
+// Playout side of the device's live audio. Frames arrive as
+// LiveAudioFrame (protocol/messages.json) followed by one self-contained
+// IMA ADPCM block, decoded on arrival with the firmware's adpcm.cpp and
+// slotted by sequence number. The player pulls one frame per frame
+// period; playout waits until the buffer holds the target delay, which
+// follows the 95th percentile of the recent arrival jitter. A missing
+// frame is concealed by replaying the last one at falling gain, then
+// silence; late frames are dropped and an overfull buffer skips a frame
+// to win latency back.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct JitterBuffer JitterBuffer;
+
+enum JitterPush {
+  JB_STORED = 0,
+  JB_LATE = 1,        // its playout time has passed
+  JB_DUPLICATE = 2,
+  JB_BAD_FRAME = 3,
+};
+
+enum JitterPull {
+  JB_PLAYED = 0,
+  JB_CONCEALED = 1,   // output synthesized for a lost frame
+  JB_SILENCE = 2,     // buffering, or the loss ran past concealment
+};
+
+typedef struct JitterStats {
+  uint32_t pushed;
+  uint32_t played;
+  uint32_t concealed;
+  uint32_t late;
+  uint32_t skipped;         // frames dropped to shrink the delay
+  uint32_t target_ms;       // current playout delay target
+  uint32_t buffered_ms;     // audio held right now
+  uint32_t jitter_ms;       // 95th percentile arrival jitter
+  // Mouth-to-ear delay of the last played frame, above the link's
+  // fastest one-way trip (the two clocks are not synchronized): frame
+  // length + arrival jitter + time spent in this buffer.
+  uint32_t ear_delay_ms;
+} JitterStats;
+
+// frame_samples and frame_ms as sent by the device (LIVE_FRAME_*);
+// the target delay is kept between min_delay_ms and max_delay_ms
+PHONE_NATIVE_EXPORT JitterBuffer* jb_create(uint32_t frame_samples,
+                                            uint32_t frame_ms,
+                                            uint32_t min_delay_ms,
+                                            uint32_t max_delay_ms);
+PHONE_NATIVE_EXPORT void jb_destroy(JitterBuffer* jb);
+
+// Scratch area the caller copies one live stream payload into
+PHONE_NATIVE_EXPORT uint8_t* jb_staging(JitterBuffer* jb);
+PHONE_NATIVE_EXPORT uint32_t jb_staging_capacity(void);
+
+// Stores the staged frame; arrival_ms on the caller's monotonic clock
+PHONE_NATIVE_EXPORT int32_t jb_push_staged(JitterBuffer* jb, uint32_t len,
+                                           uint32_t arrival_ms);
+
+// Produces the next frame_samples of audio into jb_output()
+PHONE_NATIVE_EXPORT int32_t jb_pull(JitterBuffer* jb, uint32_t now_ms);
+PHONE_NATIVE_EXPORT const int16_t* jb_output(const JitterBuffer* jb);
+
+PHONE_NATIVE_EXPORT const JitterStats* jb_stats(const JitterBuffer* jb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // PHONE_NATIVE_JITTER_BUFFER_H_
@@ -0,0 +1,11 @@
+#ifndef PHONE_NATIVE_NATIVE_EXPORT_H_
+#define PHONE_NATIVE_NATIVE_EXPORT_H_
+
+// Symbols looked up by dart:ffi; everything else stays hidden.
+#if defined(_WIN32)
+#define PHONE_NATIVE_EXPORT __declspec(dllexport)
+#else
+#define PHONE_NATIVE_EXPORT __attribute__((visibility("default")))
+#endif
+
+#endif  // PHONE_NATIVE_NATIVE_EXPORT_H_
@@ -0,0 +1,188 @@
+#include "reassembly.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crc32.h"
+
+namespace {
+
+constexpr uint32_t kSeqSize = 2;       // ImagePacket::SIZE
+constexpr uint32_t kTrailerSize = 4;   // ImagePacketTrailer::SIZE
+constexpr uint32_t kStagingSize = 512;
+constexpr uint32_t kReplySize = 128;
+constexpr int kMaxResumeRanges = 8;    // SESSION_MAX_RANGES on the device
+
+uint32_t crc32(const uint8_t* data, uint32_t len) {
+  return crc32Update(0, data, len);
+}
+
+}  // namespace
+
+struct Reassembler {
+  uint8_t* data;
+  uint64_t* bitmap;
+  uint32_t size;
+  uint32_t packets;
+  uint32_t object_crc;
+  uint32_t received;
+  uint32_t chunk;          // payload length of every packet but the last
+  uint32_t first_missing;  // all packets below are held
+  uint8_t staging[kStagingSize];
+  uint8_t reply[kReplySize];
+  uint32_t reply_len;
+};
+
+static bool has_packet(const Reassembler* r, uint32_t seq) {
+  return (r->bitmap[seq >> 6] >> (seq & 63)) & 1;
+}
+
+static void reset(Reassembler* r) {
+  memset(r->bitmap, 0, ((r->packets + 63) / 64) * sizeof(uint64_t));
+  r->received = 0;
+  r->first_missing = 0;
+}
+
+static void set_reply(Reassembler* r, const char* fmt, uint32_t a,
+                      uint32_t b) {
+  int n = snprintf(reinterpret_cast<char*>(r->reply), kReplySize, fmt, a, b);
+  r->reply_len = n < 0 ? 0 : static_cast<uint32_t>(n);
+}
+
+Reassembler* reasm_create(uint32_t size, uint32_t packets,
+                          uint32_t object_crc) {
+  if (packets == 0 || packets > 0xFFFF) return nullptr;
+
+  Reassembler* r = static_cast<Reassembler*>(calloc(1, sizeof(Reassembler)));
+  if (!r) return nullptr;
+  r->data = static_cast<uint8_t*>(malloc(size ? size : 1));
+  r->bitmap =
+      static_cast<uint64_t*>(calloc((packets + 63) / 64, sizeof(uint64_t)));
+  if (!r->data || !r->bitmap) {
+    reasm_destroy(r);
+    return nullptr;
+  }
+  r->size = size;
+  r->packets = packets;
+  r->object_crc = object_crc;
+  return r;
+}
+
+void reasm_destroy(Reassembler* r) {
+  if (!r) return;
+  free(r->data);
+  free(r->bitmap);
+  free(r);
+}
+
+uint8_t* reasm_staging(Reassembler* r) { return r->staging; }
+
+uint32_t reasm_staging_capacity(void) { return kStagingSize; }
+
+int32_t reasm_add_staged(Reassembler* r, uint32_t len) {
+  const uint8_t* p = r->staging;
+  if (len <= kSeqSize + kTrailerSize || len > kStagingSize) {
+    r->reply_len = 0;
+    return REASM_BAD_PACKET;
+  }
+
+  uint32_t seq = (p[0] << 8) | p[1];
+  uint32_t payload_len = len - kSeqSize - kTrailerSize;
+  const uint8_t* t = p + len - kTrailerSize;
+  uint32_t sent = t[0] | (t[1] << 8) | (t[2] << 16) |
+                  (static_cast<uint32_t>(t[3]) << 24);
+
+  // Offsets follow from the fixed chunk length: only the last packet
+  // may be short, and it ends exactly at the object size
+  bool last = seq == r->packets - 1;
+  uint32_t offset = last ? r->size - payload_len : seq * payload_len;
+  bool fits = seq < r->packets && payload_len <= r->size &&
+              (last || r->chunk == 0 || payload_len == r->chunk) &&
+              (!last || r->chunk == 0 || offset == seq * r->chunk) &&
+              offset + payload_len <= r->size;
+
+  if (!fits || crc32(p, len - kTrailerSize) != sent) {
+    // The seq may be the corrupted part: ask for the lowest packet still
+    // missing instead. The device sends the packet it had in flight
+    // again with it, so whichever one this was is not lost.
+    if (r->first_missing < r->packets) {
+      set_reply(r, "RESEND:%u-%u", r->first_missing, r->first_missing);
+    } else {
+      r->reply_len = 0;
+    }
+    return REASM_BAD_PACKET;
+  }
+
+  set_reply(r, "ACK:%u", seq + 1, 0);
+  if (has_packet(r, seq)) return REASM_DUPLICATE;
+
+  if (!last) r->chunk = payload_len;
+  memcpy(r->data + offset, p + kSeqSize, payload_len);
+  r->bitmap[seq >> 6] |= uint64_t(1) << (seq & 63);
+  r->received++;
+  while (r->first_missing < r->packets && has_packet(r, r->first_missing))
+    r->first_missing++;
+
+  if (r->received < r->packets) return REASM_ACCEPTED;
+
+  if (r->object_crc != 0 && crc32(r->data, r->size) != r->object_crc) {
+    // Every packet checked out, so the loss is in reassembly: start over
+    reset(r);
+    set_reply(r, "RESEND:0-%u", r->packets - 1, 0);
+    return REASM_BAD_OBJECT;
+  }
+  return REASM_COMPLETE;
+}
+
+uint32_t reasm_received(const Reassembler* r) { return r->received; }
+
+uint32_t reasm_acked_packets(const Reassembler* r) { return r->first_missing; }
+
+const uint8_t* reasm_data(const Reassembler* r) { return r->data; }
+
+uint32_t reasm_size(const Reassembler* r) { return r->size; }
+
+const uint8_t* reasm_reply(const Reassembler* r) { return r->reply; }
+
+uint32_t reasm_reply_length(const Reassembler* r) { return r->reply_len; }
+
+uint32_t reasm_build_resume(Reassembler* r, uint32_t object_id) {
+  uint32_t from[kMaxResumeRanges];
+  uint32_t to[kMaxResumeRanges];
+  int ranges = 0;
+
+  uint32_t seq = r->first_missing;
+  while (seq < r->packets) {
+    // Whole words of held packets are skipped without bit tests
+    if ((seq & 63) == 0 && r->bitmap[seq >> 6] == ~uint64_t(0)) {
+      seq += 64;
+      continue;
+    }
+    if (has_packet(r, seq)) {
+      seq++;
+      continue;
+    }
+    uint32_t start = seq;
+    while (seq < r->packets && !has_packet(r, seq)) seq++;
+
+    if (ranges == kMaxResumeRanges) {
+      // Out of ranges: widen the last one to the end, as the device does
+      to[ranges - 1] = r->packets - 1;
+      break;
+    }
+    from[ranges] = start;
+    to[ranges] = seq - 1;
+    ranges++;
+  }
+
+  char* out = reinterpret_cast<char*>(r->reply);
+  int n = snprintf(out, kReplySize, "RESUME:%u:", object_id);
+  for (int i = 0; i < ranges && n < static_cast<int>(kReplySize); i++) {
+    n += snprintf(out + n, kReplySize - n, i ? ",%u-%u" : "%u-%u", from[i],
+                  to[i]);
+  }
+
+  r->reply_len = n < static_cast<int>(kReplySize) ? n : kReplySize - 1;
+  return r->reply_len;
+}
@@ -0,0 +1,62 @@
+#ifndef PHONE_NATIVE_REASSEMBLY_H_
+#define PHONE_NATIVE_REASSEMBLY_H_
+
+#include <stdint.h>
+
+#include "native_export.h"
+
+// Receiver side of the device's image transfers: packets are verified,
+// copied once into a buffer sized for the whole object, and tracked in a
+// bitmap. The reply to send back (ACK / RESEND / RESUME text) is built
+// here too, so the Dart side only moves bytes.
+//
+// Packet layout (protocol/messages.json): ImagePacket (seq u16 BE) |
+// payload | ImagePacketTrailer (CRC-32 LE of seq + payload). Every
+// packet but the last carries the same payload length.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct Reassembler Reassembler;
+
+enum ReassemblyStatus {
+  REASM_ACCEPTED = 0,   // new packet stored, reply is an ACK
+  REASM_DUPLICATE = 1,  // already held, reply is an ACK
+  REASM_COMPLETE = 2,   // last packet stored and object CRC matches
+  REASM_BAD_PACKET = 3, // CRC or length mismatch, reply is a RESEND of
+                        // the lowest missing packet
+  REASM_BAD_OBJECT = 4, // all packets held but object CRC failed; reset
+};
+
+// Allocates the output buffer and bitmap up front; NULL on failure
+PHONE_NATIVE_EXPORT Reassembler* reasm_create(uint32_t size, uint32_t packets,
+                                              uint32_t object_crc);
+PHONE_NATIVE_EXPORT void reasm_destroy(Reassembler* r);
+
+// Scratch area the caller copies one received packet into
+PHONE_NATIVE_EXPORT uint8_t* reasm_staging(Reassembler* r);
+PHONE_NATIVE_EXPORT uint32_t reasm_staging_capacity(void);
+
+// Verifies and stores the packet in the staging area
+PHONE_NATIVE_EXPORT int32_t reasm_add_staged(Reassembler* r, uint32_t len);
+
+PHONE_NATIVE_EXPORT uint32_t reasm_received(const Reassembler* r);
+PHONE_NATIVE_EXPORT uint32_t reasm_acked_packets(const Reassembler* r);
+
+// The assembled object (valid once complete)
+PHONE_NATIVE_EXPORT const uint8_t* reasm_data(const Reassembler* r);
+PHONE_NATIVE_EXPORT uint32_t reasm_size(const Reassembler* r);
+
+// Reply text (not NUL-terminated) for the last reasm_add_staged(), or
+// after reasm_build_resume() the RESUME command listing the missing ranges
+PHONE_NATIVE_EXPORT const uint8_t* reasm_reply(const Reassembler* r);
+PHONE_NATIVE_EXPORT uint32_t reasm_reply_length(const Reassembler* r);
+PHONE_NATIVE_EXPORT uint32_t reasm_build_resume(Reassembler* r,
+                                                uint32_t object_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // PHONE_NATIVE_REASSEMBLY_H_
@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdint.h>
+
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench.h"
+#include "imu_fusion.h"
+
+// The native engine against the Dart analysis it replaces
+// (IMUFusionService._analyzeData in imu_fusion_service.dart), ported
+// line for line: a queue of event objects per sensor trimmed by count,
+// and a full pass over both queues every 100 ms timer tick. Both are fed
+// the same minute of 100 Hz accelerometer and gyroscope samples.
+
+namespace {
+
+constexpr int kRateHz = 100;
+constexpr int kSeconds = 60;
+constexpr uint32_t kWindowMs = 2000;
+constexpr int kTickMs = 100;
+
+struct Event {
+  double x, y, z;  // sensors_plus events carry doubles
+};
+
+struct Sample {
+  int64_t t_us;
+  Event accel, gyro;
+};
+
+// Walking: gravity, a 2 Hz bounce and noise
+std::vector<Sample> walk() {
+  std::mt19937 rng(38);
+  std::normal_distribution<double> noise(0, 0.4);
+  std::vector<Sample> out;
+  for (int i = 0; i < kRateHz * kSeconds; i++) {
+    double t = double(i) / kRateHz;
+    double bounce = 3 * sin(2 * M_PI * 2 * t);
+    out.push_back({int64_t(i) * 1000000 / kRateHz,
+                   {noise(rng), noise(rng) + bounce * 0.3, 9.81 + bounce},
+                   {0.5 * sin(2 * M_PI * t) + noise(rng) * 0.1,
+                    noise(rng) * 0.1, 0.2 + noise(rng) * 0.1}});
+  }
+  return out;
+}
+
+// IMUFusionService's Dart path
+class DartAnalysis {
+ public:
+  explicit DartAnalysis(size_t max_samples) : max_samples_(max_samples) {}
+
+  void add_accel(const Event& e) {
+    accel_.push_back(e);
+    trim(&accel_);
+  }
+  void add_gyro(const Event& e) {
+    gyro_.push_back(e);
+    trim(&gyro_);
+  }
+
+  // _analyzeData(): the three features and the behaviour string
+  bool analyze(double* accel_variance, double* motion) {
+    if (accel_.empty() || gyro_.empty()) return false;
+    *accel_variance = variance(accel_);
+    double gyro_variance = variance(gyro_);
+    *motion = magnitude();
+    state_ = behavior(*accel_variance, gyro_variance, *motion);
+    return true;
+  }
+
+  const std::string& state() const { return state_; }
+
+ private:
+  void trim(std::deque<Event>* buffer) {
+    while (buffer->size() > max_samples_) buffer->pop_front();
+  }
+
+  static double variance(const std::deque<Event>& buffer) {
+    double sx = 0, sy = 0, sz = 0, sx2 = 0, sy2 = 0, sz2 = 0;
+    double count = buffer.size();
+    for (const Event& e : buffer) {
+      sx += e.x;
+      sy += e.y;
+      sz += e.z;
+      sx2 += e.x * e.x;
+      sy2 += e.y * e.y;
+      sz2 += e.z * e.z;
+    }
+    double mx = sx / count, my = sy / count, mz = sz / count;
+    return (sx2 / count - mx * mx + sy2 / count - my * my + sz2 / count -
+            mz * mz) / 3;
+  }
+
+  double magnitude() const {
+    double best = 0;
+    for (const Event& e : accel_) {
+      double m = sqrt(e.x * e.x + e.y * e.y + e.z * e.z);
+      best = m > best ? m : best;
+    }
+    return best;
+  }
+
+  static std::string behavior(double av, double gv, double m) {
+    if (m > 15 || av > 10 || gv > 10) return "walking_with_phone";
+    if (m > 5 || av > 3 || gv > 3) return "light_activity";
+    return "sitting_idle";
+  }
+
+  size_t max_samples_;
+  std::deque<Event> accel_, gyro_;
+  std::string state_;
+};
+
+// Samples, then the timer's analysis whenever a tick has passed
+uint64_t run_dart(const std::vector<Sample>& samples, size_t max_samples) {
+  DartAnalysis dart(max_samples);
+  int64_t next_tick = kTickMs * 1000;
+  uint64_t out = 0;
+  for (const Sample& s : samples) {
+    dart.add_accel(s.accel);
+    dart.add_gyro(s.gyro);
+    if (s.t_us >= next_tick) {
+      next_tick += kTickMs * 1000;
+      double v, m;
+      if (dart.analyze(&v, &m)) out += uint64_t(v * 1000) + dart.state().size();
+    }
+  }
+  return out;
+}
+
+// The native path as the service drives it: evaluate on every sample
+uint64_t run_native(const std::vector<Sample>& samples, int* reports) {
+  ImuFusion* f = imu_create(kWindowMs, 200);
+  uint64_t out = 0;
+  *reports = 0;
+  for (const Sample& s : samples) {
+    imu_add_accel(f, s.t_us + 1, s.accel.x, s.accel.y, s.accel.z);
+    imu_add_gyro(f, s.t_us + 1, s.gyro.x, s.gyro.y, s.gyro.z);
+    if (imu_evaluate(f, s.t_us + 1, kTickMs)) {
+      ++*reports;
+      out += uint64_t(imu_result(f)->accel_variance * 1000);
+    }
+  }
+  imu_destroy(f);
+  return out;
+}
+
+TEST(ImuFusionBench, NativeAgainstDartPort) {
+  std::vector<Sample> samples = walk();
+  long n = samples.size();
+  const size_t window = kWindowMs * kRateHz / 1000;
+
+  double ns = benchNs(5, [&](long) { benchKeep(run_dart(samples, 20)); });
+  benchReport("Dart port, 20-sample queues (as shipped)", ns / n, "sample");
+  ns = benchNs(5, [&](long) { benchKeep(run_dart(samples, window)); });
+  benchReport("Dart port, 2 s queues (200 samples)", ns / n, "sample");
+  int reports = 0;
+  ns = benchNs(5, [&](long) { benchKeep(run_native(samples, &reports)); });
+  benchReport("native, 2 s window, evaluated per sample", ns / n, "sample");
+  printf("[   BENCH  ] native reported %d of %d ticks\n", reports,
+         kSeconds * 1000 / kTickMs);
+}
+
+// Over the same 2 s of samples both compute the same features
+TEST(ImuFusionBench, SameFeaturesAsTheDartPort) {
+  std::vector<Sample> samples = walk();
+  ImuFusion* f = imu_create(kWindowMs, 200);
+  for (int i = 0; i < 1000; i++) {
+    const Sample& s = samples[i];
+    imu_add_accel(f, s.t_us + 1, s.accel.x, s.accel.y, s.accel.z);
+    imu_add_gyro(f, s.t_us + 1, s.gyro.x, s.gyro.y, s.gyro.z);
+  }
+  ASSERT_EQ(1, imu_evaluate(f, samples[999].t_us + 1, kTickMs));
+  const ImuResult* r = imu_result(f);
+
+  DartAnalysis dart(r->samples);
+  for (int i = 0; i < 1000; i++) {
+    // The engine holds floats
+    const Event& a = samples[i].accel;
+    const Event& g = samples[i].gyro;
+    dart.add_accel({float(a.x), float(a.y), float(a.z)});
+    dart.add_gyro({float(g.x), float(g.y), float(g.z)});
+  }
+  double variance, motion;
+  ASSERT_TRUE(dart.analyze(&variance, &motion));
+  EXPECT_NEAR(variance, r->accel_variance, 1e-6 * variance);
+  EXPECT_NEAR(motion, r->motion_magnitude, 1e-5);
+  const char* states[] = {"sitting_idle", "light_activity",
+                          "walking_with_phone"};
+  EXPECT_EQ(states[r->behavior], dart.state());
+  imu_destroy(f);
+}
+
+}  // namespace
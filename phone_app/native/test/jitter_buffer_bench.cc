@@ -0,0 +1,228 @@
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <vector>
+
+#include "adpcm.h"
+#include "jitter_buffer.h"
+#include "stream_mux.h"
+#include "wire_format.h"
+
+// Mouth-to-ear latency of live audio over a simulated link, on a
+// millisecond clock: the device side is liveTask() (a 20 ms frame
+// encoded when it is complete) and the firmware's stream mux; the radio
+// sends up to a few notifications per connection event and loses whole
+// events in bursts (a two-state Gilbert model; the link layer retries
+// on the next event, so a bad event delays rather than drops); the
+// phone's stack hands each notification up a few ms later, and the
+// player pulls a frame every 20 ms from the jitter buffer as
+// LiveAudioReceiver does.
+//
+// Each frame's first sample carries its sequence number (an ADPCM block
+// stores it verbatim), so every played frame is traced back to the
+// moment it was spoken. The phone's audio output latency is not in the
+// figures; it adds the same on top of every mode.
+
+namespace {
+
+constexpr uint32_t kFrameMs = 20;
+constexpr uint32_t kFrameSamples = 320;
+constexpr uint32_t kMinDelayMs = 40;    // LiveAudioReceiver
+constexpr uint32_t kMaxDelayMs = 400;
+constexpr uint32_t kDeviceOffset = 123456;   // device clock ahead of the phone
+constexpr uint32_t kRunMs = 60000;
+
+struct Link {
+  const char* name;
+  double interval_ms;
+  uint32_t per_event;      // notifications per connection event
+  double p_bad;            // good -> bad event state, per event
+  double p_good;           // bad -> good
+  double bad_loss;         // events lost while bad
+  bool photo;              // a photo transfer sharing the link
+};
+
+struct Result {
+  std::vector<uint32_t> ear_ms;   // measured, per played frame
+  uint32_t frames = 0;            // captured
+  uint32_t dropped = 0;           // refused by the device queue
+  JitterStats stats;
+  bool estimate_ok = true;        // jitter buffer's own figure in bounds
+};
+
+// Bulk data that is always ready, as an image transfer in flight
+size_t photo_pull(uint8_t* out, size_t cap) {
+  memset(out, 0xAB, cap);
+  return cap;
+}
+
+Result simulate(const Link& link, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> u(0, 1);
+
+  muxReset();
+  muxRegister(MUX_LIVE, MUX_CLASS_LIVE, 1, nullptr);
+  muxRegister(MUX_IMAGE, MUX_CLASS_BULK, 1, link.photo ? photo_pull : nullptr);
+
+  JitterBuffer* jb = jb_create(kFrameSamples, kFrameMs, kMinDelayMs, kMaxDelayMs);
+  Result r;
+
+  struct Delivery {
+    uint32_t at;
+    std::vector<uint8_t> frame;
+  };
+  std::deque<Delivery> stack;
+  uint32_t last_delivery = 0;
+
+  double next_event = u(rng) * link.interval_ms;
+  bool bad = false;
+  uint32_t pull_phase = static_cast<uint32_t>(rng() % kFrameMs);
+  AdpcmState adpcm = {0, 0};
+  uint16_t seq = 0;
+  uint32_t fastest_trip = UINT32_MAX;   // frame complete to phone arrival
+
+  for (uint32_t now = 0; now < kRunMs; now++) {
+    uint32_t device_ms = now + kDeviceOffset;
+
+    // A frame is complete: encode and queue it (liveTask)
+    if (now >= kFrameMs && now % kFrameMs == 0) {
+      int16_t pcm[kFrameSamples];
+      for (uint32_t i = 0; i < kFrameSamples; i++) {
+        double t = (seq * kFrameSamples + i) / 16000.0;
+        pcm[i] = static_cast<int16_t>(3000 * sin(2 * M_PI * 440 * t));
+      }
+      pcm[0] = static_cast<int16_t>(seq);
+      uint8_t frame[LiveAudioFrame::SIZE + 4 + kFrameSamples / 2];
+      size_t len = adpcmEncodeFrame(&adpcm, pcm, kFrameSamples, frame + LiveAudioFrame::SIZE);
+      LiveAudioFrame::Writer header{frame};
+      header.setKind(WIRE_LIVE_KIND_AUDIO);
+      header.setSeq(seq);
+      header.setTimeMs(device_ms - kFrameMs);
+      header.setSamples(kFrameSamples);
+      if (!muxEnqueue(MUX_LIVE, frame, LiveAudioFrame::SIZE + len, device_ms)) r.dropped++;
+      r.frames++;
+      seq++;
+    }
+
+    // Connection events
+    while (next_event < now + 1) {
+      bad = bad ? u(rng) >= link.p_good : u(rng) < link.p_bad;
+      if (!bad || u(rng) >= link.bad_loss) {
+        for (uint32_t i = 0; i < link.per_event; i++) {
+          uint8_t frame[MUX_FRAME_MAX];
+          size_t len = muxNextFrame(frame, device_ms);
+          if (len == 0) break;
+          if (frame[0] != MUX_LIVE) continue;
+          // The phone's stack keeps notifications in order
+          uint32_t at = std::max(last_delivery, now + 1 + static_cast<uint32_t>(rng() % 8));
+          last_delivery = at;
+          stack.push_back({at, std::vector<uint8_t>(frame + 1, frame + len)});
+        }
+      }
+      next_event += link.interval_ms;
+    }
+
+    while (!stack.empty() && stack.front().at <= now) {
+      const std::vector<uint8_t>& p = stack.front().frame;
+      memcpy(jb_staging(jb), p.data(), p.size());
+      jb_push_staged(jb, static_cast<uint32_t>(p.size()), now);
+      uint16_t s = LiveAudioFrame::View{p.data()}.seq();
+      fastest_trip = std::min(fastest_trip, now - (s + 1) * kFrameMs);
+      stack.pop_front();
+    }
+
+    // The player
+    if (now % kFrameMs == pull_phase && jb_pull(jb, now) == JB_PLAYED) {
+      uint16_t played = static_cast<uint16_t>(jb_output(jb)[0]);
+      uint32_t spoken = played * kFrameMs;   // its first sample, phone clock
+      uint32_t ear = now - spoken;
+      r.ear_ms.push_back(ear);
+      // The buffer measures above the link's fastest trip
+      uint32_t estimate = jb_stats(jb)->ear_delay_ms;
+      if (estimate > ear || ear - estimate < fastest_trip) r.estimate_ok = false;
+    }
+  }
+  r.stats = *jb_stats(jb);
+  jb_destroy(jb);
+  return r;
+}
+
+uint32_t percentile(std::vector<uint32_t> v, int p) {
+  std::sort(v.begin(), v.end());
+  return v[(v.size() - 1) * p / 100];
+}
+
+void report(const Link& link, const Result& r) {
+  printf("[   BENCH  ] %-36s median %4u ms, p95 %4u ms, concealed %5.2f%%, "
+         "late %u, skipped %u, dropped %u\n",
+         link.name, percentile(r.ear_ms, 50), percentile(r.ear_ms, 95),
+         100.0 * r.stats.concealed / r.frames, r.stats.late, r.stats.skipped,
+         r.dropped);
+}
+
+// The burst profile (conn_manager.cpp: 7.5-15 ms, 2M PHY, DLE), which
+// the device holds while live audio is on
+const Link kClean7 = {"7.5 ms interval", 7.5, 4, 0, 1, 0, false};
+const Link kClean15 = {"15 ms interval", 15, 6, 0, 1, 0, false};
+const Link kNoisy = {"15 ms interval, interference", 15, 6, 0.02, 0.3, 0.9, false};
+const Link kPhoto = {"15 ms interval, photo transfer", 15, 6, 0, 1, 0, true};
+const Link kNoisyPhoto = {"15 ms, interference + photo", 15, 6, 0.02, 0.3, 0.9, true};
+// The idle profile, 100-200 ms
+const Link kIdle = {"150 ms interval (idle profile)", 150, 6, 0, 1, 0, false};
+
+TEST(JitterBufferBench, MouthToEarOnTheLinkModel) {
+  for (const Link* link : {&kClean7, &kClean15, &kNoisy, &kPhoto, &kNoisyPhoto}) {
+    Result r = simulate(*link, 44);
+    report(*link, r);
+    SCOPED_TRACE(link->name);
+    EXPECT_TRUE(r.estimate_ok);
+    EXPECT_EQ(0u, r.dropped);
+    // Every frame is played once, or skipped, or concealed
+    EXPECT_GE(r.frames, r.stats.played + r.stats.skipped);
+    EXPECT_LE(r.frames - r.stats.played, r.frames / 50 + 5);
+    EXPECT_LT(percentile(r.ear_ms, 95), 150u);
+    if (link->p_bad == 0) {
+      EXPECT_EQ(0u, r.stats.late);
+      EXPECT_LE(r.stats.concealed, 2u);
+      EXPECT_LT(percentile(r.ear_ms, 95), 100u);
+    }
+  }
+}
+
+// Why live audio keeps the link in the burst profile: six notifications
+// per 150 ms event are 40 frames a second, against 50 produced
+TEST(JitterBufferBench, IdleProfileCannotCarryLiveAudio) {
+  Result r = simulate(kIdle, 44);
+  report(kIdle, r);
+  EXPECT_GT(r.dropped, r.frames / 10);
+  EXPECT_GT(percentile(r.ear_ms, 50), 400u);
+}
+
+// Live priority: a photo on the same link costs live audio nothing
+TEST(JitterBufferBench, PhotoTransferDoesNotDelayLiveAudio) {
+  Result alone = simulate(kClean15, 7);
+  Result shared = simulate(kPhoto, 7);
+  EXPECT_EQ(percentile(alone.ear_ms, 50), percentile(shared.ear_ms, 50));
+  EXPECT_EQ(alone.stats.concealed, shared.stats.concealed);
+}
+
+// The flow live mode replaces: record a 10 s clip, STOP_AUDIO, then the
+// whole ADPCM WAV over the link. The first word is heard after all of
+// it, on the same 7.5 ms link.
+TEST(JitterBufferBench, RecordThenSendForComparison) {
+  const uint32_t clip_ms = 10000;
+  size_t bytes = adpcmEncodedSize(clip_ms * 16);
+  double per_ms = kClean7.per_event * MUX_PAYLOAD_MAX / kClean7.interval_ms;
+  uint32_t ear = clip_ms + static_cast<uint32_t>(bytes / per_ms);
+  printf("[   BENCH  ] %-36s first sample heard after %u ms\n",
+         "10 s clip, record then send (before)", ear);
+  Result live = simulate(kClean7, 44);
+  EXPECT_LT(percentile(live.ear_ms, 95) * 50, ear);
+}
+
+}  // namespace
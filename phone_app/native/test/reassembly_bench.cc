@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "bench.h"
+#include "crc32.h"
+#include "reassembly.h"
+
+// What the phone spends per received packet: a 100 KB photo in 180-byte
+// packets, in order and with every other packet held back for a second
+// pass; and a RESUME built over a mostly held 64K-packet bitmap.
+
+namespace {
+
+constexpr uint32_t kChunk = 180;
+constexpr uint32_t kSize = 100000;
+
+// Every packet of the object, framed as the device sends it
+std::vector<std::vector<uint8_t>> framed_packets(const std::vector<uint8_t>& object) {
+  std::vector<std::vector<uint8_t>> out;
+  for (uint32_t off = 0, seq = 0; off < object.size(); off += kChunk, seq++) {
+    uint32_t len = std::min<uint32_t>(kChunk, object.size() - off);
+    std::vector<uint8_t> p(2 + len + 4);
+    p[0] = seq >> 8;
+    p[1] = seq & 0xFF;
+    memcpy(p.data() + 2, object.data() + off, len);
+    uint32_t crc = crc32Update(0, p.data(), 2 + len);
+    memcpy(p.data() + 2 + len, &crc, 4);
+    out.push_back(p);
+  }
+  return out;
+}
+
+// Feeds the packets in `order` to a fresh reassembler
+uint32_t receive(const std::vector<std::vector<uint8_t>>& packets,
+                 const std::vector<uint32_t>& order, uint32_t object_crc) {
+  Reassembler* r = reasm_create(kSize, packets.size(), object_crc);
+  uint32_t status = 0;
+  for (uint32_t seq : order) {
+    memcpy(reasm_staging(r), packets[seq].data(), packets[seq].size());
+    status += reasm_add_staged(r, packets[seq].size());
+    status += reasm_reply_length(r);
+  }
+  reasm_destroy(r);
+  return status;
+}
+
+TEST(ReassemblyBench, PerPacket) {
+  std::mt19937 rng(37);
+  std::vector<uint8_t> object(kSize);
+  for (uint8_t& b : object) b = rng();
+  uint32_t object_crc = crc32Update(0, object.data(), kSize);
+  auto packets = framed_packets(object);
+
+  std::vector<uint32_t> in_order, interleaved;
+  for (uint32_t i = 0; i < packets.size(); i++) in_order.push_back(i);
+  for (uint32_t i = 0; i < packets.size(); i += 2) interleaved.push_back(i);
+  for (uint32_t i = 1; i < packets.size(); i += 2) interleaved.push_back(i);
+
+  double ns = benchNs(50, [&](long) {
+    benchKeep(receive(packets, in_order, object_crc));
+  });
+  benchReport("100 KB in order, object CRC included", ns / packets.size(),
+              "packet");
+  ns = benchNs(50, [&](long) {
+    benchKeep(receive(packets, interleaved, object_crc));
+  });
+  benchReport("100 KB evens then odds", ns / packets.size(), "packet");
+  // CRC is checked twice per byte (packet, then object): it is the cost
+  ns = benchNs(50, [&](long) {
+    benchKeep(crc32Update(0, object.data(), kSize));
+  });
+  benchReport("crc32 of the same 100 KB", ns / packets.size(), "packet");
+}
+
+TEST(ReassemblyBench, ResumeOverALargeBitmap) {
+  const uint32_t packets = 0xFFFF;
+  const uint32_t size = packets * 8;
+  std::vector<uint8_t> object(size, 0x5A);
+  Reassembler* r = reasm_create(size, packets, 0);
+  uint8_t* p = reasm_staging(r);
+  for (uint32_t seq = 0; seq < packets; seq++) {
+    // Holes at the start, in the middle and at the end
+    if (seq == 3 || seq == 40000 || seq >= packets - 2) continue;
+    p[0] = seq >> 8;
+    p[1] = seq & 0xFF;
+    memcpy(p + 2, object.data(), 8);
+    uint32_t crc = crc32Update(0, p, 10);
+    memcpy(p + 10, &crc, 4);
+    ASSERT_EQ(REASM_ACCEPTED, reasm_add_staged(r, 14));
+  }
+  double ns = benchNs(2000, [&](long i) {
+    benchKeep(reasm_build_resume(r, i));
+  });
+  benchReport("RESUME over 65535 packets, 3 holes", ns);
+  reasm_destroy(r);
+}
+
+}  // namespace
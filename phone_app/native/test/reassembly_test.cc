@@ -0,0 +1,166 @@
+#include "reassembly.h"
+
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "crc32.h"
+
+// The receiver's rules as the device sees them: what is stored, what
+// is answered, and what a RESUME lists.
+
+namespace {
+
+constexpr uint32_t kChunk = 180;  // IMAGE_CHUNK_SIZE on the device
+
+class Transfer {
+ public:
+  Transfer(uint32_t size, uint32_t seed) : object_(size) {
+    std::mt19937 rng(seed);
+    for (uint8_t& b : object_) b = rng();
+    packets_ = (size + kChunk - 1) / kChunk;
+    r_ = reasm_create(size, packets_, crc32Update(0, object_.data(), size));
+  }
+  ~Transfer() { reasm_destroy(r_); }
+
+  // ImagePacket | payload | ImagePacketTrailer, as the device builds it;
+  // `flip` corrupts one bit of the packet at that byte
+  int send(uint32_t seq, int flip = -1) {
+    uint8_t* p = reasm_staging(r_);
+    uint32_t off = seq * kChunk;
+    uint32_t len = std::min<uint32_t>(kChunk, object_.size() - off);
+    p[0] = seq >> 8;
+    p[1] = seq & 0xFF;
+    memcpy(p + 2, object_.data() + off, len);
+    uint32_t crc = crc32Update(0, p, 2 + len);
+    memcpy(p + 2 + len, &crc, 4);
+    if (flip >= 0) p[flip] ^= 0x04;
+    return reasm_add_staged(r_, 2 + len + 4);
+  }
+
+  std::string reply() const {
+    return std::string(reinterpret_cast<const char*>(reasm_reply(r_)),
+                       reasm_reply_length(r_));
+  }
+
+  bool holds_object() const {
+    return reasm_received(r_) == packets_ &&
+           memcmp(reasm_data(r_), object_.data(), object_.size()) == 0;
+  }
+
+  Reassembler* r_;
+  std::vector<uint8_t> object_;
+  uint32_t packets_;
+};
+
+TEST(Reassembly, InOrderCompletes) {
+  Transfer t(1000, 1);  // 5 full packets and a short one
+  ASSERT_EQ(6u, t.packets_);
+  for (uint32_t seq = 0; seq < 5; seq++) {
+    EXPECT_EQ(REASM_ACCEPTED, t.send(seq));
+    EXPECT_EQ("ACK:" + std::to_string(seq + 1), t.reply());
+    EXPECT_EQ(seq + 1, reasm_acked_packets(t.r_));
+  }
+  EXPECT_EQ(REASM_COMPLETE, t.send(5));
+  EXPECT_TRUE(t.holds_object());
+}
+
+TEST(Reassembly, OutOfOrderAndDuplicates) {
+  Transfer t(10 * kChunk, 2);
+  for (uint32_t seq : {3u, 0u, 9u, 1u}) EXPECT_EQ(REASM_ACCEPTED, t.send(seq));
+  EXPECT_EQ(2u, reasm_acked_packets(t.r_));
+  EXPECT_EQ(REASM_DUPLICATE, t.send(3));
+  EXPECT_EQ("ACK:4", t.reply());
+  for (uint32_t seq : {2u, 4u, 5u, 6u, 7u}) t.send(seq);
+  EXPECT_EQ(REASM_COMPLETE, t.send(8));
+  EXPECT_TRUE(t.holds_object());
+}
+
+// A bad CRC asks for the lowest missing packet, never for the sequence
+// number read from the damaged packet
+TEST(Reassembly, CorruptPacketAsksForTheLowestMissing) {
+  Transfer t(20 * kChunk, 3);
+  for (uint32_t seq = 0; seq < 4; seq++) t.send(seq);
+  t.send(6);
+
+  EXPECT_EQ(REASM_BAD_PACKET, t.send(4, 50));  // payload
+  EXPECT_EQ("RESEND:4-4", t.reply());
+  EXPECT_EQ(REASM_BAD_PACKET, t.send(4, 0));  // seq high byte: reads 1028
+  EXPECT_EQ("RESEND:4-4", t.reply());
+  EXPECT_EQ(REASM_BAD_PACKET, t.send(7, 1));  // seq low byte: reads 3
+  EXPECT_EQ("RESEND:4-4", t.reply());
+  EXPECT_EQ(REASM_BAD_PACKET, t.send(7, 2 + kChunk + 1));  // trailer
+  EXPECT_EQ("RESEND:4-4", t.reply());
+  EXPECT_EQ(5u, reasm_received(t.r_));
+}
+
+TEST(Reassembly, WrongLengthIsABadPacket) {
+  Transfer t(10 * kChunk, 4);
+  EXPECT_EQ(REASM_BAD_PACKET, reasm_add_staged(t.r_, 6));
+  EXPECT_EQ(0u, reasm_reply_length(t.r_));
+  t.send(0);
+  // A middle packet shorter than the first
+  uint8_t* p = reasm_staging(t.r_);
+  p[0] = 0;
+  p[1] = 1;
+  memset(p + 2, 0, 100);
+  uint32_t crc = crc32Update(0, p, 102);
+  memcpy(p + 102, &crc, 4);
+  EXPECT_EQ(REASM_BAD_PACKET, reasm_add_staged(t.r_, 106));
+  EXPECT_EQ("RESEND:1-1", t.reply());
+}
+
+TEST(Reassembly, BadObjectStartsOver) {
+  std::vector<uint8_t> object(3 * kChunk, 7);
+  Reassembler* r = reasm_create(object.size(), 3, 0x12345678);  // wrong CRC
+  for (uint32_t seq = 0; seq < 3; seq++) {
+    uint8_t* p = reasm_staging(r);
+    p[0] = 0;
+    p[1] = seq;
+    memcpy(p + 2, object.data(), kChunk);
+    uint32_t crc = crc32Update(0, p, 2 + kChunk);
+    memcpy(p + 2 + kChunk, &crc, 4);
+    int status = reasm_add_staged(r, 2 + kChunk + 4);
+    EXPECT_EQ(seq < 2 ? REASM_ACCEPTED : REASM_BAD_OBJECT, status);
+  }
+  EXPECT_EQ(std::string("RESEND:0-2"),
+            std::string(reinterpret_cast<const char*>(reasm_reply(r)),
+                        reasm_reply_length(r)));
+  EXPECT_EQ(0u, reasm_received(r));
+  reasm_destroy(r);
+}
+
+TEST(Reassembly, ResumeListsMissingRanges) {
+  Transfer t(200 * kChunk, 5);
+  for (uint32_t seq = 0; seq < 200; seq++) {
+    if (seq != 5 && !(seq >= 70 && seq < 130) && seq != 199) t.send(seq);
+  }
+  reasm_build_resume(t.r_, 42);
+  EXPECT_EQ("RESUME:42:5-5,70-129,199-199", t.reply());
+
+  // More holes than the device keeps ranges: the last one runs to the end
+  Transfer holes(200 * kChunk, 6);
+  for (uint32_t seq = 0; seq < 200; seq++) {
+    if (seq % 20 != 0) holes.send(seq);
+  }
+  reasm_build_resume(holes.r_, 7);
+  EXPECT_EQ("RESUME:7:0-0,20-20,40-40,60-60,80-80,100-100,120-120,140-199",
+            holes.reply());
+
+  Transfer whole(3 * kChunk, 8);
+  for (uint32_t seq = 0; seq < 3; seq++) whole.send(seq);
+  reasm_build_resume(whole.r_, 9);
+  EXPECT_EQ("RESUME:9:", whole.reply());
+}
+
+TEST(Reassembly, RejectsImpossibleObjects) {
+  EXPECT_EQ(nullptr, reasm_create(100, 0, 0));
+  EXPECT_EQ(nullptr, reasm_create(100, 0x10000, 0));
+}
+
+}  // namespace
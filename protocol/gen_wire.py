@@ -0,0 +1,219 @@
+"""Generate the wire-format accessors from messages.json.
+
+Writes xiao_esp32s3_sense/wire_format.h (constexpr offsets, zero-copy
+view/writer structs) and phone_app/lib/protocol/wire_format.dart (the
+same layouts as Dart views over the received bytes). Both outputs are
+checked in, since neither the Arduino nor the Flutter build runs this.
+
+    python3 protocol/gen_wire.py          # regenerate
+    python3 protocol/gen_wire.py --check  # fail if the outputs are stale
+"""
+
+import json
+import os
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+SCHEMA = os.path.join(ROOT, "protocol", "messages.json")
+CPP_OUT = os.path.join(ROOT, "xiao_esp32s3_sense", "wire_format.h")
+DART_OUT = os.path.join(ROOT, "phone_app", "lib", "protocol", "wire_format.dart")
+
+# type -> (size, C type, endianness)
+TYPES = {
+    "u8": (1, "uint8_t", None),
+    "u16le": (2, "uint16_t", "le"),
+    "u16be": (2, "uint16_t", "be"),
+    "u32le": (4, "uint32_t", "le"),
+    "u32be": (4, "uint32_t", "be"),
+    "u64le": (8, "uint64_t", "le"),
+}
+
+BANNER = "Generated by protocol/gen_wire.py from protocol/messages.json. Do not edit."
+
+
+def camel(name, upper_first=False):
+    parts = name.split("_")
+    out = parts[0] + "".join(p.capitalize() for p in parts[1:])
+    return out[0].upper() + out[1:] if upper_first else out
+
+
+def layout(message):
+    offset = 0
+    fields = []
+    for name, kind in message["fields"]:
+        if kind not in TYPES:
+            sys.exit("%s.%s: unknown type %s" % (message["name"], name, kind))
+        size = TYPES[kind][0]
+        fields.append((name, kind, offset, size))
+        offset += size
+    return fields, offset
+
+
+def cpp_get(kind, at):
+    size, _, endian = TYPES[kind]
+    if size == 1:
+        return "p[%s]" % at
+    return "wireGet%d%s(p + %s)" % (size * 8, endian.capitalize(), at)
+
+
+def cpp_put(kind, at):
+    size, _, endian = TYPES[kind]
+    if size == 1:
+        return "p[%s] = v" % at
+    return "wirePut%d%s(p + %s, v)" % (size * 8, endian.capitalize(), at)
+
+
+def gen_cpp(schema):
+    out = []
+    w = out.append
+    w("// " + BANNER)
+    w("#ifndef WIRE_FORMAT_H")
+    w("#define WIRE_FORMAT_H")
+    w("")
+    w("#include <stddef.h>")
+    w("#include <stdint.h>")
+    w("")
+    w("// Byte-wise loads and stores: alignment- and host-endian-independent;")
+    w("// the compiler folds them into single loads on little-endian targets.")
+    w("static inline uint16_t wireGet16Le(const uint8_t *p) { return p[0] | (p[1] << 8); }")
+    w("static inline uint16_t wireGet16Be(const uint8_t *p) { return (p[0] << 8) | p[1]; }")
+    w("static inline uint32_t wireGet32Le(const uint8_t *p) {")
+    w("  return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);")
+    w("}")
+    w("static inline uint32_t wireGet32Be(const uint8_t *p) {")
+    w("  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];")
+    w("}")
+    w("static inline uint64_t wireGet64Le(const uint8_t *p) {")
+    w("  return wireGet32Le(p) | ((uint64_t)wireGet32Le(p + 4) << 32);")
+    w("}")
+    w("static inline void wirePut16Le(uint8_t *p, uint16_t v) { p[0] = v; p[1] = v >> 8; }")
+    w("static inline void wirePut16Be(uint8_t *p, uint16_t v) { p[0] = v >> 8; p[1] = v; }")
+    w("static inline void wirePut32Le(uint8_t *p, uint32_t v) {")
+    w("  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;")
+    w("}")
+    w("static inline void wirePut32Be(uint8_t *p, uint32_t v) {")
+    w("  p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;")
+    w("}")
+    w("static inline void wirePut64Le(uint8_t *p, uint64_t v) {")
+    w("  wirePut32Le(p, (uint32_t)v); wirePut32Le(p + 4, (uint32_t)(v >> 32));")
+    w("}")
+    w("")
+    for name, value in schema["constants"].items():
+        w("static constexpr uint32_t WIRE_%s = 0x%02X;" % (name, value))
+    for message in schema["messages"]:
+        fields, total = layout(message)
+        name = message["name"]
+        w("")
+        w("// %s" % message["doc"])
+        w("struct %s {" % name)
+        w("  static constexpr size_t SIZE = %d;" % total)
+        for fname, _, offset, _ in fields:
+            w("  static constexpr size_t %s_OFFSET = %d;" % (fname.upper(), offset))
+        w("")
+        w("  // Read-only view over received bytes (at least SIZE of them)")
+        w("  struct View {")
+        w("    const uint8_t *p;")
+        for fname, kind, _, _ in fields:
+            ctype = TYPES[kind][1]
+            w("    %s %s() const { return %s; }" % (ctype, camel(fname), cpp_get(kind, fname.upper() + "_OFFSET")))
+        w("  };")
+        w("")
+        w("  // Writes fields in place into an outgoing buffer")
+        w("  struct Writer {")
+        w("    uint8_t *p;")
+        for fname, kind, _, _ in fields:
+            ctype = TYPES[kind][1]
+            w("    void %s(%s v) const { %s; }" % (camel("set_" + fname), ctype, cpp_put(kind, fname.upper() + "_OFFSET")))
+        w("  };")
+        w("};")
+    w("")
+    w("#endif")
+    return "\n".join(out) + "\n"
+
+
+def dart_get(kind, at):
+    size, _, endian = TYPES[kind]
+    b = lambda i: "_b[_o + %s%s]" % (at, " + %d" % i if i else "")
+    if size == 1:
+        return b(0)
+    order = range(size) if endian == "le" else reversed(range(size))
+    terms = []
+    for shift, i in enumerate(order):
+        terms.append(b(i) if shift == 0 else "(%s << %d)" % (b(i), shift * 8))
+    return " | ".join(terms)
+
+
+def dart_put(kind, at):
+    size, _, endian = TYPES[kind]
+    lines = []
+    for i in range(size):
+        shift = 8 * (i if endian in (None, "le") else size - 1 - i)
+        value = "v" if shift == 0 else "(v >> %d)" % shift
+        lines.append("_b[_o + %s%s] = %s & 0xFF;" % (at, " + %d" % i if i else "", value))
+    return lines
+
+
+def gen_dart(schema):
+    out = []
+    w = out.append
+    w("// " + BANNER)
+    w("")
+    w("// Views read fields straight out of the received bytes (no ByteData,")
+    w("// no copies); writers fill a preallocated buffer.")
+    w("")
+    w("class Wire {")
+    for name, value in schema["constants"].items():
+        w("  static const int %s = 0x%02X;" % (camel(name.lower()), value))
+    w("}")
+    for message in schema["messages"]:
+        fields, total = layout(message)
+        name = message["name"]
+        w("")
+        w("// %s" % message["doc"])
+        w("class %s {" % name)
+        w("  static const int size = %d;" % total)
+        for fname, _, offset, _ in fields:
+            w("  static const int %sOffset = %d;" % (camel(fname), offset))
+        w("")
+        w("  final List<int> _b;")
+        w("  final int _o;")
+        w("  const %s(this._b, [this._o = 0]);" % name)
+        w("")
+        w("  // True if [bytes] from [offset] hold a whole %s" % name)
+        w("  static bool fits(List<int> bytes, [int offset = 0]) =>")
+        w("      bytes.length - offset >= size;")
+        for fname, kind, _, _ in fields:
+            w("")
+            w("  int get %s => %s;" % (camel(fname), dart_get(kind, camel(fname) + "Offset")))
+            w("  set %s(int v) {" % camel(fname))
+            for line in dart_put(kind, camel(fname) + "Offset"):
+                w("    " + line)
+            w("  }")
+        w("}")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    with open(SCHEMA) as f:
+        schema = json.load(f)
+    outputs = {CPP_OUT: gen_cpp(schema), DART_OUT: gen_dart(schema)}
+
+    check = "--check" in sys.argv[1:]
+    stale = []
+    for path, text in outputs.items():
+        current = open(path).read() if os.path.exists(path) else None
+        if current == text:
+            continue
+        if check:
+            stale.append(os.path.relpath(path, ROOT))
+        else:
+            with open(path, "w") as f:
+                f.write(text)
+            print("wrote", os.path.relpath(path, ROOT))
+
+    if stale:
+        sys.exit("stale: %s (run protocol/gen_wire.py)" % ", ".join(stale))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,152 @@
+#include "adpcm.h"
+#include <string.h>
+
+static const int16_t STEP_TABLE[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+  253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+  1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+  3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+  11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+  32767,
+};
+
+static const int8_t INDEX_TABLE[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+static inline int32_t clampSample(int32_t v) {
+  return v > 32767 ? 32767 : v < -32768 ? -32768 : v;
+}
+
+static inline int32_t clampIndex(int32_t i) {
+  return i > 88 ? 88 : i < 0 ? 0 : i;
+}
+
+// Applies one nibble to the state; encoder and decoder share this step
+static inline void applyNibble(AdpcmState *s, uint8_t nibble) {
+  int32_t step = STEP_TABLE[s->index];
+  int32_t diff = step >> 3;
+  if (nibble & 4) diff += step;
+  if (nibble & 2) diff += step >> 1;
+  if (nibble & 1) diff += step >> 2;
+  s->predictor = clampSample(nibble & 8 ? s->predictor - diff : s->predictor + diff);
+  s->index = clampIndex(s->index + INDEX_TABLE[nibble]);
+}
+
+static inline uint8_t encodeSample(AdpcmState *s, int32_t sample) {
+  int32_t step = STEP_TABLE[s->index];
+  int32_t diff = sample - s->predictor;
+  uint8_t nibble = 0;
+  if (diff < 0) {
+    nibble = 8;
+    diff = -diff;
+  }
+  if (diff >= step) { nibble |= 4; diff -= step; }
+  step >>= 1;
+  if (diff >= step) { nibble |= 2; diff -= step; }
+  step >>= 1;
+  if (diff >= step) { nibble |= 1; }
+  applyNibble(s, nibble);
+  return nibble;
+}
+
+size_t adpcmEncodedSize(size_t samples) {
+  size_t blocks = (samples + ADPCM_SAMPLES_PER_BLOCK - 1) / ADPCM_SAMPLES_PER_BLOCK;
+  return ADPCM_WAV_HEADER_SIZE + blocks * ADPCM_BLOCK_ALIGN;
+}
+
+// Header, then blockSamples - 1 nibbles; input past n repeats its last
+// sample
+static void encodeInto(AdpcmState *s, const int16_t *pcm, size_t n, size_t blockSamples,
+                       uint8_t *out) {
+  s->predictor = n ? pcm[0] : 0;
+  out[0] = (uint8_t)s->predictor;
+  out[1] = (uint8_t)(s->predictor >> 8);
+  out[2] = (uint8_t)s->index;
+  out[3] = 0;
+
+  int16_t last = n ? pcm[n - 1] : 0;
+  for (size_t i = 1; i < blockSamples; i += 2) {
+    uint8_t lo = encodeSample(s, i < n ? pcm[i] : last);
+    uint8_t hi = i + 1 < blockSamples ? encodeSample(s, i + 1 < n ? pcm[i + 1] : last) : 0;
+    out[4 + (i - 1) / 2] = lo | (hi << 4);
+  }
+}
+
+// Encodes up to ADPCM_SAMPLES_PER_BLOCK samples into one full block; a
+// short block is padded by repeating its last sample.
+void adpcmEncodeBlock(AdpcmState *s, const int16_t *pcm, size_t n, uint8_t *out) {
+  encodeInto(s, pcm, n, ADPCM_SAMPLES_PER_BLOCK, out);
+}
+
+size_t adpcmFrameSize(size_t samples) {
+  return 4 + samples / 2;
+}
+
+// A block of exactly n samples, sent on its own (live audio). Each one
+// carries its own predictor and step index, so a lost frame costs only
+// itself. Returns adpcmFrameSize(n).
+size_t adpcmEncodeFrame(AdpcmState *s, const int16_t *pcm, size_t n, uint8_t *out) {
+  encodeInto(s, pcm, n, n, out);
+  return adpcmFrameSize(n);
+}
+
+void adpcmDecodeBlock(const uint8_t *in, size_t n, int16_t *pcm) {
+  AdpcmState s;
+  s.predictor = (int16_t)(in[0] | (in[1] << 8));
+  s.index = clampIndex(in[2]);
+  if (n == 0)
+    return;
+  pcm[0] = (int16_t)s.predictor;
+  for (size_t i = 1; i < n; i++) {
+    uint8_t byte = in[4 + (i - 1) / 2];
+    applyNibble(&s, (i & 1) ? (byte & 0x0F) : (byte >> 4));
+    pcm[i] = (int16_t)s.predictor;
+  }
+}
+
+void writeAdpcmWavHeader(uint8_t *out, uint32_t sampleRate, uint32_t samples) {
+  uint32_t dataSize = adpcmEncodedSize(samples) - ADPCM_WAV_HEADER_SIZE;
+  uint32_t byteRate = sampleRate * ADPCM_BLOCK_ALIGN / ADPCM_SAMPLES_PER_BLOCK;
+  uint32_t v32;
+  uint16_t v16;
+
+  memcpy(out, "RIFF", 4);
+  v32 = dataSize + ADPCM_WAV_HEADER_SIZE - 8;  memcpy(out + 4, &v32, 4);
+  memcpy(out + 8, "WAVEfmt ", 8);
+  v32 = 20;                                  memcpy(out + 16, &v32, 4);
+  v16 = 0x11;                                memcpy(out + 20, &v16, 2);  // IMA ADPCM
+  v16 = 1;                                   memcpy(out + 22, &v16, 2);  // mono
+  v32 = sampleRate;                          memcpy(out + 24, &v32, 4);
+  v32 = byteRate;                            memcpy(out + 28, &v32, 4);
+  v16 = ADPCM_BLOCK_ALIGN;                   memcpy(out + 32, &v16, 2);
+  v16 = 4;                                   memcpy(out + 34, &v16, 2);  // bits per sample
+  v16 = 2;                                   memcpy(out + 36, &v16, 2);  // extra format bytes
+  v16 = ADPCM_SAMPLES_PER_BLOCK;             memcpy(out + 38, &v16, 2);
+  memcpy(out + 40, "fact", 4);
+  v32 = 4;                                   memcpy(out + 44, &v32, 4);
+  memcpy(out + 48, &samples, 4);
+  memcpy(out + 52, "data", 4);
+  memcpy(out + 56, &dataSize, 4);
+}
+
+// Turns 16-bit PCM at buf + pcmOffset into a complete ADPCM WAV starting
+// at buf. The output never overtakes the input (4:1), so no second
+// buffer is needed; each block's input is copied out before it is
+// overwritten. Returns the WAV size.
+size_t adpcmEncodeWavInPlace(uint8_t *buf, size_t pcmOffset, size_t samples,
+                             uint32_t sampleRate) {
+  AdpcmState s = { 0, 0 };
+  int16_t block[ADPCM_SAMPLES_PER_BLOCK];
+  uint8_t *out = buf + ADPCM_WAV_HEADER_SIZE;
+
+  for (size_t at = 0; at < samples; at += ADPCM_SAMPLES_PER_BLOCK) {
+    size_t n = samples - at < ADPCM_SAMPLES_PER_BLOCK ? samples - at : ADPCM_SAMPLES_PER_BLOCK;
+    memcpy(block, buf + pcmOffset + at * 2, n * 2);
+    adpcmEncodeBlock(&s, block, n, out);
+    out += ADPCM_BLOCK_ALIGN;
+  }
+  writeAdpcmWavHeader(buf, sampleRate, samples);
+  return out - buf;
+}
@@ -0,0 +1,30 @@
+#ifndef ADPCM_H
+#define ADPCM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// IMA ADPCM (4 bits per sample) in the Microsoft WAV block layout, mono:
+// every 256-byte block starts with the exact first sample and the step
+// index, then packs 504 more samples two to a byte, low nibble first.
+
+#define ADPCM_BLOCK_ALIGN        256
+#define ADPCM_SAMPLES_PER_BLOCK  505
+#define ADPCM_WAV_HEADER_SIZE    60      // RIFF, fmt (20), fact, data
+
+struct AdpcmState {
+  int32_t predictor;
+  int32_t index;
+};
+
+// Function declarations
+size_t adpcmEncodedSize(size_t samples);
+void adpcmEncodeBlock(AdpcmState *s, const int16_t *pcm, size_t n, uint8_t *out);
+size_t adpcmFrameSize(size_t samples);
+size_t adpcmEncodeFrame(AdpcmState *s, const int16_t *pcm, size_t n, uint8_t *out);
+void adpcmDecodeBlock(const uint8_t *in, size_t n, int16_t *pcm);
+void writeAdpcmWavHeader(uint8_t *out, uint32_t sampleRate, uint32_t samples);
+size_t adpcmEncodeWavInPlace(uint8_t *buf, size_t pcmOffset, size_t samples,
+                             uint32_t sampleRate);
+
+#endif
@@ -0,0 +1,149 @@
+#include "audio_config.h"
+#include <stdio.h>
+#include <string.h>
+#include "adpcm.h"
+#include "capture_crypto.h"
+#include "psram_arena.h"
+
+#ifdef ARDUINO
+#include <Preferences.h>
+#endif
+
+// Rates the PDM receiver is clocked at
+static const uint32_t supportedRates[] = { 8000, 16000, 24000, 32000, 48000 };
+
+AudioConfig audioConfigDefault() {
+  AudioConfig c;
+  c.sampleRate = AUDIO_DEFAULT_SAMPLE_RATE;
+  c.bits = AUDIO_DEFAULT_BITS;
+  c.gainShift = AUDIO_DEFAULT_GAIN;
+  c.maxSeconds = AUDIO_DEFAULT_SECONDS;
+  c.codec = AUDIO_CODEC_ADPCM;
+  return c;
+}
+
+// Recording buffer: 16-bit PCM for the whole duration, room for the
+// larger WAV header in front and for a seal trailer behind
+size_t audioRecordCapacity(const AudioConfig &c) {
+  return ADPCM_WAV_HEADER_SIZE + (size_t)c.sampleRate * 2 * c.maxSeconds + CRYPTO_SEAL_SIZE;
+}
+
+bool audioConfigValid(const AudioConfig &c) {
+  bool rateOk = false;
+  for (size_t i = 0; i < sizeof(supportedRates) / sizeof(supportedRates[0]); i++) {
+    rateOk = rateOk || c.sampleRate == supportedRates[i];
+  }
+  return rateOk &&
+         (c.bits == 8 || c.bits == 16) &&
+         c.gainShift <= AUDIO_GAIN_MAX &&
+         c.maxSeconds > 0 &&
+         c.codec <= AUDIO_CODEC_ADPCM &&
+         (c.codec != AUDIO_CODEC_ADPCM || c.bits == 16) &&
+         audioRecordCapacity(c) <= ARENA_MEDIA_SIZE;
+}
+
+static bool keyIs(const char *key, size_t keyLen, const char *name) {
+  return keyLen == strlen(name) && memcmp(key, name, keyLen) == 0;
+}
+
+static bool parseNumber(const char *s, size_t n, uint32_t *out) {
+  if (n == 0 || n > 9) {
+    return false;
+  }
+  uint32_t v = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (s[i] < '0' || s[i] > '9') {
+      return false;
+    }
+    v = v * 10 + (s[i] - '0');
+  }
+  *out = v;
+  return true;
+}
+
+// "rate=16000,bits=16,gain=2,secs=10,codec=adpcm"; keys left out keep
+// their current value. On an unknown key or an invalid result *c is
+// left as it was.
+bool parseAudioConfig(const char *text, size_t len, AudioConfig *c) {
+  AudioConfig next = *c;
+  size_t at = 0;
+  while (at < len) {
+    size_t end = at;
+    while (end < len && text[end] != ',') {
+      end++;
+    }
+    const char *eq = (const char *)memchr(text + at, '=', end - at);
+    if (!eq) {
+      return false;
+    }
+    const char *key = text + at;
+    size_t keyLen = eq - key;
+    const char *val = eq + 1;
+    size_t valLen = text + end - val;
+    uint32_t n = 0;
+
+    if (keyIs(key, keyLen, "codec")) {
+      if (keyIs(val, valLen, "pcm")) {
+        next.codec = AUDIO_CODEC_PCM;
+      } else if (keyIs(val, valLen, "adpcm")) {
+        next.codec = AUDIO_CODEC_ADPCM;
+      } else {
+        return false;
+      }
+    } else if (!parseNumber(val, valLen, &n)) {
+      return false;
+    } else if (keyIs(key, keyLen, "rate")) {
+      next.sampleRate = n;
+    } else if (keyIs(key, keyLen, "bits")) {
+      next.bits = n > 255 ? 0 : n;
+    } else if (keyIs(key, keyLen, "gain")) {
+      next.gainShift = n > 255 ? 255 : n;
+    } else if (keyIs(key, keyLen, "secs")) {
+      next.maxSeconds = n > 0xFFFF ? 0 : n;
+    } else {
+      return false;
+    }
+    at = end + 1;
+  }
+
+  if (!audioConfigValid(next)) {
+    return false;
+  }
+  *c = next;
+  return true;
+}
+
+size_t formatAudioConfig(const AudioConfig &c, char *out, size_t cap) {
+  int n = snprintf(out, cap, "rate=%lu,bits=%u,gain=%u,secs=%u,codec=%s",
+                   (unsigned long)c.sampleRate, c.bits, c.gainShift, c.maxSeconds,
+                   c.codec == AUDIO_CODEC_ADPCM ? "adpcm" : "pcm");
+  return n < 0 ? 0 : (size_t)n;
+}
+
+#ifdef ARDUINO
+
+AudioConfig loadAudioConfig() {
+  AudioConfig c = audioConfigDefault();
+  Preferences prefs;
+  if (prefs.begin("audio", true)) {
+    AudioConfig stored;
+    if (prefs.getBytes("cfg", &stored, sizeof(stored)) == sizeof(stored) &&
+        audioConfigValid(stored)) {
+      c = stored;
+    }
+    prefs.end();
+  }
+  return c;
+}
+
+bool saveAudioConfig(const AudioConfig &c) {
+  Preferences prefs;
+  if (!prefs.begin("audio", false)) {
+    return false;
+  }
+  bool ok = prefs.putBytes("cfg", &c, sizeof(c)) == sizeof(c);
+  prefs.end();
+  return ok;
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef AUDIO_CONFIG_H
+#define AUDIO_CONFIG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Capture format the phone sets per session (AUDIO_CONFIG:...), kept in
+// NVS across boots. The microphone always delivers 16-bit PCM; bits is
+// the depth of what is stored and sent, and ADPCM needs 16-bit input.
+// A clip is recorded into one arena media slot, which bounds the
+// duration at high rates.
+
+#define AUDIO_DEFAULT_SAMPLE_RATE  16000U
+#define AUDIO_DEFAULT_BITS         16
+#define AUDIO_DEFAULT_GAIN         2      // left shift
+#define AUDIO_DEFAULT_SECONDS      10
+#define AUDIO_GAIN_MAX             4
+#define AUDIO_CONFIG_TEXT_MAX      64
+
+enum AudioCodec : uint8_t {
+  AUDIO_CODEC_PCM = 0,
+  AUDIO_CODEC_ADPCM
+};
+
+struct AudioConfig {
+  uint32_t sampleRate;
+  uint8_t bits;          // 8 or 16
+  uint8_t gainShift;
+  uint16_t maxSeconds;
+  uint8_t codec;         // AudioCodec
+};
+
+// Function declarations
+AudioConfig audioConfigDefault();
+bool audioConfigValid(const AudioConfig &c);
+size_t audioRecordCapacity(const AudioConfig &c);
+bool parseAudioConfig(const char *text, size_t len, AudioConfig *c);
+size_t formatAudioConfig(const AudioConfig &c, char *out, size_t cap);
+
+#ifdef ARDUINO
+AudioConfig loadAudioConfig();
+bool saveAudioConfig(const AudioConfig &c);
+#endif
+
+#endif
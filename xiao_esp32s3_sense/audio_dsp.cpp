@@ -0,0 +1,42 @@
+#include "audio_dsp.h"
+#include <string.h>
+
+static const GainStage gainStages[] = {
+  applyGain<0>, applyGain<1>, applyGain<2>, applyGain<3>, applyGain<4>,
+};
+static_assert(sizeof(gainStages) / sizeof(gainStages[0]) == AUDIO_GAIN_MAX + 1,
+              "one gain stage per setting");
+
+AudioPipeline audioPipelineFor(const AudioConfig &c) {
+  AudioPipeline p;
+  p.gain = gainStages[c.gainShift <= AUDIO_GAIN_MAX ? c.gainShift : AUDIO_GAIN_MAX];
+  p.pack = c.bits == 8 ? packSamples<8> : packSamples<16>;
+  return p;
+}
+
+void writePcmWavHeader(uint8_t *out, uint32_t sampleRate, uint8_t bits, uint32_t dataBytes) {
+  uint32_t v32;
+  uint16_t v16;
+
+  memcpy(out, "RIFF", 4);
+  v32 = dataBytes + PCM_WAV_HEADER_SIZE - 8;  memcpy(out + 4, &v32, 4);
+  memcpy(out + 8, "WAVEfmt ", 8);
+  v32 = 16;                                   memcpy(out + 16, &v32, 4);
+  v16 = 1;                                    memcpy(out + 20, &v16, 2);  // PCM
+  v16 = 1;                                    memcpy(out + 22, &v16, 2);  // mono
+  v32 = sampleRate;                           memcpy(out + 24, &v32, 4);
+  v32 = sampleRate * (bits / 8);              memcpy(out + 28, &v32, 4);
+  v16 = bits / 8;                             memcpy(out + 32, &v16, 2);
+  v16 = bits;                                 memcpy(out + 34, &v16, 2);
+  memcpy(out + 36, "data", 4);
+  v32 = dataBytes;                            memcpy(out + 40, &v32, 4);
+}
+
+// Turns 16-bit PCM at buf + pcmOffset into a PCM WAV of the configured
+// depth starting at buf. Returns the WAV size.
+size_t pcmWavInPlace(uint8_t *buf, size_t pcmOffset, size_t samples, const AudioConfig &c) {
+  size_t bytes = audioPipelineFor(c).pack((int16_t *)(buf + pcmOffset), samples);
+  memmove(buf + PCM_WAV_HEADER_SIZE, buf + pcmOffset, bytes);
+  writePcmWavHeader(buf, c.sampleRate, c.bits, bytes);
+  return PCM_WAV_HEADER_SIZE + bytes;
+}
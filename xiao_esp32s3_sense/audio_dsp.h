@@ -0,0 +1,60 @@
+#ifndef AUDIO_DSP_H
+#define AUDIO_DSP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "audio_config.h"
+
+// Per-format sample stages. Each stage is a template over its format
+// parameter, instantiated for every supported value; a pipeline picks
+// its instantiations once per session, so the per-sample loops carry no
+// format tests.
+
+#define PCM_WAV_HEADER_SIZE 44
+
+// Saturating left shift
+template <unsigned Shift>
+inline void applyGain(int16_t *pcm, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    int32_t v = (int32_t)pcm[i] * (1 << Shift);
+    pcm[i] = (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+  }
+}
+
+template <>
+inline void applyGain<0>(int16_t *, size_t) {}
+
+// 16-bit PCM to the stored depth, in place; returns the byte count
+template <unsigned Bits>
+size_t packSamples(int16_t *pcm, size_t n);
+
+template <>
+inline size_t packSamples<16>(int16_t *, size_t n) {
+  return n * 2;
+}
+
+// WAV 8-bit is unsigned. Byte i is written after sample i is read, and
+// never lands on a sample still to be read.
+template <>
+inline size_t packSamples<8>(int16_t *pcm, size_t n) {
+  uint8_t *out = (uint8_t *)pcm;
+  for (size_t i = 0; i < n; i++) {
+    out[i] = (uint8_t)((pcm[i] >> 8) + 128);
+  }
+  return n;
+}
+
+typedef void (*GainStage)(int16_t *pcm, size_t n);
+typedef size_t (*PackStage)(int16_t *pcm, size_t n);
+
+struct AudioPipeline {
+  GainStage gain;
+  PackStage pack;
+};
+
+// Function declarations
+AudioPipeline audioPipelineFor(const AudioConfig &c);
+void writePcmWavHeader(uint8_t *out, uint32_t sampleRate, uint8_t bits, uint32_t dataBytes);
+size_t pcmWavInPlace(uint8_t *buf, size_t pcmOffset, size_t samples, const AudioConfig &c);
+
+#endif
@@ -1,79 +1,277 @@
 #include "audio_handler.h"
 #include "sd_card.h"
+#include "psram_arena.h"
+#include "content_hash.h"
+#include "dedup_index.h"
+#include "metrics.h"
+#include "voice_detect.h"
+#include "adpcm.h"
+#include "capture_catalog.h"
+#include "audio_dsp.h"
+#include "capture_crypto.h"
+#include "ble_transfer.h"
+#include "stream_mux.h"
+#include "wire_format.h"
+#include "power_manager.h"
+#include "task_topology.h"
 
-static bool recording = false;
+static volatile bool recording = false;
 static uint8_t* audioBuffer = NULL;
 static size_t audioBufferSize = 0;
-static TaskHandle_t recordTaskHandle = NULL;
+static ArenaScope audioScope = ARENA_SCOPE_NONE;
+static volatile TaskHandle_t recordTaskHandle = NULL;
+static volatile bool liveAudio = false;
+static volatile TaskHandle_t liveTaskHandle = NULL;
 I2SClass i2s;
+static AudioConfig config;
+static AudioPipeline pipeline;
+
+static AudioSegment segments[AUDIO_MAX_SEGMENTS];
+static int segmentCount = 0;
+
+static uint32_t bytesToMs(size_t bytes) {
+    return (uint32_t)((uint64_t)bytes * 1000 / (config.sampleRate * 2));
+}
+
+// Once the table is full, later speech is folded into the last segment
+static void openSegment(uint32_t ms) {
+    if (segmentCount < AUDIO_MAX_SEGMENTS) {
+        segments[segmentCount++] = { ms, ms };
+    }
+}
+
+static void closeSegment(uint32_t ms) {
+    if (segmentCount > 0) {
+        segments[segmentCount - 1].endMs = ms;
+    }
+}
+
+// "AUDIO_SEGMENTS:<start>-<end>,..." in ms from the start of recording
+static void formatSegments(char *out, size_t cap) {
+    size_t at = snprintf(out, cap, "AUDIO_SEGMENTS:");
+    for (int i = 0; i < segmentCount && at < cap; i++) {
+        at += snprintf(out + at, cap - at, "%s%lu-%lu", i ? "," : "",
+                       (unsigned long)segments[i].startMs,
+                       (unsigned long)segments[i].endMs);
+    }
+}
+
+// Stores the clip (and its segment list next to it) and hands it to BLE
+static void saveAndSendClip(size_t cap) {
+    uint32_t captureId = catalogBeginCapture(CAPTURE_AUDIO);
+    char filename[32];
+    capturePath(filename, sizeof(filename), captureId, CAPTURE_AUDIO);
+    uint8_t catalogFlags = cryptoEnabled() ? CATALOG_FLAG_SEALED : 0;
+
+    char segText[24 + AUDIO_MAX_SEGMENTS * 24];
+    formatSegments(segText, sizeof(segText));
+    Serial.println(segText);
+
+    uint64_t digest = hashBuffer(audioBuffer, audioBufferSize);
+    DedupRecord dup;
+    if (dedupLookup(digest, audioBufferSize, &dup)) {
+        Serial.printf("Duplicate of %s\n", dup.path);
+        metricAdd("dedup.hits", 1);
+        catalogFinishCapture(captureId, saveReference(filename, dup.path),
+                             catalogFlags | CATALOG_FLAG_DUPLICATE);
+    } else {
+        size_t stored = writeFile(SD, filename, audioBuffer, audioBufferSize);
+        catalogFinishCapture(captureId, stored, catalogFlags);
+        if (stored > 0) {
+            dedupInsert(digest, audioBufferSize, filename,
+                        cryptoEnabled() ? DEDUP_SEALED : 0);
+        }
+
+        char segName[32];
+        strcpy(segName, filename);
+        strcpy(strrchr(segName, '.'), ".seg");
+        writeFile(SD, segName, (uint8_t *)segText, strlen(segText));
+    }
+
+    if (!isDeviceConnected()) {
+        return;
+    }
+    sendStatusText(segText);
+
+    uint8_t flags = 0;
+    size_t sendLen = audioBufferSize;
+    if (cryptoEnabled()) {
+        sendLen = cryptoSeal(audioBuffer, audioBufferSize, cap);
+        flags = AUDIO_FLAG_SEALED;
+    }
+    if (sendLen == 0) {
+        Serial.println("Seal failed, clip not sent");
+        return;
+    }
+
+    // The sender releases the clip's scope when it is done
+    sendAudioViaBLE(audioBuffer, sendLen, audioScope, flags);
+    audioScope = ARENA_SCOPE_NONE;
+    audioBuffer = NULL;
+    audioBufferSize = 0;
+}
 
 void recordTask(void *parameter) {
-    // Record audio using the built-in WAV recording function
-    audioBuffer = i2s.recordWAV(RECORD_TIME, &audioBufferSize);
-    
+    // Record straight into one PSRAM arena slot, one DMA block at a time.
+    // Blocks without voice are dropped as they arrive, except the last
+    // AUDIO_PREROLL_MS of them, kept as the lead-in of the next
+    // segment. What is kept is packed into the configured format in place
+    // at the end.
+    powerAcquire(POWER_AUDIO);
+    const size_t dataSize = (size_t)config.sampleRate * 2 * config.maxSeconds;
+    const size_t cap = audioRecordCapacity(config);
+    const size_t prerollBytes = (size_t)config.sampleRate * 2 * AUDIO_PREROLL_MS / 1000;
+    audioBuffer = arenaAlloc(cap, audioScope);
+    audioBufferSize = 0;
+
     if (audioBuffer == NULL) {
-        Serial.println("Record Failed!");
-        audioBufferSize = 0;
+        Serial.println("Record Failed! (arena full)");
     } else {
-        Serial.printf("Recorded %d bytes\n", audioBufferSize);
-        
-        // Increase volume
-        for (uint32_t i = WAV_HEADER_SIZE; i < audioBufferSize; i += 2) {
-            (*(uint16_t *)(audioBuffer + i)) <<= VOLUME_GAIN;
+        uint8_t *pcm = audioBuffer + ADPCM_WAV_HEADER_SIZE;
+        size_t kept = 0;        // voice and its pre-roll
+        size_t pending = 0;     // quiet since, the next pre-roll
+        size_t got = 0;         // everything read from the microphone
+        uint32_t vadUs = 0;
+        bool inSegment = false;
+
+        VadState vad;
+        vadBegin(&vad);
+        segmentCount = 0;
+
+        while (recording && got < dataSize) {
+            size_t want = min((size_t)ARENA_AUDIO_BLOCK_SIZE, dataSize - got);
+            uint8_t *block = pcm + kept + pending;
+            size_t n = i2s.readBytes((char *)block, want) & ~(size_t)1;
+            if (n == 0)
+                break;
+
+            // Increase volume, then classify the block while it is still hot
+            pipeline.gain((int16_t *)block, n / 2);
+            uint32_t t0 = micros();
+            bool voice = vadProcess(&vad, (const int16_t *)block, n / 2);
+            vadUs += micros() - t0;
+
+            if (voice) {
+                if (!inSegment) {
+                    openSegment(bytesToMs(got - pending));
+                    inSegment = true;
+                }
+                kept += pending + n;
+                pending = 0;
+            } else {
+                if (inSegment) {
+                    closeSegment(bytesToMs(got));
+                    inSegment = false;
+                }
+                pending += n;
+                if (pending > prerollBytes) {
+                    memmove(pcm + kept, pcm + kept + pending - prerollBytes, prerollBytes);
+                    pending = prerollBytes;
+                }
+            }
+            got += n;
+        }
+        if (inSegment) {
+            closeSegment(bytesToMs(got));
         }
 
-        // Save to SD card with timestamp
-        char filename[32];
-        time_t now = time(nullptr);
-        strftime(filename, sizeof(filename), "/audio_%Y%m%d_%H%M%S.wav", localtime(&now));
-        
-        // Create a copy of the buffer for SD card writing
-        uint8_t* sdBuffer = (uint8_t*)malloc(audioBufferSize);
-        if (sdBuffer != NULL) {
-            memcpy(sdBuffer, audioBuffer, audioBufferSize);
-            writeFile(SD, filename, sdBuffer, audioBufferSize);
-            free(sdBuffer);
+        if (got > 0) {
+            metricSet("vad.us_per_s", (uint32_t)((uint64_t)vadUs * config.sampleRate * 2 / got));
+        }
+        metricSet("vad.kept_ms", bytesToMs(kept));
+        metricAdd("vad.segments", segmentCount);
+        Serial.printf("Recorded %u ms, kept %u ms in %d segments\n",
+                      (unsigned)bytesToMs(got), (unsigned)bytesToMs(kept), segmentCount);
+
+        if (kept == 0) {
+            sendStatusText("AUDIO_SEGMENTS:");
         } else {
-            Serial.println("Failed to allocate memory for SD card writing");
+            if (config.codec == AUDIO_CODEC_ADPCM) {
+                audioBufferSize = adpcmEncodeWavInPlace(audioBuffer, ADPCM_WAV_HEADER_SIZE,
+                                                        kept / 2, config.sampleRate);
+            } else {
+                audioBufferSize = pcmWavInPlace(audioBuffer, ADPCM_WAV_HEADER_SIZE,
+                                                kept / 2, config);
+            }
+            metricSet("audio.clip_bytes", audioBufferSize);
+            saveAndSendClip(cap);
         }
     }
     
+    powerRelease(POWER_AUDIO);
     recording = false;
-    vTaskDelete(NULL);
+    recordTaskHandle = NULL;
+    taskExit(TASK_RECORD);
 }
 
-bool initAudio() {
+static bool beginI2S(uint32_t sampleRate) {
     // Set I2S pins for XIAO ESP32S3 Sense
     i2s.setPinsPdmRx(42, 41);  // CLK, DIN0
-    
+
     // Initialize I2S in PDM RX mode
-    if (!i2s.begin(I2S_MODE_PDM_RX, SAMPLE_RATE, SAMPLE_BITS, I2S_SLOT_MODE_MONO)) {
+    return i2s.begin(I2S_MODE_PDM_RX, sampleRate, SAMPLE_BITS, I2S_SLOT_MODE_MONO);
+}
+
+bool initAudio() {
+    config = loadAudioConfig();
+    pipeline = audioPipelineFor(config);
+
+    if (!beginI2S(config.sampleRate)) {
         Serial.println("Failed to initialize I2S!");
         return false;
     }
-    
+
+    return true;
+}
+
+const AudioConfig& audioConfig() {
+    return config;
+}
+
+// Only while the microphone is idle. A new rate restarts the I2S driver
+// in place; if it will not start, the old format is put back.
+bool applyAudioConfig(const AudioConfig &c) {
+    if (recording || liveAudio || !audioConfigValid(c)) {
+        return false;
+    }
+    if (c.sampleRate != config.sampleRate) {
+        i2s.end();
+        if (!beginI2S(c.sampleRate)) {
+            Serial.println("I2S restart failed, keeping the old format");
+            beginI2S(config.sampleRate);
+            return false;
+        }
+    }
+    config = c;
+    pipeline = audioPipelineFor(config);
+    saveAudioConfig(config);
+
+    char text[AUDIO_CONFIG_TEXT_MAX];
+    formatAudioConfig(config, text, sizeof(text));
+    Serial.printf("Audio format %s\n", text);
     return true;
 }
 
 void startRecording() {
     if (!recording) {
-        // Free any existing buffer
-        if (audioBuffer != NULL) {
-            free(audioBuffer);
-            audioBuffer = NULL;
-        }
+        // Release the previous clip and everything allocated with it
+        arenaEndScope(audioScope);
+        audioBuffer = NULL;
         audioBufferSize = 0;
+        audioScope = arenaBeginScope();
         
         recording = true;
-        xTaskCreate(recordTask, "RecordTask", 4096, NULL, 1, &recordTaskHandle);
+        if (!taskStart(TASK_RECORD, recordTask, NULL, (TaskHandle_t *)&recordTaskHandle)) {
+            recording = false;
+        }
     }
 }
 
 void stopRecording() {
+    // Let the task finish its current block and save what it has
     recording = false;
-    if (recordTaskHandle != NULL) {
-        vTaskDelete(recordTaskHandle);
-        recordTaskHandle = NULL;
+    while (recordTaskHandle != NULL) {
+        delay(10);
     }
 }
 
@@ -81,10 +279,87 @@ bool isRecording() {
     return recording;
 }
 
+// Reads up to len bytes of gained PCM, for other recorders (video clips);
+// only while no clip is being recorded or streamed here
+size_t readMicrophone(uint8_t *buf, size_t len) {
+    if (recording || liveAudio) {
+        return 0;
+    }
+    size_t n = i2s.readBytes((char *)buf, len) & ~(size_t)1;
+    pipeline.gain((int16_t *)buf, n / 2);
+    return n;
+}
+
 uint8_t* getAudioData() {
     return audioBuffer;
 }
 
 size_t getAudioDataSize() {
     return audioBufferSize;
-} 
\ No newline at end of file
+}
+
+// Streams the microphone as it is captured: every LIVE_FRAME_MS one
+// LiveAudioFrame header and a self-contained ADPCM block go on the live
+// stream. Frames the radio cannot take are dropped, never queued behind:
+// the phone's jitter buffer conceals the gap.
+static void liveTask(void *parameter) {
+    int16_t pcm[LIVE_FRAME_SAMPLES];
+    uint8_t frame[LiveAudioFrame::SIZE + 4 + LIVE_FRAME_SAMPLES / 2];
+    static_assert(sizeof(frame) <= MUX_PAYLOAD_MAX, "live frame must fit one notification");
+
+    powerAcquire(POWER_AUDIO);
+    AdpcmState adpcm = { 0, 0 };
+    uint16_t seq = 0;
+    while (liveAudio) {
+        size_t n = i2s.readBytes((char *)pcm, sizeof(pcm)) & ~(size_t)1;
+        if (n == 0)
+            break;
+        // Device time of the frame's first sample
+        uint32_t timeMs = millis() - LIVE_FRAME_MS;
+
+        uint32_t t0 = micros();
+        size_t samples = n / 2;
+        pipeline.gain(pcm, samples);
+        size_t len = adpcmEncodeFrame(&adpcm, pcm, samples, frame + LiveAudioFrame::SIZE);
+        metricMax("live.encode_us", micros() - t0);
+
+        LiveAudioFrame::Writer header{frame};
+        header.setKind(WIRE_LIVE_KIND_AUDIO);
+        header.setSeq(seq++);
+        header.setTimeMs(timeMs);
+        header.setSamples(samples);
+        if (muxEnqueue(MUX_LIVE, frame, LiveAudioFrame::SIZE + len, millis())) {
+            metricAdd("live.frames", 1);
+        } else {
+            metricAdd("live.dropped", 1);
+        }
+    }
+
+    powerRelease(POWER_AUDIO);
+    liveAudio = false;
+    liveTaskHandle = NULL;
+    taskExit(TASK_LIVE_AUDIO);
+}
+
+bool startLiveAudio() {
+    if (liveAudio || recording || config.sampleRate != LIVE_SAMPLE_RATE) {
+        return false;
+    }
+    liveAudio = true;
+    if (!taskStart(TASK_LIVE_AUDIO, liveTask, NULL, (TaskHandle_t *)&liveTaskHandle)) {
+        liveAudio = false;
+        return false;
+    }
+    return true;
+}
+
+void stopLiveAudio() {
+    liveAudio = false;
+    while (liveTaskHandle != NULL) {
+        delay(10);
+    }
+}
+
+bool isLiveAudio() {
+    return liveAudio;
+}
@@ -4,19 +4,39 @@
 #include <Arduino.h>
 #include <ESP_I2S.h>
 #include "sd_card.h"
+#include "audio_config.h"
 
-// I2S configuration
-#define SAMPLE_RATE     16000U
+// The microphone is read as 16-bit mono at the configured rate
+// (audio_config.h); the I2S driver is restarted when the rate changes
 #define SAMPLE_BITS     I2S_DATA_BIT_WIDTH_16BIT
-#define WAV_HEADER_SIZE 44
-#define RECORD_TIME     10  // seconds
-#define VOLUME_GAIN     2   // Volume gain factor
+
+// Only voiced stretches are kept, each with this much audio before it
+#define AUDIO_PREROLL_MS     300
+#define AUDIO_MAX_SEGMENTS   16
+
+// Live mode: one ADPCM frame on the live stream every LIVE_FRAME_MS, at
+// the one rate the phone's jitter buffer plays
+#define LIVE_SAMPLE_RATE     16000U
+#define LIVE_FRAME_MS        20
+#define LIVE_FRAME_SAMPLES   (LIVE_SAMPLE_RATE * LIVE_FRAME_MS / 1000)
+
+// A kept stretch, in ms from the start of the recording
+struct AudioSegment {
+  uint32_t startMs;
+  uint32_t endMs;
+};
 
 // Function declarations
 bool initAudio();
+const AudioConfig& audioConfig();
+bool applyAudioConfig(const AudioConfig &c);
 void startRecording();
 void stopRecording();
 bool isRecording();
+size_t readMicrophone(uint8_t *buf, size_t len);
+bool startLiveAudio();
+void stopLiveAudio();
+bool isLiveAudio();
 uint8_t* getAudioData();
 size_t getAudioDataSize();
 
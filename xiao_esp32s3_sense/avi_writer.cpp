@@ -0,0 +1,300 @@
+#include "avi_writer.h"
+#include <string.h>
+
+#define AVIF_HASINDEX    0x10
+#define AVIIF_KEYFRAME   0x10
+#define AVI_AUDIO_BIT    0x80000000u
+#define AVI_SIZE_LIMIT   0x7FFFFFFFu   // AVI 1.0 sizes are signed in practice
+
+// Offsets of the patched fields inside the avih and strh bodies
+#define AVIH_US_PER_FRAME   0
+#define AVIH_MAX_BPS        4
+#define AVIH_TOTAL_FRAMES   16
+#define AVIH_SUGGESTED      28
+#define STRH_SCALE          20
+#define STRH_LENGTH         32
+#define STRH_SUGGESTED      36
+
+static void put16(uint8_t *p, uint16_t v) {
+  p[0] = v & 0xFF;
+  p[1] = v >> 8;
+}
+
+static void put32(uint8_t *p, uint32_t v) {
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = v >> 24;
+}
+
+/* ===== Header ===== */
+
+struct HeaderOut {
+  uint8_t *buf;
+  uint32_t at;
+};
+
+static void tag(HeaderOut *h, const char *fourcc) {
+  memcpy(h->buf + h->at, fourcc, 4);
+  h->at += 4;
+}
+
+static void u32(HeaderOut *h, uint32_t v) {
+  put32(h->buf + h->at, v);
+  h->at += 4;
+}
+
+static void u16(HeaderOut *h, uint16_t v) {
+  put16(h->buf + h->at, v);
+  h->at += 2;
+}
+
+static void videoStreamList(HeaderOut *h, AviWriter *w, uint16_t width, uint16_t height,
+                            uint32_t usPerFrame) {
+  tag(h, "LIST");
+  u32(h, 4 + 8 + 56 + 8 + 40);
+  tag(h, "strl");
+
+  tag(h, "strh");
+  u32(h, 56);
+  w->videoStrhAt = h->at;
+  tag(h, "vids");
+  tag(h, "MJPG");
+  u32(h, 0);               // flags
+  u16(h, 0);               // priority
+  u16(h, 0);               // language
+  u32(h, 0);               // initial frames
+  u32(h, usPerFrame);      // scale / rate = seconds per frame
+  u32(h, 1000000);
+  u32(h, 0);               // start
+  u32(h, 0);               // length, patched
+  u32(h, 0);               // suggested buffer, patched
+  u32(h, 0xFFFFFFFF);      // quality: default
+  u32(h, 0);               // sample size: varies
+  u16(h, 0);
+  u16(h, 0);
+  u16(h, width);
+  u16(h, height);
+
+  tag(h, "strf");          // BITMAPINFOHEADER
+  u32(h, 40);
+  u32(h, 40);
+  u32(h, width);
+  u32(h, height);
+  u16(h, 1);
+  u16(h, 24);
+  tag(h, "MJPG");
+  u32(h, (uint32_t)width * height * 3);
+  h->at += 16;             // resolution and palette: unused
+}
+
+static void audioStreamList(HeaderOut *h, AviWriter *w, uint32_t rate) {
+  tag(h, "LIST");
+  u32(h, 4 + 8 + 56 + 8 + 18);
+  tag(h, "strl");
+
+  tag(h, "strh");
+  u32(h, 56);
+  w->audioStrhAt = h->at;
+  tag(h, "auds");
+  u32(h, 0);               // handler
+  u32(h, 0);
+  u16(h, 0);
+  u16(h, 0);
+  u32(h, 0);
+  u32(h, 2);               // scale = block align, rate = bytes/s: units are samples
+  u32(h, rate * 2);
+  u32(h, 0);
+  u32(h, 0);               // length in samples, patched
+  u32(h, rate * 2);
+  u32(h, 0xFFFFFFFF);
+  u32(h, 2);
+  h->at += 8;              // frame rectangle
+
+  tag(h, "strf");          // WAVEFORMATEX, PCM
+  u32(h, 18);
+  u16(h, 1);
+  u16(h, 1);
+  u32(h, rate);
+  u32(h, rate * 2);
+  u16(h, 2);
+  u16(h, 16);
+  u16(h, 0);
+}
+
+bool aviBegin(AviWriter *w, const AviSink &sink, AviIndexEntry *index, uint32_t indexCap,
+              uint16_t width, uint16_t height, uint32_t usPerFrame, uint32_t audioRate) {
+  memset(w, 0, sizeof(*w));
+  w->sink = sink;
+  w->index = index;
+  w->indexCap = indexCap;
+  w->audioRate = audioRate;
+
+  uint8_t buf[AVI_HEADER_MAX];
+  memset(buf, 0, sizeof(buf));
+  HeaderOut h = { buf, 0 };
+
+  tag(&h, "RIFF");
+  u32(&h, 0);              // patched
+  tag(&h, "AVI ");
+
+  tag(&h, "LIST");
+  uint32_t hdrlSizeAt = h.at;
+  u32(&h, 0);
+  tag(&h, "hdrl");
+
+  tag(&h, "avih");
+  u32(&h, 56);
+  w->avihAt = h.at;
+  u32(&h, usPerFrame);
+  u32(&h, 0);              // max bytes per second, patched
+  u32(&h, 0);              // padding granularity
+  u32(&h, AVIF_HASINDEX);
+  u32(&h, 0);              // total frames, patched
+  u32(&h, 0);              // initial frames
+  u32(&h, audioRate ? 2 : 1);
+  u32(&h, 0);              // suggested buffer, patched
+  u32(&h, width);
+  u32(&h, height);
+  h.at += 16;              // reserved
+
+  videoStreamList(&h, w, width, height, usPerFrame);
+  if (audioRate) {
+    audioStreamList(&h, w, audioRate);
+  }
+  put32(buf + hdrlSizeAt, h.at - hdrlSizeAt - 4);
+
+  tag(&h, "LIST");
+  u32(&h, 0);              // patched
+  tag(&h, "movi");
+  w->moviAt = h.at - 4;
+
+  if (!sink.write(sink.ctx, buf, h.at, nullptr, 0, false)) {
+    return false;
+  }
+  w->pos = h.at;
+  return true;
+}
+
+/* ===== Chunks ===== */
+
+static bool addChunk(AviWriter *w, const char *fourcc, const uint8_t *data, size_t len,
+                     bool audio) {
+  if (aviIndexFull(w) || len >= AVI_AUDIO_BIT) {
+    return false;
+  }
+  // Room for this chunk, its index entry and the index header
+  uint64_t end = (uint64_t)w->pos + AVI_CHUNK_HEAD + len +
+                 (uint64_t)(w->indexCount + 1) * 16 + 8;
+  if (end > AVI_SIZE_LIMIT) {
+    return false;
+  }
+
+  uint8_t head[AVI_CHUNK_HEAD];
+  size_t n = 0;
+  if (w->pad) {
+    head[n++] = 0;
+  }
+  memcpy(head + n, fourcc, 4);
+  put32(head + n + 4, (uint32_t)len);
+  n += 8;
+  if (!w->sink.write(w->sink.ctx, head, n, data, len, true)) {
+    return false;
+  }
+
+  uint32_t chunkAt = w->pos + (w->pad ? 1 : 0);
+  w->index[w->indexCount].offset = chunkAt - w->moviAt;
+  w->index[w->indexCount].size = (uint32_t)len | (audio ? AVI_AUDIO_BIT : 0);
+  w->indexCount++;
+  w->pos = chunkAt + 8 + (uint32_t)len;
+  w->pad = len & 1;
+  if (len > w->maxChunk) {
+    w->maxChunk = len;
+  }
+  return true;
+}
+
+// false: not written (sink busy, index full or file at its size limit);
+// the container stays valid either way
+bool aviAddFrame(AviWriter *w, const uint8_t *jpg, size_t len) {
+  if (!addChunk(w, "00dc", jpg, len, false)) {
+    return false;
+  }
+  w->frames++;
+  return true;
+}
+
+bool aviAddAudio(AviWriter *w, const uint8_t *pcm, size_t len) {
+  if (!w->audioRate || !addChunk(w, "01wb", pcm, len & ~(size_t)1, true)) {
+    return false;
+  }
+  w->audioBytes += len & ~(size_t)1;
+  return true;
+}
+
+bool aviIndexFull(const AviWriter *w) {
+  return w->indexCount >= w->indexCap;
+}
+
+/* ===== Close ===== */
+
+static bool patch32(AviWriter *w, uint32_t at, uint32_t v) {
+  uint8_t b[4];
+  put32(b, v);
+  return w->sink.patch(w->sink.ctx, at, b, 4);
+}
+
+// Writes idx1 and fills in the sizes and counts left open in the header.
+// usPerFrame is the measured frame interval, which the player uses.
+bool aviEnd(AviWriter *w, uint32_t usPerFrame) {
+  uint8_t batch[AVI_CHUNK_HEAD + AVI_INDEX_BATCH * 16];
+  size_t n = 0;
+  if (w->pad) {
+    batch[n++] = 0;
+  }
+  memcpy(batch + n, "idx1", 4);
+  put32(batch + n + 4, w->indexCount * 16);
+  n += 8;
+  uint32_t idx1At = w->pos + (w->pad ? 1 : 0);
+  if (!w->sink.write(w->sink.ctx, batch, n, nullptr, 0, false)) {
+    return false;
+  }
+  w->pos = idx1At + 8;
+  w->pad = false;
+
+  for (uint32_t i = 0; i < w->indexCount; i += AVI_INDEX_BATCH) {
+    uint32_t count = w->indexCount - i < AVI_INDEX_BATCH ? w->indexCount - i : AVI_INDEX_BATCH;
+    for (uint32_t k = 0; k < count; k++) {
+      const AviIndexEntry &e = w->index[i + k];
+      bool audio = e.size & AVI_AUDIO_BIT;
+      uint8_t *p = batch + k * 16;
+      memcpy(p, audio ? "01wb" : "00dc", 4);
+      put32(p + 4, audio ? 0 : AVIIF_KEYFRAME);
+      put32(p + 8, e.offset);
+      put32(p + 12, e.size & ~AVI_AUDIO_BIT);
+    }
+    if (!w->sink.write(w->sink.ctx, batch, count * 16, nullptr, 0, false)) {
+      return false;
+    }
+    w->pos += count * 16;
+  }
+
+  if (usPerFrame == 0) {
+    usPerFrame = 1;
+  }
+  uint32_t bytesPerSec = (uint32_t)((uint64_t)w->maxChunk * 1000000 / usPerFrame) +
+                         w->audioRate * 2;
+  bool ok = patch32(w, 4, w->pos - 8) &&
+            patch32(w, w->moviAt - 4, idx1At - w->moviAt) &&
+            patch32(w, w->avihAt + AVIH_US_PER_FRAME, usPerFrame) &&
+            patch32(w, w->avihAt + AVIH_MAX_BPS, bytesPerSec) &&
+            patch32(w, w->avihAt + AVIH_TOTAL_FRAMES, w->frames) &&
+            patch32(w, w->avihAt + AVIH_SUGGESTED, w->maxChunk + 8) &&
+            patch32(w, w->videoStrhAt + STRH_SCALE, usPerFrame) &&
+            patch32(w, w->videoStrhAt + STRH_LENGTH, w->frames) &&
+            patch32(w, w->videoStrhAt + STRH_SUGGESTED, w->maxChunk + 8);
+  if (ok && w->audioRate) {
+    ok = patch32(w, w->audioStrhAt + STRH_LENGTH, w->audioBytes / 2);
+  }
+  return ok;
+}
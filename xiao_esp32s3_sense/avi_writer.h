@@ -0,0 +1,61 @@
+#ifndef AVI_WRITER_H
+#define AVI_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// MJPEG AVI 1.0 container written front to back into a sink that only
+// appends, plus a few in-place patches of the header at close. Chunks go
+// straight out as they arrive; the idx1 index is kept in a caller-owned
+// RAM table and written after the last chunk. Optional second stream:
+// 16-bit mono PCM, interleaved as '01wb' chunks.
+//
+// Layout:
+//   RIFF 'AVI ' { LIST 'hdrl' { avih, LIST 'strl' { strh, strf } [, audio strl] }
+//                 LIST 'movi' { '00dc' | '01wb' ... }
+//                 idx1 }
+
+#define AVI_HEADER_MAX   512
+#define AVI_CHUNK_HEAD   9       // pad byte of the previous chunk + fourcc + size
+#define AVI_INDEX_BATCH  32      // idx1 entries written per sink call
+
+// head and body go out together or not at all. A droppable write may
+// be refused (the sink is busy); others wait for room.
+struct AviSink {
+  void *ctx;
+  bool (*write)(void *ctx, const uint8_t *head, size_t headLen,
+                const uint8_t *body, size_t bodyLen, bool droppable);
+  bool (*patch)(void *ctx, uint32_t offset, const uint8_t *data, size_t len);
+};
+
+struct AviIndexEntry {
+  uint32_t offset;     // of the chunk, from the 'movi' fourcc
+  uint32_t size;       // high bit set: audio chunk
+};
+
+struct AviWriter {
+  AviSink sink;
+  AviIndexEntry *index;
+  uint32_t indexCap;
+  uint32_t indexCount;
+  uint32_t pos;            // bytes in the file so far, pad included
+  uint32_t moviAt;         // offset of the 'movi' fourcc
+  uint32_t avihAt;         // offsets of the fields patched at close
+  uint32_t videoStrhAt;
+  uint32_t audioStrhAt;
+  uint32_t frames;
+  uint32_t audioBytes;
+  uint32_t maxChunk;
+  uint32_t audioRate;      // 0: no audio stream
+  bool pad;                // the last chunk had an odd size
+};
+
+// Function declarations
+bool aviBegin(AviWriter *w, const AviSink &sink, AviIndexEntry *index, uint32_t indexCap,
+              uint16_t width, uint16_t height, uint32_t usPerFrame, uint32_t audioRate);
+bool aviAddFrame(AviWriter *w, const uint8_t *jpg, size_t len);
+bool aviAddAudio(AviWriter *w, const uint8_t *pcm, size_t len);
+bool aviIndexFull(const AviWriter *w);
+bool aviEnd(AviWriter *w, uint32_t usPerFrame);
+
+#endif
@@ -1,13 +1,34 @@
 #include "ble_transfer.h"
 #include "audio_handler.h"
+#include "capture_catalog.h"
+#include "thumb_sheet.h"
 #include "camera_config.h"
 #include "sd_card.h"
+#include "psram_arena.h"
+#include "metrics.h"
+#include "rate_control.h"
+#include "motion_detect.h"
+#include "crc32.h"
+#include "conn_manager.h"
+#include "transfer_session.h"
+#include "dedup_index.h"
+#include "stream_mux.h"
+#include "wire_format.h"
+#include "capture_crypto.h"
+#include "boot_status.h"
+#include "camera_power.h"
+#include "power_manager.h"
+#include "task_topology.h"
+#include "esp_timer.h"
+#include <esp_gap_ble_api.h>
+#include <BLESecurity.h>
 
 BLEServer *pServer = nullptr;
 BLECharacteristic *pCameraCharacteristic = nullptr;
 BLECharacteristic *pAudioCharacteristic = nullptr;
 
 bool deviceConnected = false;
+static esp_bd_addr_t remoteBda;
 
 /* ================= LED ================= */
 
@@ -23,24 +44,188 @@ void blink()
 static const int IMAGE_CHUNK_SIZE = 180;
 
 static uint8_t *imageBuf = nullptr;
+static ArenaScope imageScope = ARENA_SCOPE_NONE;
 static size_t imageLen = 0;
-static size_t imageOffset = 0;
+static uint32_t imageStartMs = 0;
+static uint8_t imageKind = IMAGE_KIND_FULL;
+static uint64_t imageHash = 0;
+static uint32_t imageCrc = 0;
+static uint8_t imageFlags = 0;
+static uint32_t nextObjectId = 0;
+// Packet CRC cost over the current image, for the crc.cycles_per_kb metric
+static uint32_t crcCycles = 0;
+static uint32_t crcBytes = 0;
+
+// Images waiting behind the one in flight (a preview, then its frame)
+struct PendingImage
+{
+  uint8_t *buf;
+  size_t len;
+  ArenaScope scope;
+  uint8_t kind;
+  uint64_t hash;
+  uint32_t crc;
+  uint8_t flags;
+  uint32_t objectId;
+};
+
+static const int IMAGE_QUEUE_DEPTH = 2;
+static PendingImage imageQueue[IMAGE_QUEUE_DEPTH];
+static int imageQueueLen = 0;
 
 static bool sendingImage = false;
 static bool headerSent = false;
-static bool waitingAck = false;
+static volatile bool waitingAck = false;
 
-static uint16_t imageSeq = 0;
+// A lost notification or ACK would otherwise stall the transfer: after
+// this long without an answer the header or packet goes out again.
+static const uint32_t ACK_TIMEOUT_MS = 1500;
+static uint32_t ackWaitStartMs = 0;
+
+static TransferSession session;
 static uint16_t totalPackets = 0;
+static volatile uint16_t ackExpected = 0;   // seq of last packet sent + 1
+static volatile bool ackArrived = false;
+
+// Selective re-request from the phone ("RESEND:a-b"), applied by the
+// sender loop: packets a..b go out again, then sending resumes.
+static volatile bool resendPending = false;
+static volatile uint16_t resendFrom = 0;
+static volatile uint16_t resendTo = 0;
+
+// Reconnect handling: the transfer in flight is kept, its header is sent
+// again once the phone has written to us (so notifications are enabled),
+// and the phone answers "RESUME:<id>:<missing ranges>" or ACK:0 to start
+// over.
+static volatile bool linkLost = false;
+static volatile bool peerReady = false;
+// Set once pairing or a stored bond has encrypted this connection; key
+// material and the encryption switch are only taken over such a link
+static volatile bool linkEncrypted = false;
+static bool resumingHeader = false;
+// The RESUME answer is written by the BLE host task and taken by the
+// sender loop; the ranges are too big to hand over atomically, so both
+// sides hold resumeLock
+static portMUX_TYPE resumeLock = portMUX_INITIALIZER_UNLOCKED;
+static bool resumePending = false;
+static uint32_t resumeObjectId = 0;
+static SeqRange resumeRanges[SESSION_MAX_RANGES];
+static int resumeRangeCount = 0;
+
+// Audio clip credits: the phone's last "AUDIO_ACK:<bytes held>", applied
+// by the sender loop
+static volatile uint32_t audioAckBytes = 0;
+static volatile bool audioAckPending = false;
+
+// Stream sources for the multiplexer, defined with their senders below
+static size_t pullImage(uint8_t *out, size_t cap);
+static size_t pullAudio(uint8_t *out, size_t cap);
+
+/* ================= CONNECTION PROFILE STATE ================= */
+
+static LinkProfile linkProfile = LINK_IDLE;
+static uint32_t linkSwitchMs = 0;
+static uint32_t lastBulkMs = 0;
+// Goodput of the last transfer before the switch, reported against the
+// first transfer after it
+static uint32_t goodputBeforeSwitch = 0;
+static bool switchEffectPending = false;
+
+static void resetLinkProfile()
+{
+  // A fresh connection runs on whatever the central picked; treat it as idle
+  linkProfile = LINK_IDLE;
+  linkSwitchMs = millis();
+  switchEffectPending = false;
+}
+
 volatile bool cameraCommandPending = false;
+volatile int64_t cameraCommandUs = 0;
+volatile bool metricsCommandPending = false;
+volatile bool audioStartPending = false;
+volatile bool bootCommandPending = false;
+volatile bool tasksCommandPending = false;
+volatile bool audioStopPending = false;
+volatile bool liveAudioPending = false;
+volatile bool liveAudioOn = false;
+volatile bool audioConfigPending = false;
+AudioConfig pendingAudioConfig;
+volatile bool videoStartPending = false;
+volatile bool videoStopPending = false;
+volatile uint16_t videoSeconds = 0;
+volatile uint8_t videoFps = 0;
+volatile bool videoWithAudio = false;
+volatile bool queryPending = false;
+volatile uint32_t queryFrom = 0;
+volatile uint32_t queryTo = 0;
+volatile uint32_t querySkip = 0;
+volatile bool fetchPending = false;
+volatile uint64_t fetchHash = 0;
+volatile uint32_t fetchLen = 0;
+volatile bool thumbsPending = false;
+volatile uint32_t thumbsFrom = 0;
+volatile uint16_t thumbsCount = 0;
+volatile uint32_t captureBudgetMs = RATE_DEFAULT_BUDGET_MS;
+volatile bool capturePreviewEnabled = false;
+
+/* ================= COMMAND PARSING ================= */
+
+// Commands are compared in place on the characteristic's raw value so a
+// write never allocates an Arduino String.
+static bool commandIs(const uint8_t *data, size_t len, const char *cmd)
+{
+  size_t n = strlen(cmd);
+  return len == n && memcmp(data, cmd, n) == 0;
+}
+
+static bool commandStartsWith(const uint8_t *data, size_t len, const char *prefix)
+{
+  size_t n = strlen(prefix);
+  return len >= n && memcmp(data, prefix, n) == 0;
+}
+
+static uint32_t parseUint(const uint8_t *data, size_t len)
+{
+  uint32_t v = 0;
+  for (size_t i = 0; i < len && data[i] >= '0' && data[i] <= '9'; i++)
+    v = v * 10 + (data[i] - '0');
+  return v;
+}
+
+// Exactly 2 * outLen hex digits
+static bool parseHex(const uint8_t *data, size_t len, uint8_t *out, size_t outLen)
+{
+  if (len != outLen * 2)
+    return false;
+  for (size_t i = 0; i < len; i++)
+  {
+    uint8_t c = data[i];
+    uint8_t v;
+    if (c >= '0' && c <= '9')
+      v = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      v = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      v = c - 'A' + 10;
+    else
+      return false;
+    out[i / 2] = (i % 2) ? (out[i / 2] | v) : (uint8_t)(v << 4);
+  }
+  return true;
+}
 
 /* ================= BLE CALLBACKS ================= */
 
 class MyServerCallbacks : public BLEServerCallbacks
 {
-  void onConnect(BLEServer *pServer) override
+  void onConnect(BLEServer *pServer, esp_ble_gatts_cb_param_t *param) override
   {
+    memcpy(remoteBda, param->connect.remote_bda, sizeof(esp_bd_addr_t));
+    resetLinkProfile();
+    peerReady = false;
+    linkEncrypted = false;
     deviceConnected = true;
+    powerWake();
     Serial.println("BLE connected");
     blink();
   }
@@ -48,41 +233,298 @@ class MyServerCallbacks : public BLEServerCallbacks
   void onDisconnect(BLEServer *pServer) override
   {
     deviceConnected = false;
+    linkEncrypted = false;
+    linkLost = true;
+    powerWake();
     Serial.println("BLE disconnected");
     BLEDevice::startAdvertising();
   }
 };
 
+// "Just works" pairing: no display or keyboard on the device, but the
+// link is encrypted and the bond stored, so later connections encrypt
+// without asking again
+class MySecurityCallbacks : public BLESecurityCallbacks
+{
+  uint32_t onPassKeyRequest() override { return 0; }
+  void onPassKeyNotify(uint32_t passKey) override {}
+  bool onConfirmPIN(uint32_t passKey) override { return true; }
+  bool onSecurityRequest() override { return true; }
+
+  void onAuthenticationComplete(esp_ble_auth_cmpl_t cmpl) override
+  {
+    linkEncrypted = cmpl.success;
+    Serial.printf("BLE pairing %s\n", cmpl.success ? "done" : "failed");
+  }
+};
+
+// Crypto commands on a link that is not encrypted are refused, and the
+// phone is asked to pair; it sends them again once that completes
+static bool requireEncryptedLink(const char *reply)
+{
+  if (linkEncrypted)
+    return true;
+  esp_ble_set_encryption(remoteBda, ESP_BLE_SEC_ENCRYPT);
+  sendStatusText(reply);
+  return false;
+}
+
 class MyCallbacks : public BLECharacteristicCallbacks
 {
   void onWrite(BLECharacteristic *pCharacteristic) override
   {
-    String value = pCharacteristic->getValue();
+    const uint8_t *data = pCharacteristic->getData();
+    size_t len = pCharacteristic->getLength();
 
-    if (value == "START_CAMERA")
+    // Any write means the phone is subscribed and listening
+    peerReady = true;
+
+    if (commandIs(data, len, "START_CAMERA"))
     {
+      // The shot must start after this moment (esp_timer time)
+      cameraCommandUs = esp_timer_get_time();
       cameraCommandPending = true;
       Serial.println("Camera command received");
     }
 
-    if (value.startsWith("ACK:"))
+    if (commandIs(data, len, "BOOT?"))
+    {
+      bootCommandPending = true;
+    }
+
+    if (commandIs(data, len, "TASKS?"))
+    {
+      tasksCommandPending = true;
+    }
+
+    if (commandIs(data, len, "START_AUDIO"))
     {
-      uint16_t ackSeq = value.substring(4).toInt();
-      Serial.printf("Received ACK for sequence %d, waiting for %d;\n", ackSeq, imageSeq);
-      if (ackSeq == imageSeq || ackSeq == 0xFFFF)
+      audioStartPending = true;
+    }
+
+    if (commandIs(data, len, "STOP_AUDIO"))
+    {
+      audioStopPending = true;
+    }
+
+    if (commandIs(data, len, "AUDIO_CONFIG?"))
+    {
+      char reply[16 + AUDIO_CONFIG_TEXT_MAX];
+      strcpy(reply, "AUDIO_CONFIG:");
+      formatAudioConfig(audioConfig(), reply + 13, sizeof(reply) - 13);
+      sendStatusText(reply);
+    }
+    else if (commandStartsWith(data, len, "AUDIO_CONFIG:"))
+    {
+      // AUDIO_CONFIG:rate=16000,bits=16,gain=2,secs=10,codec=adpcm (any
+      // subset); applied by loop() once the microphone is idle
+      AudioConfig next = audioConfig();
+      if (!audioConfigPending &&
+          parseAudioConfig((const char *)data + 13, len - 13, &next))
       {
-        Serial.printf("Packet %d ACK received, moving to %d\n", ackSeq, imageSeq);
+        pendingAudioConfig = next;
+        audioConfigPending = true;
+      }
+      else
+      {
+        sendStatusText("AUDIO_CONFIG:BAD");
+      }
+    }
+
+    if (commandStartsWith(data, len, "LIVE_AUDIO:"))
+    {
+      liveAudioOn = parseUint(data + 11, len - 11) != 0;
+      liveAudioPending = true;
+    }
+
+    if (commandStartsWith(data, len, "VIDEO:"))
+    {
+      // VIDEO:<seconds>[:<fps>[:<audio 0|1>]]
+      const uint8_t *end = data + len;
+      const uint8_t *fps = (const uint8_t *)memchr(data + 6, ':', len - 6);
+      const uint8_t *audio = fps ? (const uint8_t *)memchr(fps + 1, ':', end - fps - 1) : nullptr;
+      videoSeconds = parseUint(data + 6, len - 6);
+      videoFps = fps ? parseUint(fps + 1, end - fps - 1) : 0;
+      videoWithAudio = audio && parseUint(audio + 1, end - audio - 1) != 0;
+      videoStartPending = true;
+    }
+
+    if (commandIs(data, len, "VIDEO_STOP"))
+    {
+      videoStopPending = true;
+    }
+
+    if (commandStartsWith(data, len, "TIME:"))
+    {
+      // TIME:<unix seconds>, set right away so the phone's clock reading
+      // is as fresh as possible
+      catalogSetTime(parseUint(data + 5, len - 5));
+      sendStatusText(catalogTimeSynced() ? "TIME:OK" : "TIME:BAD");
+    }
+
+    if (commandStartsWith(data, len, "QUERY:"))
+    {
+      // QUERY:<from>[:<to>[:<skip>]], Unix seconds, both ends included
+      const uint8_t *end = data + len;
+      const uint8_t *to = (const uint8_t *)memchr(data + 6, ':', len - 6);
+      const uint8_t *skip = to ? (const uint8_t *)memchr(to + 1, ':', end - to - 1) : nullptr;
+      queryFrom = parseUint(data + 6, len - 6);
+      queryTo = to ? parseUint(to + 1, end - to - 1) : UINT32_MAX;
+      querySkip = skip ? parseUint(skip + 1, end - skip - 1) : 0;
+      queryPending = true;
+    }
+
+    if (commandStartsWith(data, len, "THUMBS:"))
+    {
+      // THUMBS:<from id>[:<count>], a sheet of photo thumbnails
+      const uint8_t *end = data + len;
+      const uint8_t *count = (const uint8_t *)memchr(data + 7, ':', len - 7);
+      thumbsFrom = parseUint(data + 7, len - 7);
+      // 1 at least: an empty sheet would point back at fromId
+      thumbsCount = count ? min(max(parseUint(count + 1, end - count - 1), (uint32_t)1),
+                                (uint32_t)THUMB_SHEET_MAX)
+                          : THUMB_SHEET_MAX;
+      thumbsPending = true;
+    }
+
+    if (commandStartsWith(data, len, "FETCH:"))
+    {
+      // FETCH:<16 hex digit hash>:<length>, the original of a reference
+      // the phone could not resolve
+      const uint8_t *colon = (const uint8_t *)memchr(data + 6, ':', len - 6);
+      uint8_t digest[8];
+      if (colon && parseHex(data + 6, colon - data - 6, digest, sizeof(digest)))
+      {
+        uint64_t hash = 0;
+        for (size_t i = 0; i < sizeof(digest); i++)
+          hash = hash << 8 | digest[i];
+        fetchHash = hash;
+        fetchLen = parseUint(colon + 1, data + len - colon - 1);
+        fetchPending = true;
+      }
+    }
+
+    if (commandIs(data, len, "METRICS"))
+    {
+      metricsCommandPending = true;
+    }
+
+    if (commandStartsWith(data, len, "CAMERA_BUDGET:"))
+    {
+      captureBudgetMs = parseUint(data + 14, len - 14);
+      Serial.printf("Capture latency budget %u ms\n", (unsigned)captureBudgetMs);
+    }
+
+    if (commandStartsWith(data, len, "CAMERA_PREVIEW:"))
+    {
+      capturePreviewEnabled = parseUint(data + 15, len - 15) != 0;
+    }
+
+    if (commandStartsWith(data, len, "CAMERA_WARM:"))
+    {
+      setCameraAlwaysOn(parseUint(data + 12, len - 12) != 0);
+    }
+
+    if (commandStartsWith(data, len, "MOTION_GATE:"))
+    {
+      setMotionGate(parseUint(data + 12, len - 12) != 0);
+      Serial.printf("Motion gate %s\n", motionGateEnabled() ? "on" : "off");
+    }
+
+    if (commandStartsWith(data, len, "CRYPTO_KEY:") &&
+        requireEncryptedLink("CRYPTO_KEY:INSECURE"))
+    {
+      // CRYPTO_KEY:<64 hex digits>, the master key captures are sealed with
+      uint8_t key[CRYPTO_KEY_SIZE];
+      bool ok = parseHex(data + 11, len - 11, key, sizeof(key)) &&
+                cryptoSetMasterKey(key);
+      memset(key, 0, sizeof(key));
+      sendStatusText(ok ? "CRYPTO_KEY:OK" : "CRYPTO_KEY:BAD");
+    }
+
+    if (commandStartsWith(data, len, "CRYPTO:") &&
+        requireEncryptedLink("CRYPTO:INSECURE"))
+    {
+      bool on = parseUint(data + 7, len - 7) != 0;
+      if (cryptoSetEnabled(on))
+        sendStatusText(on ? "CRYPTO:1" : "CRYPTO:0");
+      else
+        sendStatusText("CRYPTO:NOKEY");
+      Serial.printf("Capture encryption %s\n", cryptoEnabled() ? "on" : "off");
+    }
+
+    if (commandStartsWith(data, len, "RESEND:"))
+    {
+      const uint8_t *dash = (const uint8_t *)memchr(data + 7, '-', len - 7);
+      resendFrom = parseUint(data + 7, len - 7);
+      resendTo = dash ? parseUint(dash + 1, len - (dash + 1 - data)) : resendFrom;
+      resendPending = true;
+      waitingAck = false;
+      metricAdd("crc.resend_requests", 1);
+      Serial.printf("Resend requested for packets %u-%u\n", resendFrom, resendTo);
+    }
+
+    if (commandStartsWith(data, len, "RESUME:"))
+    {
+      // RESUME:<object id>:<a-b,c-d,...> lists what the phone still lacks
+      const uint8_t *colon = (const uint8_t *)memchr(data + 7, ':', len - 7);
+      if (colon)
+      {
+        size_t at = colon + 1 - data;
+        uint32_t objectId = parseUint(data + 7, len - 7);
+        SeqRange ranges[SESSION_MAX_RANGES];
+        int count = parseSeqRanges(data + at, len - at, ranges, SESSION_MAX_RANGES);
+        portENTER_CRITICAL(&resumeLock);
+        resumeObjectId = objectId;
+        memcpy(resumeRanges, ranges, sizeof(ranges));
+        resumeRangeCount = count;
+        resumePending = true;
+        portEXIT_CRITICAL(&resumeLock);
         waitingAck = false;
+        Serial.printf("Resume requested for object %lu (%d ranges)\n",
+                      (unsigned long)objectId, count);
       }
     }
+
+    if (commandStartsWith(data, len, "AUDIO_ACK:"))
+    {
+      audioAckBytes = parseUint(data + 10, len - 10);
+      audioAckPending = true;
+    }
+
+    if (commandStartsWith(data, len, "ACK:"))
+    {
+      uint16_t ackSeq = parseUint(data + 4, len - 4);
+      Serial.printf("Received ACK for sequence %d, waiting for %d;\n", ackSeq, ackExpected);
+      if (ackSeq == ackExpected || ackSeq == 0xFFFF)
+      {
+        Serial.printf("Packet %d ACK received\n", ackSeq);
+        ackArrived = true;
+        waitingAck = false;
+      }
+    }
+
+    // Whatever was asked for, loop() handles it
+    powerWake();
   }
 };
 
 void initBLE()
 {
+  // Object IDs must not repeat across reboots, or the phone could resume
+  // a new object from a stale partial one
+  nextObjectId = esp_random();
+
   BLEDevice::init("XIAO_ESP32S3");
   BLEDevice::setMTU(247);
 
+  // Bond on request (see requireEncryptedLink); nothing else needs it
+  BLEDevice::setSecurityCallbacks(new MySecurityCallbacks());
+  BLESecurity *pSecurity = new BLESecurity();
+  pSecurity->setAuthenticationMode(ESP_LE_AUTH_REQ_SC_BOND);
+  pSecurity->setCapability(ESP_IO_CAP_NONE);
+  pSecurity->setInitEncryptionKey(ESP_BLE_ENC_KEY_MASK | ESP_BLE_ID_KEY_MASK);
+
   pServer = BLEDevice::createServer();
   pServer->setCallbacks(new MyServerCallbacks());
 
@@ -106,6 +548,13 @@ void initBLE()
 
   pService->start();
 
+  // Control replies first, then live features, then bulk media (images
+  // get twice the audio share when both are moving)
+  muxRegister(MUX_CONTROL, MUX_CLASS_CONTROL, 1, nullptr);
+  muxRegister(MUX_LIVE, MUX_CLASS_LIVE, 1, nullptr);
+  muxRegister(MUX_IMAGE, MUX_CLASS_BULK, 2, pullImage);
+  muxRegister(MUX_AUDIO, MUX_CLASS_BULK, 1, pullAudio);
+
   BLEAdvertising *pAdvertising = BLEDevice::getAdvertising();
   pAdvertising->addServiceUUID(SERVICE_UUID);
   pAdvertising->setScanResponse(true);
@@ -116,106 +565,516 @@ void initBLE()
   Serial.println("BLE ready");
 }
 
-/* ================= BLE CALLBACK ================= */
+/* ================= CONNECTION PROFILE ================= */
+
+static void applyLinkProfile(LinkProfile profile)
+{
+  const LinkParams &lp = linkParamsFor(profile);
+  esp_ble_gap_phy_mask_t phy = lp.phy2M ? ESP_BLE_GAP_PHY_2M_PREF_MASK
+                                        : ESP_BLE_GAP_PHY_1M_PREF_MASK;
+
+  // Each request is a separate LL procedure; the central may refuse any of
+  // them, which only costs throughput
+  esp_ble_gap_set_preferred_phy(remoteBda, 0, phy, phy,
+                                ESP_BLE_GAP_PHY_OPTIONS_NO_PREF);
+  esp_ble_gap_set_pkt_data_len(remoteBda, lp.dataLength);
+  pServer->updateConnParams(remoteBda, lp.minInterval, lp.maxInterval,
+                            lp.latency, lp.timeout);
+}
+
+// Called from the sender loop; bulkPending is true while a transfer or
+// the live audio stream is using the link.
+static void serviceLinkProfile(bool bulkPending)
+{
+  if (!deviceConnected)
+    return;
+
+  uint32_t now = millis();
+  if (bulkPending)
+    lastBulkMs = now;
+
+  LinkProfile next = decideLinkProfile(linkProfile, bulkPending,
+                                       now - lastBulkMs, now - linkSwitchMs);
+  if (next == linkProfile)
+    return;
+
+  goodputBeforeSwitch = rateGoodputBps();
+  switchEffectPending = next == LINK_BURST;
+  Serial.printf("Link profile %s -> %s (goodput %u B/s)\n",
+                linkProfileName(linkProfile), linkProfileName(next),
+                (unsigned)goodputBeforeSwitch);
+
+  linkProfile = next;
+  linkSwitchMs = now;
+  applyLinkProfile(next);
+  metricSet("link.profile", next);
+  metricAdd("link.switches", 1);
+}
+
+// Log what the last switch did for the first transfer that ran under it
+static void reportLinkEffect(uint32_t transferBps)
+{
+  metricSet(linkProfile == LINK_BURST ? "link.burst_bps" : "link.idle_bps",
+            transferBps);
+  if (!switchEffectPending)
+    return;
+
+  switchEffectPending = false;
+  Serial.printf("Link profile %s: goodput %u -> %u B/s\n",
+                linkProfileName(linkProfile),
+                (unsigned)goodputBeforeSwitch, (unsigned)transferBps);
+}
 
 /* ================= IMAGE SEND ================= */
 
-void startImageSend(camera_fb_t *fb)
+static void beginImageSend(uint8_t *buf, size_t len, ArenaScope scope,
+                           uint8_t kind, uint64_t hash, uint32_t crc,
+                           uint8_t flags, uint32_t objectId);
+
+static void finishImageSend()
 {
-  if (!deviceConnected || !fb)
+  sendingImage = false;
+  arenaEndScope(imageScope);
+  imageScope = ARENA_SCOPE_NONE;
+  imageBuf = nullptr;
+
+  if (imageQueueLen > 0)
+  {
+    PendingImage next = imageQueue[0];
+    for (int i = 1; i < imageQueueLen; i++)
+      imageQueue[i - 1] = imageQueue[i];
+    imageQueueLen--;
+    beginImageSend(next.buf, next.len, next.scope, next.kind, next.hash, next.crc,
+                   next.flags, next.objectId);
+  }
+}
+
+void startImageSend(uint8_t *buf, size_t len, ArenaScope scope, uint8_t kind,
+                    uint64_t hash, uint32_t crc, uint8_t flags)
+{
+  if (!deviceConnected || (!buf && kind != IMAGE_KIND_DUPLICATE))
+  {
+    arenaEndScope(scope);
+    return;
+  }
+
+  uint32_t objectId = ++nextObjectId;
+  if (objectId == 0)
+    objectId = ++nextObjectId;    // 0 means "no session" to the phone
+
+  // A sealed object's header never carries the plaintext's hash
+  if (flags & IMAGE_FLAG_SEALED)
+    hash = 0;
+
+  if (sendingImage)
+  {
+    // Queue behind the image in flight, dropping the oldest if full
+    if (imageQueueLen == IMAGE_QUEUE_DEPTH)
+    {
+      arenaEndScope(imageQueue[0].scope);
+      for (int i = 1; i < imageQueueLen; i++)
+        imageQueue[i - 1] = imageQueue[i];
+      imageQueueLen--;
+    }
+    imageQueue[imageQueueLen++] = { buf, len, scope, kind, hash, crc, flags, objectId };
     return;
+  }
 
-  imageBuf = fb->buf;
-  imageLen = fb->len;
-  imageOffset = 0;
-  imageSeq = 0;
+  beginImageSend(buf, len, scope, kind, hash, crc, flags, objectId);
+}
 
-  totalPackets = (imageLen + IMAGE_CHUNK_SIZE - 1) / IMAGE_CHUNK_SIZE;
+// The phone already holds this content: send only a header naming it.
+void sendImageReference(size_t len, uint64_t hash)
+{
+  startImageSend(nullptr, len, ARENA_SCOPE_NONE, IMAGE_KIND_DUPLICATE, hash, 0);
+}
+
+static void beginImageSend(uint8_t *buf, size_t len, ArenaScope scope,
+                           uint8_t kind, uint64_t hash, uint32_t crc,
+                           uint8_t flags, uint32_t objectId)
+{
+  imageBuf = buf;
+  imageKind = kind;
+  imageHash = hash;
+  imageCrc = crc;
+  imageFlags = flags;
+  imageLen = len;
+  imageScope = scope;
+  imageStartMs = millis();
+  crcCycles = 0;
+  crcBytes = 0;
+  ackExpected = 0;
+  ackArrived = false;
+  resendPending = false;
+  portENTER_CRITICAL(&resumeLock);
+  resumePending = false;
+  portEXIT_CRITICAL(&resumeLock);
+  resumingHeader = false;
+
+  totalPackets = buf ? (imageLen + IMAGE_CHUNK_SIZE - 1) / IMAGE_CHUNK_SIZE : 0;
+  sessionBegin(&session, objectId, totalPackets);
 
   sendingImage = true;
   headerSent = false;
   waitingAck = false;
 
-  Serial.printf("Begin image TX (%d bytes, %d packets)\n",
-                imageLen, totalPackets);
+  Serial.printf("Begin %s TX %lu (%d bytes, %d packets, hash %016llx)\n",
+                kind == IMAGE_KIND_PREVIEW ? "preview" :
+                kind == IMAGE_KIND_DUPLICATE ? "duplicate" :
+                kind == IMAGE_KIND_SHEET ? "thumbnail sheet" : "image",
+                (unsigned long)objectId, imageLen, totalPackets,
+                (unsigned long long)hash);
 }
 
-void processImageSend()
+// Image stream source for the multiplexer: the header, then one packet
+// per ACK. Returns 0 while waiting for the phone.
+static size_t pullImage(uint8_t *out, size_t cap)
 {
-  if (!sendingImage || !deviceConnected || waitingAck)
-    return;
+  if (!sendingImage)
+    return 0;
+
+  if (waitingAck)
+  {
+    if (millis() - ackWaitStartMs < ACK_TIMEOUT_MS)
+      return 0;
+    waitingAck = false;
+    metricAdd("session.ack_timeouts", 1);
+    if (ackExpected == 0)
+    {
+      // The header went unanswered
+      headerSent = false;
+      Serial.println("No answer to image header, sending it again");
+    }
+    else if (sessionAckTimeout(&session))
+    {
+      Serial.printf("No ACK for packet %u, sending it again\n", ackExpected - 1);
+    }
+  }
 
   /* -------- send header -------- */
+  // Layout: ImageHeader in wire_format.h
   if (!headerSent)
   {
-    uint8_t header[8];
-    header[0] = 0xFF;
-    header[1] = 0xFF;
-    memcpy(header + 2, &imageLen, 4);
-    memcpy(header + 6, &totalPackets, 2);
-
-    pCameraCharacteristic->setValue(header, sizeof(header));
-    pCameraCharacteristic->notify();
+    ImageHeader::Writer header{out};
+    header.setMagic(WIRE_IMAGE_MAGIC);
+    header.setKind(imageKind);
+    header.setLength(imageLen);
+    header.setPackets(totalPackets);
+    header.setHash(imageHash);
+    header.setCrc(imageCrc);
+    header.setObjectId(session.objectId);
+    header.setFlags(imageFlags);
 
     headerSent = true;
-    waitingAck = true;
-    return;
+    ackExpected = 0;
+    ackArrived = false;
+    // A reference has no packets, so nothing to acknowledge
+    waitingAck = totalPackets > 0;
+    ackWaitStartMs = millis();
+    return ImageHeader::SIZE;
   }
 
-  /* -------- send data packet -------- */
-  if (imageSeq < totalPackets)
+  /* -------- answer to a header sent after reconnect -------- */
+  if (resumingHeader)
   {
-    
-    size_t len = min((size_t)IMAGE_CHUNK_SIZE,
-                     imageLen - imageOffset);
-    if (imageSeq == totalPackets - 1) {
-      // last packet: send all remaining bytes
-      len = imageLen - imageOffset;
+    resumingHeader = false;
+    SeqRange ranges[SESSION_MAX_RANGES];
+    int count = 0;
+    portENTER_CRITICAL(&resumeLock);
+    bool resume = resumePending && resumeObjectId == session.objectId;
+    if (resume)
+    {
+      count = resumeRangeCount;
+      memcpy(ranges, resumeRanges, sizeof(ranges));
     }
-    uint8_t packet[2 + IMAGE_CHUNK_SIZE];
-    packet[0] = imageSeq >> 8;
-    packet[1] = imageSeq & 0xFF;
-    memcpy(packet + 2, imageBuf + imageOffset, len);
+    resumePending = false;
+    portEXIT_CRITICAL(&resumeLock);
 
-    pCameraCharacteristic->setValue(packet, len + 2);
-    pCameraCharacteristic->notify();
+    if (resume)
+    {
+      sessionResume(&session, ranges, count);
+      metricAdd("session.resumed", 1);
+      Serial.printf("Transfer %lu resumed, phone holds %u/%u packets\n",
+                    (unsigned long)session.objectId,
+                    session.ackedThrough, totalPackets);
+    }
+    else
+    {
+      // The phone has nothing for this object (ACK:0): start over
+      sessionBegin(&session, session.objectId, totalPackets);
+      metricAdd("session.restarted", 1);
+    }
+    ackArrived = false;
+  }
 
-    imageOffset += len;
-    waitingAck = true;
+  /* -------- account for the last packet -------- */
+  if (ackArrived)
+  {
+    ackArrived = false;
+    if (ackExpected > 0)
+      sessionAck(&session, ackExpected - 1);
+  }
 
-    Serial.printf("Sent packet %d / %d\n",
-                  imageSeq + 1, totalPackets);
-    imageSeq++;
+  /* -------- apply re-request -------- */
+  if (resendPending)
+  {
+    resendPending = false;
+    // The packet in flight is the one the phone could not read, whatever
+    // range it asked for: it goes out again too
+    sessionAckTimeout(&session);
+    sessionRequest(&session, resendFrom, resendTo);
   }
 
-  if (imageSeq >= totalPackets)
+  /* -------- complete once the last packet is acknowledged -------- */
+  uint16_t seq;
+  if (!sessionNext(&session, &seq))
   {
-    sendingImage = false;
-    Serial.println("Image TX complete");
+    uint32_t elapsed = millis() - imageStartMs;
+    rateObserveTransfer(imageLen, elapsed);
+    if (elapsed > 0)
+      reportLinkEffect((uint32_t)((uint64_t)imageLen * 1000 / elapsed));
+    metricSet("link.goodput_bps", rateGoodputBps());
+    if (crcBytes > 0)
+      metricSet("crc.cycles_per_kb", (uint32_t)((uint64_t)crcCycles * 1024 / crcBytes));
+    Serial.printf("Image TX complete (%u ms, goodput %u B/s)\n",
+                  (unsigned)elapsed, (unsigned)rateGoodputBps());
+    // The phone holds the original now: repeats may go as references
+    if (imageKind == IMAGE_KIND_FULL && imageHash != 0 && !(imageFlags & IMAGE_FLAG_SEALED))
+      dedupMarkDelivered(imageHash, imageLen);
+    finishImageSend();
     delay(50);
     blink();
+    return 0;
+  }
+
+  /* -------- send data packet -------- */
+  // ImagePacket | payload | ImagePacketTrailer
+  size_t offset = (size_t)seq * IMAGE_CHUNK_SIZE;
+  size_t len = min((size_t)IMAGE_CHUNK_SIZE, imageLen - offset);
+
+  uint8_t *packet = out;
+  ImagePacket::Writer{packet}.setSeq(seq);
+  memcpy(packet + ImagePacket::SIZE, imageBuf + offset, len);
+  uint32_t cycles = ESP.getCycleCount();
+  uint32_t crc = crc32Update(0, packet, ImagePacket::SIZE + len);
+  crcCycles += ESP.getCycleCount() - cycles;
+  crcBytes += ImagePacket::SIZE + len;
+  ImagePacketTrailer::Writer{packet + ImagePacket::SIZE + len}.setCrc(crc);
+
+  ackExpected = seq + 1;
+  waitingAck = true;
+  ackWaitStartMs = millis();
+
+  Serial.printf("Sent packet %d / %d\n",
+                seq + 1, totalPackets);
+  return ImagePacket::SIZE + len + ImagePacketTrailer::SIZE;
+}
+
+
+/* ================= AUDIO SEND ================= */
+
+// A recorded clip goes out as an AudioHeader, then chunks tagged with
+// their offset, on the audio stream; it interleaves with images and
+// control replies. At most WIRE_AUDIO_WINDOW bytes are ahead of the
+// phone's last AUDIO_ACK, so the notification queue is never flooded.
+// If the acknowledgements stop, sending goes back to the last
+// acknowledged byte; after a reconnect the clip starts over with its
+// header. The clip is released once the phone holds all of it.
+static uint8_t *audioBuf = nullptr;
+static size_t audioLen = 0;
+static size_t audioOffset = 0;        // next byte to send
+static size_t audioAcked = 0;         // bytes the phone holds
+static uint32_t audioProgressMs = 0;  // last send or ACK that moved things
+static ArenaScope audioSendScope = ARENA_SCOPE_NONE;
+static uint8_t audioFlags = 0;
+static bool sendingAudio = false;
+static bool audioHeaderSent = false;
+
+void sendAudioViaBLE(uint8_t *data, size_t length, ArenaScope scope, uint8_t flags)
+{
+  if (!deviceConnected || sendingAudio)
+  {
+    Serial.println("Audio TX busy or not connected, clip dropped");
+    arenaEndScope(scope);
+    return;
+  }
+
+  audioBuf = data;
+  audioLen = length;
+  audioOffset = 0;
+  audioAcked = 0;
+  audioSendScope = scope;
+  audioFlags = flags;
+  audioHeaderSent = false;
+  audioAckPending = false;
+  sendingAudio = true;
+}
+
+static void finishAudioSend()
+{
+  sendingAudio = false;
+  arenaEndScope(audioSendScope);
+  audioSendScope = ARENA_SCOPE_NONE;
+  audioBuf = nullptr;
+}
+
+static size_t pullAudio(uint8_t *out, size_t cap)
+{
+  if (!sendingAudio)
+    return 0;
+
+  uint32_t now = millis();
+  if (!audioHeaderSent)
+  {
+    AudioChunk::Writer{out}.setOffset(WIRE_AUDIO_HEADER_OFFSET);
+    AudioHeader::Writer header{out + AudioChunk::SIZE};
+    header.setSize(audioLen);
+    header.setFlags(audioFlags);
+    audioHeaderSent = true;
+    audioOffset = 0;
+    audioAcked = 0;
+    audioAckPending = false;
+    audioProgressMs = now;
+    return AudioChunk::SIZE + AudioHeader::SIZE;
+  }
+
+  if (audioAckPending)
+  {
+    audioAckPending = false;
+    uint32_t held = audioAckBytes;
+    if (held > audioAcked && held <= audioLen)
+    {
+      // A late ACK after going back may be past what we resent
+      audioAcked = held;
+      if (audioOffset < held)
+        audioOffset = held;
+      audioProgressMs = now;
+    }
+  }
+
+  if (audioAcked >= audioLen)
+  {
+    finishAudioSend();
+    Serial.printf("Audio TX complete (%u bytes)\n", (unsigned)audioLen);
+    return 0;
+  }
+
+  size_t room = audioAcked + WIRE_AUDIO_WINDOW - audioOffset;
+  if (audioOffset >= audioLen || room == 0)
+  {
+    // Everything in the window is out; wait for the phone
+    if (now - audioProgressMs < ACK_TIMEOUT_MS)
+      return 0;
+    metricAdd("audio.ack_timeouts", 1);
+    Serial.printf("No audio ACK past %u bytes, sending again from there\n",
+                  (unsigned)audioAcked);
+    audioOffset = audioAcked;
+    room = WIRE_AUDIO_WINDOW;
+  }
+
+  size_t len = min(min(cap - AudioChunk::SIZE, audioLen - audioOffset), room);
+  AudioChunk::Writer{out}.setOffset(audioOffset);
+  memcpy(out + AudioChunk::SIZE, audioBuf + audioOffset, len);
+  audioOffset += len;
+  audioProgressMs = now;
+  return AudioChunk::SIZE + len;
+}
+
+/* ================= TRANSMIT ================= */
+
+// Called from loop(): one multiplexed frame per call, highest-priority
+// stream with something ready first. False when nothing went out.
+bool processTransmit()
+{
+  static bool transferHeld = false;
+  bool transferring = sendingImage || sendingAudio;
+  // Live audio needs a frame through every 20 ms, which the idle
+  // profile's 100-200 ms events cannot carry
+  serviceLinkProfile(transferring || isLiveAudio());
+  if (transferring != transferHeld)
+  {
+    transferHeld = transferring;
+    if (transferring)
+      powerAcquire(POWER_TRANSFER);
+    else
+      powerRelease(POWER_TRANSFER);
+  }
+
+  /* -------- link dropped: keep the transfer, resend its header -------- */
+  if (linkLost)
+  {
+    linkLost = false;
+    if (sendingImage && headerSent)
+    {
+      sessionLinkLost(&session);
+      headerSent = false;
+      resumingHeader = true;
+      Serial.printf("Transfer %lu suspended at %u/%u packets\n",
+                    (unsigned long)session.objectId,
+                    session.ackedThrough, totalPackets);
+    }
+    if (sendingAudio && audioHeaderSent)
+    {
+      // The phone drops a partial clip with the connection: start over
+      audioHeaderSent = false;
+      Serial.printf("Audio clip restarts after reconnect (%u/%u bytes held)\n",
+                    (unsigned)audioAcked, (unsigned)audioLen);
+    }
+    waitingAck = false;
+    // Replies queued for the old connection are stale
+    muxReset();
   }
+
+  if (!deviceConnected || !peerReady)
+    return false;
+
+  uint8_t frame[MUX_FRAME_MAX];
+  size_t len = muxNextFrame(frame, millis());
+  if (len == 0)
+    return false;
+
+  pCameraCharacteristic->setValue(frame, len);
+  pCameraCharacteristic->notify();
+  return true;
 }
 
+/* ================= STATUS REPLIES ================= */
 
-void sendAudioViaBLE(uint8_t *data, size_t length)
+// Text replies go out on the control stream, split to fit one frame
+// each; they are sent ahead of any image or audio data. Safe to call
+// from the BLE callbacks.
+void sendStatusText(const char *text)
 {
   if (!deviceConnected)
     return;
 
-  uint32_t size = length;
-  pAudioCharacteristic->setValue((uint8_t *)&size, sizeof(size));
-  pAudioCharacteristic->notify();
-  delay(10);
+  uint32_t now = millis();
+  size_t total = strlen(text);
 
-  const int chunkSize = 244;
-  for (size_t i = 0; i < length; i += chunkSize)
+  for (size_t i = 0; i < total; i += MUX_PAYLOAD_MAX)
   {
-    size_t len = min((size_t)chunkSize, length - i);
-    pAudioCharacteristic->setValue(data + i, len);
-    pAudioCharacteristic->notify();
-    delay(5);
+    size_t len = min((size_t)MUX_PAYLOAD_MAX, total - i);
+    if (!muxEnqueue(MUX_CONTROL, (const uint8_t *)text + i, len, now))
+    {
+      Serial.println("Control queue full, status reply truncated");
+      break;
+    }
   }
+  powerWake();
+}
+
+void sendMetricsViaBLE()
+{
+  static char report[2048];
+
+  arenaPublishMetrics();
+  muxPublishMetrics();
+  bootPublishMetrics();
+  powerPublishMetrics();
+  taskPublishMetrics();
+  formatMetrics(report, sizeof(report));
+  Serial.printf("Metrics: %s\n", report);
+  sendStatusText(report);
 }
 
 /* ================= HELPERS ================= */
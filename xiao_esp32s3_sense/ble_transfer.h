@@ -7,21 +7,67 @@
 #include <BLEUtils.h>
 #include <BLE2902.h>
 #include "esp_camera.h"
+#include "psram_arena.h"
+#include "wire_format.h"
+#include "audio_config.h"
 
 // BLE Service and Characteristic UUIDs
 #define SERVICE_UUID        "4fafc201-1fb5-459e-8fcc-c5c9c331914b"
 #define CAMERA_CHARACTERISTIC_UUID    "beb5483e-36e1-4688-b7f5-ea07361b26a8"
 #define AUDIO_CHARACTERISTIC_UUID     "d2b5483e-36e1-4688-b7f5-ea07361b26aa"
 
+// Second header byte tells the phone what the image is
+#define IMAGE_KIND_FULL     WIRE_IMAGE_KIND_FULL
+#define IMAGE_KIND_PREVIEW  WIRE_IMAGE_KIND_PREVIEW
+#define IMAGE_KIND_DUPLICATE WIRE_IMAGE_KIND_DUPLICATE   // header only: same content as `hash`
+#define IMAGE_KIND_SHEET    WIRE_IMAGE_KIND_SHEET        // thumb_sheet.h layout
+
+// Header flags
+#define IMAGE_FLAG_SEALED   WIRE_IMAGE_FLAG_SEALED   // object is a capture_crypto.h sealed blob
+#define AUDIO_FLAG_SEALED   WIRE_AUDIO_FLAG_SEALED
+
 // Function declarations
 extern volatile bool cameraCommandPending;
+extern volatile int64_t cameraCommandUs;
+extern volatile bool metricsCommandPending;
+extern volatile bool audioStartPending;
+extern volatile bool audioStopPending;
+extern volatile bool liveAudioPending;
+extern volatile bool liveAudioOn;
+extern volatile bool audioConfigPending;
+extern AudioConfig pendingAudioConfig;
+extern volatile bool bootCommandPending;
+extern volatile bool tasksCommandPending;
+extern volatile bool videoStartPending;
+extern volatile bool videoStopPending;
+extern volatile uint16_t videoSeconds;
+extern volatile uint8_t videoFps;
+extern volatile bool videoWithAudio;
+extern volatile bool queryPending;
+extern volatile uint32_t queryFrom;
+extern volatile uint32_t queryTo;
+extern volatile uint32_t querySkip;
+extern volatile bool fetchPending;
+extern volatile uint64_t fetchHash;
+extern volatile uint32_t fetchLen;
+extern volatile bool thumbsPending;
+extern volatile uint32_t thumbsFrom;
+extern volatile uint16_t thumbsCount;
+extern volatile uint32_t captureBudgetMs;
+extern volatile bool capturePreviewEnabled;
 
-void startImageSend(camera_fb_t *fb);
-void processImageSend();
+void startImageSend(uint8_t *buf, size_t len, ArenaScope scope,
+                    uint8_t kind = IMAGE_KIND_FULL, uint64_t hash = 0,
+                    uint32_t crc = 0, uint8_t flags = 0);
+void sendImageReference(size_t len, uint64_t hash);
+bool processTransmit();
+void sendStatusText(const char *text);
+void sendMetricsViaBLE();
 
 void initBLE();
 void sendImageViaBLE(camera_fb_t *fb);
-void sendAudioViaBLE(uint8_t* data, size_t length);
+void sendAudioViaBLE(uint8_t* data, size_t length, ArenaScope scope,
+                     uint8_t flags = 0);
 bool isDeviceConnected();
 
 #endif 
\ No newline at end of file
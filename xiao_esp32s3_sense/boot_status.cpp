@@ -0,0 +1,143 @@
+#include "boot_status.h"
+#include <stdio.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "metrics.h"
+static portMUX_TYPE bootLock = portMUX_INITIALIZER_UNLOCKED;
+#define BOOT_LOCK()   portENTER_CRITICAL(&bootLock)
+#define BOOT_UNLOCK() portEXIT_CRITICAL(&bootLock)
+#else
+#define BOOT_LOCK()
+#define BOOT_UNLOCK()
+#endif
+
+struct BootEntry {
+  const char *name;
+  const char *metric;     // literal, for the metrics table
+  BootState state;
+  uint32_t startMs;
+  uint32_t doneMs;
+};
+
+static BootEntry entries[BOOT_SUBSYSTEM_COUNT] = {
+  { "arena",  "boot.arena_ms",  BOOT_PENDING, 0, 0 },
+  { "ble",    "boot.ble_ms",    BOOT_PENDING, 0, 0 },
+  { "camera", "boot.camera_ms", BOOT_PENDING, 0, 0 },
+  { "audio",  "boot.audio_ms",  BOOT_PENDING, 0, 0 },
+  { "sd",     "boot.sd_ms",     BOOT_PENDING, 0, 0 },
+};
+
+void bootMark(BootSubsystem s, BootState state, uint32_t nowMs) {
+  BOOT_LOCK();
+  BootEntry &e = entries[s];
+  if (state == BOOT_RUNNING)
+    e.startMs = nowMs;
+  else if (state >= BOOT_READY)
+    e.doneMs = nowMs;
+  e.state = state;
+  BOOT_UNLOCK();
+}
+
+BootState bootState(BootSubsystem s) {
+  BOOT_LOCK();
+  BootState state = entries[s].state;
+  BOOT_UNLOCK();
+  return state;
+}
+
+bool bootReady(BootSubsystem s) {
+  return bootState(s) == BOOT_READY;
+}
+
+bool bootSettled(BootSubsystem s) {
+  return bootState(s) >= BOOT_READY;
+}
+
+bool bootAllSettled() {
+  for (int i = 0; i < BOOT_SUBSYSTEM_COUNT; i++) {
+    if (!bootSettled((BootSubsystem)i))
+      return false;
+  }
+  return true;
+}
+
+// "BOOT:arena=ok@12+40,ble=ok@52+180,camera=fail@232+95,sd=..."
+// (state @ start ms since boot + duration ms)
+size_t formatBootReport(char *out, size_t cap) {
+  static const char *const stateNames[] = { "pending", "running", "ok", "fail" };
+  BootEntry copy[BOOT_SUBSYSTEM_COUNT];
+  BOOT_LOCK();
+  for (int i = 0; i < BOOT_SUBSYSTEM_COUNT; i++)
+    copy[i] = entries[i];
+  BOOT_UNLOCK();
+
+  size_t at = snprintf(out, cap, "BOOT:");
+  for (int i = 0; i < BOOT_SUBSYSTEM_COUNT && at < cap; i++) {
+    const BootEntry &e = copy[i];
+    uint32_t took = e.state >= BOOT_READY ? e.doneMs - e.startMs : 0;
+    at += snprintf(out + at, cap - at, "%s%s=%s@%lu+%lu", i ? "," : "",
+                   e.name, stateNames[e.state],
+                   (unsigned long)e.startMs, (unsigned long)took);
+  }
+  return at < cap ? at : cap - 1;
+}
+
+#ifdef ARDUINO
+
+// Runs one init step in the calling task and records how it went
+bool bootRun(BootSubsystem s, bool (*init)()) {
+  bootMark(s, BOOT_RUNNING, millis());
+  bool ok = init();
+  bootMark(s, ok ? BOOT_READY : BOOT_FAILED, millis());
+  Serial.printf("Boot: %s %s (%lu ms)\n", entries[s].name, ok ? "ready" : "FAILED",
+                (unsigned long)(entries[s].doneMs - entries[s].startMs));
+  return ok;
+}
+
+struct BootJob {
+  BootSubsystem subsystem;
+  bool (*init)();
+  TaskId task;
+};
+
+static BootJob jobs[BOOT_SUBSYSTEM_COUNT];
+
+static void bootTask(void *param) {
+  BootJob *job = (BootJob *)param;
+  bootRun(job->subsystem, job->init);
+  taskExit(job->task);
+}
+
+// Starts an init step in its own task; bootSettled() tells when it is done
+void bootRunAsync(BootSubsystem s, bool (*init)(), TaskId task) {
+  jobs[s] = { s, init, task };
+  bootMark(s, BOOT_RUNNING, millis());
+  if (!taskStart(task, bootTask, &jobs[s])) {
+    bootMark(s, BOOT_FAILED, millis());
+    Serial.printf("Boot: no task for %s\n", entries[s].name);
+  }
+}
+
+// A subsystem that cannot start because one it depends on failed
+void bootSkip(BootSubsystem s) {
+  uint32_t now = millis();
+  bootMark(s, BOOT_RUNNING, now);
+  bootMark(s, BOOT_FAILED, now);
+}
+
+void bootPublishMetrics() {
+  for (int i = 0; i < BOOT_SUBSYSTEM_COUNT; i++) {
+    BootEntry e;
+    BOOT_LOCK();
+    e = entries[i];
+    BOOT_UNLOCK();
+    if (e.state == BOOT_READY)
+      metricSet(e.metric, e.doneMs - e.startMs);
+  }
+  // Time from reset until the phone can find us
+  if (bootReady(BOOT_BLE))
+    metricSet("boot.advertise_ms", entries[BOOT_BLE].doneMs);
+}
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef BOOT_STATUS_H
+#define BOOT_STATUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "task_topology.h"
+
+// Per-subsystem boot state and timing. BLE comes up first; the
+// peripherals then initialize concurrently in their own tasks and the
+// device runs with whichever of them succeeded.
+
+enum BootSubsystem {
+  BOOT_ARENA = 0,
+  BOOT_BLE,
+  BOOT_CAMERA,
+  BOOT_AUDIO,
+  BOOT_SD,
+  BOOT_SUBSYSTEM_COUNT
+};
+
+enum BootState {
+  BOOT_PENDING = 0,
+  BOOT_RUNNING,
+  BOOT_READY,       // settled states from here on
+  BOOT_FAILED
+};
+
+// Function declarations
+void bootMark(BootSubsystem s, BootState state, uint32_t nowMs);
+BootState bootState(BootSubsystem s);
+bool bootReady(BootSubsystem s);
+bool bootSettled(BootSubsystem s);
+bool bootAllSettled();
+size_t formatBootReport(char *out, size_t cap);
+
+#ifdef ARDUINO
+bool bootRun(BootSubsystem s, bool (*init)());
+void bootRunAsync(BootSubsystem s, bool (*init)(), TaskId task);
+void bootSkip(BootSubsystem s);
+void bootPublishMetrics();
+#endif
+
+#endif
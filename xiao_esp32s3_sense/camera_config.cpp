@@ -1,8 +1,14 @@
 #include "camera_config.h"
 #include <Arduino.h>
+#include "power_manager.h"
 
 camera_config_t config;
 
+static const framesize_t resFrameSize[RES_COUNT] = {
+  FRAMESIZE_QVGA, FRAMESIZE_VGA, FRAMESIZE_SVGA,
+  FRAMESIZE_XGA, FRAMESIZE_SXGA, FRAMESIZE_UXGA,
+};
+
 bool initCamera() {
   config.ledc_channel = LEDC_CHANNEL_0;
   config.ledc_timer = LEDC_TIMER_0;
@@ -46,6 +52,8 @@ bool initCamera() {
     Serial.printf("Camera init failed with error 0x%x", err);
     return false;
   }
+  // Streaming from here until camera_power puts the sensor in standby
+  powerAcquire(POWER_CAMERA);
   return true;
 }
 
@@ -55,4 +63,29 @@ camera_fb_t* capturePhoto() {
     Serial.println("Camera capture failed");
   }
   return fb;
-} 
\ No newline at end of file
+}
+
+// Reconfigures the sensor for the next shot. After a change the driver
+// may still hold a frame in the old mode, so one frame is discarded.
+bool applyCaptureSettings(const CaptureSettings &settings) {
+  sensor_t *s = esp_camera_sensor_get();
+  if (!s) {
+    return false;
+  }
+
+  framesize_t size = resFrameSize[settings.res];
+  if (s->status.framesize == size && s->status.quality == settings.quality) {
+    return true;
+  }
+
+  if (s->set_framesize(s, size) != 0 || s->set_quality(s, settings.quality) != 0) {
+    Serial.println("Camera settings change failed");
+    return false;
+  }
+
+  camera_fb_t *stale = esp_camera_fb_get();
+  if (stale) {
+    esp_camera_fb_return(stale);
+  }
+  return true;
+}
@@ -2,6 +2,7 @@
 #define CAMERA_CONFIG_H
 
 #include "esp_camera.h"
+#include "rate_control.h"
 
 // Camera pins configuration
 #define CAMERA_MODEL_XIAO_ESP32S3
@@ -30,5 +31,6 @@ extern camera_config_t config;
 // Function declarations
 bool initCamera();
 camera_fb_t* capturePhoto();
+bool applyCaptureSettings(const CaptureSettings &settings);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "camera_power.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "esp_timer.h"
+#include "sensor.h"
+#include "camera_config.h"
+#include "metrics.h"
+#include "power_manager.h"
+#endif
+
+void settleBegin(SettleTracker *t) {
+  t->lastLen = 0;
+  t->frames = 0;
+  t->stableRun = 0;
+}
+
+// Feeds one discarded frame's size; true once the exposure looks settled
+// (or after CAM_SETTLE_MAX_FRAMES, so a flickering scene cannot stall a
+// capture)
+bool settleObserve(SettleTracker *t, uint32_t jpegLen) {
+  t->frames++;
+  if (t->lastLen > 0) {
+    uint32_t diff = jpegLen > t->lastLen ? jpegLen - t->lastLen : t->lastLen - jpegLen;
+    if ((uint64_t)diff * 1000 <= (uint64_t)t->lastLen * CAM_SETTLE_TOLERANCE_PERMILLE)
+      t->stableRun++;
+    else
+      t->stableRun = 0;
+  }
+  t->lastLen = jpegLen;
+
+  return (t->frames >= CAM_SETTLE_MIN_FRAMES && t->stableRun >= CAM_SETTLE_STABLE_FRAMES) ||
+         t->frames >= CAM_SETTLE_MAX_FRAMES;
+}
+
+#ifdef ARDUINO
+
+static CameraPowerState powerState = CAM_POWER_STREAMING;
+static uint32_t lastActiveMs = 0;
+static volatile bool alwaysOn = false;
+static bool standbyUnsupported = false;
+
+// Software standby through the sensor's own register; the XIAO wires no
+// PWDN pin
+static bool sensorStandby(bool on) {
+  sensor_t *s = esp_camera_sensor_get();
+  if (!s) {
+    return false;
+  }
+  switch (s->id.PID) {
+    case OV2640_PID:
+      return s->set_reg(s, 0x109, 0x10, on ? 0x10 : 0) == 0;   // COM2 bit 4 (sensor bank)
+    case OV3660_PID:
+    case OV5640_PID:
+      return s->set_reg(s, 0x3008, 0x40, on ? 0x40 : 0) == 0;  // SYSTEM_CTROL0 power down
+    default:
+      return false;
+  }
+}
+
+// Starts the driver over when the sensor will not leave standby: a
+// brown-out or a missed SCCB write can leave it powered down or with
+// its registers lost, which no register write brings back
+static bool cameraReinit() {
+  esp_camera_deinit();
+  if (!initCamera()) {
+    return false;
+  }
+  // initCamera() takes the streaming lock, which the wake already holds
+  powerRelease(POWER_CAMERA);
+  return true;
+}
+
+static int64_t frameTimeUs(const camera_fb_t *fb) {
+  return (int64_t)fb->timestamp.tv_sec * 1000000 + fb->timestamp.tv_usec;
+}
+
+// Brings the sensor out of standby, reinitializing the camera if it
+// does not answer, and drops frames until it has settled. Returns false
+// if the camera cannot be brought back or no frames arrive.
+bool cameraWake() {
+  lastActiveMs = millis();
+  if (powerState == CAM_POWER_STREAMING) {
+    return true;
+  }
+
+  uint32_t t0 = millis();
+  powerAcquire(POWER_CAMERA);
+  if (!sensorStandby(false)) {
+    metricAdd("camera.wake_failures", 1);
+    Serial.println("Camera: standby exit failed, reinitializing");
+    if (!cameraReinit()) {
+      powerRelease(POWER_CAMERA);
+      Serial.println("Camera: reinit failed, still in standby");
+      return false;
+    }
+    metricAdd("camera.reinits", 1);
+  }
+  powerState = CAM_POWER_STREAMING;
+
+  SettleTracker settle;
+  settleBegin(&settle);
+  bool gotFrame = false;
+  while (true) {
+    camera_fb_t *fb = esp_camera_fb_get();
+    if (!fb) {
+      break;
+    }
+    gotFrame = true;
+    bool settled = settleObserve(&settle, fb->len);
+    esp_camera_fb_return(fb);
+    if (settled) {
+      break;
+    }
+  }
+
+  metricSet("camera.wake_ms", millis() - t0);
+  metricSet("camera.settle_frames", settle.frames);
+  Serial.printf("Camera awake in %lu ms (%u frames dropped)\n",
+                (unsigned long)(millis() - t0), settle.frames);
+  return gotFrame;
+}
+
+// A frame whose exposure started at or after notBeforeUs (esp_timer
+// time); older frames still queued in the driver are dropped
+camera_fb_t* captureFreshPhoto(int64_t notBeforeUs) {
+  lastActiveMs = millis();
+  camera_fb_t *fb = nullptr;
+  for (int i = 0; i < CAM_FRESH_MAX_TRIES; i++) {
+    fb = esp_camera_fb_get();
+    if (!fb || frameTimeUs(fb) >= notBeforeUs) {
+      break;
+    }
+    esp_camera_fb_return(fb);
+    fb = nullptr;
+    metricAdd("camera.stale_dropped", 1);
+  }
+  if (!fb) {
+    Serial.println("Camera capture failed");
+    return nullptr;
+  }
+
+  int64_t latencyUs = frameTimeUs(fb) - notBeforeUs;
+  metricSet("camera.shutter_ms", latencyUs > 0 ? (uint32_t)(latencyUs / 1000) : 0);
+  return fb;
+}
+
+// From loop(): idle cameras go to standby, and come back when asked to
+// stay on
+void cameraPowerService(uint32_t nowMs) {
+  if (alwaysOn && powerState == CAM_POWER_STANDBY) {
+    cameraWake();
+    return;
+  }
+  if (alwaysOn || standbyUnsupported || powerState != CAM_POWER_STREAMING ||
+      nowMs - lastActiveMs < CAM_STANDBY_AFTER_MS) {
+    return;
+  }
+  if (!sensorStandby(true)) {
+    standbyUnsupported = true;
+    Serial.println("Camera: sensor has no standby, staying on");
+    return;
+  }
+  powerState = CAM_POWER_STANDBY;
+  powerRelease(POWER_CAMERA);
+  metricAdd("camera.standby_entries", 1);
+}
+
+// Always on trades power for the shortest shutter latency. Safe to call
+// from the BLE callbacks; the wake itself happens in cameraPowerService().
+void setCameraAlwaysOn(bool on) {
+  alwaysOn = on;
+}
+
+CameraPowerState cameraPowerState() {
+  return powerState;
+}
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef CAMERA_POWER_H
+#define CAMERA_POWER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Camera power states. Between captures the sensor drops into its
+// software standby (registers kept, no frames, no DMA). A command wakes
+// it and frames are discarded until exposure and white balance have
+// settled, judged by the JPEG size holding steady from frame to frame.
+// The shot itself is always a frame started after the command arrived,
+// never one left in the driver's buffers.
+
+#define CAM_STANDBY_AFTER_MS           10000
+#define CAM_SETTLE_MIN_FRAMES          2
+#define CAM_SETTLE_MAX_FRAMES          12
+#define CAM_SETTLE_STABLE_FRAMES       2       // similar sizes in a row
+#define CAM_SETTLE_TOLERANCE_PERMILLE  60
+#define CAM_FRESH_MAX_TRIES            4
+
+enum CameraPowerState {
+  CAM_POWER_STREAMING = 0,
+  CAM_POWER_STANDBY
+};
+
+struct SettleTracker {
+  uint32_t lastLen;
+  uint8_t frames;
+  uint8_t stableRun;
+};
+
+// Function declarations
+void settleBegin(SettleTracker *t);
+bool settleObserve(SettleTracker *t, uint32_t jpegLen);
+
+#ifdef ARDUINO
+#include "esp_camera.h"
+
+bool cameraWake();
+camera_fb_t* captureFreshPhoto(int64_t notBeforeUs);
+void cameraPowerService(uint32_t nowMs);
+void setCameraAlwaysOn(bool on);
+CameraPowerState cameraPowerState();
+#endif
+
+#endif
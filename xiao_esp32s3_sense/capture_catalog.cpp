@@ -0,0 +1,470 @@
+#include "capture_catalog.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <sys/time.h>
+#include "metrics.h"
+#endif
+
+static const uint8_t catalogMagic[4] = { 'C', 'C', 'A', 'T' };
+
+static void put32(uint8_t *p, uint32_t v) {
+  p[0] = v & 0xFF;
+  p[1] = (v >> 8) & 0xFF;
+  p[2] = (v >> 16) & 0xFF;
+  p[3] = v >> 24;
+}
+
+static uint32_t get32(const uint8_t *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static void encode(const CatalogEntry &e, uint8_t *rec) {
+  put32(rec, e.id);
+  put32(rec + 4, e.time);
+  put32(rec + 8, e.size);
+  rec[12] = e.type;
+  rec[13] = e.flags;
+  rec[14] = 0;
+  rec[15] = 0;
+}
+
+static void decode(const uint8_t *rec, CatalogEntry *e) {
+  e->id = get32(rec);
+  e->time = get32(rec + 4);
+  e->size = get32(rec + 8);
+  e->type = rec[12];
+  e->flags = rec[13];
+}
+
+static uint32_t offsetOf(uint32_t index) {
+  return CATALOG_HEADER_SIZE + index * CATALOG_RECORD_SIZE;
+}
+
+static bool readRecord(Catalog *c, uint32_t index, CatalogEntry *e) {
+  uint8_t rec[CATALOG_RECORD_SIZE];
+  if (!c->store.read(c->store.ctx, offsetOf(index), rec, sizeof(rec))) {
+    return false;
+  }
+  decode(rec, e);
+  return true;
+}
+
+static bool writeRecord(Catalog *c, uint32_t index, const CatalogEntry &e) {
+  uint8_t rec[CATALOG_RECORD_SIZE];
+  encode(e, rec);
+  return c->store.write(c->store.ctx, offsetOf(index), rec, sizeof(rec));
+}
+
+// A new file gets its header; an existing one is checked and its last
+// record recovers the next ID and the latest time. firstId numbers the
+// first capture of an empty catalog.
+bool catalogOpen(Catalog *c, const CatalogStore &store, uint32_t fileSize, uint32_t firstId) {
+  memset(c, 0, sizeof(*c));
+  c->store = store;
+  c->firstId = firstId;
+  c->nextId = firstId;
+
+  uint8_t header[CATALOG_HEADER_SIZE];
+  if (fileSize < CATALOG_HEADER_SIZE) {
+    memset(header, 0, sizeof(header));
+    memcpy(header, catalogMagic, 4);
+    put32(header + 4, CATALOG_VERSION);
+    put32(header + 8, CATALOG_RECORD_SIZE);
+    return store.write(store.ctx, 0, header, sizeof(header));
+  }
+
+  if (!store.read(store.ctx, 0, header, sizeof(header)) ||
+      memcmp(header, catalogMagic, 4) != 0 ||
+      get32(header + 4) != CATALOG_VERSION ||
+      get32(header + 8) != CATALOG_RECORD_SIZE) {
+    return false;
+  }
+
+  c->count = (fileSize - CATALOG_HEADER_SIZE) / CATALOG_RECORD_SIZE;
+  if (c->count > 0) {
+    CatalogEntry first, last;
+    if (!readRecord(c, 0, &first) || !readRecord(c, c->count - 1, &last) ||
+        last.id < first.id) {
+      return false;
+    }
+    c->firstId = first.id;
+    c->nextId = last.id + 1;
+    c->lastTime = last.time;
+  }
+  return true;
+}
+
+// Takes the next ID and appends its record, pending until updated. Times
+// never go backwards: a clock set back, or not set at all, repeats the
+// latest time. out->id is valid even when the write fails, so the
+// capture can still be named; the ID is then missing from the file.
+bool catalogAppend(Catalog *c, uint8_t type, uint32_t now, CatalogEntry *out) {
+  out->id = c->nextId++;
+  out->size = 0;
+  out->type = type;
+  out->flags = CATALOG_FLAG_PENDING;
+  if (now >= CATALOG_TIME_VALID) {
+    out->time = now > c->lastTime ? now : c->lastTime;
+  } else {
+    out->time = c->lastTime;
+    out->flags |= CATALOG_FLAG_ESTIMATED;
+  }
+
+  if (!writeRecord(c, c->count, *out)) {
+    return false;
+  }
+  c->count++;
+  c->lastTime = out->time;
+  return true;
+}
+
+// Index of the record with this ID. IDs ascend through the file with an
+// occasional gap, so a record sits no later than if there were no gaps
+// before it and no earlier than if there were none after it: the search
+// covers only the gaps, and each end is tried first (the newest captures,
+// which catalogFinishCapture() asks for, and a file with no gaps)
+static bool findId(Catalog *c, uint32_t id, uint32_t *index) {
+  if (id < c->firstId || id >= c->nextId || c->count == 0) {
+    return false;
+  }
+  uint32_t after = c->nextId - id;    // at least the records from id on
+  uint32_t lo = after < c->count ? c->count - after : 0;
+  uint32_t hi = id - c->firstId < c->count ? id - c->firstId + 1 : c->count;
+  if (lo >= hi) {
+    return false;
+  }
+
+  CatalogEntry e;
+  const uint32_t ends[2] = { lo, hi - 1 };
+  for (uint32_t guess : ends) {
+    if (!readRecord(c, guess, &e)) {
+      return false;
+    }
+    if (e.id == id) {
+      *index = guess;
+      return true;
+    }
+  }
+
+  lo++;
+  hi--;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    if (!readRecord(c, mid, &e)) {
+      return false;
+    }
+    if (e.id == id) {
+      *index = mid;
+      return true;
+    }
+    if (e.id < id) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return false;
+}
+
+bool catalogGet(Catalog *c, uint32_t id, CatalogEntry *out) {
+  uint32_t index;
+  return findId(c, id, &index) && readRecord(c, index, out);
+}
+
+// Rewrites size and flags; the ID and time stay where they were filed
+bool catalogUpdate(Catalog *c, const CatalogEntry &e) {
+  uint32_t index;
+  CatalogEntry filed;
+  if (!findId(c, e.id, &index) || !readRecord(c, index, &filed)) {
+    return false;
+  }
+  filed.size = e.size;
+  filed.flags = e.flags;
+  return writeRecord(c, index, filed);
+}
+
+// Index of the first record at or after `time`; count if there is none
+uint32_t catalogLowerBound(Catalog *c, uint32_t time) {
+  uint32_t lo = 0, hi = c->count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    uint8_t t[4];
+    if (!c->store.read(c->store.ctx, offsetOf(mid) + 4, t, sizeof(t))) {
+      return c->count;
+    }
+    if (get32(t) < time) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// Index of the first record with an ID at or after `id`
+uint32_t catalogLowerBoundId(Catalog *c, uint32_t id) {
+  uint32_t lo = 0, hi = c->count;
+  while (lo < hi) {
+    uint32_t mid = lo + (hi - lo) / 2;
+    uint8_t v[4];
+    if (!c->store.read(c->store.ctx, offsetOf(mid), v, sizeof(v))) {
+      return c->count;
+    }
+    if (get32(v) < id) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// Up to max consecutive records from index, one store read per page
+size_t catalogRead(Catalog *c, uint32_t index, CatalogEntry *out, size_t max) {
+  uint8_t page[CATALOG_QUERY_MAX * CATALOG_RECORD_SIZE];
+  size_t got = 0;
+  while (got < max && index + got < c->count) {
+    size_t n = max - got;
+    if (n > CATALOG_QUERY_MAX) {
+      n = CATALOG_QUERY_MAX;
+    }
+    if (n > c->count - index - got) {
+      n = c->count - index - got;
+    }
+    if (!c->store.read(c->store.ctx, offsetOf(index + got), page, n * CATALOG_RECORD_SIZE)) {
+      break;
+    }
+    for (size_t i = 0; i < n; i++) {
+      decode(page + i * CATALOG_RECORD_SIZE, &out[got + i]);
+    }
+    got += n;
+  }
+  return got;
+}
+
+/* ===== File names ===== */
+
+// Named by ID alone: unique on the card whether or not the clock is set
+void capturePath(char *out, size_t cap, uint32_t id, uint8_t type) {
+  const char *format = type == CAPTURE_PHOTO ? "/photo_%06lu.jpg" :
+                       type == CAPTURE_AUDIO ? "/audio_%06lu.wav" : "/clip_%06lu.avi";
+  snprintf(out, cap, format, (unsigned long)id);
+}
+
+// Thumbnail stored next to a photo
+void captureThumbPath(char *out, size_t cap, uint32_t id) {
+  snprintf(out, cap, "/photo_%06lu.thm", (unsigned long)id);
+}
+
+// The ID in a capture file's name (any of the above, or the .ref of a
+// duplicate), with or without its directory; 0 for any other file
+uint32_t captureIdOf(const char *name) {
+  const char *slash = strrchr(name, '/');
+  if (slash) {
+    name = slash + 1;
+  }
+  static const char *const prefixes[] = { "photo_", "audio_", "clip_" };
+  const char *digits = nullptr;
+  for (const char *prefix : prefixes) {
+    size_t n = strlen(prefix);
+    if (strncmp(name, prefix, n) == 0) {
+      digits = name + n;
+    }
+  }
+  if (!digits || *digits < '0' || *digits > '9') {
+    return 0;
+  }
+  uint64_t id = 0;
+  for (; *digits >= '0' && *digits <= '9'; digits++) {
+    id = id * 10 + (*digits - '0');
+    if (id > UINT32_MAX) {
+      return 0;
+    }
+  }
+  return *digits == '.' ? (uint32_t)id : 0;
+}
+
+#ifdef ARDUINO
+
+/* ===== On the SD card ===== */
+
+static Catalog catalog;
+static File catalogFile;
+static volatile bool catalogReady = false;
+static SemaphoreHandle_t catalogLock = NULL;
+
+// IDs handed out with no catalog. Without a card nothing on it is named
+// with them; with a card whose catalog failed, catalogMount() starts
+// them after the highest ID among its files.
+static portMUX_TYPE spareLock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t spareId = 1;
+
+static bool fileRead(void *ctx, uint32_t offset, uint8_t *buf, size_t len) {
+  File *f = (File *)ctx;
+  return f->seek(offset) && f->read(buf, len) == len;
+}
+
+static bool fileWrite(void *ctx, uint32_t offset, const uint8_t *buf, size_t len) {
+  File *f = (File *)ctx;
+  if (!f->seek(offset) || f->write(buf, len) != len) {
+    return false;
+  }
+  f->flush();
+  return true;
+}
+
+// One past the highest capture ID among the files in the card's root; 0
+// if the root cannot be listed
+static uint32_t firstFreeId(fs::FS &fs) {
+  File root = fs.open("/");
+  if (!root || !root.isDirectory()) {
+    return 0;
+  }
+  uint32_t highest = 0;
+  for (File f = root.openNextFile(); f; f = root.openNextFile()) {
+    uint32_t id = captureIdOf(f.name());
+    if (id > highest) {
+      highest = id;
+    }
+  }
+  return highest + 1;
+}
+
+// Opened for update ("r+") so records can be patched in place. A file
+// that does not parse is kept aside and a new one started. A catalog with
+// no records yet (new, deleted, or set aside) numbers on from the files
+// already on the card rather than from 1, and so does a card with no
+// usable catalog at all, un-indexed. False if the card cannot be listed
+// either: no ID is then known not to overwrite a capture, and the card
+// must not be written.
+bool catalogMount(fs::FS &fs) {
+  if (!catalogLock) {
+    catalogLock = xSemaphoreCreateMutex();
+  }
+  if (!fs.exists(CATALOG_PATH)) {
+    File created = fs.open(CATALOG_PATH, FILE_WRITE);
+    created.close();
+  }
+  catalogFile = fs.open(CATALOG_PATH, "r+");
+  CatalogStore store = { &catalogFile, fileRead, fileWrite };
+  uint32_t fileSize = catalogFile ? catalogFile.size() : 0;
+  uint32_t firstId = fileSize < CATALOG_HEADER_SIZE + CATALOG_RECORD_SIZE ? firstFreeId(fs) : 1;
+  bool ok = catalogFile && firstId && catalogOpen(&catalog, store, fileSize, firstId);
+
+  if (catalogFile && firstId && !ok) {
+    Serial.println("Catalog unreadable, starting a new one");
+    catalogFile.close();
+    fs.remove("/catalog.bad");
+    fs.rename(CATALOG_PATH, "/catalog.bad");
+    catalogFile = fs.open(CATALOG_PATH, "w+");
+    firstId = firstFreeId(fs);
+    ok = catalogFile && firstId && catalogOpen(&catalog, store, 0, firstId);
+  }
+  if (!ok) {
+    // Every way here has scanned the card for firstId
+    if (!firstId) {
+      Serial.println("Catalog unavailable and card cannot be listed");
+      return false;
+    }
+    portENTER_CRITICAL(&spareLock);
+    spareId = firstId;
+    portEXIT_CRITICAL(&spareLock);
+    Serial.printf("Catalog unavailable, captures not indexed from ID %lu\n",
+                  (unsigned long)firstId);
+    return true;
+  }
+
+  metricSet("catalog.entries", catalog.count);
+  Serial.printf("Catalog: %lu captures, next ID %lu\n",
+                (unsigned long)catalog.count, (unsigned long)catalog.nextId);
+  catalogReady = true;
+  return true;
+}
+
+// Called when a capture is about to be stored; its ID names the file
+uint32_t catalogBeginCapture(uint8_t type) {
+  if (!catalogReady) {
+    portENTER_CRITICAL(&spareLock);
+    uint32_t id = spareId++;
+    portEXIT_CRITICAL(&spareLock);
+    return id;
+  }
+
+  CatalogEntry e;
+  xSemaphoreTake(catalogLock, portMAX_DELAY);
+  if (catalogAppend(&catalog, type, (uint32_t)time(nullptr), &e)) {
+    metricSet("catalog.entries", catalog.count);
+  } else {
+    Serial.println("Catalog append failed");
+  }
+  xSemaphoreGive(catalogLock);
+  return e.id;
+}
+
+// Size 0: the capture was not stored after all
+void catalogFinishCapture(uint32_t id, uint32_t size, uint8_t flags) {
+  if (!catalogReady) {
+    return;
+  }
+  xSemaphoreTake(catalogLock, portMAX_DELAY);
+  CatalogEntry e;
+  if (catalogGet(&catalog, id, &e)) {
+    e.size = size;
+    e.flags = (e.flags & CATALOG_FLAG_ESTIMATED) | flags |
+              (size == 0 ? CATALOG_FLAG_PENDING : 0);
+    catalogUpdate(&catalog, e);
+  }
+  xSemaphoreGive(catalogLock);
+}
+
+// From the phone (TIME:<unix seconds>); until then the clock counts from
+// boot and captures are filed under the latest known time
+void catalogSetTime(uint32_t unixSeconds) {
+  struct timeval tv = { (time_t)unixSeconds, 0 };
+  settimeofday(&tv, NULL);
+}
+
+bool catalogTimeSynced() {
+  return (uint32_t)time(nullptr) >= CATALOG_TIME_VALID;
+}
+
+// Captures filed in [from, to], skipping the first `skip` of them;
+// *total counts the whole range
+size_t catalogQuery(uint32_t from, uint32_t to, uint32_t skip,
+                    CatalogEntry *out, size_t max, uint32_t *total) {
+  *total = 0;
+  if (!catalogReady || from > to) {
+    return 0;
+  }
+
+  uint32_t t0 = micros();
+  xSemaphoreTake(catalogLock, portMAX_DELAY);
+  uint32_t first = catalogLowerBound(&catalog, from);
+  uint32_t end = to == UINT32_MAX ? catalog.count : catalogLowerBound(&catalog, to + 1);
+  size_t n = 0;
+  if (end > first) {
+    *total = end - first;
+    if (skip < *total) {
+      n = catalogRead(&catalog, first + skip, out, min((size_t)(*total - skip), max));
+    }
+  }
+  xSemaphoreGive(catalogLock);
+  metricMax("catalog.query_us", micros() - t0);
+  return n;
+}
+
+// Records with an ID at or after fromId, in ID order
+size_t catalogList(uint32_t fromId, CatalogEntry *out, size_t max) {
+  if (!catalogReady) {
+    return 0;
+  }
+  xSemaphoreTake(catalogLock, portMAX_DELAY);
+  size_t n = catalogRead(&catalog, catalogLowerBoundId(&catalog, fromId), out, max);
+  xSemaphoreGive(catalogLock);
+  return n;
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef CAPTURE_CATALOG_H
+#define CAPTURE_CATALOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "wire_format.h"
+
+// Persistent index of every capture on the card, one fixed-size record
+// per capture ID in a single append-only file. IDs are handed out in
+// order and a record is appended the moment its ID is, so the file is
+// sorted by ID (record i holds firstId + i) and, because times are
+// clamped never to run backwards, by time as well: a time range is two
+// binary searches over the file. Captures that take a while (video)
+// append a pending record first and patch its size at the end.
+//
+// File: 16-byte header ("CCAT", version, record size), then records of
+//   id u32le | time u32le | size u32le | type u8 | flags u8 | 0 u16
+// A torn record at the end is ignored and overwritten.
+
+#define CATALOG_PATH          "/catalog.idx"
+#define CATALOG_HEADER_SIZE   16
+#define CATALOG_RECORD_SIZE   16
+#define CATALOG_VERSION       1
+#define CATALOG_TIME_VALID    1600000000UL   // earlier clock readings are not wall time
+#define CATALOG_QUERY_MAX     32             // records per QUERY reply page
+
+#define CAPTURE_PHOTO           WIRE_CAPTURE_PHOTO
+#define CAPTURE_AUDIO           WIRE_CAPTURE_AUDIO
+#define CAPTURE_VIDEO           WIRE_CAPTURE_VIDEO
+
+#define CATALOG_FLAG_PENDING    WIRE_CATALOG_FLAG_PENDING     // not finished (yet)
+#define CATALOG_FLAG_ESTIMATED  WIRE_CATALOG_FLAG_ESTIMATED   // clock unset: previous capture's time
+#define CATALOG_FLAG_DUPLICATE  WIRE_CATALOG_FLAG_DUPLICATE   // stored as a .ref to an earlier capture
+#define CATALOG_FLAG_SEALED     WIRE_CATALOG_FLAG_SEALED      // files sealed by capture_crypto
+
+struct CatalogEntry {
+  uint32_t id;
+  uint32_t time;     // Unix seconds
+  uint32_t size;     // bytes on the card
+  uint8_t type;
+  uint8_t flags;
+};
+
+// Random-access file underneath; writes past the end extend it
+struct CatalogStore {
+  void *ctx;
+  bool (*read)(void *ctx, uint32_t offset, uint8_t *buf, size_t len);
+  bool (*write)(void *ctx, uint32_t offset, const uint8_t *buf, size_t len);
+};
+
+struct Catalog {
+  CatalogStore store;
+  uint32_t count;      // whole records in the file
+  uint32_t firstId;
+  uint32_t nextId;
+  uint32_t lastTime;
+};
+
+// Function declarations
+bool catalogOpen(Catalog *c, const CatalogStore &store, uint32_t fileSize, uint32_t firstId);
+bool catalogAppend(Catalog *c, uint8_t type, uint32_t now, CatalogEntry *out);
+bool catalogUpdate(Catalog *c, const CatalogEntry &e);
+bool catalogGet(Catalog *c, uint32_t id, CatalogEntry *out);
+uint32_t catalogLowerBound(Catalog *c, uint32_t time);
+uint32_t catalogLowerBoundId(Catalog *c, uint32_t id);
+size_t catalogRead(Catalog *c, uint32_t index, CatalogEntry *out, size_t max);
+void capturePath(char *out, size_t cap, uint32_t id, uint8_t type);
+void captureThumbPath(char *out, size_t cap, uint32_t id);
+uint32_t captureIdOf(const char *name);
+
+#ifdef ARDUINO
+#include "FS.h"
+
+bool catalogMount(fs::FS &fs);
+uint32_t catalogBeginCapture(uint8_t type);
+void catalogFinishCapture(uint32_t id, uint32_t size, uint8_t flags);
+void catalogSetTime(uint32_t unixSeconds);
+bool catalogTimeSynced();
+size_t catalogQuery(uint32_t from, uint32_t to, uint32_t skip,
+                    CatalogEntry *out, size_t max, uint32_t *total);
+size_t catalogList(uint32_t fromId, CatalogEntry *out, size_t max);
+#endif
+
+#endif
@@ -0,0 +1,581 @@
+#include "capture_crypto.h"
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <Preferences.h>
+#include "esp_random.h"
+#include "metrics.h"
+#endif
+
+#ifdef CAPTURE_CRYPTO_HARDWARE
+#include "mbedtls/md.h"
+#endif
+
+static const uint8_t SEAL_MAGIC[CRYPTO_MAGIC_SIZE] = { 'X', 'S', 'L', '1' };
+static const char HKDF_INFO[] = "xiao-capture-v1";
+
+// memset the compiler may not drop for a buffer that is about to die
+static void wipe(void *p, size_t len) {
+  volatile uint8_t *b = (volatile uint8_t *)p;
+  while (len--)
+    *b++ = 0;
+}
+
+/* ===== HMAC-SHA256 ===== */
+
+#ifdef CAPTURE_CRYPTO_HARDWARE
+
+void cryptoHmacSha256(const uint8_t *key, size_t keyLen,
+                      const uint8_t *msg, size_t msgLen, uint8_t *out) {
+  mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256),
+                  key, keyLen, msg, msgLen, out);
+}
+
+#else
+
+struct Sha256 {
+  uint32_t h[8];
+  uint8_t block[64];
+  uint32_t used;
+  uint64_t total;
+};
+
+static const uint32_t SHA_K[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t ror32(uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+static void shaCompress(Sha256 *s, const uint8_t *p) {
+  uint32_t w[64];
+  for (int i = 0; i < 16; i++)
+    w[i] = ((uint32_t)p[4 * i] << 24) | ((uint32_t)p[4 * i + 1] << 16) |
+           ((uint32_t)p[4 * i + 2] << 8) | p[4 * i + 3];
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = ror32(w[i - 15], 7) ^ ror32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = ror32(w[i - 2], 17) ^ ror32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  uint32_t a = s->h[0], b = s->h[1], c = s->h[2], d = s->h[3];
+  uint32_t e = s->h[4], f = s->h[5], g = s->h[6], h = s->h[7];
+  for (int i = 0; i < 64; i++) {
+    uint32_t t1 = h + (ror32(e, 6) ^ ror32(e, 11) ^ ror32(e, 25)) +
+                  ((e & f) ^ (~e & g)) + SHA_K[i] + w[i];
+    uint32_t t2 = (ror32(a, 2) ^ ror32(a, 13) ^ ror32(a, 22)) +
+                  ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+  s->h[0] += a; s->h[1] += b; s->h[2] += c; s->h[3] += d;
+  s->h[4] += e; s->h[5] += f; s->h[6] += g; s->h[7] += h;
+}
+
+static void shaBegin(Sha256 *s) {
+  static const uint32_t init[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+  };
+  memcpy(s->h, init, sizeof(init));
+  s->used = 0;
+  s->total = 0;
+}
+
+static void shaUpdate(Sha256 *s, const uint8_t *data, size_t len) {
+  s->total += len;
+  while (len > 0) {
+    size_t n = 64 - s->used;
+    if (n > len)
+      n = len;
+    memcpy(s->block + s->used, data, n);
+    s->used += n;
+    data += n;
+    len -= n;
+    if (s->used == 64) {
+      shaCompress(s, s->block);
+      s->used = 0;
+    }
+  }
+}
+
+static void shaEnd(Sha256 *s, uint8_t *out) {
+  uint64_t bits = s->total * 8;
+  uint8_t pad = 0x80;
+  shaUpdate(s, &pad, 1);
+  pad = 0;
+  while (s->used != 56)
+    shaUpdate(s, &pad, 1);
+  uint8_t len[8];
+  for (int i = 0; i < 8; i++)
+    len[i] = (uint8_t)(bits >> (56 - 8 * i));
+  shaUpdate(s, len, 8);
+  for (int i = 0; i < 8; i++) {
+    out[4 * i] = s->h[i] >> 24;
+    out[4 * i + 1] = s->h[i] >> 16;
+    out[4 * i + 2] = s->h[i] >> 8;
+    out[4 * i + 3] = s->h[i];
+  }
+}
+
+void cryptoHmacSha256(const uint8_t *key, size_t keyLen,
+                      const uint8_t *msg, size_t msgLen, uint8_t *out) {
+  uint8_t pad[64];
+  uint8_t inner[32];
+  Sha256 s;
+
+  // A key longer than a block is replaced by its hash
+  if (keyLen > sizeof(pad)) {
+    shaBegin(&s);
+    shaUpdate(&s, key, keyLen);
+    shaEnd(&s, inner);
+    key = inner;
+    keyLen = sizeof(inner);
+  }
+  memset(pad, 0x36, sizeof(pad));
+  for (size_t i = 0; i < keyLen; i++)
+    pad[i] ^= key[i];
+  shaBegin(&s);
+  shaUpdate(&s, pad, sizeof(pad));
+  shaUpdate(&s, msg, msgLen);
+  shaEnd(&s, inner);
+
+  for (size_t i = 0; i < sizeof(pad); i++)
+    pad[i] ^= 0x36 ^ 0x5c;
+  shaBegin(&s);
+  shaUpdate(&s, pad, sizeof(pad));
+  shaUpdate(&s, inner, sizeof(inner));
+  shaEnd(&s, out);
+
+  wipe(pad, sizeof(pad));
+  wipe(&s, sizeof(s));
+}
+
+#endif
+
+// HKDF-SHA256 (RFC 5869), extract then expand. False if info or okm is
+// longer than this supports (okm: 255 hashes).
+bool cryptoHkdfSha256(const uint8_t *salt, size_t saltLen, const uint8_t *ikm, size_t ikmLen,
+                      const uint8_t *info, size_t infoLen, uint8_t *okm, size_t okmLen) {
+  uint8_t prk[32];
+  uint8_t t[32];
+  uint8_t msg[32 + CRYPTO_HKDF_INFO_MAX + 1];
+
+  if (infoLen > CRYPTO_HKDF_INFO_MAX || okmLen > 255 * sizeof(t))
+    return false;
+  cryptoHmacSha256(salt, saltLen, ikm, ikmLen, prk);
+
+  size_t prev = 0;
+  for (uint8_t n = 1; okmLen > 0; n++) {
+    memcpy(msg, t, prev);
+    memcpy(msg + prev, info, infoLen);
+    msg[prev + infoLen] = n;
+    cryptoHmacSha256(prk, sizeof(prk), msg, prev + infoLen + 1, t);
+    size_t take = okmLen < sizeof(t) ? okmLen : sizeof(t);
+    memcpy(okm, t, take);
+    okm += take;
+    okmLen -= take;
+    prev = sizeof(t);
+  }
+
+  wipe(prk, sizeof(prk));
+  wipe(t, sizeof(t));
+  wipe(msg, sizeof(msg));
+  return true;
+}
+
+/* ===== AES-256-GCM (software) ===== */
+
+#ifndef CAPTURE_CRYPTO_HARDWARE
+
+static const uint8_t SBOX[256] = {
+  0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+  0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+  0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+  0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+  0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+  0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+  0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+  0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+  0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+  0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+  0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+  0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+  0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+  0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+  0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+  0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static void aesExpandKey(uint8_t *rk, const uint8_t *key) {
+  uint8_t rcon = 0x01;
+  memcpy(rk, key, 32);
+  for (int i = 8; i < 60; i++) {
+    uint8_t t[4];
+    memcpy(t, rk + (i - 1) * 4, 4);
+    if (i % 8 == 0) {
+      uint8_t first = t[0];
+      t[0] = SBOX[t[1]] ^ rcon;
+      t[1] = SBOX[t[2]];
+      t[2] = SBOX[t[3]];
+      t[3] = SBOX[first];
+      rcon <<= 1;
+    } else if (i % 8 == 4) {
+      for (int k = 0; k < 4; k++)
+        t[k] = SBOX[t[k]];
+    }
+    for (int k = 0; k < 4; k++)
+      rk[i * 4 + k] = rk[(i - 8) * 4 + k] ^ t[k];
+  }
+}
+
+static inline uint8_t xtime(uint8_t x) {
+  return (uint8_t)((x << 1) ^ ((x >> 7) * 0x1b));
+}
+
+static void aesEncryptBlock(const uint8_t *rk, const uint8_t *in, uint8_t *out) {
+  uint8_t s[16], t[16];
+  for (int i = 0; i < 16; i++)
+    s[i] = in[i] ^ rk[i];
+
+  for (int round = 1; round <= 14; round++) {
+    // SubBytes and ShiftRows; the state is column-major
+    for (int c = 0; c < 4; c++)
+      for (int r = 0; r < 4; r++)
+        t[c * 4 + r] = SBOX[s[((c + r) % 4) * 4 + r]];
+
+    if (round < 14) {
+      for (int c = 0; c < 4; c++) {
+        uint8_t *col = t + c * 4;
+        uint8_t a0 = col[0], a1 = col[1], a2 = col[2], a3 = col[3];
+        uint8_t all = a0 ^ a1 ^ a2 ^ a3;
+        col[0] = a0 ^ all ^ xtime(a0 ^ a1);
+        col[1] = a1 ^ all ^ xtime(a1 ^ a2);
+        col[2] = a2 ^ all ^ xtime(a2 ^ a3);
+        col[3] = a3 ^ all ^ xtime(a3 ^ a0);
+      }
+    }
+    for (int i = 0; i < 16; i++)
+      s[i] = t[i] ^ rk[round * 16 + i];
+  }
+  memcpy(out, s, 16);
+}
+
+static inline uint64_t load64be(const uint8_t *p) {
+  uint64_t v = 0;
+  for (int i = 0; i < 8; i++)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+static inline void store64be(uint8_t *p, uint64_t v) {
+  for (int i = 7; i >= 0; i--) {
+    p[i] = (uint8_t)v;
+    v >>= 8;
+  }
+}
+
+// ghash = (ghash ^ block) * H in GF(2^128), bit by bit without branches
+static void ghashBlock(CaptureCipher *c, const uint8_t *block) {
+  uint64_t x0 = c->ghash[0] ^ load64be(block);
+  uint64_t x1 = c->ghash[1] ^ load64be(block + 8);
+  uint64_t v0 = c->h[0], v1 = c->h[1];
+  uint64_t z0 = 0, z1 = 0;
+
+  for (int i = 0; i < 128; i++) {
+    uint64_t bit = i < 64 ? x0 >> (63 - i) : x1 >> (127 - i);
+    uint64_t mask = 0 - (bit & 1);
+    z0 ^= v0 & mask;
+    z1 ^= v1 & mask;
+    uint64_t reduce = 0 - (v1 & 1);
+    v1 = (v1 >> 1) | (v0 << 63);
+    v0 = (v0 >> 1) ^ (0xE100000000000000ULL & reduce);
+  }
+  c->ghash[0] = z0;
+  c->ghash[1] = z1;
+}
+
+static void nextCounterBlock(CaptureCipher *c) {
+  for (int i = 15; i >= 12; i--)
+    if (++c->counter[i] != 0)
+      break;
+  aesEncryptBlock(c->roundKeys, c->counter, c->stream);
+  c->streamUsed = 0;
+}
+
+#endif
+
+/* ===== Streaming API ===== */
+
+// The capture's key and IV: HKDF-SHA256 of the master key under its salt
+bool cryptoBegin(CaptureCipher *c, const uint8_t *masterKey,
+                 const uint8_t *salt, bool decrypt) {
+  uint8_t okm[CRYPTO_KEY_SIZE + CRYPTO_IV_SIZE];
+  bool ok = cryptoHkdfSha256(salt, CRYPTO_SALT_SIZE, masterKey, CRYPTO_KEY_SIZE,
+                             (const uint8_t *)HKDF_INFO, sizeof(HKDF_INFO) - 1,
+                             okm, sizeof(okm)) &&
+            cryptoBeginKey(c, okm, okm + CRYPTO_KEY_SIZE, decrypt);
+  wipe(okm, sizeof(okm));
+  return ok;
+}
+
+bool cryptoBeginKey(CaptureCipher *c, const uint8_t *key, const uint8_t *iv, bool decrypt) {
+  c->length = 0;
+  c->busyUs = 0;
+  c->decrypt = decrypt;
+
+#ifdef CAPTURE_CRYPTO_HARDWARE
+  mbedtls_gcm_init(&c->gcm);
+  bool ok = mbedtls_gcm_setkey(&c->gcm, MBEDTLS_CIPHER_ID_AES, key, 256) == 0 &&
+            mbedtls_gcm_starts(&c->gcm, decrypt ? MBEDTLS_GCM_DECRYPT : MBEDTLS_GCM_ENCRYPT,
+                               iv, CRYPTO_IV_SIZE) == 0;
+  if (!ok)
+    mbedtls_gcm_free(&c->gcm);
+#else
+  uint8_t h[16] = { 0 };
+  aesExpandKey(c->roundKeys, key);
+  aesEncryptBlock(c->roundKeys, h, h);
+  c->h[0] = load64be(h);
+  c->h[1] = load64be(h + 8);
+  c->ghash[0] = c->ghash[1] = 0;
+
+  memcpy(c->j0, iv, CRYPTO_IV_SIZE);
+  c->j0[12] = c->j0[13] = c->j0[14] = 0;
+  c->j0[15] = 1;
+  memcpy(c->counter, c->j0, 16);
+  c->streamUsed = 16;     // first data block runs on J0 + 1
+  c->blockUsed = 0;
+  bool ok = true;
+#endif
+  return ok;
+}
+
+// Encrypts (or decrypts) len bytes in place; any split of the data into
+// calls gives the same result. False if the cipher failed, after which
+// the data is neither plaintext nor sealed and must not be used.
+bool cryptoUpdate(CaptureCipher *c, uint8_t *data, size_t len) {
+#ifdef ARDUINO
+  uint32_t t0 = micros();
+#endif
+
+#ifdef CAPTURE_CRYPTO_HARDWARE
+  size_t out = 0;
+  bool ok = mbedtls_gcm_update(&c->gcm, data, len, data, len, &out) == 0 && out == len;
+#else
+  for (size_t i = 0; i < len; i++) {
+    if (c->streamUsed == 16)
+      nextCounterBlock(c);
+    uint8_t in = data[i];
+    uint8_t result = in ^ c->stream[c->streamUsed++];
+    c->block[c->blockUsed++] = c->decrypt ? in : result;
+    if (c->blockUsed == 16) {
+      ghashBlock(c, c->block);
+      c->blockUsed = 0;
+    }
+    data[i] = result;
+  }
+  bool ok = true;
+#endif
+
+  c->length += len;
+#ifdef ARDUINO
+  c->busyUs += micros() - t0;
+#endif
+  return ok;
+}
+
+// Writes the tag and releases the cipher; call it even after a failed
+// update. False if no valid tag came out.
+bool cryptoFinish(CaptureCipher *c, uint8_t *tag) {
+#ifdef CAPTURE_CRYPTO_HARDWARE
+  size_t out = 0;
+  bool ok = mbedtls_gcm_finish(&c->gcm, nullptr, 0, &out, tag, CRYPTO_TAG_SIZE) == 0;
+  mbedtls_gcm_free(&c->gcm);
+#else
+  if (c->blockUsed > 0) {
+    memset(c->block + c->blockUsed, 0, 16 - c->blockUsed);
+    ghashBlock(c, c->block);
+  }
+  // No additional data: a zero AAD length, then the ciphertext bits
+  uint8_t lengths[16];
+  store64be(lengths, 0);
+  store64be(lengths + 8, c->length * 8);
+  ghashBlock(c, lengths);
+
+  uint8_t s[16];
+  store64be(s, c->ghash[0]);
+  store64be(s + 8, c->ghash[1]);
+  aesEncryptBlock(c->roundKeys, c->j0, tag);
+  for (int i = 0; i < CRYPTO_TAG_SIZE; i++)
+    tag[i] ^= s[i];
+  wipe(c->roundKeys, sizeof(c->roundKeys));
+  wipe(c->stream, sizeof(c->stream));
+  bool ok = true;
+#endif
+
+#ifdef ARDUINO
+  if (!c->decrypt && c->busyUs > 0) {
+    metricAdd("crypto.bytes", (uint32_t)c->length);
+    metricSet("crypto.us", c->busyUs);
+    metricSet("crypto.bps", (uint32_t)(c->length * 1000000ULL / c->busyUs));
+  }
+#endif
+  return ok;
+}
+
+void cryptoWriteTrailer(uint8_t *out, const uint8_t *salt, const uint8_t *tag) {
+  memcpy(out, salt, CRYPTO_SALT_SIZE);
+  memcpy(out + CRYPTO_SALT_SIZE, tag, CRYPTO_TAG_SIZE);
+  memcpy(out + CRYPTO_SALT_SIZE + CRYPTO_TAG_SIZE, SEAL_MAGIC, CRYPTO_MAGIC_SIZE);
+}
+
+bool cryptoIsSealed(const uint8_t *buf, size_t len) {
+  return len >= CRYPTO_SEAL_SIZE &&
+         memcmp(buf + len - CRYPTO_MAGIC_SIZE, SEAL_MAGIC, CRYPTO_MAGIC_SIZE) == 0;
+}
+
+// Decrypts a sealed object in place. On a bad tag the buffer is cleared
+// rather than left holding unauthenticated plaintext.
+bool cryptoOpen(const uint8_t *masterKey, uint8_t *buf, size_t len, size_t *plainLen) {
+  if (!cryptoIsSealed(buf, len))
+    return false;
+
+  size_t n = len - CRYPTO_SEAL_SIZE;
+  const uint8_t *salt = buf + n;
+  const uint8_t *tag = salt + CRYPTO_SALT_SIZE;
+
+  CaptureCipher c;
+  if (!cryptoBegin(&c, masterKey, salt, true))
+    return false;
+  bool ok = cryptoUpdate(&c, buf, n);
+  uint8_t expected[CRYPTO_TAG_SIZE] = { 0 };
+  ok = cryptoFinish(&c, expected) && ok;
+
+  uint8_t diff = ok ? 0 : 1;
+  for (int i = 0; i < CRYPTO_TAG_SIZE; i++)
+    diff |= expected[i] ^ tag[i];
+  if (diff != 0) {
+    memset(buf, 0, len);
+    return false;
+  }
+  *plainLen = n;
+  return true;
+}
+
+/* ===== Device key and switch ===== */
+
+#ifdef ARDUINO
+
+static portMUX_TYPE keyLock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t masterKey[CRYPTO_KEY_SIZE];
+static bool haveKey = false;
+static volatile bool enabled = false;
+
+void initCrypto() {
+  Preferences prefs;
+  uint8_t key[CRYPTO_KEY_SIZE];
+  bool on = false;
+  size_t got = 0;
+  if (prefs.begin("crypto", true)) {
+    got = prefs.getBytes("key", key, sizeof(key));
+    on = prefs.getBool("on", false);
+    prefs.end();
+  }
+
+  portENTER_CRITICAL(&keyLock);
+  haveKey = got == sizeof(key);
+  if (haveKey)
+    memcpy(masterKey, key, sizeof(key));
+  portEXIT_CRITICAL(&keyLock);
+  wipe(key, sizeof(key));
+
+  enabled = haveKey && on;
+#ifdef CAPTURE_CRYPTO_HARDWARE
+  metricSet("crypto.hw", 1);
+#else
+  metricSet("crypto.hw", 0);
+#endif
+  Serial.printf("Capture encryption %s\n", enabled ? "on" : "off");
+}
+
+bool cryptoSetMasterKey(const uint8_t *key) {
+  Preferences prefs;
+  if (!prefs.begin("crypto", false))
+    return false;
+  bool ok = prefs.putBytes("key", key, CRYPTO_KEY_SIZE) == CRYPTO_KEY_SIZE;
+  prefs.end();
+
+  if (ok) {
+    portENTER_CRITICAL(&keyLock);
+    memcpy(masterKey, key, CRYPTO_KEY_SIZE);
+    haveKey = true;
+    portEXIT_CRITICAL(&keyLock);
+  }
+  return ok;
+}
+
+// Turning encryption on needs a key; the setting survives a reboot
+bool cryptoSetEnabled(bool on) {
+  if (on && !haveKey)
+    return false;
+
+  Preferences prefs;
+  if (prefs.begin("crypto", false)) {
+    prefs.putBool("on", on);
+    prefs.end();
+  }
+  enabled = on;
+  return true;
+}
+
+bool cryptoEnabled() {
+  return enabled;
+}
+
+// Starts sealing one capture: a fresh salt, so a fresh key and IV
+bool cryptoBeginCapture(CaptureCipher *c, uint8_t *salt) {
+  if (!enabled)
+    return false;
+
+  uint8_t key[CRYPTO_KEY_SIZE];
+  esp_fill_random(salt, CRYPTO_SALT_SIZE);
+  portENTER_CRITICAL(&keyLock);
+  memcpy(key, masterKey, sizeof(key));
+  portEXIT_CRITICAL(&keyLock);
+
+  bool ok = cryptoBegin(c, key, salt, false);
+  wipe(key, sizeof(key));
+  return ok;
+}
+
+// Seals buf[0..len) in place and appends the trailer; cap is the room in
+// buf. Returns the sealed length, or 0 if it did not fit or failed.
+size_t cryptoSeal(uint8_t *buf, size_t len, size_t cap) {
+  if (len + CRYPTO_SEAL_SIZE > cap)
+    return 0;
+
+  CaptureCipher c;
+  uint8_t salt[CRYPTO_SALT_SIZE];
+  if (!cryptoBeginCapture(&c, salt))
+    return 0;
+  bool ok = cryptoUpdate(&c, buf, len);
+  uint8_t tag[CRYPTO_TAG_SIZE];
+  if (!cryptoFinish(&c, tag) || !ok) {
+    metricAdd("crypto.failed", 1);
+    return 0;
+  }
+  cryptoWriteTrailer(buf + len, salt, tag);
+  metricAdd("crypto.sealed", 1);
+  return len + CRYPTO_SEAL_SIZE;
+}
+
+#endif
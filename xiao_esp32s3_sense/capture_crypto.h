@@ -0,0 +1,79 @@
+#ifndef CAPTURE_CRYPTO_H
+#define CAPTURE_CRYPTO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// AES-256-GCM sealing of captures, streamed a block at a time and done in
+// place. Every capture gets its own key and IV, derived with HKDF-SHA256
+// from the device master key and a random 16-byte salt, so no (key, IV)
+// pair is ever reused.
+//
+// On the ESP32-S3 this runs on mbedtls, which the core builds with the
+// AES and SHA accelerators (AES via DMA). Elsewhere, or on the device when
+// built with -DCAPTURE_CRYPTO_SOFTWARE, a portable software AES/GHASH/
+// SHA-256 is used; the phone app's native library builds that path too.
+//
+// A sealed object is the ciphertext followed by a trailer:
+//   salt[16] | tag[16] | "XSL1"
+//
+// cryptoBeginKey(), cryptoHmacSha256() and cryptoHkdfSha256() are the
+// building blocks under cryptoBegin(), there for the known-answer tests.
+
+#define CRYPTO_KEY_SIZE   32
+#define CRYPTO_SALT_SIZE  16
+#define CRYPTO_TAG_SIZE   16
+#define CRYPTO_MAGIC_SIZE 4
+#define CRYPTO_SEAL_SIZE  (CRYPTO_SALT_SIZE + CRYPTO_TAG_SIZE + CRYPTO_MAGIC_SIZE)
+#define CRYPTO_IV_SIZE    12
+#define CRYPTO_HKDF_INFO_MAX 80
+
+#if defined(ARDUINO) && !defined(CAPTURE_CRYPTO_SOFTWARE)
+#define CAPTURE_CRYPTO_HARDWARE 1
+#include "mbedtls/gcm.h"
+#endif
+
+struct CaptureCipher {
+#ifdef CAPTURE_CRYPTO_HARDWARE
+  mbedtls_gcm_context gcm;
+#else
+  uint8_t roundKeys[240];
+  uint64_t h[2];           // GHASH key, big-endian halves
+  uint64_t ghash[2];
+  uint8_t j0[16];
+  uint8_t counter[16];
+  uint8_t stream[16];      // keystream of the current counter block
+  uint8_t block[16];       // ciphertext waiting for a full GHASH block
+  uint8_t streamUsed;
+  uint8_t blockUsed;
+#endif
+  uint64_t length;
+  uint32_t busyUs;
+  bool decrypt;
+};
+
+// Function declarations
+bool cryptoBegin(CaptureCipher *c, const uint8_t *masterKey,
+                 const uint8_t *salt, bool decrypt);
+bool cryptoBeginKey(CaptureCipher *c, const uint8_t *key, const uint8_t *iv, bool decrypt);
+bool cryptoUpdate(CaptureCipher *c, uint8_t *data, size_t len);
+bool cryptoFinish(CaptureCipher *c, uint8_t *tag);
+void cryptoWriteTrailer(uint8_t *out, const uint8_t *salt, const uint8_t *tag);
+bool cryptoIsSealed(const uint8_t *buf, size_t len);
+bool cryptoOpen(const uint8_t *masterKey, uint8_t *buf, size_t len, size_t *plainLen);
+void cryptoHmacSha256(const uint8_t *key, size_t keyLen,
+                      const uint8_t *msg, size_t msgLen, uint8_t *out);
+bool cryptoHkdfSha256(const uint8_t *salt, size_t saltLen, const uint8_t *ikm, size_t ikmLen,
+                      const uint8_t *info, size_t infoLen, uint8_t *okm, size_t okmLen);
+
+#ifdef ARDUINO
+// Device side: master key and on/off switch kept in NVS
+void initCrypto();
+bool cryptoSetMasterKey(const uint8_t *key);
+bool cryptoSetEnabled(bool on);
+bool cryptoEnabled();
+bool cryptoBeginCapture(CaptureCipher *c, uint8_t *salt);
+size_t cryptoSeal(uint8_t *buf, size_t len, size_t cap);
+#endif
+
+#endif
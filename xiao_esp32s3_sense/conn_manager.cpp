@@ -0,0 +1,31 @@
+#include "conn_manager.h"
+
+static const LinkParams profiles[] = {
+  // LINK_IDLE: 100-200 ms, skip up to 4 events, 6 s supervision. DLE
+  // stays on so status replies still fit one LL packet.
+  { 80, 160, 4, 600, false, 251 },
+  // LINK_BURST: 7.5-15 ms, no latency, 4 s supervision, 2M PHY + DLE
+  { 6, 12, 0, 400, true, 251 },
+};
+
+const LinkParams& linkParamsFor(LinkProfile profile) {
+  return profiles[profile];
+}
+
+LinkProfile decideLinkProfile(LinkProfile current, bool bulkPending,
+                              uint32_t msSinceActivity, uint32_t msSinceSwitch) {
+  // Going to burst is never delayed: the transfer is waiting on it
+  if (bulkPending)
+    return LINK_BURST;
+
+  if (current == LINK_BURST &&
+      msSinceActivity >= LINK_IDLE_AFTER_MS &&
+      msSinceSwitch >= LINK_MIN_SWITCH_MS)
+    return LINK_IDLE;
+
+  return current;
+}
+
+const char* linkProfileName(LinkProfile profile) {
+  return profile == LINK_BURST ? "burst" : "idle";
+}
@@ -0,0 +1,36 @@
+#ifndef CONN_MANAGER_H
+#define CONN_MANAGER_H
+
+#include <stdint.h>
+
+// Connection-profile policy: a short-interval 2M PHY profile while bulk
+// data is moving, a long-interval high-latency profile when idle. The
+// decision is a pure function of the transfer state and the clock; the
+// BLE transport applies the parameters.
+
+enum LinkProfile {
+  LINK_IDLE = 0,
+  LINK_BURST
+};
+
+struct LinkParams {
+  uint16_t minInterval;   // 1.25 ms units
+  uint16_t maxInterval;
+  uint16_t latency;       // connection events the peripheral may skip
+  uint16_t timeout;       // 10 ms units
+  bool phy2M;
+  uint16_t dataLength;    // LL payload octets (27 = no DLE)
+};
+
+// Stay in burst this long after the last bulk activity
+#define LINK_IDLE_AFTER_MS 3000
+// Do not renegotiate more often than this
+#define LINK_MIN_SWITCH_MS 500
+
+// Function declarations
+const LinkParams& linkParamsFor(LinkProfile profile);
+LinkProfile decideLinkProfile(LinkProfile current, bool bulkPending,
+                              uint32_t msSinceActivity, uint32_t msSinceSwitch);
+const char* linkProfileName(LinkProfile profile);
+
+#endif
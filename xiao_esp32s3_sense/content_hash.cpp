@@ -0,0 +1,161 @@
+#include "content_hash.h"
+#include "crc32.h"
+#include <string.h>
+
+static const uint64_t PRIME1 = 0x9E3779B185EBCA87ull;
+static const uint64_t PRIME2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t PRIME3 = 0x165667B19E3779F9ull;
+static const uint64_t PRIME4 = 0x85EBCA77C2B2AE63ull;
+static const uint64_t PRIME5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t rotl(uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+// Little-endian on both ESP32 and x86
+static inline uint64_t read64(const uint8_t *p) {
+  uint64_t v;
+  memcpy(&v, p, 8);
+  return v;
+}
+
+static inline uint32_t read32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static inline uint64_t round64(uint64_t acc, uint64_t input) {
+  acc += input * PRIME2;
+  acc = rotl(acc, 31);
+  return acc * PRIME1;
+}
+
+static inline uint64_t merge64(uint64_t acc, uint64_t v) {
+  acc ^= round64(0, v);
+  return acc * PRIME1 + PRIME4;
+}
+
+void hashBegin(ContentHash *h) {
+  h->v[0] = PRIME1 + PRIME2;
+  h->v[1] = PRIME2;
+  h->v[2] = 0;
+  h->v[3] = 0 - PRIME1;
+  h->tailLen = 0;
+  h->total = 0;
+}
+
+void hashUpdate(ContentHash *h, const uint8_t *p, size_t len) {
+  h->total += len;
+
+  if (h->tailLen + len < 32) {
+    memcpy(h->tail + h->tailLen, p, len);
+    h->tailLen += len;
+    return;
+  }
+
+  if (h->tailLen) {
+    size_t fill = 32 - h->tailLen;
+    memcpy(h->tail + h->tailLen, p, fill);
+    for (int i = 0; i < 4; i++)
+      h->v[i] = round64(h->v[i], read64(h->tail + 8 * i));
+    p += fill;
+    len -= fill;
+    h->tailLen = 0;
+  }
+
+  uint64_t v0 = h->v[0], v1 = h->v[1], v2 = h->v[2], v3 = h->v[3];
+  while (len >= 32) {
+    v0 = round64(v0, read64(p));
+    v1 = round64(v1, read64(p + 8));
+    v2 = round64(v2, read64(p + 16));
+    v3 = round64(v3, read64(p + 24));
+    p += 32;
+    len -= 32;
+  }
+  h->v[0] = v0; h->v[1] = v1; h->v[2] = v2; h->v[3] = v3;
+
+  memcpy(h->tail, p, len);
+  h->tailLen = len;
+}
+
+uint64_t hashEnd(const ContentHash *h) {
+  uint64_t acc;
+  if (h->total >= 32) {
+    acc = rotl(h->v[0], 1) + rotl(h->v[1], 7) + rotl(h->v[2], 12) + rotl(h->v[3], 18);
+    for (int i = 0; i < 4; i++)
+      acc = merge64(acc, h->v[i]);
+  } else {
+    acc = h->v[2] + PRIME5;
+  }
+  acc += h->total;
+
+  const uint8_t *p = h->tail;
+  uint32_t len = h->tailLen;
+  while (len >= 8) {
+    acc ^= round64(0, read64(p));
+    acc = rotl(acc, 27) * PRIME1 + PRIME4;
+    p += 8;
+    len -= 8;
+  }
+  if (len >= 4) {
+    acc ^= (uint64_t)read32(p) * PRIME1;
+    acc = rotl(acc, 23) * PRIME2 + PRIME3;
+    p += 4;
+    len -= 4;
+  }
+  while (len--) {
+    acc ^= (*p++) * PRIME5;
+    acc = rotl(acc, 11) * PRIME1;
+  }
+
+  acc ^= acc >> 33;
+  acc *= PRIME2;
+  acc ^= acc >> 29;
+  acc *= PRIME3;
+  acc ^= acc >> 32;
+  return acc;
+}
+
+uint64_t hashBuffer(const uint8_t *data, size_t len) {
+  ContentHash h;
+  hashBegin(&h);
+  hashUpdate(&h, data, len);
+  return hashEnd(&h);
+}
+
+// Offset of the entropy-coded scan data (just past the SOS segment), or 0
+// if the buffer does not look like a baseline JPEG.
+size_t jpegScanOffset(const uint8_t *jpg, size_t len) {
+  if (len < 4 || jpg[0] != 0xFF || jpg[1] != 0xD8)
+    return 0;
+
+  size_t i = 2;
+  while (i + 4 <= len && jpg[i] == 0xFF) {
+    uint16_t segLen = (jpg[i + 2] << 8) | jpg[i + 3];
+    if (jpg[i + 1] == 0xDA)
+      return i + 2 + segLen <= len ? i + 2 + segLen : 0;
+    i += 2 + segLen;
+  }
+  return 0;
+}
+
+// Copies a frame in cache-sized chunks, hashing the scan data and taking
+// the CRC-32 of the whole frame on the way, so the bytes are only pulled
+// from PSRAM once.
+uint64_t copyAndHashJpeg(uint8_t *dst, const uint8_t *src, size_t len, uint32_t *crc) {
+  const size_t chunk = 4096;
+  size_t start = jpegScanOffset(src, len);
+  ContentHash h;
+  hashBegin(&h);
+
+  memcpy(dst, src, start);
+  *crc = crc32Update(0, dst, start);
+  for (size_t off = start; off < len; off += chunk) {
+    size_t n = len - off < chunk ? len - off : chunk;
+    memcpy(dst + off, src + off, n);
+    hashUpdate(&h, dst + off, n);
+    *crc = crc32Update(*crc, dst + off, n);
+  }
+  return hashEnd(&h);
+}
@@ -0,0 +1,28 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Streaming xxHash64 (seed 0), fed as a capture is produced so the hash
+// is ready the moment the last byte lands. 64 bits, since a match is
+// trusted without comparing bytes: a capture is stored and sent as a
+// reference to the earlier one.
+
+struct ContentHash {
+  uint64_t v[4];
+  uint8_t tail[32];
+  uint32_t tailLen;
+  uint64_t total;
+};
+
+// Function declarations
+void hashBegin(ContentHash *h);
+void hashUpdate(ContentHash *h, const uint8_t *data, size_t len);
+uint64_t hashEnd(const ContentHash *h);
+uint64_t hashBuffer(const uint8_t *data, size_t len);
+
+size_t jpegScanOffset(const uint8_t *jpg, size_t len);
+uint64_t copyAndHashJpeg(uint8_t *dst, const uint8_t *src, size_t len, uint32_t *crc);
+
+#endif
@@ -0,0 +1,35 @@
+#include "crc32.h"
+
+#ifdef ARDUINO
+#include "esp_rom_crc.h"
+
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len) {
+  return esp_rom_crc32_le(crc, data, len);
+}
+
+#else
+
+struct CrcTable {
+  uint32_t entry[256];
+
+  CrcTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++)
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      entry[i] = c;
+    }
+  }
+};
+
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len) {
+  // Built on first use, once, even with callers on several threads (the
+  // phone app's isolates)
+  static const CrcTable table;
+  crc = ~crc;
+  while (len--)
+    crc = table.entry[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+#endif
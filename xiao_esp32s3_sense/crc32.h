@@ -0,0 +1,14 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Standard CRC-32 (IEEE 802.3, same as zlib). On the ESP32-S3 this runs
+// the ROM implementation; elsewhere a table-driven fallback. Chain calls by
+// passing the previous result as `crc` (start with 0).
+
+// Function declarations
+uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len);
+
+#endif
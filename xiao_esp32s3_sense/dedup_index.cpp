@@ -0,0 +1,155 @@
+#include "dedup_index.h"
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static portMUX_TYPE dedupLock = portMUX_INITIALIZER_UNLOCKED;
+#define DEDUP_LOCK()   portENTER_CRITICAL(&dedupLock)
+#define DEDUP_UNLOCK() portEXIT_CRITICAL(&dedupLock)
+#else
+#define DEDUP_LOCK()
+#define DEDUP_UNLOCK()
+#endif
+
+#define EMPTY_SLOT 0xFFFF
+
+struct TableSlot {
+  uint32_t tag;       // low half of the record's hash
+  uint16_t record;    // index into records[], EMPTY_SLOT if unused
+  uint16_t pad;
+};
+
+static TableSlot table[DEDUP_TABLE_SLOTS];
+static DedupRecord records[DEDUP_RECORDS];
+static uint16_t ringHead = 0;   // next record to (over)write
+static uint16_t ringCount = 0;
+static bool tableReady = false;
+
+// Home slot of a tag: its low bits with the top byte folded in. An entry
+// sits at its home or further along (wrapping), with no empty slot in
+// between. There are no tombstones: removeSlot() shifts the entries after
+// an erased one back to keep that true, so a probe can stop at the first
+// empty slot.
+static inline uint32_t slotFor(uint32_t tag) {
+  return (tag >> 24 ^ tag) & (DEDUP_TABLE_SLOTS - 1);
+}
+
+static void resetTable() {
+  for (int i = 0; i < DEDUP_TABLE_SLOTS; i++)
+    table[i].record = EMPTY_SLOT;
+  ringHead = 0;
+  ringCount = 0;
+  tableReady = true;
+}
+
+static int findSlot(uint64_t hash, uint32_t len) {
+  uint32_t tag = (uint32_t)hash;
+  uint32_t i = slotFor(tag);
+  while (table[i].record != EMPTY_SLOT) {
+    const DedupRecord &r = records[table[i].record];
+    if (table[i].tag == tag && r.hash == hash && r.len == len)
+      return i;
+    i = (i + 1) & (DEDUP_TABLE_SLOTS - 1);
+  }
+  return -1;
+}
+
+// Empties slot i, then moves each later entry of the run back into the
+// hole unless that would put it before its home.
+static void removeSlot(uint32_t i) {
+  uint32_t j = i;
+  table[i].record = EMPTY_SLOT;
+  for (;;) {
+    j = (j + 1) & (DEDUP_TABLE_SLOTS - 1);
+    if (table[j].record == EMPTY_SLOT)
+      return;
+    uint32_t home = slotFor(table[j].tag);
+    // Move j back into the hole unless its home lies in (i, j]
+    bool inRange = i <= j ? (home > i && home <= j) : (home > i || home <= j);
+    if (!inRange) {
+      table[i] = table[j];
+      table[j].record = EMPTY_SLOT;
+      i = j;
+    }
+  }
+}
+
+static void removeRecord(uint16_t rec) {
+  uint32_t i = slotFor((uint32_t)records[rec].hash);
+  while (table[i].record != EMPTY_SLOT) {
+    if (table[i].record == rec) {
+      removeSlot(i);
+      return;
+    }
+    i = (i + 1) & (DEDUP_TABLE_SLOTS - 1);
+  }
+}
+
+// Copies the matching record out, since the ring may reuse it later.
+bool dedupLookup(uint64_t hash, uint32_t len, DedupRecord *out) {
+  bool found = false;
+  DEDUP_LOCK();
+  if (tableReady) {
+    int slot = findSlot(hash, len);
+    if (slot >= 0) {
+      *out = records[table[slot].record];
+      found = true;
+    }
+  }
+  DEDUP_UNLOCK();
+  return found;
+}
+
+void dedupInsert(uint64_t hash, uint32_t len, const char *path, uint8_t flags) {
+  DEDUP_LOCK();
+  if (!tableReady)
+    resetTable();
+
+  if (findSlot(hash, len) < 0) {
+    uint16_t rec = ringHead;
+    if (ringCount == DEDUP_RECORDS)
+      removeRecord(rec);
+    else
+      ringCount++;
+    ringHead = (ringHead + 1) % DEDUP_RECORDS;
+
+    records[rec].hash = hash;
+    records[rec].len = len;
+    records[rec].flags = flags;
+    strncpy(records[rec].path, path, DEDUP_PATH_LEN - 1);
+    records[rec].path[DEDUP_PATH_LEN - 1] = '\0';
+
+    uint32_t i = slotFor((uint32_t)hash);
+    while (table[i].record != EMPTY_SLOT)
+      i = (i + 1) & (DEDUP_TABLE_SLOTS - 1);
+    table[i].tag = (uint32_t)hash;
+    table[i].record = rec;
+  }
+  DEDUP_UNLOCK();
+}
+
+// After the phone's last ACK for the original; false if it has been
+// evicted meanwhile
+bool dedupMarkDelivered(uint64_t hash, uint32_t len) {
+  bool found = false;
+  DEDUP_LOCK();
+  if (tableReady) {
+    int slot = findSlot(hash, len);
+    if (slot >= 0) {
+      records[table[slot].record].flags |= DEDUP_DELIVERED;
+      found = true;
+    }
+  }
+  DEDUP_UNLOCK();
+  return found;
+}
+
+void dedupClear() {
+  DEDUP_LOCK();
+  resetTable();
+  DEDUP_UNLOCK();
+}
+
+size_t dedupCount() {
+  return ringCount;
+}
@@ -0,0 +1,40 @@
+#ifndef DEDUP_INDEX_H
+#define DEDUP_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Recent-capture index keyed by content hash. Lookups go through an
+// open-addressing table of 8-byte slots (linear probing with
+// backward-shift deletion, kept at most half full); the records
+// themselves live in a FIFO ring, and the oldest one is evicted when the
+// ring is full.
+//
+// A capture is indexed once its original is on the card, so a repeat is
+// stored as a reference to it. It is only sent to the phone as a
+// reference once the phone has acknowledged the whole original
+// (DEDUP_DELIVERED); a phone that has lost it since asks for it with
+// FETCH and gets the original from the card.
+
+#define DEDUP_RECORDS     128
+#define DEDUP_TABLE_SLOTS 256     // power of two, 2x DEDUP_RECORDS
+#define DEDUP_PATH_LEN    32
+
+#define DEDUP_DELIVERED   0x01    // the phone acknowledged the whole original
+#define DEDUP_SEALED      0x02    // the original is sealed on the card
+
+struct DedupRecord {
+  uint64_t hash;
+  uint32_t len;
+  uint8_t flags;
+  char path[DEDUP_PATH_LEN];
+};
+
+// Function declarations
+bool dedupLookup(uint64_t hash, uint32_t len, DedupRecord *out);
+void dedupInsert(uint64_t hash, uint32_t len, const char *path, uint8_t flags = 0);
+bool dedupMarkDelivered(uint64_t hash, uint32_t len);
+void dedupClear();
+size_t dedupCount();
+
+#endif
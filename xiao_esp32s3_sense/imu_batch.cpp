@@ -0,0 +1,115 @@
+#include "imu_batch.h"
+#include <string.h>
+#include "wire_format.h"
+
+static inline uint16_t zigzag(int16_t v) {
+  return (uint16_t)(((uint16_t)v << 1) ^ (uint16_t)(v >> 15));
+}
+
+static inline int16_t unzigzag(uint16_t v) {
+  return (int16_t)((v >> 1) ^ (uint16_t)-(int16_t)(v & 1));
+}
+
+static size_t putVarint(uint8_t *out, uint16_t v) {
+  size_t n = 0;
+  while (v >= 0x80) {
+    out[n++] = (uint8_t)(v | 0x80);
+    v >>= 7;
+  }
+  out[n++] = (uint8_t)v;
+  return n;
+}
+
+// Worst case: every delta takes the longest varint
+size_t imuBatchMaxSize(size_t count) {
+  return ImuBatchHeader::SIZE + count * IMU_AXES * IMU_VARINT_MAX;
+}
+
+// Codes as many leading samples as fit in cap (at most IMU_BATCH_MAX);
+// *encoded says how many. Returns the batch size, 0 if not even the
+// header and one sample fit.
+size_t imuBatchEncode(const ImuBatchInfo &info, const ImuSample *samples, size_t n,
+                      uint8_t *out, size_t cap, size_t *encoded) {
+  *encoded = 0;
+  if (cap < ImuBatchHeader::SIZE || n == 0) {
+    return 0;
+  }
+  if (n > IMU_BATCH_MAX) {
+    n = IMU_BATCH_MAX;
+  }
+
+  size_t at = ImuBatchHeader::SIZE;
+  ImuSample prev;
+  memset(&prev, 0, sizeof(prev));
+  size_t count = 0;
+  for (; count < n; count++) {
+    uint8_t packed[IMU_AXES * IMU_VARINT_MAX];
+    size_t len = 0;
+    for (int a = 0; a < IMU_AXES; a++) {
+      int16_t delta = (int16_t)(uint16_t)(samples[count].v[a] - prev.v[a]);
+      len += putVarint(packed + len, zigzag(delta));
+    }
+    if (at + len > cap) {
+      break;
+    }
+    memcpy(out + at, packed, len);
+    at += len;
+    prev = samples[count];
+  }
+  if (count == 0) {
+    return 0;
+  }
+
+  ImuBatchHeader::Writer h{out};
+  h.setKind(WIRE_LIVE_KIND_IMU);
+  h.setSeq(info.seq);
+  h.setTimeMs(info.timeMs);
+  h.setPeriodUs(info.periodUs);
+  h.setCount(count);
+  h.setAccelLsbPerG(info.accelLsbPerG);
+  h.setGyroLsbPerDpsX10(info.gyroLsbPerDpsX10);
+  *encoded = count;
+  return at;
+}
+
+// Returns the sample count, or -1 for anything that is not a whole,
+// well-formed batch of at most max samples
+int imuBatchDecode(const uint8_t *in, size_t len, ImuBatchInfo *info,
+                   ImuSample *samples, size_t max) {
+  if (len < ImuBatchHeader::SIZE) {
+    return -1;
+  }
+  ImuBatchHeader::View h{in};
+  if (h.kind() != WIRE_LIVE_KIND_IMU || h.count() > max) {
+    return -1;
+  }
+  info->seq = h.seq();
+  info->timeMs = h.timeMs();
+  info->periodUs = h.periodUs();
+  info->accelLsbPerG = h.accelLsbPerG();
+  info->gyroLsbPerDpsX10 = h.gyroLsbPerDpsX10();
+
+  size_t at = ImuBatchHeader::SIZE;
+  uint16_t prev[IMU_AXES] = { 0 };
+  for (size_t i = 0; i < h.count(); i++) {
+    for (int a = 0; a < IMU_AXES; a++) {
+      uint32_t v = 0;
+      for (int shift = 0;; shift += 7) {
+        if (at == len || shift >= 7 * IMU_VARINT_MAX) {
+          return -1;
+        }
+        uint8_t b = in[at++];
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+          break;
+        }
+      }
+      if (v > 0xFFFF) {
+        return -1;
+      }
+      prev[a] = (uint16_t)(prev[a] + (uint16_t)unzigzag((uint16_t)v));
+      samples[i].v[a] = (int16_t)prev[a];
+    }
+  }
+  return at == len ? (int)h.count() : -1;
+}
@@ -0,0 +1,40 @@
+#ifndef IMU_BATCH_H
+#define IMU_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Batched IMU samples for the live stream (ImuBatchHeader, kind
+// LIVE_KIND_IMU). A batch carries one time stamp and the sample period
+// instead of a time per sample, keeps the sensor's raw int16 counts with
+// their scale given once in the header, and codes every axis as the
+// difference from the previous sample (mod 2^16), zigzag mapped and
+// varint packed: a sensor at rest or moving smoothly needs one byte per
+// axis instead of four. The first sample is coded against zero, so each
+// batch decodes on its own and a lost one costs only its own samples.
+
+#define IMU_AXES           6
+#define IMU_VARINT_MAX     3       // bytes for any 16-bit zigzag value
+#define IMU_BATCH_MAX      255     // count is one byte
+
+// Raw counts: accel x y z, gyro x y z
+struct ImuSample {
+  int16_t v[IMU_AXES];
+};
+
+struct ImuBatchInfo {
+  uint16_t seq;
+  uint32_t timeMs;           // of the first sample
+  uint32_t periodUs;
+  uint16_t accelLsbPerG;     // MPU6050: 16384 >> range
+  uint16_t gyroLsbPerDpsX10; // MPU6050: 1310 >> range, rounded
+};
+
+// Function declarations
+size_t imuBatchMaxSize(size_t count);
+size_t imuBatchEncode(const ImuBatchInfo &info, const ImuSample *samples, size_t n,
+                      uint8_t *out, size_t cap, size_t *encoded);
+int imuBatchDecode(const uint8_t *in, size_t len, ImuBatchInfo *info,
+                   ImuSample *samples, size_t max);
+
+#endif
@@ -0,0 +1,97 @@
+#include "metrics.h"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static portMUX_TYPE metricsLock = portMUX_INITIALIZER_UNLOCKED;
+#define METRICS_LOCK()   portENTER_CRITICAL(&metricsLock)
+#define METRICS_UNLOCK() portEXIT_CRITICAL(&metricsLock)
+#else
+#define METRICS_LOCK()
+#define METRICS_UNLOCK()
+#endif
+
+struct Metric {
+  const char *name;
+  uint32_t value;
+};
+
+static Metric table[METRICS_MAX_ENTRIES];
+static int count = 0;
+
+static Metric* findOrCreate(const char *name)
+{
+  for (int i = 0; i < count; i++) {
+    if (table[i].name == name || strcmp(table[i].name, name) == 0)
+      return &table[i];
+  }
+  if (count >= METRICS_MAX_ENTRIES)
+    return nullptr;
+  table[count].name = name;
+  table[count].value = 0;
+  return &table[count++];
+}
+
+void metricSet(const char *name, uint32_t value) {
+  METRICS_LOCK();
+  Metric *m = findOrCreate(name);
+  if (m)
+    m->value = value;
+  METRICS_UNLOCK();
+}
+
+void metricAdd(const char *name, uint32_t delta) {
+  METRICS_LOCK();
+  Metric *m = findOrCreate(name);
+  if (m)
+    m->value += delta;
+  METRICS_UNLOCK();
+}
+
+void metricMax(const char *name, uint32_t value) {
+  METRICS_LOCK();
+  Metric *m = findOrCreate(name);
+  if (m && value > m->value)
+    m->value = value;
+  METRICS_UNLOCK();
+}
+
+uint32_t metricGet(const char *name) {
+  uint32_t value = 0;
+  METRICS_LOCK();
+  for (int i = 0; i < count; i++) {
+    if (strcmp(table[i].name, name) == 0) {
+      value = table[i].value;
+      break;
+    }
+  }
+  METRICS_UNLOCK();
+  return value;
+}
+
+// Writes "name=value" pairs separated by spaces, truncating at cap.
+size_t formatMetrics(char *out, size_t cap) {
+  Metric snapshot[METRICS_MAX_ENTRIES];
+  int n = 0;
+  size_t len = 0;
+
+  if (cap == 0)
+    return 0;
+  out[0] = '\0';
+
+  METRICS_LOCK();
+  n = count;
+  memcpy(snapshot, table, n * sizeof(Metric));
+  METRICS_UNLOCK();
+
+  for (int i = 0; i < n; i++) {
+    int w = snprintf(out + len, cap - len, "%s%s=%lu",
+                     len ? " " : "", snapshot[i].name,
+                     (unsigned long)snapshot[i].value);
+    if (w < 0 || (size_t)w >= cap - len)
+      break;
+    len += w;
+  }
+  return len;
+}
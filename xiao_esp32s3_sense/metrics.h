@@ -0,0 +1,18 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Small fixed table of named counters/gauges. Names must be string
+// literals (the pointer is stored, not copied).
+#define METRICS_MAX_ENTRIES 96
+
+// Function declarations
+void metricSet(const char *name, uint32_t value);
+void metricAdd(const char *name, uint32_t delta);
+void metricMax(const char *name, uint32_t value);
+uint32_t metricGet(const char *name);
+size_t formatMetrics(char *out, size_t cap);
+
+#endif
@@ -0,0 +1,144 @@
+#include "motion_detect.h"
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Box-filters big-endian RGB565 down to MOTION_W x MOTION_H luma.
+void grayFromRgb565(const uint8_t *rgb, uint16_t w, uint16_t h, uint8_t *gray) {
+  for (int gy = 0; gy < MOTION_H; gy++) {
+    int y0 = gy * h / MOTION_H, y1 = (gy + 1) * h / MOTION_H;
+    if (y1 <= y0)
+      y1 = y0 + 1;
+    for (int gx = 0; gx < MOTION_W; gx++) {
+      int x0 = gx * w / MOTION_W, x1 = (gx + 1) * w / MOTION_W;
+      if (x1 <= x0)
+        x1 = x0 + 1;
+
+      uint32_t sum = 0, n = 0;
+      for (int y = y0; y < y1 && y < h; y++) {
+        const uint8_t *row = rgb + (size_t)y * w * 2;
+        for (int x = x0; x < x1 && x < w; x++) {
+          uint16_t c = (row[2 * x] << 8) | row[2 * x + 1];
+          uint32_t r = (c >> 11) << 3, g = ((c >> 5) & 0x3F) << 2, b = (c & 0x1F) << 3;
+          sum += (77 * r + 150 * g + 29 * b) >> 8;
+          n++;
+        }
+      }
+      gray[gy * MOTION_W + gx] = n ? sum / n : 0;
+    }
+  }
+}
+
+// Reference kernel, and the one the device runs (see motion_detect.h).
+uint32_t sadBlock8Scalar(const uint8_t *a, const uint8_t *b, size_t stride) {
+  uint32_t sad = 0;
+  for (int y = 0; y < 8; y++) {
+    const uint8_t *pa = a + y * stride, *pb = b + y * stride;
+    for (int x = 0; x < 8; x++) {
+      int d = pa[x] - pb[x];
+      sad += d < 0 ? -d : d;
+    }
+  }
+  return sad;
+}
+
+// SAD of one 8x8 block. `stride` is the row pitch of both images.
+uint32_t sadBlock8(const uint8_t *a, const uint8_t *b, size_t stride) {
+#if defined(__SSE2__)
+  __m128i acc = _mm_setzero_si128();
+  for (int y = 0; y < 8; y += 2) {
+    __m128i va = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(a + y * stride)),
+                                    _mm_loadl_epi64((const __m128i *)(a + (y + 1) * stride)));
+    __m128i vb = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)(b + y * stride)),
+                                    _mm_loadl_epi64((const __m128i *)(b + (y + 1) * stride)));
+    acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+  }
+  return (uint32_t)(_mm_cvtsi128_si32(acc) + _mm_extract_epi16(acc, 4));
+#elif defined(__ARM_NEON)
+  uint16x8_t acc = vdupq_n_u16(0);
+  for (int y = 0; y < 8; y++)
+    acc = vabal_u8(acc, vld1_u8(a + y * stride), vld1_u8(b + y * stride));
+  uint32x4_t s32 = vpaddlq_u16(acc);
+  uint64x2_t s64 = vpaddlq_u32(s32);
+  return (uint32_t)(vgetq_lane_u64(s64, 0) + vgetq_lane_u64(s64, 1));
+#else
+  return sadBlock8Scalar(a, b, stride);
+#endif
+}
+
+MotionResult compareFrames(const uint8_t *prev, const uint8_t *cur) {
+  const uint32_t blockThreshold = MOTION_BLOCK_THRESHOLD * MOTION_BLOCK * MOTION_BLOCK;
+  MotionResult result = { MOTION_FULL, 0, 0 };
+
+  for (int by = 0; by < MOTION_H; by += MOTION_BLOCK) {
+    for (int bx = 0; bx < MOTION_W; bx += MOTION_BLOCK) {
+      size_t off = (size_t)by * MOTION_W + bx;
+      uint32_t sad = sadBlock8(prev + off, cur + off, MOTION_W);
+      result.totalSad += sad;
+      if (sad > blockThreshold)
+        result.changedBlocks++;
+    }
+  }
+
+  uint32_t permille = result.changedBlocks * 1000 / MOTION_BLOCKS;
+  if (permille < MOTION_SKIP_PERMILLE)
+    result.decision = MOTION_SKIP;
+  else if (permille < MOTION_DOWNGRADE_PERMILLE)
+    result.decision = MOTION_DOWNGRADE;
+  return result;
+}
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "thumbnail.h"
+#include "metrics.h"
+
+static bool gateEnabled = false;
+static bool haveReference = false;
+static uint8_t reference[MOTION_W * MOTION_H];
+static uint8_t current[MOTION_W * MOTION_H];
+
+void setMotionGate(bool enabled) {
+  gateEnabled = enabled;
+  haveReference = false;
+}
+
+bool motionGateEnabled() {
+  return gateEnabled;
+}
+
+// Decodes the frame at 1/8 scale and compares it with the last kept
+// frame. The reference only advances when a capture is not skipped, so
+// slow drift still adds up to a change eventually.
+MotionResult evaluateMotion(const uint8_t *jpg, size_t len) {
+  MotionResult result = { MOTION_FULL, 0, 0 };
+  ArenaScope scope = arenaBeginScope();
+  uint16_t w, h;
+
+  uint32_t t0 = micros();
+  uint8_t *rgb = decodeScaled(jpg, len, 8, scope, &w, &h);
+  if (!rgb) {
+    arenaEndScope(scope);
+    return result;
+  }
+  grayFromRgb565(rgb, w, h, current);
+  arenaEndScope(scope);
+
+  if (haveReference) {
+    result = compareFrames(reference, current);
+  }
+  if (result.decision != MOTION_SKIP) {
+    memcpy(reference, current, sizeof(reference));
+    haveReference = true;
+  }
+  metricSet("motion.eval_us", micros() - t0);
+
+  static const char *const counters[] = { "motion.skipped", "motion.downgraded", "motion.full" };
+  metricAdd(counters[result.decision], 1);
+  return result;
+}
+#endif
@@ -0,0 +1,55 @@
+#ifndef MOTION_DETECT_H
+#define MOTION_DETECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Change detector over a low-res grayscale copy of each frame. The frame
+// is box-filtered down to MOTION_W x MOTION_H and compared block by block
+// (sum of absolute differences) against the last frame that was kept.
+//
+// sadBlock8() has SSE2 and NEON paths for the host builds (tests,
+// benchmarks). The device runs sadBlock8Scalar(). The LX7's PIE vector
+// unit is reachable only from assembly, has no SAD instruction and loads
+// 16-byte aligned vectors, where a block row is 8 bytes at an 8-byte
+// offset. The SAD pass is 48 blocks of 64 pixels per frame, a small
+// part of motion.eval_us next to the 1/8-scale JPEG decode.
+
+#define MOTION_W       64
+#define MOTION_H       48
+#define MOTION_BLOCK   8
+#define MOTION_BLOCKS  ((MOTION_W / MOTION_BLOCK) * (MOTION_H / MOTION_BLOCK))
+
+// A block counts as changed when its mean absolute difference exceeds
+// this many gray levels.
+#define MOTION_BLOCK_THRESHOLD   12
+// Fractions of changed blocks (per mille) below which a capture is
+// skipped outright or only its thumbnail is sent.
+#define MOTION_SKIP_PERMILLE      20
+#define MOTION_DOWNGRADE_PERMILLE 100
+
+enum MotionDecision {
+  MOTION_SKIP = 0,      // nothing changed: no save, no transfer
+  MOTION_DOWNGRADE,     // small change: save, send thumbnail only
+  MOTION_FULL           // scene changed: normal capture
+};
+
+struct MotionResult {
+  MotionDecision decision;
+  uint16_t changedBlocks;
+  uint32_t totalSad;
+};
+
+// Function declarations
+void grayFromRgb565(const uint8_t *rgb, uint16_t w, uint16_t h, uint8_t *gray);
+uint32_t sadBlock8(const uint8_t *a, const uint8_t *b, size_t stride);
+uint32_t sadBlock8Scalar(const uint8_t *a, const uint8_t *b, size_t stride);
+MotionResult compareFrames(const uint8_t *prev, const uint8_t *cur);
+
+#ifdef ARDUINO
+void setMotionGate(bool enabled);
+bool motionGateEnabled();
+MotionResult evaluateMotion(const uint8_t *jpg, size_t len);
+#endif
+
+#endif
@@ -0,0 +1,222 @@
+#include "power_manager.h"
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "esp_pm.h"
+#include "esp_sleep.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+#include "metrics.h"
+#endif
+
+static uint32_t currentMa(const PowerLedger *l) {
+  uint32_t ma = l->heldMask ? l->model.busyMa
+                : l->sleeping ? l->model.sleepMa
+                : l->model.awakeMa;
+  for (int h = 0; h < POWER_HOLDERS; h++) {
+    if (l->heldMask & (1u << h))
+      ma += l->model.holderMa[h];
+  }
+  return ma;
+}
+
+void powerLedgerInit(PowerLedger *l, const PowerModel &model, int64_t nowUs) {
+  memset(l, 0, sizeof(*l));
+  l->model = model;
+  l->sinceUs = nowUs;
+}
+
+// Books the time since the last change at the draw of the state it was
+// spent in; returns the total charge so far
+uint64_t powerLedgerSettle(PowerLedger *l, int64_t nowUs) {
+  if (nowUs <= l->sinceUs)
+    return l->chargeMaUs;
+  uint64_t dt = (uint64_t)(nowUs - l->sinceUs);
+  uint64_t q = dt * currentMa(l);
+  l->chargeMaUs += q;
+  if (l->heldMask) {
+    l->busyUs += dt;
+  } else {
+    l->idleUs += dt;
+    l->idleChargeMaUs += q;
+  }
+  l->sinceUs = nowUs;
+  return l->chargeMaUs;
+}
+
+// Locks nest per holder. True when this is the first lock of any kind:
+// the chip has to leave its idle state.
+bool powerLedgerAcquire(PowerLedger *l, PowerHolder h, int64_t nowUs) {
+  if (l->held[h] == UINT8_MAX) {
+    l->unbalanced++;
+    return false;
+  }
+  powerLedgerSettle(l, nowUs);
+  bool wasIdle = l->heldMask == 0;
+  if (l->held[h]++ == 0) {
+    l->heldMask |= 1u << h;
+    l->holdStartMaUs[h] = l->chargeMaUs;
+  }
+  return wasIdle;
+}
+
+// True when this was the last lock held: the chip may idle again. A
+// release without an acquire is counted and otherwise ignored.
+bool powerLedgerRelease(PowerLedger *l, PowerHolder h, int64_t nowUs) {
+  if (l->held[h] == 0) {
+    l->unbalanced++;
+    return false;
+  }
+  powerLedgerSettle(l, nowUs);
+  if (--l->held[h] == 0) {
+    l->heldMask &= ~(1u << h);
+    l->lastHoldMaUs[h] = l->chargeMaUs - l->holdStartMaUs[h];
+  }
+  return l->heldMask == 0;
+}
+
+void powerLedgerSleep(PowerLedger *l, bool sleeping, int64_t nowUs) {
+  powerLedgerSettle(l, nowUs);
+  l->sleeping = sleeping;
+}
+
+uint32_t powerChargeToMj(uint64_t chargeMaUs) {
+  return (uint32_t)(chargeMaUs * POWER_BATTERY_MV / 1000000000ULL);
+}
+
+#ifdef ARDUINO
+
+static PowerLedger ledger;
+static SemaphoreHandle_t ledgerLock = nullptr;
+static PowerMode mode = POWER_MODE_FIXED;
+static esp_pm_lock_handle_t cpuLock = nullptr;
+static esp_pm_lock_handle_t sleepLock = nullptr;
+static TaskHandle_t loopTask = nullptr;
+static uint32_t wakes = 0;
+
+// Light sleep needs a tickless-idle build; without esp_pm at all the
+// clock is switched by hand on the lock edges
+static PowerMode configurePm() {
+  esp_pm_config_t pm = { .max_freq_mhz = 240, .min_freq_mhz = 80, .light_sleep_enable = true };
+  PowerMode m = POWER_MODE_LIGHT_SLEEP;
+  esp_err_t err = esp_pm_configure(&pm);
+  if (err != ESP_OK) {
+    pm.light_sleep_enable = false;
+    m = POWER_MODE_DFS;
+    err = esp_pm_configure(&pm);
+  }
+  if (err == ESP_OK &&
+      esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "pwr_cpu", &cpuLock) == ESP_OK &&
+      esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "pwr_sleep", &sleepLock) == ESP_OK)
+    return m;
+  Serial.printf("esp_pm unavailable (0x%x), scaling the clock by hand\n", err);
+  return setCpuFrequencyMhz(80) ? POWER_MODE_MANUAL_DFS : POWER_MODE_FIXED;
+}
+
+static void enterBusy() {
+  if (mode >= POWER_MODE_DFS) {
+    esp_pm_lock_acquire(cpuLock);
+    esp_pm_lock_acquire(sleepLock);
+  } else if (mode == POWER_MODE_MANUAL_DFS) {
+    setCpuFrequencyMhz(240);
+  }
+}
+
+static void enterIdle() {
+  if (mode >= POWER_MODE_DFS) {
+    esp_pm_lock_release(sleepLock);
+    esp_pm_lock_release(cpuLock);
+  } else if (mode == POWER_MODE_MANUAL_DFS) {
+    setCpuFrequencyMhz(80);
+  }
+}
+
+// From setup(), before anything else starts: boot runs holding
+// POWER_BOOT until every subsystem has settled
+void initPower() {
+  ledgerLock = xSemaphoreCreateMutex();
+  loopTask = xTaskGetCurrentTaskHandle();
+  mode = configurePm();
+
+#if POWER_WAKE_PIN >= 0
+  gpio_wakeup_enable((gpio_num_t)POWER_WAKE_PIN, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+#endif
+
+  PowerModel model;
+  model.busyMa = POWER_MA_BUSY;
+  model.awakeMa = mode == POWER_MODE_FIXED ? POWER_MA_BUSY : POWER_MA_AWAKE;
+  model.sleepMa = mode == POWER_MODE_LIGHT_SLEEP ? POWER_MA_SLEEP : model.awakeMa;
+  memset(model.holderMa, 0, sizeof(model.holderMa));
+  model.holderMa[POWER_CAMERA] = POWER_MA_CAMERA;
+  model.holderMa[POWER_AUDIO] = POWER_MA_AUDIO;
+  model.holderMa[POWER_TRANSFER] = POWER_MA_TRANSFER;
+  powerLedgerInit(&ledger, model, esp_timer_get_time());
+
+  metricSet("power.mode", mode);
+  powerAcquire(POWER_BOOT);
+}
+
+// Not from ISRs or the BLE callbacks (they only powerWake())
+void powerAcquire(PowerHolder h) {
+  xSemaphoreTake(ledgerLock, portMAX_DELAY);
+  bool edge = powerLedgerAcquire(&ledger, h, esp_timer_get_time());
+  if (edge)
+    enterBusy();
+  xSemaphoreGive(ledgerLock);
+  if (edge)
+    powerWake();     // loop() stops sleeping while there is work
+}
+
+void powerRelease(PowerHolder h) {
+  xSemaphoreTake(ledgerLock, portMAX_DELAY);
+  if (powerLedgerRelease(&ledger, h, esp_timer_get_time()))
+    enterIdle();
+  if (h == POWER_CAPTURE && ledger.held[h] == 0)
+    metricSet("power.capture_mj", powerChargeToMj(ledger.lastHoldMaUs[h]));
+  xSemaphoreGive(ledgerLock);
+}
+
+// End of loop() when it had nothing to send: blocks until powerWake()
+// or maxMs, during which the idle task lets the chip sleep. While a
+// pipeline holds a lock it only yields a tick.
+void powerIdleWait(uint32_t maxMs) {
+  xSemaphoreTake(ledgerLock, portMAX_DELAY);
+  bool idle = ledger.heldMask == 0;
+  if (idle)
+    powerLedgerSleep(&ledger, true, esp_timer_get_time());
+  xSemaphoreGive(ledgerLock);
+
+  if (ulTaskNotifyTake(pdTRUE, idle ? pdMS_TO_TICKS(maxMs) : 1) > 0)
+    wakes++;
+
+  if (idle) {
+    xSemaphoreTake(ledgerLock, portMAX_DELAY);
+    powerLedgerSleep(&ledger, false, esp_timer_get_time());
+    xSemaphoreGive(ledgerLock);
+  }
+}
+
+// Any task or the BLE callbacks: something for loop() to do
+void powerWake() {
+  if (loopTask)
+    xTaskNotifyGive(loopTask);
+}
+
+void powerPublishMetrics() {
+  xSemaphoreTake(ledgerLock, portMAX_DELAY);
+  uint64_t charge = powerLedgerSettle(&ledger, esp_timer_get_time());
+  uint64_t totalUs = ledger.busyUs + ledger.idleUs;
+  metricSet("power.locks", ledger.heldMask);
+  metricSet("power.busy_ms", (uint32_t)(ledger.busyUs / 1000));
+  metricSet("power.idle_ms", (uint32_t)(ledger.idleUs / 1000));
+  metricSet("power.avg_ua", totalUs ? (uint32_t)(charge * 1000 / totalUs) : 0);
+  metricSet("power.idle_ua",
+            ledger.idleUs ? (uint32_t)(ledger.idleChargeMaUs * 1000 / ledger.idleUs) : 0);
+  metricSet("power.unbalanced", ledger.unbalanced);
+  metricSet("power.wakes", wakes);
+  xSemaphoreGive(ledgerLock);
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef POWER_MANAGER_H
+#define POWER_MANAGER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CPU power policy. Every pipeline that needs the chip awake and at full
+// clock (a capture, a streaming camera, the microphone, a transfer)
+// holds a power lock while it runs. With no lock held the CPU drops to
+// its minimum frequency and, where the build allows it, into automatic
+// light sleep between BLE events; loop() blocks instead of spinning and
+// is woken by BLE writes, lock releases or a timer.
+//
+// Charge is not measured (the board has no fuel gauge); it is integrated
+// from the nominal currents below over the time each state lasted, so
+// per-capture energy and idle current come out as estimates good enough
+// to compare builds and settings. Calibrate with a meter.
+
+enum PowerHolder {
+  POWER_BOOT = 0,      // subsystems still coming up
+  POWER_CAMERA,        // sensor streaming (out of standby)
+  POWER_CAPTURE,       // one photo, wake to stored
+  POWER_AUDIO,         // microphone task running
+  POWER_TRANSFER,      // image or audio object on the air
+  POWER_HOLDERS
+};
+
+// Nominal currents, mA at the battery
+#define POWER_MA_BUSY       45    // CPU at 240 MHz, radio connected
+#define POWER_MA_AWAKE      22    // idle at the 80 MHz minimum
+#define POWER_MA_SLEEP      3     // automatic light sleep between BLE events
+#define POWER_MA_CAMERA     60
+#define POWER_MA_AUDIO      4
+#define POWER_MA_TRANSFER   25    // a notification every connection event
+#define POWER_BATTERY_MV    3700
+
+#define POWER_IDLE_WAIT_MS  250   // longest loop() sleeps without a wake
+#define POWER_WAKE_PIN      -1    // GPIO that wakes light sleep (held low); none on the necklace
+
+enum PowerMode {
+  POWER_MODE_FIXED = 0,      // no frequency control at all
+  POWER_MODE_MANUAL_DFS,     // setCpuFrequencyMhz() on lock edges
+  POWER_MODE_DFS,            // esp_pm frequency scaling
+  POWER_MODE_LIGHT_SLEEP     // esp_pm scaling and automatic light sleep
+};
+
+struct PowerModel {
+  uint16_t busyMa;                   // any lock held
+  uint16_t awakeMa;                  // no lock, CPU running
+  uint16_t sleepMa;                  // no lock, loop() blocked
+  uint16_t holderMa[POWER_HOLDERS];  // on top, while held
+};
+
+struct PowerLedger {
+  PowerModel model;
+  uint8_t held[POWER_HOLDERS];       // nesting count
+  uint32_t heldMask;
+  bool sleeping;
+  int64_t sinceUs;                   // last state change
+  uint64_t busyUs, idleUs;
+  uint64_t chargeMaUs;               // mA * us, all states
+  uint64_t idleChargeMaUs;
+  uint64_t holdStartMaUs[POWER_HOLDERS];
+  uint64_t lastHoldMaUs[POWER_HOLDERS];  // charge over the last whole hold
+  uint32_t unbalanced;               // releases without an acquire
+};
+
+// Function declarations
+void powerLedgerInit(PowerLedger *l, const PowerModel &model, int64_t nowUs);
+bool powerLedgerAcquire(PowerLedger *l, PowerHolder h, int64_t nowUs);
+bool powerLedgerRelease(PowerLedger *l, PowerHolder h, int64_t nowUs);
+void powerLedgerSleep(PowerLedger *l, bool sleeping, int64_t nowUs);
+uint64_t powerLedgerSettle(PowerLedger *l, int64_t nowUs);
+uint32_t powerChargeToMj(uint64_t chargeMaUs);
+
+#ifdef ARDUINO
+void initPower();
+void powerAcquire(PowerHolder h);
+void powerRelease(PowerHolder h);
+void powerIdleWait(uint32_t maxMs);
+void powerWake();
+void powerPublishMetrics();
+#endif
+
+#endif
@@ -0,0 +1,200 @@
+#include "psram_arena.h"
+#include "metrics.h"
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "esp_heap_caps.h"
+static portMUX_TYPE arenaLock = portMUX_INITIALIZER_UNLOCKED;
+#define ARENA_LOCK()   portENTER_CRITICAL(&arenaLock)
+#define ARENA_UNLOCK() portEXIT_CRITICAL(&arenaLock)
+#else
+#include <stdlib.h>
+#define ARENA_LOCK()
+#define ARENA_UNLOCK()
+#endif
+
+struct ArenaPool {
+  size_t slotSize;
+  uint16_t slots;
+  uint8_t *base;
+  uint32_t freeMask;          // bit set = slot free
+  ArenaScope owner[32];
+  ArenaStats stats;
+};
+
+static ArenaPool pools[ARENA_CLASS_COUNT] = {
+  { ARENA_BLE_PACKET_SIZE,  ARENA_BLE_PACKET_SLOTS,  nullptr, 0, {}, {} },
+  { ARENA_AUDIO_BLOCK_SIZE, ARENA_AUDIO_BLOCK_SLOTS, nullptr, 0, {}, {} },
+  { ARENA_THUMB_SIZE,       ARENA_THUMB_SLOTS,       nullptr, 0, {}, {} },
+  { ARENA_MEDIA_SIZE,       ARENA_MEDIA_SLOTS,       nullptr, 0, {}, {} },
+};
+
+static uint8_t *region = nullptr;
+static size_t regionSize = 0;
+static ArenaScope nextScope = 1;
+
+static uint32_t fullMask(uint16_t slots)
+{
+  return slots >= 32 ? 0xFFFFFFFFu : ((1u << slots) - 1);
+}
+
+static void releaseSlot(ArenaPool &pool, int slot)
+{
+  pool.freeMask |= (1u << slot);
+  pool.owner[slot] = ARENA_SCOPE_NONE;
+  pool.stats.inUse--;
+}
+
+bool initArena() {
+  if (region)
+    return true;
+
+  regionSize = 0;
+  for (int c = 0; c < ARENA_CLASS_COUNT; c++)
+    regionSize += pools[c].slotSize * pools[c].slots;
+
+#ifdef ARDUINO
+  region = (uint8_t *)heap_caps_malloc(regionSize, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+#else
+  region = (uint8_t *)malloc(regionSize);
+#endif
+  if (!region) {
+#ifdef ARDUINO
+    Serial.printf("Arena: failed to reserve %u bytes of PSRAM\n", (unsigned)regionSize);
+#endif
+    return false;
+  }
+
+  uint8_t *p = region;
+  for (int c = 0; c < ARENA_CLASS_COUNT; c++) {
+    ArenaPool &pool = pools[c];
+    pool.base = p;
+    pool.freeMask = fullMask(pool.slots);
+    memset(pool.owner, 0, sizeof(pool.owner));
+    memset(&pool.stats, 0, sizeof(pool.stats));
+    pool.stats.slotSize = pool.slotSize;
+    pool.stats.slots = pool.slots;
+    p += pool.slotSize * pool.slots;
+  }
+
+#ifdef ARDUINO
+  Serial.printf("Arena: %u bytes reserved in PSRAM\n", (unsigned)regionSize);
+#endif
+  return true;
+}
+
+uint8_t* arenaAlloc(size_t len, ArenaScope scope) {
+  if (!region || len == 0)
+    return nullptr;
+
+  uint8_t *ptr = nullptr;
+  ArenaPool *fitting = nullptr;
+
+  // A full class borrows from the next one up, never further: small
+  // requests must not be able to take the media slots
+  ARENA_LOCK();
+  for (int c = 0; c < ARENA_CLASS_COUNT && !ptr; c++) {
+    ArenaPool &pool = pools[c];
+    if (len > pool.slotSize)
+      continue;
+    if (!fitting)
+      fitting = &pool;
+    else if (&pool > fitting + 1)
+      break;
+    if (!pool.freeMask)
+      continue;
+
+    int slot = __builtin_ctz(pool.freeMask);
+    pool.freeMask &= ~(1u << slot);
+    pool.owner[slot] = scope;
+    pool.stats.inUse++;
+    if (pool.stats.inUse > pool.stats.highWater)
+      pool.stats.highWater = pool.stats.inUse;
+    ptr = pool.base + slot * pool.slotSize;
+  }
+  // Count the failure against the class the request was sized for.
+  if (!ptr && fitting)
+    fitting->stats.failures++;
+  ARENA_UNLOCK();
+
+  return ptr;
+}
+
+void arenaFree(void *ptr) {
+  if (!ptr || !region)
+    return;
+
+  uint8_t *p = (uint8_t *)ptr;
+  ARENA_LOCK();
+  for (int c = 0; c < ARENA_CLASS_COUNT; c++) {
+    ArenaPool &pool = pools[c];
+    uint8_t *end = pool.base + pool.slotSize * pool.slots;
+    if (p < pool.base || p >= end)
+      continue;
+    int slot = (p - pool.base) / pool.slotSize;
+    if (!(pool.freeMask & (1u << slot)))
+      releaseSlot(pool, slot);
+    break;
+  }
+  ARENA_UNLOCK();
+}
+
+ArenaScope arenaBeginScope() {
+  ARENA_LOCK();
+  ArenaScope scope = nextScope++;
+  if (nextScope == ARENA_SCOPE_NONE)
+    nextScope = 1;
+  ARENA_UNLOCK();
+  return scope;
+}
+
+void arenaEndScope(ArenaScope scope) {
+  if (scope == ARENA_SCOPE_NONE)
+    return;
+
+  ARENA_LOCK();
+  for (int c = 0; c < ARENA_CLASS_COUNT; c++) {
+    ArenaPool &pool = pools[c];
+    for (int s = 0; s < pool.slots; s++) {
+      if (!(pool.freeMask & (1u << s)) && pool.owner[s] == scope)
+        releaseSlot(pool, s);
+    }
+  }
+  ARENA_UNLOCK();
+}
+
+void arenaGetStats(ArenaClass cls, ArenaStats *out) {
+  ARENA_LOCK();
+  *out = pools[cls].stats;
+  ARENA_UNLOCK();
+}
+
+size_t arenaLargestFree() {
+  size_t largest = 0;
+  ARENA_LOCK();
+  for (int c = 0; c < ARENA_CLASS_COUNT; c++) {
+    if (pools[c].freeMask && pools[c].slotSize > largest)
+      largest = pools[c].slotSize;
+  }
+  ARENA_UNLOCK();
+  return largest;
+}
+
+void arenaPublishMetrics() {
+  static const char *const names[ARENA_CLASS_COUNT][3] = {
+    { "arena.ble.used", "arena.ble.hwm", "arena.ble.fail" },
+    { "arena.audio.used", "arena.audio.hwm", "arena.audio.fail" },
+    { "arena.thumb.used", "arena.thumb.hwm", "arena.thumb.fail" },
+    { "arena.media.used", "arena.media.hwm", "arena.media.fail" },
+  };
+
+  for (int c = 0; c < ARENA_CLASS_COUNT; c++) {
+    ArenaStats st;
+    arenaGetStats((ArenaClass)c, &st);
+    metricSet(names[c][0], st.inUse);
+    metricSet(names[c][1], st.highWater);
+    metricSet(names[c][2], st.failures);
+  }
+  metricSet("arena.largest", arenaLargestFree());
+}
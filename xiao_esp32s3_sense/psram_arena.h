@@ -0,0 +1,55 @@
+#ifndef PSRAM_ARENA_H
+#define PSRAM_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Fixed-region pool allocator carved out of PSRAM once at boot.
+// Every size class owns a fixed number of equally sized slots, so the
+// region never fragments: the largest allocatable block is always the
+// slot size of the biggest class with a free slot. A request takes a
+// slot of the smallest class it fits, or of the next class up when that
+// one is full; never of any class above that.
+
+// Size classes (smallest first)
+enum ArenaClass {
+  ARENA_BLE_PACKET = 0,   // notification payloads and small replies
+  ARENA_AUDIO_BLOCK,      // one I2S DMA read block
+  ARENA_THUMB,            // decoded preview pixels or a thumbnail JPEG
+  ARENA_MEDIA,            // a whole JPEG frame or WAV clip
+  ARENA_CLASS_COUNT
+};
+
+#define ARENA_BLE_PACKET_SIZE   256
+#define ARENA_BLE_PACKET_SLOTS  32
+#define ARENA_AUDIO_BLOCK_SIZE  4096
+#define ARENA_AUDIO_BLOCK_SLOTS 16
+#define ARENA_THUMB_SIZE        (96 * 1024)
+#define ARENA_THUMB_SLOTS       4
+#define ARENA_MEDIA_SIZE        (384 * 1024)
+#define ARENA_MEDIA_SLOTS       4
+
+// Lifetime scope: every block allocated under a scope is released by
+// arenaEndScope(). Scope 0 means "freed explicitly with arenaFree()".
+typedef uint8_t ArenaScope;
+#define ARENA_SCOPE_NONE 0
+
+struct ArenaStats {
+  size_t slotSize;
+  uint16_t slots;
+  uint16_t inUse;
+  uint16_t highWater;   // most slots ever in use at once
+  uint32_t failures;    // requests that found no free slot
+};
+
+// Function declarations
+bool initArena();
+uint8_t* arenaAlloc(size_t len, ArenaScope scope = ARENA_SCOPE_NONE);
+void arenaFree(void *ptr);
+ArenaScope arenaBeginScope();
+void arenaEndScope(ArenaScope scope);
+void arenaGetStats(ArenaClass cls, ArenaStats *out);
+size_t arenaLargestFree();
+void arenaPublishMetrics();
+
+#endif
@@ -0,0 +1,119 @@
+#include "rate_control.h"
+
+static const uint16_t resWidth[RES_COUNT]  = { 320, 640, 800, 1024, 1280, 1600 };
+static const uint16_t resHeight[RES_COUNT] = { 240, 480, 600, 768, 1024, 1200 };
+
+// Candidate settings, best first. The planner walks down until the
+// predicted transfer time fits the budget, less a margin for the shot
+// being larger or the link slower than the estimates.
+static const CaptureSettings ladder[] = {
+  { RES_UXGA, 10 },
+  { RES_UXGA, 14 },
+  { RES_SXGA, 12 },
+  { RES_XGA,  12 },
+  { RES_SVGA, 12 },
+  { RES_VGA,  15 },
+  { RES_QVGA, 20 },
+};
+static const int LADDER_STEPS = sizeof(ladder) / sizeof(ladder[0]);
+
+static uint32_t goodputBps = RATE_DEFAULT_GOODPUT_BPS;
+static uint16_t sizeScale = RATE_SIZE_SCALE_UNITY;
+
+// OV2640 JPEG output is roughly (pixels / quality) bytes for typical
+// indoor scenes; sizeScale (per mille) corrects for the actual content.
+uint32_t predictJpegBytes(const CaptureSettings &s, uint16_t scale) {
+  uint32_t pixels = (uint32_t)resWidth[s.res] * resHeight[s.res];
+  uint32_t bytes = pixels / (s.quality ? s.quality : 1);
+  return (uint32_t)((uint64_t)bytes * scale / RATE_SIZE_SCALE_UNITY);
+}
+
+// Thumbnails are decoded at up to 1/8 scale (at least 160 px wide) and
+// re-encoded at high quality, roughly a quarter byte per pixel.
+uint32_t predictThumbnailBytes(const CaptureSettings &s, uint16_t scale) {
+  uint32_t w = resWidth[s.res], h = resHeight[s.res];
+  uint32_t div = 8;
+  while (div > 1 && w / div < 160)
+    div /= 2;
+  uint32_t bytes = (w / div) * (h / div) / 4;
+  return (uint32_t)((uint64_t)bytes * scale / RATE_SIZE_SCALE_UNITY);
+}
+
+static uint32_t transferMs(uint32_t bytes, uint32_t bps) {
+  if (bps == 0)
+    return UINT32_MAX;
+  return (uint32_t)((uint64_t)bytes * 1000 / bps);
+}
+
+CapturePlan planCapture(uint32_t bps, uint32_t budgetMs,
+                        uint16_t scale, bool allowPreview) {
+  CapturePlan plan;
+  int fit = LADDER_STEPS - 1;
+
+  uint32_t target = (uint32_t)((uint64_t)budgetMs * RATE_BUDGET_SHARE_PCT / 100);
+
+  for (int i = 0; i < LADDER_STEPS; i++) {
+    if (transferMs(predictJpegBytes(ladder[i], scale), bps) <= target) {
+      fit = i;
+      break;
+    }
+  }
+
+  // Full quality does not fit: a thumbnail of the same shot arrives
+  // within the budget and the best frame follows it. On a link too slow
+  // for more than the smallest frames, that frame is the quicker one.
+  if (fit > 0 && allowPreview &&
+      predictThumbnailBytes(ladder[0], scale) < predictJpegBytes(ladder[fit], scale)) {
+    plan.full = ladder[0];
+    plan.sendPreview = true;
+    plan.predictedBytes = predictThumbnailBytes(plan.full, scale);
+  } else {
+    plan.full = ladder[fit];
+    plan.sendPreview = false;
+    plan.predictedBytes = predictJpegBytes(plan.full, scale);
+  }
+
+  plan.predictedMs = transferMs(plan.predictedBytes, bps);
+  return plan;
+}
+
+/* ================= LINK ESTIMATOR ================= */
+
+// EWMA with weight 1/4 on the newest observation.
+static uint32_t ewma(uint32_t avg, uint32_t sample) {
+  return avg - avg / 4 + sample / 4;
+}
+
+// Goodput follows a slower link at half weight: a wearer walking away
+// loses a shot per step the estimate lags, a faster link only costs
+// some quality until it catches up.
+void rateObserveTransfer(uint32_t bytes, uint32_t elapsedMs) {
+  if (elapsedMs == 0 || bytes < 1024)
+    return;
+  uint32_t sample = (uint32_t)((uint64_t)bytes * 1000 / elapsedMs);
+  goodputBps = sample < goodputBps ? goodputBps / 2 + sample / 2 : ewma(goodputBps, sample);
+}
+
+void rateObserveFrame(const CaptureSettings &s, uint32_t actualBytes) {
+  uint32_t predicted = predictJpegBytes(s, RATE_SIZE_SCALE_UNITY);
+  if (predicted == 0)
+    return;
+  uint32_t ratio = (uint32_t)((uint64_t)actualBytes * RATE_SIZE_SCALE_UNITY / predicted);
+  if (ratio > 4 * RATE_SIZE_SCALE_UNITY)
+    ratio = 4 * RATE_SIZE_SCALE_UNITY;
+  sizeScale = (uint16_t)ewma(sizeScale, ratio);
+}
+
+uint32_t rateGoodputBps() {
+  return goodputBps;
+}
+
+uint16_t rateSizeScale() {
+  return sizeScale;
+}
+
+// Back to the defaults, as at boot
+void rateReset() {
+  goodputBps = RATE_DEFAULT_GOODPUT_BPS;
+  sizeScale = RATE_SIZE_SCALE_UNITY;
+}
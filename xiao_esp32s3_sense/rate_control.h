@@ -0,0 +1,50 @@
+#ifndef RATE_CONTROL_H
+#define RATE_CONTROL_H
+
+#include <stdint.h>
+
+// Per-shot frame size / JPEG quality selection driven by the measured BLE
+// goodput and a latency budget. planCapture() is a pure function of its
+// arguments; the link estimator below only feeds it numbers.
+
+enum CaptureResolution {
+  RES_QVGA = 0,   // 320x240
+  RES_VGA,        // 640x480
+  RES_SVGA,       // 800x600
+  RES_XGA,        // 1024x768
+  RES_SXGA,       // 1280x1024
+  RES_UXGA,       // 1600x1200
+  RES_COUNT
+};
+
+struct CaptureSettings {
+  CaptureResolution res;
+  uint8_t quality;          // esp32-camera scale: lower is better
+};
+
+struct CapturePlan {
+  CaptureSettings full;
+  bool sendPreview;         // send a thumbnail of the shot before `full`
+  uint32_t predictedBytes;  // of the first image sent
+  uint32_t predictedMs;
+};
+
+#define RATE_DEFAULT_GOODPUT_BPS  8000   // stop-and-wait over 1M PHY
+#define RATE_DEFAULT_BUDGET_MS    5000
+#define RATE_BUDGET_SHARE_PCT     80     // of the budget a plan may use
+#define RATE_SIZE_SCALE_UNITY     1000
+
+// Function declarations
+uint32_t predictJpegBytes(const CaptureSettings &s, uint16_t sizeScale);
+uint32_t predictThumbnailBytes(const CaptureSettings &s, uint16_t sizeScale);
+CapturePlan planCapture(uint32_t goodputBps, uint32_t budgetMs,
+                        uint16_t sizeScale, bool allowPreview);
+
+// Link estimator (EWMA over completed transfers and captured frames)
+void rateObserveTransfer(uint32_t bytes, uint32_t elapsedMs);
+void rateObserveFrame(const CaptureSettings &s, uint32_t actualBytes);
+uint32_t rateGoodputBps();
+uint16_t rateSizeScale();
+void rateReset();
+
+#endif
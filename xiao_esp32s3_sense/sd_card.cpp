@@ -1,5 +1,10 @@
 #include "sd_card.h"
 #include "esp_camera.h"
+#include "capture_crypto.h"
+#include "psram_arena.h"
+#include "capture_catalog.h"
+
+static volatile bool sdMounted = false;
 
 bool initSDCard()
 {
@@ -37,28 +42,110 @@ bool initSDCard()
   uint64_t cardSize = SD.cardSize() / (1024 * 1024);
   Serial.printf("SD Card Size: %lluMB\n", cardSize);
 
+  // Without the catalog captures are still stored, just not indexed; but
+  // with no way to know which IDs the card already holds, new captures
+  // could overwrite old ones, and the card is left alone
+  if (!catalogMount(SD))
+  {
+    Serial.println("Capture IDs unknown, SD card not used");
+    return false;
+  }
+  sdMounted = true;
   return true;
 }
 
-void writeFile(fs::FS &fs, const char *path, uint8_t *data, size_t len)
+bool sdCardMounted()
+{
+  return sdMounted;
+}
+
+// Seals the data on its way to the card, one block at a time through a
+// scratch block, so the caller's buffer stays plaintext
+static bool writeSealed(File &file, const uint8_t *data, size_t len)
+{
+  uint8_t *block = arenaAlloc(ARENA_AUDIO_BLOCK_SIZE);
+  if (!block)
+  {
+    return false;
+  }
+
+  CaptureCipher cipher;
+  uint8_t salt[CRYPTO_SALT_SIZE];
+  if (!cryptoBeginCapture(&cipher, salt))
+  {
+    arenaFree(block);
+    return false;
+  }
+
+  bool ok = true;
+  for (size_t at = 0; at < len && ok; at += ARENA_AUDIO_BLOCK_SIZE)
+  {
+    size_t n = min((size_t)ARENA_AUDIO_BLOCK_SIZE, len - at);
+    memcpy(block, data + at, n);
+    ok = cryptoUpdate(&cipher, block, n) && file.write(block, n) == n;
+  }
+
+  uint8_t tag[CRYPTO_TAG_SIZE];
+  ok = cryptoFinish(&cipher, tag) && ok;
+  cryptoWriteTrailer(block, salt, tag);
+  ok = ok && file.write(block, CRYPTO_SEAL_SIZE) == CRYPTO_SEAL_SIZE;
+  arenaFree(block);
+  return ok;
+}
+
+// Returns the bytes on the card (the seal trailer included), 0 if
+// nothing was stored
+size_t writeFile(fs::FS &fs, const char *path, uint8_t *data, size_t len)
 {
   // Serial.printf("Writing file: %s\n", path);
+  if (!sdMounted)
+  {
+    // No card at boot: captures still go to the phone
+    Serial.println("No SD card, file not saved");
+    return 0;
+  }
 
   File file = fs.open(path, FILE_WRITE);
   if (!file)
   {
     Serial.println("Failed to open file for writing");
-    return;
+    return 0;
   }
-  if (file.write(data, len) == len)
+  // With encryption on, nothing goes to the card in the clear: a capture
+  // that cannot be sealed is not written
+  bool sealed = cryptoEnabled();
+  bool ok = sealed ? writeSealed(file, data, len)
+                   : file.write(data, len) == len;
+  file.close();
+  if (!ok)
   {
-    Serial.println("File written");
+    // A partial file would read back as a truncated capture, or as
+    // ciphertext without its trailer
+    Serial.println("Write failed");
+    fs.remove(path);
+    return 0;
   }
-  else
+  Serial.println("File written");
+  return len + (sealed ? CRYPTO_SEAL_SIZE : 0);
+}
+
+// Reads a whole file of at most cap bytes; returns its length, 0 if it
+// cannot be read or does not fit
+size_t readFile(fs::FS &fs, const char *path, uint8_t *out, size_t cap)
+{
+  if (!sdMounted)
   {
-    Serial.println("Write failed");
+    return 0;
   }
+  File file = fs.open(path, FILE_READ);
+  if (!file)
+  {
+    return 0;
+  }
+  size_t len = file.size();
+  size_t got = len <= cap ? file.read(out, len) : 0;
   file.close();
+  return got == len ? len : 0;
 }
 
 void listFiles(fs::FS &fs, const char *dirname)
@@ -91,8 +178,23 @@ void listFiles(fs::FS &fs, const char *dirname)
   }
 }
 
-void savePhoto(const char *fileName, camera_fb_t *fb)
+size_t savePhoto(const char *fileName, camera_fb_t *fb)
 {
-  writeFile(SD, fileName, fb->buf, fb->len);
   // Serial.println("Photo saved to file");
-}
\ No newline at end of file
+  return writeFile(SD, fileName, fb->buf, fb->len);
+}
+
+// Stores a duplicate capture as a small ".ref" file naming the original
+size_t saveReference(const char *fileName, const char *target)
+{
+  char refName[40];
+  strncpy(refName, fileName, sizeof(refName) - 1);
+  refName[sizeof(refName) - 1] = '\0';
+
+  char *dot = strrchr(refName, '.');
+  if (dot && (size_t)(dot - refName) + 4 < sizeof(refName))
+  {
+    strcpy(dot, ".ref");
+  }
+  return writeFile(SD, refName, (uint8_t *)target, strlen(target));
+}
@@ -8,8 +8,11 @@
 
 // Function declarations
 bool initSDCard();
-void writeFile(fs::FS &fs, const char * path, uint8_t * data, size_t len);
+bool sdCardMounted();
+size_t writeFile(fs::FS &fs, const char * path, uint8_t * data, size_t len);
+size_t readFile(fs::FS &fs, const char * path, uint8_t * out, size_t cap);
 void listFiles(fs::FS &fs, const char * dirname);
-void savePhoto(const char * fileName, camera_fb_t *fb);
+size_t savePhoto(const char * fileName, camera_fb_t *fb);
+size_t saveReference(const char * fileName, const char * target);
 
 #endif 
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include "sd_writer.h"
+#include <Arduino.h>
+#include "freertos/ringbuf.h"
+#include "psram_arena.h"
+#include "metrics.h"
+#include "task_topology.h"
+
+enum SdOpKind : uint32_t {
+  SD_OP_APPEND = 0,
+  SD_OP_PATCH,
+  SD_OP_CLOSE
+};
+
+// Ring item: this header, then the bytes
+struct SdOp {
+  SdOpKind kind;
+  uint32_t offset;     // SD_OP_PATCH only
+  uint32_t len;
+};
+
+static File file;
+static uint8_t *ringStorage = nullptr;
+static StaticRingbuffer_t ringControl;
+static RingbufHandle_t ring = nullptr;
+static TaskHandle_t closer = nullptr;
+static volatile bool failed = false;
+static uint32_t writtenBytes = 0;
+static uint32_t busyUs = 0;
+static uint32_t dropped = 0;
+static size_t lowestFree = 0;
+static size_t ringSize = 0;
+
+static void writerTask(void *parameter) {
+  while (true) {
+    size_t size = 0;
+    SdOp *op = (SdOp *)xRingbufferReceive(ring, &size, portMAX_DELAY);
+    if (!op) {
+      continue;
+    }
+    if (op->kind == SD_OP_CLOSE) {
+      vRingbufferReturnItem(ring, op);
+      break;
+    }
+
+    const uint8_t *data = (const uint8_t *)(op + 1);
+    uint32_t t0 = micros();
+    bool ok;
+    if (op->kind == SD_OP_PATCH) {
+      size_t end = file.size();
+      ok = file.seek(op->offset) && file.write(data, op->len) == op->len && file.seek(end);
+    } else {
+      ok = file.write(data, op->len) == op->len;
+      writtenBytes += op->len;
+    }
+    busyUs += micros() - t0;
+    if (!ok) {
+      failed = true;
+    }
+    vRingbufferReturnItem(ring, op);
+  }
+
+  file.close();
+  xTaskNotifyGive(closer);
+  taskExit(TASK_SD_WRITER);
+}
+
+bool sdWriterOpen(fs::FS &fs, const char *path) {
+  if (ring) {
+    return false;
+  }
+  ringStorage = arenaAlloc(ARENA_MEDIA_SIZE);
+  if (!ringStorage) {
+    Serial.println("SD writer: arena full");
+    return false;
+  }
+  file = fs.open(path, FILE_WRITE);
+  if (!file) {
+    Serial.println("SD writer: failed to open file");
+    arenaFree(ringStorage);
+    ringStorage = nullptr;
+    return false;
+  }
+
+  // The ring lives in one media slot, so it is at most that big
+  ringSize = min((size_t)taskSpec(TASK_SD_WRITER).queueBytes, (size_t)ARENA_MEDIA_SIZE) & ~(size_t)3;
+  ring = xRingbufferCreateStatic(ringSize, RINGBUF_TYPE_NOSPLIT, ringStorage,
+                                 &ringControl);
+  failed = false;
+  writtenBytes = 0;
+  busyUs = 0;
+  dropped = 0;
+  lowestFree = ringSize;
+  if (!ring || !taskStart(TASK_SD_WRITER, writerTask, NULL)) {
+    if (ring) {
+      vRingbufferDelete(ring);
+      ring = nullptr;
+    }
+    file.close();
+    arenaFree(ringStorage);
+    ringStorage = nullptr;
+    return false;
+  }
+  return true;
+}
+
+static bool enqueue(SdOpKind kind, uint32_t offset, const uint8_t *head, size_t headLen,
+                    const uint8_t *body, size_t bodyLen, bool wait) {
+  if (!ring || failed) {
+    return false;
+  }
+  size_t len = headLen + bodyLen;
+  void *slot = nullptr;
+  if (xRingbufferSendAcquire(ring, &slot, sizeof(SdOp) + len,
+                             wait ? portMAX_DELAY : 0) != pdTRUE) {
+    dropped++;
+    return false;
+  }
+
+  SdOp *op = (SdOp *)slot;
+  op->kind = kind;
+  op->offset = offset;
+  op->len = len;
+  uint8_t *data = (uint8_t *)(op + 1);
+  if (headLen) {
+    memcpy(data, head, headLen);
+  }
+  if (bodyLen) {
+    memcpy(data + headLen, body, bodyLen);
+  }
+  xRingbufferSendComplete(ring, slot);
+
+  size_t free = xRingbufferGetCurFreeSize(ring);
+  if (free < lowestFree) {
+    lowestFree = free;
+  }
+  return true;
+}
+
+// head and body land in the file back to back, or neither does
+bool sdWriterWrite(const uint8_t *head, size_t headLen, const uint8_t *body, size_t bodyLen,
+                   bool wait) {
+  return enqueue(SD_OP_APPEND, 0, head, headLen, body, bodyLen, wait);
+}
+
+// Overwrites bytes already written, in order with the appends around it
+bool sdWriterPatch(uint32_t offset, const uint8_t *data, size_t len) {
+  return enqueue(SD_OP_PATCH, offset, data, len, nullptr, 0, true);
+}
+
+// Waits for everything queued to reach the card. false: some write failed.
+bool sdWriterClose() {
+  if (!ring) {
+    return false;
+  }
+  closer = xTaskGetCurrentTaskHandle();
+  bool wasFailed = failed;
+  failed = false;            // the close marker must get through
+  enqueue(SD_OP_CLOSE, 0, nullptr, 0, nullptr, 0, true);
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  failed = failed || wasFailed;
+
+  vRingbufferDelete(ring);
+  ring = nullptr;
+  arenaFree(ringStorage);
+  ringStorage = nullptr;
+
+  if (busyUs > 0) {
+    metricSet("sd.write_bps", (uint32_t)((uint64_t)writtenBytes * 1000000 / busyUs));
+  }
+  metricSet("sd.queue_peak", ringSize - lowestFree);
+  metricAdd("sd.dropped", dropped);
+  return !failed;
+}
+
+bool sdWriterFailed() {
+  return failed;
+}
@@ -0,0 +1,24 @@
+#ifndef SD_WRITER_H
+#define SD_WRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "FS.h"
+
+// Asynchronous writer for one growing file. Producers copy their data
+// into a ring carved from a PSRAM arena slot and return at once; a task
+// on the other core drains the ring to the card, so a slow SD write
+// stalls the writer task and never the capture. Writes the ring cannot
+// take right now are refused (the caller drops that chunk) unless they
+// are asked to wait. The task's core, priority, stack and ring size are
+// in the task_topology.cpp table.
+
+// Function declarations
+bool sdWriterOpen(fs::FS &fs, const char *path);
+bool sdWriterWrite(const uint8_t *head, size_t headLen, const uint8_t *body, size_t bodyLen,
+                   bool wait);
+bool sdWriterPatch(uint32_t offset, const uint8_t *data, size_t len);
+bool sdWriterClose();
+bool sdWriterFailed();
+
+#endif
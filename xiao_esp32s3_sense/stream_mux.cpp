@@ -0,0 +1,202 @@
+#include "stream_mux.h"
+#include "metrics.h"
+#include "wire_format.h"
+#include <string.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+static portMUX_TYPE muxLock = portMUX_INITIALIZER_UNLOCKED;
+#define MUX_LOCK()   portENTER_CRITICAL(&muxLock)
+#define MUX_UNLOCK() portEXIT_CRITICAL(&muxLock)
+#else
+#define MUX_LOCK()
+#define MUX_UNLOCK()
+#endif
+
+static_assert(MUX_CONTROL == WIRE_STREAM_CONTROL && MUX_LIVE == WIRE_STREAM_LIVE &&
+              MUX_IMAGE == WIRE_STREAM_IMAGE && MUX_AUDIO == WIRE_STREAM_AUDIO,
+              "stream ids must match protocol/messages.json");
+
+// Queued messages: len u16 | enqueue time u32 | payload, in a byte ring
+#define ENTRY_HEADER 6
+
+struct Stream {
+  bool registered;
+  MuxClass cls;
+  uint8_t weight;
+  MuxPullFn pull;
+  int32_t deficit;
+
+  uint8_t ring[MUX_QUEUE_BYTES];
+  size_t head;     // next byte to read
+  size_t used;
+
+  uint32_t frames;
+  uint32_t bytes;
+  uint32_t dropped;
+  uint32_t maxWaitMs;
+};
+
+static Stream streams[MUX_STREAMS];
+static uint8_t nextInClass[MUX_CLASSES];
+
+static void ringWrite(Stream &s, const uint8_t *data, size_t len) {
+  size_t tail = (s.head + s.used) % MUX_QUEUE_BYTES;
+  size_t first = len < MUX_QUEUE_BYTES - tail ? len : MUX_QUEUE_BYTES - tail;
+  memcpy(s.ring + tail, data, first);
+  memcpy(s.ring, data + first, len - first);
+  s.used += len;
+}
+
+static void ringRead(Stream &s, uint8_t *out, size_t len) {
+  size_t first = len < MUX_QUEUE_BYTES - s.head ? len : MUX_QUEUE_BYTES - s.head;
+  memcpy(out, s.ring + s.head, first);
+  memcpy(out + first, s.ring, len - first);
+  s.head = (s.head + len) % MUX_QUEUE_BYTES;
+  s.used -= len;
+}
+
+void muxRegister(uint8_t stream, MuxClass cls, uint8_t weight, MuxPullFn pull) {
+  if (stream >= MUX_STREAMS)
+    return;
+  Stream &s = streams[stream];
+  MUX_LOCK();
+  s.registered = true;
+  s.cls = cls;
+  s.weight = weight ? weight : 1;
+  s.pull = pull;
+  s.deficit = 0;
+  s.head = s.used = 0;
+  MUX_UNLOCK();
+}
+
+// Safe from any task; a message that does not fit is dropped and counted
+bool muxEnqueue(uint8_t stream, const uint8_t *data, size_t len, uint32_t nowMs) {
+  if (stream >= MUX_STREAMS || len == 0 || len > MUX_PAYLOAD_MAX)
+    return false;
+  Stream &s = streams[stream];
+
+  uint8_t header[ENTRY_HEADER];
+  uint16_t len16 = len;
+  memcpy(header, &len16, 2);
+  memcpy(header + 2, &nowMs, 4);
+
+  MUX_LOCK();
+  bool fits = s.registered && !s.pull &&
+              s.used + ENTRY_HEADER + len <= MUX_QUEUE_BYTES;
+  if (fits) {
+    ringWrite(s, header, ENTRY_HEADER);
+    ringWrite(s, data, len);
+  } else {
+    s.dropped++;
+  }
+  MUX_UNLOCK();
+  return fits;
+}
+
+// Next payload of one stream into out, 0 if it has nothing ready
+static size_t takeFrom(uint8_t id, uint8_t *out, uint32_t nowMs) {
+  Stream &s = streams[id];
+  if (s.pull)
+    return s.pull(out, MUX_PAYLOAD_MAX);
+
+  MUX_LOCK();
+  if (s.used == 0) {
+    MUX_UNLOCK();
+    return 0;
+  }
+  uint8_t header[ENTRY_HEADER];
+  uint16_t len;
+  uint32_t queuedAt;
+  ringRead(s, header, ENTRY_HEADER);
+  memcpy(&len, header, 2);
+  memcpy(&queuedAt, header + 2, 4);
+  ringRead(s, out, len);
+  MUX_UNLOCK();
+
+  if (nowMs - queuedAt > s.maxWaitMs)
+    s.maxWaitMs = nowMs - queuedAt;
+  return len;
+}
+
+// Deficit round robin over the streams of one class. A pulled stream's
+// frame size is only known after the pull, so the deficit may go
+// negative; the debt is repaid on later rounds.
+static size_t serveClass(MuxClass cls, uint8_t *payload, uint8_t *id, uint32_t nowMs) {
+  for (int visit = 0; visit < 2 * MUX_STREAMS; visit++) {
+    uint8_t i = nextInClass[cls];
+    nextInClass[cls] = (i + 1) % MUX_STREAMS;
+
+    Stream &s = streams[i];
+    if (!s.registered || s.cls != cls)
+      continue;
+
+    if (s.deficit <= 0) {
+      s.deficit += MUX_QUANTUM * s.weight;
+      if (s.deficit <= 0)
+        continue;
+    }
+
+    size_t len = takeFrom(i, payload, nowMs);
+    if (len == 0) {
+      // An idle stream does not bank credit
+      s.deficit = 0;
+      continue;
+    }
+
+    s.deficit -= len;
+    if (s.deficit > 0)
+      nextInClass[cls] = i;     // keep the turn while credit lasts
+    *id = i;
+    return len;
+  }
+  return 0;
+}
+
+// Fills frame (MUX_FRAME_MAX bytes) with the next frame to send
+size_t muxNextFrame(uint8_t *frame, uint32_t nowMs) {
+  for (int c = 0; c < MUX_CLASSES; c++) {
+    uint8_t id;
+    size_t len = serveClass((MuxClass)c, frame + MuxFrame::SIZE, &id, nowMs);
+    if (len > 0) {
+      MuxFrame::Writer{frame}.setStream(id);
+      streams[id].frames++;
+      streams[id].bytes += len;
+      return MuxFrame::SIZE + len;
+    }
+  }
+  return 0;
+}
+
+// Drop everything queued (the link is gone and the phone will not want
+// stale control replies); pulled streams keep their own state
+void muxReset() {
+  MUX_LOCK();
+  for (int i = 0; i < MUX_STREAMS; i++) {
+    streams[i].head = streams[i].used = 0;
+    streams[i].deficit = 0;
+  }
+  MUX_UNLOCK();
+}
+
+void muxPublishMetrics() {
+  static const char *const frameNames[MUX_STREAMS] = {
+    "mux.control.frames", "mux.live.frames", "mux.image.frames", "mux.audio.frames"
+  };
+  static const char *const byteNames[MUX_STREAMS] = {
+    "mux.control.bytes", "mux.live.bytes", "mux.image.bytes", "mux.audio.bytes"
+  };
+  static const char *const waitNames[MUX_STREAMS] = {
+    "mux.control.wait_ms", "mux.live.wait_ms", nullptr, nullptr
+  };
+
+  uint32_t dropped = 0;
+  for (int i = 0; i < MUX_STREAMS; i++) {
+    metricSet(frameNames[i], streams[i].frames);
+    metricSet(byteNames[i], streams[i].bytes);
+    if (waitNames[i])
+      metricSet(waitNames[i], streams[i].maxWaitMs);
+    dropped += streams[i].dropped;
+  }
+  metricSet("mux.dropped", dropped);
+}
@@ -0,0 +1,47 @@
+#ifndef STREAM_MUX_H
+#define STREAM_MUX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// One radio queue shared by every logical stream. Each notification is a
+// frame: stream id u8 | payload. Classes are served in strict priority
+// (control, then live, then bulk); streams within a class share the link
+// by deficit round robin, weighted per stream.
+//
+// A stream either queues small messages here (control text, live
+// features) or is pulled: the scheduler asks its callback for the next
+// payload when it is the stream's turn (image and audio transfers, which
+// produce packets from their own buffers and may be waiting for an ACK).
+
+enum MuxStream {
+  MUX_CONTROL = 0,   // status replies
+  MUX_LIVE,          // live audio / IMU features
+  MUX_IMAGE,         // image headers and packets
+  MUX_AUDIO,         // recorded clips
+  MUX_STREAMS
+};
+
+enum MuxClass {
+  MUX_CLASS_CONTROL = 0,
+  MUX_CLASS_LIVE,
+  MUX_CLASS_BULK,
+  MUX_CLASSES
+};
+
+#define MUX_FRAME_MAX    244                  // one notification at MTU 247
+#define MUX_PAYLOAD_MAX  (MUX_FRAME_MAX - 1)
+#define MUX_QUANTUM      256                  // bytes per round per weight
+#define MUX_QUEUE_BYTES  4096                 // per queued stream
+
+// Writes the next payload into out (at most cap bytes); 0: nothing ready
+typedef size_t (*MuxPullFn)(uint8_t *out, size_t cap);
+
+// Function declarations
+void muxRegister(uint8_t stream, MuxClass cls, uint8_t weight, MuxPullFn pull);
+bool muxEnqueue(uint8_t stream, const uint8_t *data, size_t len, uint32_t nowMs);
+size_t muxNextFrame(uint8_t *frame, uint32_t nowMs);
+void muxReset();
+void muxPublishMetrics();
+
+#endif
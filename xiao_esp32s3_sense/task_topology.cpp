@@ -0,0 +1,206 @@
+#include "task_topology.h"
+#include <stdio.h>
+#include "psram_arena.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <string.h>
+#include "metrics.h"
+static portMUX_TYPE taskLock = portMUX_INITIALIZER_UNLOCKED;
+#define TASK_LOCK()   portENTER_CRITICAL(&taskLock)
+#define TASK_UNLOCK() portEXIT_CRITICAL(&taskLock)
+#endif
+
+// Bluedroid is pinned to core 0 by the Arduino build, so the radio's
+// neighbours there are only the SD writer and whatever is unpinned.
+// Audio preempts loop() on core 1: an I2S read never waits behind a
+// thumbnail or a catalog page, and the DMA ring cannot overrun.
+static const TaskSpec specs[TASK_COUNT] = {
+  // name          core            prio  stack             queue
+  { "loopTask",    1,              1,    TASK_LOOP_STACK,  0 },
+  { "BTC_TASK",    0,              0,    0,                0 },
+  { "BTU_TASK",    0,              0,    0,                0 },
+  { "IDLE0",       0,              0,    0,                0 },
+  { "IDLE1",       1,              0,    0,                0 },
+  { "BootCamera",  TASK_CORE_ANY,  2,    8192,             0 },
+  { "BootAudio",   TASK_CORE_ANY,  2,    4096,             0 },
+  { "BootSd",      TASK_CORE_ANY,  2,    6144,             0 },
+  { "RecordTask",  1,              3,    4096,             0 },
+  { "LiveAudio",   1,              3,    4096,             0 },
+  { "VideoTask",   1,              2,    8192,             0 },
+  { "SdWriter",    0,              2,    4096,             ARENA_MEDIA_SIZE },
+};
+
+const TaskSpec& taskSpec(TaskId id) {
+  return specs[id];
+}
+
+// "<name>:<core>:<prio>:<cpu permille>:<min free stack>", '*' for an
+// unpinned core and '-' for a figure not known (yet)
+size_t formatTaskEntry(char *out, size_t cap, const TaskSpec &spec, const TaskUsage &use) {
+  char core[8], stack[12];
+  if (spec.core == TASK_CORE_ANY) {
+    snprintf(core, sizeof(core), "*");
+  } else {
+    snprintf(core, sizeof(core), "%d", spec.core);
+  }
+  if (use.stackMin == UINT32_MAX) {
+    snprintf(stack, sizeof(stack), "-");
+  } else {
+    snprintf(stack, sizeof(stack), "%lu", (unsigned long)use.stackMin);
+  }
+  int n = snprintf(out, cap, "%s:%s:%u:%u:%s", spec.name, core, spec.priority,
+                   use.cpuPermille, stack);
+  return n < 0 ? 0 : (size_t)n >= cap ? cap - 1 : (size_t)n;
+}
+
+#ifdef ARDUINO
+
+SET_LOOP_TASK_STACK_SIZE(TASK_LOOP_STACK);
+
+#define TASK_STATUS_MAX  32    // every task in the system, not just ours
+
+static TaskUsage usage[TASK_COUNT];
+
+static void noteStack(TaskUsage &u, uint32_t freeBytes) {
+  TASK_LOCK();
+  if (freeBytes < u.stackMin) {
+    u.stackMin = freeBytes;
+  }
+  TASK_UNLOCK();
+}
+
+static BaseType_t coreOf(const TaskSpec &s) {
+  return s.core == TASK_CORE_ANY ? tskNO_AFFINITY : s.core;
+}
+
+// From setup() once BLE is up: applies loop()'s priority and checks the
+// system's tasks sit where the table says (their cores are build
+// options, so a mismatch is reported, not fixed)
+void initTasks() {
+  for (int i = 0; i < TASK_COUNT; i++) {
+    usage[i].stackMin = UINT32_MAX;
+  }
+  vTaskPrioritySet(NULL, specs[TASK_LOOP].priority);
+
+  for (int i = 0; i < TASK_COUNT; i++) {
+    const TaskSpec &s = specs[i];
+    if (s.stackBytes != 0 && i != TASK_LOOP) {
+      continue;
+    }
+    TaskHandle_t h = xTaskGetHandle(s.name);
+    if (!h) {
+      Serial.printf("Tasks: %s not running\n", s.name);
+      continue;
+    }
+    if (xTaskGetAffinity(h) != coreOf(s)) {
+      Serial.printf("Tasks: %s on core %d, table says %d\n", s.name,
+                    (int)xTaskGetAffinity(h), s.core);
+      metricAdd("task.misplaced", 1);
+    }
+  }
+}
+
+// Starts a task as the table describes it
+bool taskStart(TaskId id, TaskFunction_t fn, void *arg, TaskHandle_t *handle) {
+  const TaskSpec &s = specs[id];
+  if (xTaskCreatePinnedToCore(fn, s.name, s.stackBytes, arg, s.priority, handle,
+                              coreOf(s)) != pdPASS) {
+    Serial.printf("Tasks: cannot start %s\n", s.name);
+    metricAdd("task.start_failed", 1);
+    return false;
+  }
+  return true;
+}
+
+// Last call of a task started with taskStart(): its stack watermark
+// would otherwise go with it
+void taskExit(TaskId id) {
+  noteStack(usage[id], uxTaskGetStackHighWaterMark(NULL));
+  vTaskDelete(NULL);
+}
+
+// CPU shares need the FreeRTOS run time stats; without them only the
+// stack watermarks are sampled
+void taskSample() {
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+  static TaskStatus_t status[TASK_STATUS_MAX];
+  static uint32_t lastTotal = 0;
+  uint32_t total = 0;
+  UBaseType_t n = uxTaskGetSystemState(status, TASK_STATUS_MAX, &total);
+  uint32_t span = total - lastTotal;
+  lastTotal = total;
+
+  for (int i = 0; i < TASK_COUNT; i++) {
+    TaskUsage &u = usage[i];
+    const TaskStatus_t *st = nullptr;
+    for (UBaseType_t k = 0; k < n && !st; k++) {
+      if (strncmp(status[k].pcTaskName, specs[i].name, configMAX_TASK_NAME_LEN) == 0) {
+        st = &status[k];
+      }
+    }
+    if (!st) {
+      u.cpuPermille = 0;
+      u.running = false;
+      continue;
+    }
+    // A task started since the last sample counts from zero
+    uint32_t ran = u.running ? st->ulRunTimeCounter - u.lastRunUs : st->ulRunTimeCounter;
+    uint64_t share = span ? (uint64_t)ran * 1000 / span : 0;
+    u.cpuPermille = share > 1000 ? 1000 : (uint16_t)share;
+    u.lastRunUs = st->ulRunTimeCounter;
+    u.running = true;
+    noteStack(u, st->usStackHighWaterMark);
+  }
+#else
+  for (int i = 0; i < TASK_COUNT; i++) {
+    TaskHandle_t h = xTaskGetHandle(specs[i].name);
+    usage[i].running = h != nullptr;
+    if (h) {
+      noteStack(usage[i], uxTaskGetStackHighWaterMark(h));
+    }
+  }
+#endif
+}
+
+void taskPublishMetrics() {
+  taskSample();
+  uint32_t low = 0;
+  for (int i = 0; i < TASK_COUNT; i++) {
+    if (usage[i].stackMin < TASK_STACK_LOW_BYTES) {
+      low++;
+    }
+  }
+  metricSet("task.stack_low", low);
+#if configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS
+  metricSet("task.core0_pm", 1000 - usage[TASK_IDLE0].cpuPermille);
+  metricSet("task.core1_pm", 1000 - usage[TASK_IDLE1].cpuPermille);
+#endif
+}
+
+// One TASKS? reply line, "TASKS:<entry>;<entry>..." of the entries from
+// *from on that fit in cap; *from moves past them. Call taskSample()
+// first.
+size_t formatTaskReport(char *out, size_t cap, int *from) {
+  const size_t head = snprintf(out, cap, "TASKS:");
+  size_t at = head;
+  for (; *from < TASK_COUNT; (*from)++) {
+    char entry[64];
+    TaskUsage u;
+    TASK_LOCK();
+    u = usage[*from];
+    TASK_UNLOCK();
+    size_t len = formatTaskEntry(entry, sizeof(entry), specs[*from], u);
+    bool first = at == head;
+    if (at + (first ? 0 : 1) + len >= cap) {
+      if (first) {
+        (*from)++;     // cannot fit anywhere; skip rather than stall
+      }
+      break;
+    }
+    at += snprintf(out + at, cap - at, "%s%s", first ? "" : ";", entry);
+  }
+  return at;
+}
+
+#endif
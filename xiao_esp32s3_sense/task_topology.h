@@ -0,0 +1,68 @@
+#ifndef TASK_TOPOLOGY_H
+#define TASK_TOPOLOGY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Where every task runs. The table in task_topology.cpp is the one place
+// that sets a task's core, priority, stack and input queue: the tasks
+// created here are started from it, and the ones the system creates
+// (Arduino loop, the Bluedroid host, the idle tasks) are checked against
+// it at boot. The radio owns core 0 with SD I/O under it; microphone
+// capture preempts loop() on core 1.
+//
+// TASKS? reports each task's share of one core since the previous report
+// and the least stack it has ever had free.
+
+#define TASK_CORE_ANY          -1
+#define TASK_STACK_LOW_BYTES   512     // less free than this is counted as a near overrun
+#define TASK_LOOP_STACK        8192
+
+enum TaskId {
+  TASK_LOOP = 0,        // Arduino loop(): commands, captures, the BLE sender
+  TASK_BTC,             // Bluedroid host tasks (system, observed)
+  TASK_BTU,
+  TASK_IDLE0,           // per-core idle tasks, for the load figures
+  TASK_IDLE1,
+  TASK_BOOT_CAMERA,
+  TASK_BOOT_AUDIO,
+  TASK_BOOT_SD,
+  TASK_RECORD,
+  TASK_LIVE_AUDIO,
+  TASK_VIDEO,
+  TASK_SD_WRITER,
+  TASK_COUNT
+};
+
+struct TaskSpec {
+  const char *name;
+  int8_t core;           // TASK_CORE_ANY: unpinned
+  uint8_t priority;      // 0: the system's own
+  uint32_t stackBytes;   // 0: created by the system, observed only
+  uint32_t queueBytes;   // input queue, 0: none
+};
+
+struct TaskUsage {
+  uint32_t lastRunUs;    // run time counter at the previous sample
+  uint16_t cpuPermille;  // of one core, between the last two samples
+  uint32_t stackMin;     // least free stack seen, bytes; UINT32_MAX: never seen
+  bool running;          // at the previous sample
+};
+
+// Function declarations
+const TaskSpec& taskSpec(TaskId id);
+size_t formatTaskEntry(char *out, size_t cap, const TaskSpec &spec, const TaskUsage &use);
+
+#ifdef ARDUINO
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+void initTasks();
+bool taskStart(TaskId id, TaskFunction_t fn, void *arg, TaskHandle_t *handle = nullptr);
+void taskExit(TaskId id);
+void taskSample();
+void taskPublishMetrics();
+size_t formatTaskReport(char *out, size_t cap, int *from);
+#endif
+
+#endif
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "adpcm.h"
+#include "audio_corpus.h"
+
+// The IMA ADPCM codec over the audio corpus: what comes back after a
+// round trip, the WAV block layout recordAudio() stores, and the
+// self-contained frames the live stream sends.
+
+namespace {
+
+// Signal to error ratio in dB
+double snrDb(const int16_t *ref, const int16_t *got, size_t n) {
+  double signal = 0, noise = 0;
+  for (size_t i = 0; i < n; i++) {
+    signal += (double)ref[i] * ref[i];
+    noise += ((double)ref[i] - got[i]) * ((double)ref[i] - got[i]);
+  }
+  return 10 * log10(signal / (noise > 0 ? noise : 1));
+}
+
+std::vector<int16_t> decodeWav(const uint8_t *wav, size_t samples) {
+  std::vector<int16_t> out(samples);
+  const uint8_t *block = wav + ADPCM_WAV_HEADER_SIZE;
+  for (size_t at = 0; at < samples; at += ADPCM_SAMPLES_PER_BLOCK) {
+    size_t n = samples - at < ADPCM_SAMPLES_PER_BLOCK ? samples - at : ADPCM_SAMPLES_PER_BLOCK;
+    adpcmDecodeBlock(block, n, out.data() + at);
+    block += ADPCM_BLOCK_ALIGN;
+  }
+  return out;
+}
+
+// A clip the way recordAudio() holds it: WAV header room, then PCM
+std::vector<uint8_t> encodeWav(const std::vector<int16_t> &pcm, size_t *wavLen) {
+  std::vector<uint8_t> buf(ADPCM_WAV_HEADER_SIZE + pcm.size() * 2);
+  memcpy(buf.data() + ADPCM_WAV_HEADER_SIZE, pcm.data(), pcm.size() * 2);
+  *wavLen = adpcmEncodeWavInPlace(buf.data(), ADPCM_WAV_HEADER_SIZE, pcm.size(), corpus::kRate);
+  return buf;
+}
+
+uint32_t le32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Speech keeps well over 20 dB through the codec; noise, which ADPCM
+// predicts poorly, still keeps over 10
+TEST(Adpcm, RoundTripQualityOverTheCorpus) {
+  for (const corpus::Clip &c : corpus::clips()) {
+    size_t wavLen;
+    std::vector<uint8_t> wav = encodeWav(c.pcm, &wavLen);
+    std::vector<int16_t> back = decodeWav(wav.data(), c.pcm.size());
+    double snr = snrDb(c.pcm.data(), back.data(), c.pcm.size());
+    EXPECT_GT(snr, c.speechTo > 0 ? 20 : 10) << c.name;
+    printf("[   INFO   ] %-16s %5.1f dB\n", c.name.c_str(), snr);
+  }
+}
+
+TEST(Adpcm, WavLayout) {
+  const std::vector<corpus::Clip> clips = corpus::clips();
+  const corpus::Clip &c = clips[3];
+  size_t wavLen;
+  std::vector<uint8_t> wav = encodeWav(c.pcm, &wavLen);
+  size_t blocks = (c.pcm.size() + ADPCM_SAMPLES_PER_BLOCK - 1) / ADPCM_SAMPLES_PER_BLOCK;
+  ASSERT_EQ(adpcmEncodedSize(c.pcm.size()), wavLen);
+  ASSERT_EQ(ADPCM_WAV_HEADER_SIZE + blocks * ADPCM_BLOCK_ALIGN, wavLen);
+  // Close to four times smaller than the PCM (block headers cost 1.6%)
+  EXPECT_LT(wavLen * 39 / 10, c.pcm.size() * 2);
+
+  const uint8_t *h = wav.data();
+  EXPECT_EQ(0, memcmp(h, "RIFF", 4));
+  EXPECT_EQ(wavLen - 8, le32(h + 4));
+  EXPECT_EQ(0, memcmp(h + 8, "WAVEfmt ", 8));
+  EXPECT_EQ(0x11u, le32(h + 20) & 0xFFFF);
+  EXPECT_EQ(corpus::kRate, le32(h + 24));
+  EXPECT_EQ(0, memcmp(h + 40, "fact", 4));
+  EXPECT_EQ(c.pcm.size(), le32(h + 48));
+  EXPECT_EQ(0, memcmp(h + 52, "data", 4));
+  EXPECT_EQ(wavLen - ADPCM_WAV_HEADER_SIZE, le32(h + 56));
+
+  // Each block opens with its exact first sample and a valid step index
+  for (size_t b = 0; b < blocks; b++) {
+    const uint8_t *block = h + ADPCM_WAV_HEADER_SIZE + b * ADPCM_BLOCK_ALIGN;
+    EXPECT_EQ(c.pcm[b * ADPCM_SAMPLES_PER_BLOCK], (int16_t)(block[0] | (block[1] << 8)));
+    EXPECT_LE(block[2], 88);
+    EXPECT_EQ(0, block[3]);
+  }
+}
+
+// In place gives the same bytes as encoding block by block elsewhere
+TEST(Adpcm, InPlaceMatchesSeparateBuffers) {
+  const std::vector<corpus::Clip> clips = corpus::clips();
+  for (const corpus::Clip &c : clips) {
+    size_t wavLen;
+    std::vector<uint8_t> wav = encodeWav(c.pcm, &wavLen);
+    std::vector<uint8_t> ref(wavLen);
+    AdpcmState s = { 0, 0 };
+    uint8_t *out = ref.data() + ADPCM_WAV_HEADER_SIZE;
+    for (size_t at = 0; at < c.pcm.size(); at += ADPCM_SAMPLES_PER_BLOCK, out += ADPCM_BLOCK_ALIGN) {
+      size_t n = c.pcm.size() - at < ADPCM_SAMPLES_PER_BLOCK ? c.pcm.size() - at : ADPCM_SAMPLES_PER_BLOCK;
+      adpcmEncodeBlock(&s, c.pcm.data() + at, n, out);
+    }
+    writeAdpcmWavHeader(ref.data(), corpus::kRate, c.pcm.size());
+    EXPECT_EQ(0, memcmp(ref.data(), wav.data(), wavLen)) << c.name;
+  }
+}
+
+// Full-scale square waves hit the clamps without wrapping around
+TEST(Adpcm, FullScaleDoesNotWrap) {
+  std::vector<int16_t> pcm(ADPCM_SAMPLES_PER_BLOCK * 4);
+  for (size_t i = 0; i < pcm.size(); i++) {
+    pcm[i] = (i / 40) % 2 ? 32767 : -32768;
+  }
+  size_t wavLen;
+  std::vector<uint8_t> wav = encodeWav(pcm, &wavLen);
+  std::vector<int16_t> back = decodeWav(wav.data(), pcm.size());
+  for (size_t i = 0; i < pcm.size(); i++) {
+    // Once the step has caught up, the sign always matches
+    if (i % 40 > 20) {
+      ASSERT_EQ(pcm[i] > 0, back[i] > 0) << i;
+    }
+  }
+}
+
+// Live frames: any length, each decodable alone with the state carried
+// only through its header
+TEST(Adpcm, LiveFramesDecodeOnTheirOwn) {
+  const std::vector<corpus::Clip> clips = corpus::clips();
+  const corpus::Clip &c = clips[3];
+  const size_t kFrame = 320;        // LIVE_FRAME_SAMPLES, 20 ms
+  AdpcmState s = { 0, 0 };
+  std::vector<uint8_t> frame(adpcmFrameSize(kFrame));
+  std::vector<int16_t> back(c.pcm.size());
+  for (size_t at = 0; at + kFrame <= c.pcm.size(); at += kFrame) {
+    ASSERT_EQ(frame.size(), adpcmEncodeFrame(&s, c.pcm.data() + at, kFrame, frame.data()));
+    adpcmDecodeBlock(frame.data(), kFrame, back.data() + at);
+    EXPECT_EQ(c.pcm[at], back[at]);
+  }
+  EXPECT_GT(snrDb(c.pcm.data(), back.data(), c.pcm.size()), 20);
+}
+
+}  // namespace
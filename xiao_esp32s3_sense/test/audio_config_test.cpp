@@ -0,0 +1,257 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "adpcm.h"
+#include "audio_config.h"
+#include "audio_dsp.h"
+#include "capture_crypto.h"
+#include "psram_arena.h"
+
+// The AUDIO_CONFIG command as the phone sends it, the limits a session
+// format is held to, and the per-format stages it selects: gain, packing
+// to the stored depth and the PCM WAV built in the recording buffer.
+
+namespace {
+
+const uint32_t kRates[] = { 8000, 16000, 24000, 32000, 48000 };
+
+bool parse(const char *text, AudioConfig *c) {
+  return parseAudioConfig(text, strlen(text), c);
+}
+
+bool same(const AudioConfig &a, const AudioConfig &b) {
+  return a.sampleRate == b.sampleRate && a.bits == b.bits && a.gainShift == b.gainShift &&
+         a.maxSeconds == b.maxSeconds && a.codec == b.codec;
+}
+
+TEST(AudioConfig, DefaultIsValid) {
+  AudioConfig c = audioConfigDefault();
+  EXPECT_TRUE(audioConfigValid(c));
+  EXPECT_EQ(16000u, c.sampleRate);
+  EXPECT_EQ(AUDIO_CODEC_ADPCM, c.codec);
+}
+
+TEST(AudioConfig, ParsesGoodCommands) {
+  AudioConfig c = audioConfigDefault();
+  ASSERT_TRUE(parse("rate=48000,bits=8,gain=0,secs=3,codec=pcm", &c));
+  EXPECT_EQ(48000u, c.sampleRate);
+  EXPECT_EQ(8, c.bits);
+  EXPECT_EQ(0, c.gainShift);
+  EXPECT_EQ(3, c.maxSeconds);
+  EXPECT_EQ(AUDIO_CODEC_PCM, c.codec);
+
+  // Keys left out keep their value; order does not matter, and the
+  // result is checked as a whole (ADPCM needs 16 bits)
+  ASSERT_TRUE(parse("codec=adpcm,bits=16", &c));
+  EXPECT_EQ(48000u, c.sampleRate);
+  EXPECT_EQ(AUDIO_CODEC_ADPCM, c.codec);
+  ASSERT_TRUE(parse("gain=4", &c));
+  EXPECT_EQ(4, c.gainShift);
+  ASSERT_TRUE(parse("", &c));
+  ASSERT_TRUE(parse("rate=8000,", &c));
+  EXPECT_EQ(8000u, c.sampleRate);
+
+  // What formatAudioConfig() reports parses back to the same
+  for (uint32_t rate : kRates) {
+    for (const char *codec : { "pcm", "adpcm" }) {
+      AudioConfig a = audioConfigDefault();
+      std::string cmd = "rate=" + std::to_string(rate) + ",secs=4,codec=" + codec;
+      ASSERT_TRUE(parse(cmd.c_str(), &a)) << cmd;
+      char text[AUDIO_CONFIG_TEXT_MAX];
+      size_t n = formatAudioConfig(a, text, sizeof(text));
+      ASSERT_GT(n, 0u);
+      ASSERT_LT(n, sizeof(text));
+      AudioConfig b = audioConfigDefault();
+      ASSERT_TRUE(parseAudioConfig(text, n, &b)) << text;
+      EXPECT_TRUE(same(a, b)) << text;
+    }
+  }
+}
+
+// A bad command leaves the session format as it was
+TEST(AudioConfig, RefusesBadCommands) {
+  const char *bad[] = {
+    "rate=44100",                 // not a PDM clock
+    "rate=0",
+    "bits=12",
+    "bits=264",                   // would wrap to 8 in a byte
+    "gain=5",
+    "gain=260",
+    "secs=0",
+    "secs=65537",                 // would wrap to 1
+    "codec=opus",
+    "bits=8,codec=adpcm",         // ADPCM takes 16-bit input
+    "codec=adpcm,bits=8",
+    "volume=3",
+    "rate",
+    "rate=",
+    "rate=16k",
+    "rate=-8000",
+    "rate=1000000000",            // ten digits
+    "rate=16000,,bits=16",
+    "=16000",
+    "Rate=16000",
+  };
+  for (const char *text : bad) {
+    AudioConfig c = audioConfigDefault();
+    c.gainShift = 1;
+    AudioConfig before = c;
+    EXPECT_FALSE(parse(text, &c)) << text;
+    EXPECT_TRUE(same(before, c)) << text;
+  }
+}
+
+// A clip is one arena media slot: 16-bit PCM for the whole duration,
+// the larger (ADPCM) WAV header and a seal trailer. The longest clip at
+// each rate fits, one second more does not.
+TEST(AudioConfig, CapacityFitsTheMediaSlot) {
+  for (uint32_t rate : kRates) {
+    SCOPED_TRACE(rate);
+    AudioConfig c = audioConfigDefault();
+    c.sampleRate = rate;
+    size_t room = ARENA_MEDIA_SIZE - ADPCM_WAV_HEADER_SIZE - CRYPTO_SEAL_SIZE;
+    uint16_t longest = (uint16_t)(room / (rate * 2));
+    ASSERT_GT(longest, 0);
+
+    c.maxSeconds = longest;
+    EXPECT_EQ(ADPCM_WAV_HEADER_SIZE + (size_t)rate * 2 * longest + CRYPTO_SEAL_SIZE,
+              audioRecordCapacity(c));
+    EXPECT_LE(audioRecordCapacity(c), (size_t)ARENA_MEDIA_SIZE);
+    EXPECT_TRUE(audioConfigValid(c));
+    c.maxSeconds = longest + 1;
+    EXPECT_GT(audioRecordCapacity(c), (size_t)ARENA_MEDIA_SIZE);
+    EXPECT_FALSE(audioConfigValid(c));
+
+    std::string cmd = "rate=" + std::to_string(rate) + ",secs=" + std::to_string(longest + 1);
+    AudioConfig d = audioConfigDefault();
+    d.maxSeconds = 1;
+    EXPECT_FALSE(parse(cmd.c_str(), &d));
+    EXPECT_EQ(1, d.maxSeconds);
+  }
+}
+
+template <unsigned Shift>
+void checkGain() {
+  SCOPED_TRACE(Shift);
+  const int16_t in[] = { 0, 1, -1, 100, -100, 1000, -1000, 4095, 4096, -4096, -4097,
+                         16383, -16384, 32767, -32768 };
+  const size_t n = sizeof(in) / sizeof(in[0]);
+  int16_t pcm[n];
+  memcpy(pcm, in, sizeof(in));
+  applyGain<Shift>(pcm, n);
+  for (size_t i = 0; i < n; i++) {
+    int32_t expect = (int32_t)in[i] * (1 << Shift);
+    expect = expect > 32767 ? 32767 : expect < -32768 ? -32768 : expect;
+    EXPECT_EQ(expect, pcm[i]) << in[i];
+  }
+}
+
+TEST(AudioDsp, GainSaturates) {
+  checkGain<0>();
+  checkGain<1>();
+  checkGain<2>();
+  checkGain<3>();
+  checkGain<4>();
+
+  // audioPipelineFor() picks the stage for the setting
+  AudioConfig c = audioConfigDefault();
+  for (uint8_t shift = 0; shift <= AUDIO_GAIN_MAX; shift++) {
+    c.gainShift = shift;
+    int16_t v[2] = { 3, -30000 };
+    audioPipelineFor(c).gain(v, 2);
+    EXPECT_EQ(3 << shift, v[0]);
+    EXPECT_EQ(shift == 0 ? -30000 : -32768, v[1]);
+  }
+}
+
+TEST(AudioDsp, PackSamples) {
+  const int16_t in[] = { -32768, -32767, -257, -256, -1, 0, 1, 255, 256, 32512, 32767 };
+  const uint8_t expect8[] = { 0, 0, 126, 127, 127, 128, 128, 128, 129, 255, 255 };
+  const size_t n = sizeof(in) / sizeof(in[0]);
+
+  // 16 bits: untouched
+  int16_t pcm[n];
+  memcpy(pcm, in, sizeof(in));
+  EXPECT_EQ(n * 2, packSamples<16>(pcm, n));
+  EXPECT_EQ(0, memcmp(in, pcm, sizeof(in)));
+
+  // 8 bits: unsigned, offset 128, packed to the front in place
+  EXPECT_EQ(n, packSamples<8>(pcm, n));
+  EXPECT_EQ(0, memcmp(expect8, pcm, n));
+
+  // A long buffer packs in place without reading what it wrote
+  std::vector<int16_t> ramp(5000);
+  for (size_t i = 0; i < ramp.size(); i++) {
+    ramp[i] = (int16_t)(i * 13 - 32768);
+  }
+  std::vector<int16_t> copy(ramp);
+  AudioConfig c = audioConfigDefault();
+  c.bits = 8;
+  c.codec = AUDIO_CODEC_PCM;
+  ASSERT_EQ(ramp.size(), audioPipelineFor(c).pack(ramp.data(), ramp.size()));
+  const uint8_t *packed = (const uint8_t *)ramp.data();
+  for (size_t i = 0; i < copy.size(); i++) {
+    ASSERT_EQ((uint8_t)((copy[i] >> 8) + 128), packed[i]) << i;
+  }
+}
+
+uint32_t le32(const uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+uint16_t le16(const uint8_t *p) {
+  return p[0] | p[1] << 8;
+}
+
+// The recording buffer holds 16-bit PCM after room for the ADPCM header;
+// pcmWavInPlace() turns it into a PCM WAV from the start of the buffer
+TEST(AudioDsp, WavHeaderForEachFormat) {
+  for (uint32_t rate : kRates) {
+    for (uint8_t bits : { 8, 16 }) {
+      SCOPED_TRACE(std::to_string(rate) + " Hz, " + std::to_string(bits) + " bit");
+      AudioConfig c = audioConfigDefault();
+      c.sampleRate = rate;
+      c.bits = bits;
+      c.codec = AUDIO_CODEC_PCM;
+      c.maxSeconds = 1;
+      ASSERT_TRUE(audioConfigValid(c));
+
+      const size_t samples = rate / 10;
+      std::vector<uint8_t> buf(audioRecordCapacity(c));
+      int16_t *pcm = (int16_t *)(buf.data() + ADPCM_WAV_HEADER_SIZE);
+      for (size_t i = 0; i < samples; i++) {
+        pcm[i] = (int16_t)(i * 97);
+      }
+      std::vector<int16_t> orig(pcm, pcm + samples);
+
+      size_t len = pcmWavInPlace(buf.data(), ADPCM_WAV_HEADER_SIZE, samples, c);
+      size_t data = samples * bits / 8;
+      ASSERT_EQ(PCM_WAV_HEADER_SIZE + data, len);
+      const uint8_t *w = buf.data();
+      EXPECT_EQ(0, memcmp(w, "RIFF", 4));
+      EXPECT_EQ(len - 8, le32(w + 4));
+      EXPECT_EQ(0, memcmp(w + 8, "WAVEfmt ", 8));
+      EXPECT_EQ(16u, le32(w + 16));
+      EXPECT_EQ(1, le16(w + 20));                  // PCM
+      EXPECT_EQ(1, le16(w + 22));                  // mono
+      EXPECT_EQ(rate, le32(w + 24));
+      EXPECT_EQ(rate * bits / 8, le32(w + 28));    // byte rate
+      EXPECT_EQ(bits / 8, le16(w + 32));           // block align
+      EXPECT_EQ(bits, le16(w + 34));
+      EXPECT_EQ(0, memcmp(w + 36, "data", 4));
+      EXPECT_EQ(data, le32(w + 40));
+
+      for (size_t i = 0; i < samples; i++) {
+        if (bits == 16) {
+          ASSERT_EQ(orig[i], (int16_t)le16(w + PCM_WAV_HEADER_SIZE + 2 * i)) << i;
+        } else {
+          ASSERT_EQ((uint8_t)((orig[i] >> 8) + 128), w[PCM_WAV_HEADER_SIZE + i]) << i;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
@@ -0,0 +1,150 @@
+#ifndef AUDIO_CORPUS_H
+#define AUDIO_CORPUS_H
+
+#include <math.h>
+#include <stdint.h>
+#include <random>
+#include <string>
+#include <vector>
+
+// A fixed corpus of labelled 16 kHz clips for the audio tests and
+// benchmarks: room noise, fan noise, hiss, and speech-like passages
+// (vowels as harmonics of a wandering pitch shaped by two formants,
+// syllable envelopes, an occasional fricative) at a few levels. Every
+// clip comes from a fixed seed, so runs and machines see the same
+// samples.
+
+namespace corpus {
+
+const uint32_t kRate = 16000;
+
+struct Clip {
+  std::string name;
+  std::vector<int16_t> pcm;
+  std::vector<bool> speech;     // per sample: inside a syllable
+  size_t speechFrom = 0;        // first and one past the last speech sample
+  size_t speechTo = 0;
+};
+
+// Distributions by hand: the standard library's are free to differ
+// between implementations, mt19937 itself is not
+struct Rng {
+  std::mt19937 gen;
+  explicit Rng(uint32_t seed) : gen(seed) {}
+  double uniform() { return (gen() + 0.5) / 4294967296.0; }
+  double normal() {
+    return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+  }
+};
+
+inline int16_t clamp16(double v) {
+  return (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+}
+
+// Background: white noise of the given RMS, low-passed by `smooth`
+// (0: none; near 1: a rumble)
+inline void addNoise(Clip &c, Rng &rng, double rms, double smooth) {
+  double scale = rms * sqrt(1 - smooth * smooth);
+  double y = 0;
+  for (size_t i = 0; i < c.pcm.size(); i++) {
+    y = smooth * y + scale * rng.normal();
+    c.pcm[i] = clamp16(c.pcm[i] + y);
+  }
+}
+
+// Speech-like syllables from `from` for `seconds`, peak around `level`
+inline void addSpeech(Clip &c, Rng &rng, size_t from, double seconds, double level) {
+  auto u = [&rng]() { return rng.uniform(); };
+  size_t to = from + (size_t)(seconds * kRate);
+  size_t at = from;
+  double phase = 0;
+  while (at < to) {
+    size_t syllable = (size_t)((0.12 + 0.12 * u()) * kRate);
+    size_t gap = (size_t)((0.04 + 0.1 * u()) * kRate);
+    if (at + syllable > to) {
+      syllable = to - at;
+    }
+    double f1 = 400 + 500 * u(), f2 = 1000 + 1200 * u();
+    double f0 = 110 + 90 * u();
+    // Some syllables start with a fricative
+    size_t fricative = u() < 0.3 ? (size_t)(0.04 * kRate) : 0;
+    for (size_t i = 0; i < syllable; i++) {
+      double env = sin(M_PI * i / syllable);
+      double v = 0;
+      if (i < fricative) {
+        v = level / 3 * rng.normal() * env;
+      } else {
+        double pitch = f0 * (1 + 0.1 * sin(2 * M_PI * 3 * i / kRate));
+        phase += 2 * M_PI * pitch / kRate;
+        for (int k = 1; k * pitch < 4000; k++) {
+          double a = exp(-pow((k * pitch - f1) / 150, 2)) + 0.5 * exp(-pow((k * pitch - f2) / 200, 2)) +
+                     0.05 / k;
+          v += a * sin(k * phase);
+        }
+        v *= level * env / 1.5;
+      }
+      c.pcm[at + i] = clamp16(c.pcm[at + i] + v);
+      c.speech[at + i] = true;
+    }
+    at += syllable + gap;
+  }
+  c.speechFrom = from;
+  c.speechTo = to;
+}
+
+inline Clip blank(const char *name, double seconds) {
+  Clip c;
+  c.name = name;
+  c.pcm.assign((size_t)(seconds * kRate), 0);
+  c.speech.assign(c.pcm.size(), false);
+  return c;
+}
+
+inline std::vector<Clip> clips() {
+  std::vector<Clip> out;
+  Rng rng(40);
+  {
+    Clip c = blank("quiet_room", 4);
+    addNoise(c, rng, 20, 0);
+    out.push_back(c);
+  }
+  {
+    Clip c = blank("hiss", 4);
+    addNoise(c, rng, 3000, 0);
+    out.push_back(c);
+  }
+  {
+    Clip c = blank("fan", 4);
+    addNoise(c, rng, 400, 0.9);
+    out.push_back(c);
+  }
+  {
+    Clip c = blank("speech", 5);
+    addSpeech(c, rng, kRate, 2.5, 4000);
+    addNoise(c, rng, 20, 0);
+    out.push_back(c);
+  }
+  {
+    Clip c = blank("quiet_speech", 5);
+    addSpeech(c, rng, kRate, 2.5, 600);
+    addNoise(c, rng, 20, 0);
+    out.push_back(c);
+  }
+  {
+    Clip c = blank("speech_over_fan", 5);
+    addSpeech(c, rng, kRate, 2.5, 4000);
+    addNoise(c, rng, 400, 0.9);
+    out.push_back(c);
+  }
+  {
+    Clip c = blank("loud_speech", 5);
+    addSpeech(c, rng, kRate / 2, 3, 30000);
+    addNoise(c, rng, 50, 0);
+    out.push_back(c);
+  }
+  return out;
+}
+
+}  // namespace corpus
+
+#endif
@@ -0,0 +1,276 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "avi_writer.h"
+
+// Files from the AVI writer parsed back the way a player reads them:
+// the RIFF tree walked chunk by chunk (odd sizes padded), the header
+// counts checked against what was written, and every idx1 entry
+// resolved to its chunk in 'movi'.
+
+namespace {
+
+struct MemorySink {
+  std::vector<uint8_t> file;
+  int refuseEvery = 0;       // refuse every n-th droppable write
+  int droppable = 0;
+
+  AviSink sink() {
+    return { this, write, patch };
+  }
+
+  static bool write(void *ctx, const uint8_t *head, size_t headLen, const uint8_t *body,
+                    size_t bodyLen, bool droppable) {
+    MemorySink *s = (MemorySink *)ctx;
+    if (droppable && s->refuseEvery && ++s->droppable % s->refuseEvery == 0) {
+      return false;
+    }
+    s->file.insert(s->file.end(), head, head + headLen);
+    if (body) {
+      s->file.insert(s->file.end(), body, body + bodyLen);
+    }
+    return true;
+  }
+
+  static bool patch(void *ctx, uint32_t offset, const uint8_t *data, size_t len) {
+    MemorySink *s = (MemorySink *)ctx;
+    if (offset + len > s->file.size()) {
+      return false;
+    }
+    memcpy(s->file.data() + offset, data, len);
+    return true;
+  }
+};
+
+uint32_t le32(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint16_t le16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+std::string fourcc(const uint8_t *p) {
+  return std::string((const char *)p, 4);
+}
+
+struct Chunk {
+  std::string id;
+  uint32_t at;     // of the fourcc
+  uint32_t size;
+};
+
+// The chunks directly inside [from, to), pad bytes skipped
+std::vector<Chunk> chunks(const std::vector<uint8_t> &f, uint32_t from, uint32_t to) {
+  std::vector<Chunk> out;
+  uint32_t at = from;
+  while (at + 8 <= to) {
+    Chunk c = { fourcc(&f[at]), at, le32(&f[at + 4]) };
+    EXPECT_LE(at + 8 + c.size, to) << c.id << " at " << at;
+    out.push_back(c);
+    at += 8 + c.size + (c.size & 1);
+  }
+  EXPECT_EQ(to, at) << "chunks do not tile their parent";
+  return out;
+}
+
+struct Written {
+  std::vector<std::vector<uint8_t>> frames;
+  std::vector<std::vector<uint8_t>> audio;
+  std::vector<bool> order;   // true: audio
+};
+
+// Parses a finished file and checks it against what went in
+void checkFile(const std::vector<uint8_t> &f, const Written &w, uint32_t usPerFrame,
+               uint32_t audioRate, uint16_t width, uint16_t height) {
+  ASSERT_GE(f.size(), 12u);
+  ASSERT_EQ("RIFF", fourcc(&f[0]));
+  ASSERT_EQ(f.size() - 8, le32(&f[4]));
+  ASSERT_EQ("AVI ", fourcc(&f[8]));
+
+  std::vector<Chunk> top = chunks(f, 12, f.size());
+  ASSERT_EQ(3u, top.size());
+  ASSERT_EQ("LIST", top[0].id);
+  ASSERT_EQ("hdrl", fourcc(&f[top[0].at + 8]));
+  ASSERT_EQ("LIST", top[1].id);
+  ASSERT_EQ("movi", fourcc(&f[top[1].at + 8]));
+  ASSERT_EQ("idx1", top[2].id);
+
+  // hdrl: avih, then a strl per stream
+  std::vector<Chunk> hdrl = chunks(f, top[0].at + 12, top[0].at + 8 + top[0].size);
+  ASSERT_EQ(audioRate ? 3u : 2u, hdrl.size());
+  ASSERT_EQ("avih", hdrl[0].id);
+  ASSERT_EQ(56u, hdrl[0].size);
+  const uint8_t *avih = &f[hdrl[0].at + 8];
+  EXPECT_EQ(usPerFrame, le32(avih));
+  EXPECT_EQ(0x10u, le32(avih + 12) & 0x10);          // AVIF_HASINDEX
+  EXPECT_EQ(w.frames.size(), le32(avih + 16));
+  EXPECT_EQ(audioRate ? 2u : 1u, le32(avih + 24));
+  EXPECT_EQ(width, le32(avih + 32));
+  EXPECT_EQ(height, le32(avih + 36));
+
+  uint32_t maxChunk = 0;
+  for (const auto &c : w.frames) {
+    maxChunk = c.size() > maxChunk ? c.size() : maxChunk;
+  }
+  size_t audioBytes = 0;
+  for (const auto &c : w.audio) {
+    maxChunk = c.size() > maxChunk ? c.size() : maxChunk;
+    audioBytes += c.size();
+  }
+  EXPECT_EQ(maxChunk + 8, le32(avih + 28));
+
+  for (size_t s = 1; s < hdrl.size(); s++) {
+    ASSERT_EQ("LIST", hdrl[s].id);
+    ASSERT_EQ("strl", fourcc(&f[hdrl[s].at + 8]));
+    std::vector<Chunk> strl = chunks(f, hdrl[s].at + 12, hdrl[s].at + 8 + hdrl[s].size);
+    ASSERT_EQ(2u, strl.size());
+    ASSERT_EQ("strh", strl[0].id);
+    ASSERT_EQ("strf", strl[1].id);
+    const uint8_t *strh = &f[strl[0].at + 8];
+    const uint8_t *strf = &f[strl[1].at + 8];
+    if (s == 1) {
+      EXPECT_EQ("vids", fourcc(strh));
+      EXPECT_EQ("MJPG", fourcc(strh + 4));
+      EXPECT_EQ(usPerFrame, le32(strh + 20));
+      EXPECT_EQ(1000000u, le32(strh + 24));
+      EXPECT_EQ(w.frames.size(), le32(strh + 32));
+      EXPECT_EQ(40u, strl[1].size);
+      EXPECT_EQ(width, le32(strf + 4));
+      EXPECT_EQ(height, le32(strf + 8));
+      EXPECT_EQ("MJPG", fourcc(strf + 16));
+    } else {
+      EXPECT_EQ("auds", fourcc(strh));
+      EXPECT_EQ(2u, le32(strh + 20));
+      EXPECT_EQ(audioRate * 2, le32(strh + 24));
+      EXPECT_EQ(audioBytes / 2, le32(strh + 32));
+      EXPECT_EQ(1, le16(strf));                       // PCM
+      EXPECT_EQ(1, le16(strf + 2));                   // mono
+      EXPECT_EQ(audioRate, le32(strf + 4));
+      EXPECT_EQ(16, le16(strf + 14));
+    }
+  }
+
+  // movi: the chunks in the order written, with their bytes
+  uint32_t moviAt = top[1].at + 8;
+  std::vector<Chunk> movi = chunks(f, top[1].at + 12, top[1].at + 8 + top[1].size);
+  ASSERT_EQ(w.order.size(), movi.size());
+  size_t fi = 0, ai = 0;
+  for (size_t i = 0; i < movi.size(); i++) {
+    const std::vector<uint8_t> &data = w.order[i] ? w.audio[ai++] : w.frames[fi++];
+    ASSERT_EQ(w.order[i] ? "01wb" : "00dc", movi[i].id) << i;
+    ASSERT_EQ(data.size(), movi[i].size) << i;
+    ASSERT_EQ(0, memcmp(&f[movi[i].at + 8], data.data(), data.size())) << i;
+  }
+
+  // idx1: one entry per chunk, offsets from the 'movi' fourcc
+  ASSERT_EQ(movi.size() * 16, top[2].size);
+  for (size_t i = 0; i < movi.size(); i++) {
+    const uint8_t *e = &f[top[2].at + 8 + i * 16];
+    EXPECT_EQ(movi[i].id, fourcc(e)) << i;
+    EXPECT_EQ(w.order[i] ? 0u : 0x10u, le32(e + 4)) << i;   // AVIIF_KEYFRAME
+    EXPECT_EQ(movi[i].at - moviAt, le32(e + 8)) << i;
+    EXPECT_EQ(movi[i].size, le32(e + 12)) << i;
+  }
+}
+
+// A JPEG-ish frame of the given size
+std::vector<uint8_t> frame(size_t len, int seed) {
+  std::vector<uint8_t> f(len);
+  for (size_t i = 0; i < len; i++) {
+    f[i] = (uint8_t)(i * 31 + seed);
+  }
+  if (len >= 2) {
+    f[0] = 0xFF;
+    f[1] = 0xD8;
+  }
+  return f;
+}
+
+// Frame counts around the index batch size, odd and even chunk sizes
+TEST(AviWriter, ParsesBackForSeveralFrameCounts) {
+  for (uint32_t count : { 0u, 1u, 2u, 31u, 32u, 33u, 64u, 100u }) {
+    for (bool withAudio : { false, true }) {
+      MemorySink sink;
+      std::vector<AviIndexEntry> index(256);
+      AviWriter w;
+      uint32_t rate = withAudio ? 16000 : 0;
+      ASSERT_TRUE(aviBegin(&w, sink.sink(), index.data(), index.size(), 640, 480, 100000, rate));
+
+      Written in;
+      for (uint32_t i = 0; i < count; i++) {
+        in.frames.push_back(frame(1000 + i * 7, i));   // odd every other frame
+        ASSERT_TRUE(aviAddFrame(&w, in.frames.back().data(), in.frames.back().size()));
+        in.order.push_back(false);
+        if (withAudio) {
+          in.audio.push_back(frame(3200 + (i % 3) * 2, i));
+          ASSERT_TRUE(aviAddAudio(&w, in.audio.back().data(), in.audio.back().size()));
+          in.order.push_back(true);
+        }
+      }
+      ASSERT_TRUE(aviEnd(&w, 99000));
+      SCOPED_TRACE(testing::Message() << count << " frames" << (withAudio ? " + audio" : ""));
+      checkFile(sink.file, in, 99000, rate, 640, 480);
+    }
+  }
+}
+
+// A busy sink drops frames; what was dropped is simply absent
+TEST(AviWriter, DroppedFramesLeaveAValidFile) {
+  MemorySink sink;
+  sink.refuseEvery = 3;
+  std::vector<AviIndexEntry> index(64);
+  AviWriter w;
+  ASSERT_TRUE(aviBegin(&w, sink.sink(), index.data(), index.size(), 320, 240, 50000, 0));
+  Written in;
+  for (int i = 0; i < 30; i++) {
+    std::vector<uint8_t> f = frame(501 + i, i);
+    if (aviAddFrame(&w, f.data(), f.size())) {
+      in.frames.push_back(f);
+      in.order.push_back(false);
+    }
+  }
+  EXPECT_EQ(20u, in.frames.size());
+  ASSERT_TRUE(aviEnd(&w, 50000));
+  checkFile(sink.file, in, 50000, 0, 320, 240);
+}
+
+// A full index stops the recording there, and the file still closes
+TEST(AviWriter, FullIndexStopsCleanly) {
+  MemorySink sink;
+  std::vector<AviIndexEntry> index(5);
+  AviWriter w;
+  ASSERT_TRUE(aviBegin(&w, sink.sink(), index.data(), index.size(), 320, 240, 50000, 8000));
+  Written in;
+  for (int i = 0; i < 3; i++) {
+    std::vector<uint8_t> f = frame(777, i), a = frame(1601, i);
+    if (aviAddFrame(&w, f.data(), f.size())) {
+      in.frames.push_back(f);
+      in.order.push_back(false);
+    }
+    if (aviAddAudio(&w, a.data(), a.size())) {
+      a.pop_back();      // odd audio lengths are cut to whole samples
+      in.audio.push_back(a);
+      in.order.push_back(true);
+    }
+  }
+  EXPECT_TRUE(aviIndexFull(&w));
+  EXPECT_EQ(5u, in.order.size());
+  ASSERT_TRUE(aviEnd(&w, 50000));
+  checkFile(sink.file, in, 50000, 8000, 320, 240);
+}
+
+TEST(AviWriter, AudioWithoutAnAudioStreamIsRefused) {
+  MemorySink sink;
+  std::vector<AviIndexEntry> index(4);
+  AviWriter w;
+  ASSERT_TRUE(aviBegin(&w, sink.sink(), index.data(), index.size(), 320, 240, 50000, 0));
+  uint8_t pcm[64] = {};
+  EXPECT_FALSE(aviAddAudio(&w, pcm, sizeof(pcm)));
+  ASSERT_TRUE(aviEnd(&w, 50000));
+  checkFile(sink.file, Written(), 50000, 0, 320, 240);
+}
+
+}  // namespace
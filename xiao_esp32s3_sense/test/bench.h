@@ -0,0 +1,41 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+
+// Timing for the *_bench tests: best of a few rounds, so a busy CI host
+// slows the figure down less than an average would.
+
+#define BENCH_ROUNDS 5
+
+// Keeps a result alive so the compiler cannot drop the work behind it
+inline void benchKeep(uint64_t v) {
+  static volatile uint64_t sink;
+  sink = sink + v;
+}
+
+// Nanoseconds per call of body(i), i counting 0..calls-1 in each round
+template <typename F>
+double benchNs(long calls, F body) {
+  double best = 0;
+  for (int round = 0; round < BENCH_ROUNDS; round++) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (long i = 0; i < calls; i++) {
+      body(i);
+    }
+    std::chrono::duration<double, std::nano> dt = std::chrono::steady_clock::now() - t0;
+    double ns = dt.count() / calls;
+    if (round == 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best;
+}
+
+inline void benchReport(const char *what, double ns, const char *per = "call") {
+  printf("[   BENCH  ] %-44s %12.1f ns/%s\n", what, ns, per);
+}
+
+#endif
@@ -0,0 +1,211 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "boot_status.h"
+
+// Time to advertise and time to the first capture, simulated on the
+// host: setup() and loop() replayed on a millisecond clock against the
+// real boot_status bookkeeping, with each init step taking a random
+// time from the ranges below. Both the boot this firmware does (BLE
+// first, peripherals in parallel) and the one it replaced (USB wait,
+// then camera, audio, SD, crypto, BLE in turn, halting on a failure)
+// are run over the same 1000 draws.
+//
+// The ranges are assumptions, not measurements: replace them with the
+// boot.*_ms metrics of a real device to get its figures.
+
+namespace {
+
+struct Range {
+  uint32_t lo, hi;
+};
+
+const Range kArena = { 2, 5 };
+const Range kCrypto = { 5, 15 };         // NVS read
+const Range kBle = { 250, 450 };         // Bluedroid up, advertising
+const Range kCamera = { 400, 900 };      // sensor probe, frame buffers
+const Range kAudio = { 20, 60 };         // I2S PDM
+const Range kSd = { 150, 1200 };         // mount, card dependent
+const Range kSdMissing = { 1000, 1500 }; // mount timeout
+const Range kConnect = { 300, 1500 };    // phone scan, connect, subscribe
+const Range kCapture = { 300, 600 };     // first frame, exposure settling
+
+struct Draw {
+  uint32_t arena, crypto, ble, camera, audio, sd, connect, capture;
+  bool sdFails;
+};
+
+Draw draw(std::mt19937 &rng, bool sdMissing) {
+  auto t = [&rng](Range r) { return r.lo + (uint32_t)(rng() % (r.hi - r.lo + 1)); };
+  Draw d;
+  d.arena = t(kArena);
+  d.crypto = t(kCrypto);
+  d.ble = t(kBle);
+  d.camera = t(kCamera);
+  d.audio = t(kAudio);
+  d.sd = t(sdMissing ? kSdMissing : kSd);
+  d.connect = t(kConnect);
+  d.capture = t(kCapture);
+  d.sdFails = sdMissing;
+  return d;
+}
+
+struct Mark {
+  uint32_t at;
+  BootSubsystem s;
+  BootState state;
+};
+
+struct Outcome {
+  uint32_t advertiseMs;
+  uint32_t firstCaptureMs;   // UINT32_MAX: never
+};
+
+void bootReset() {
+  for (int i = 0; i < BOOT_SUBSYSTEM_COUNT; i++) {
+    bootMark((BootSubsystem)i, BOOT_PENDING, 0);
+  }
+}
+
+// The phone connects once advertising starts and asks for a photo at
+// once; loop() holds the command until bootSettled(BOOT_CAMERA), as in
+// the sketch. Marks are applied when the clock reaches them.
+Outcome run(std::vector<Mark> marks, uint32_t loopFromMs, const Draw &d) {
+  bootReset();
+  std::sort(marks.begin(), marks.end(), [](const Mark &a, const Mark &b) { return a.at < b.at; });
+  uint32_t advertise = UINT32_MAX;
+  for (const Mark &m : marks) {
+    if (m.s == BOOT_BLE && m.state == BOOT_READY) {
+      advertise = m.at;
+    }
+  }
+  uint32_t commandMs = advertise + d.connect;
+
+  Outcome out = { advertise, UINT32_MAX };
+  size_t next = 0;
+  for (uint32_t now = 0; now < 20000; now++) {
+    while (next < marks.size() && marks[next].at <= now) {
+      bootMark(marks[next].s, marks[next].state, marks[next].at);
+      next++;
+    }
+    if (out.firstCaptureMs == UINT32_MAX && now >= loopFromMs && now >= commandMs &&
+        bootReady(BOOT_CAMERA)) {
+      out.firstCaptureMs = now + d.capture;
+    }
+    if (next == marks.size() && out.firstCaptureMs != UINT32_MAX) {
+      break;      // boot has settled too, for the report
+    }
+  }
+  return out;
+}
+
+// setup() as it is: arena, crypto, BLE, then the three peripherals in
+// their own tasks; loop() runs as soon as setup() returns
+Outcome bleFirst(const Draw &d) {
+  std::vector<Mark> m;
+  uint32_t t = 0;
+  m.push_back({ t, BOOT_ARENA, BOOT_RUNNING });
+  t += d.arena;
+  m.push_back({ t, BOOT_ARENA, BOOT_READY });
+  t += d.crypto;
+  m.push_back({ t, BOOT_BLE, BOOT_RUNNING });
+  t += d.ble;
+  m.push_back({ t, BOOT_BLE, BOOT_READY });
+  m.push_back({ t, BOOT_CAMERA, BOOT_RUNNING });
+  m.push_back({ t, BOOT_AUDIO, BOOT_RUNNING });
+  m.push_back({ t, BOOT_SD, BOOT_RUNNING });
+  m.push_back({ t + d.camera, BOOT_CAMERA, BOOT_READY });
+  m.push_back({ t + d.audio, BOOT_AUDIO, BOOT_READY });
+  m.push_back({ t + d.sd, BOOT_SD, d.sdFails ? BOOT_FAILED : BOOT_READY });
+  return run(m, t, d);
+}
+
+// The setup() it replaced: every step in turn, BLE last, and a halt if
+// any peripheral failed. The USB wait is taken as satisfied at once (a
+// necklace on battery never got past it).
+Outcome sequential(const Draw &d) {
+  std::vector<Mark> m;
+  uint32_t t = 0;
+  const struct {
+    BootSubsystem s;
+    uint32_t ms;
+  } steps[] = { { BOOT_ARENA, d.arena }, { BOOT_CAMERA, d.camera }, { BOOT_AUDIO, d.audio },
+                { BOOT_SD, d.sd } };
+  for (const auto &step : steps) {
+    m.push_back({ t, step.s, BOOT_RUNNING });
+    t += step.ms;
+    bool fails = step.s == BOOT_SD && d.sdFails;
+    m.push_back({ t, step.s, fails ? BOOT_FAILED : BOOT_READY });
+    if (fails) {
+      return run(m, UINT32_MAX, d);    // while (1);
+    }
+  }
+  t += d.crypto;
+  m.push_back({ t, BOOT_BLE, BOOT_RUNNING });
+  t += d.ble;
+  m.push_back({ t, BOOT_BLE, BOOT_READY });
+  return run(m, t, d);
+}
+
+uint32_t percentile(std::vector<uint32_t> v, int p) {
+  std::sort(v.begin(), v.end());
+  return v[(v.size() - 1) * p / 100];
+}
+
+void report(const char *what, const std::vector<uint32_t> &ms) {
+  printf("[   BENCH  ] %-44s median %5u ms, p95 %5u ms\n", what, percentile(ms, 50),
+         percentile(ms, 95));
+}
+
+TEST(BootStatusBench, TimeToAdvertiseAndFirstCapture) {
+  std::mt19937 rng(41);
+  std::vector<uint32_t> advNew, advOld, capNew, capOld;
+  for (int i = 0; i < 1000; i++) {
+    Draw d = draw(rng, false);
+    Outcome now = bleFirst(d), before = sequential(d);
+    ASSERT_LE(now.advertiseMs, before.advertiseMs);
+    ASSERT_LE(now.firstCaptureMs, before.firstCaptureMs);
+    // Advertising no longer waits for any peripheral
+    ASSERT_EQ(d.arena + d.crypto + d.ble, now.advertiseMs);
+    advNew.push_back(now.advertiseMs);
+    advOld.push_back(before.advertiseMs);
+    capNew.push_back(now.firstCaptureMs);
+    capOld.push_back(before.firstCaptureMs);
+  }
+  report("advertise, BLE first", advNew);
+  report("advertise, sequential (before)", advOld);
+  report("first capture, BLE first", capNew);
+  report("first capture, sequential (before)", capOld);
+  EXPECT_LT(percentile(advNew, 95), percentile(advOld, 50));
+  EXPECT_LT(percentile(capNew, 50), percentile(capOld, 50));
+}
+
+// No SD card: the old boot never got to advertise; now the first
+// capture does not wait for the mount to time out
+TEST(BootStatusBench, MissingCardDoesNotDelayTheFirstCapture) {
+  std::mt19937 rng(4141);
+  std::vector<uint32_t> cap;
+  for (int i = 0; i < 1000; i++) {
+    Draw d = draw(rng, true);
+    Outcome before = sequential(d);
+    EXPECT_EQ(UINT32_MAX, before.advertiseMs);
+    EXPECT_EQ(UINT32_MAX, before.firstCaptureMs);
+
+    Outcome now = bleFirst(d);
+    uint32_t cameraReady = now.advertiseMs + d.camera;
+    uint32_t command = now.advertiseMs + d.connect;
+    ASSERT_EQ(std::max(cameraReady, command) + d.capture, now.firstCaptureMs);
+    cap.push_back(now.firstCaptureMs);
+  }
+  report("first capture without a card, BLE first", cap);
+
+  char text[192];
+  formatBootReport(text, sizeof(text));
+  EXPECT_NE(nullptr, strstr(text, "camera=ok@"));
+  EXPECT_NE(nullptr, strstr(text, "sd=fail@"));
+}
+
+}  // namespace
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <vector>
+#include "camera_power.h"
+
+// When a camera coming out of standby counts as settled: the JPEG sizes
+// of the frames it drops, as the auto exposure converges, a scene that
+// jumps, and one that never holds still.
+
+namespace {
+
+// Frames fed until settleObserve() says settled, or 0 if it never does
+int framesToSettle(const std::vector<uint32_t> &sizes) {
+  SettleTracker t;
+  settleBegin(&t);
+  for (size_t i = 0; i < sizes.size(); i++) {
+    if (settleObserve(&t, sizes[i])) {
+      EXPECT_EQ(i + 1, t.frames);
+      return (int)(i + 1);
+    }
+  }
+  return 0;
+}
+
+// The first frame has nothing to compare with; two similar ones after it
+TEST(CameraSettle, SteadySceneSettlesAtOnce) {
+  EXPECT_EQ(1 + CAM_SETTLE_STABLE_FRAMES, framesToSettle({ 50000, 50000, 50000, 50000 }));
+  EXPECT_EQ(3, framesToSettle({ 50000, 51000, 49500, 50000 }));
+}
+
+// Exposure ramping up from dark: sizes grow by less each frame, and the
+// camera counts as settled once two steps in a row are within 6%
+TEST(CameraSettle, ConvergingExposure) {
+  EXPECT_EQ(5, framesToSettle({ 20000, 40000, 52000, 54000, 55000, 55200, 55300 }));
+  EXPECT_EQ(6, framesToSettle({ 10000, 20000, 30000, 40000, 41000, 41500, 41600 }));
+}
+
+// A large step breaks a run that had started
+TEST(CameraSettle, JumpRestartsTheRun) {
+  EXPECT_EQ(5, framesToSettle({ 50000, 50500, 80000, 80500, 80000, 80000 }));
+}
+
+// The tolerance is inclusive, in thousandths of the previous size
+TEST(CameraSettle, ToleranceEdge) {
+  const uint32_t base = 100000;
+  const uint32_t edge = base * CAM_SETTLE_TOLERANCE_PERMILLE / 1000;
+  EXPECT_EQ(3, framesToSettle({ base, base + edge, base }));
+  EXPECT_EQ(3, framesToSettle({ base, base - edge, base - edge }));
+  EXPECT_EQ(4, framesToSettle({ base, base + edge + 1, base + edge + 1, base + edge + 1 }));
+}
+
+// A flickering scene is given up on after CAM_SETTLE_MAX_FRAMES, so a
+// capture never stalls on it
+TEST(CameraSettle, FlickerStopsAtTheCap) {
+  std::vector<uint32_t> flicker;
+  for (int i = 0; i < 40; i++) {
+    flicker.push_back(i % 2 ? 30000 : 60000);
+  }
+  EXPECT_EQ(CAM_SETTLE_MAX_FRAMES, framesToSettle(flicker));
+
+  // Empty frames (a covered lens) count as unsettled too, but still end
+  std::vector<uint32_t> dark(40, 0);
+  EXPECT_EQ(CAM_SETTLE_MAX_FRAMES, framesToSettle(dark));
+}
+
+// Each wake starts from nothing
+TEST(CameraSettle, BeginResets) {
+  SettleTracker t;
+  settleBegin(&t);
+  settleObserve(&t, 50000);
+  settleObserve(&t, 50000);
+  settleBegin(&t);
+  EXPECT_EQ(0, t.frames);
+  EXPECT_EQ(0, t.stableRun);
+  EXPECT_EQ(0u, t.lastLen);
+  EXPECT_FALSE(settleObserve(&t, 50000));
+  EXPECT_FALSE(settleObserve(&t, 90000));
+}
+
+}  // namespace
@@ -0,0 +1,154 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "bench.h"
+#include "capture_catalog.h"
+
+// The catalog at 100k captures, over an in-memory file that counts its
+// reads: on the card each read is a seek and at least one sector, so
+// reads per operation is the figure that carries over; host time is
+// reported beside it. One append in 100 fails, leaving a gap in the IDs
+// as a failed write on the card does. Also the name parsing behind the
+// directory scan that seeds a new catalog.
+
+namespace {
+
+const uint32_t kEntries = 100000;
+const uint32_t kStart = 1700000000;
+
+struct CountingFile {
+  std::vector<uint8_t> bytes;
+  uint64_t reads = 0;
+  uint32_t writes = 0;
+  uint32_t failEvery = 0;    // refuse every n-th write
+
+  CatalogStore store() {
+    return { this, read, write };
+  }
+
+  static bool read(void *ctx, uint32_t offset, uint8_t *buf, size_t len) {
+    CountingFile *f = (CountingFile *)ctx;
+    f->reads++;
+    if (offset + len > f->bytes.size()) {
+      return false;
+    }
+    memcpy(buf, f->bytes.data() + offset, len);
+    return true;
+  }
+
+  static bool write(void *ctx, uint32_t offset, const uint8_t *buf, size_t len) {
+    CountingFile *f = (CountingFile *)ctx;
+    if (f->failEvery && ++f->writes % f->failEvery == 0) {
+      return false;
+    }
+    if (offset + len > f->bytes.size()) {
+      f->bytes.resize(offset + len);
+    }
+    memcpy(f->bytes.data() + offset, buf, len);
+    return true;
+  }
+};
+
+// 100k captures a few seconds apart; the IDs that were filed
+std::vector<uint32_t> fill(CountingFile &file, Catalog *c) {
+  std::vector<uint32_t> filed;
+  EXPECT_TRUE(catalogOpen(c, file.store(), 0, 1));
+  file.failEvery = 100;
+  CatalogEntry e;
+  for (uint32_t i = 0; filed.size() < kEntries; i++) {
+    if (catalogAppend(c, CAPTURE_PHOTO, kStart + i * 5, &e)) {
+      filed.push_back(e.id);
+    }
+  }
+  file.failEvery = 0;
+  return filed;
+}
+
+void report(const char *what, double ns, double reads) {
+  printf("[   BENCH  ] %-44s %10.1f ns/op %6.2f reads/op\n", what, ns, reads);
+}
+
+TEST(CaptureCatalogBench, HundredThousandEntries) {
+  CountingFile file;
+  Catalog c;
+  double append = benchNs(1, [&](long) {
+    file.bytes.clear();
+    fill(file, &c);
+  });
+  std::vector<uint32_t> filed = fill(file, &c);
+  ASSERT_EQ(kEntries, c.count);
+  report("catalogAppend (100k, 1% failed)", append / kEntries, 0);
+
+  Catalog opened;
+  file.reads = 0;
+  double open = benchNs(100, [&](long) {
+    benchKeep(catalogOpen(&opened, file.store(), file.bytes.size(), 1));
+  });
+  EXPECT_EQ(filed.back() + 1, opened.nextId);
+  report("catalogOpen", open, file.reads / (100.0 * BENCH_ROUNDS));
+
+  std::mt19937 rng(46);
+  std::vector<uint32_t> ids(10000);
+  for (uint32_t &id : ids) {
+    id = filed[rng() % filed.size()];
+  }
+  CatalogEntry e;
+  file.reads = 0;
+  size_t found = 0;
+  double get = benchNs(ids.size(), [&](long i) { found += catalogGet(&opened, ids[i], &e); });
+  EXPECT_EQ(ids.size() * BENCH_ROUNDS, found);
+  double getReads = file.reads / (double)(ids.size() * BENCH_ROUNDS);
+  report("catalogGet, random ID", get, getReads);
+  // The search covers the 1000 gaps, not the 100k records
+  EXPECT_LE(getReads, 14);
+
+  // The newest capture, as catalogFinishCapture() asks for
+  file.reads = 0;
+  double newest = benchNs(1000, [&](long) { found += catalogGet(&opened, filed.back(), &e); });
+  double newestReads = file.reads / (1000.0 * BENCH_ROUNDS);
+  report("catalogGet, newest", newest, newestReads);
+  EXPECT_EQ(2, newestReads);   // the lookup and the record
+
+  std::vector<uint32_t> times(10000);
+  for (uint32_t &t : times) {
+    t = kStart + rng() % (kEntries * 5);
+  }
+  file.reads = 0;
+  double bound = benchNs(times.size(), [&](long i) { benchKeep(catalogLowerBound(&opened, times[i])); });
+  double boundReads = file.reads / (double)(times.size() * BENCH_ROUNDS);
+  report("catalogLowerBound, random time", bound, boundReads);
+  EXPECT_LE(boundReads, 18);
+
+  CatalogEntry page[CATALOG_QUERY_MAX];
+  file.reads = 0;
+  double read = benchNs(10000, [&](long i) {
+    benchKeep(catalogRead(&opened, (i * 7919) % (kEntries - CATALOG_QUERY_MAX), page, CATALOG_QUERY_MAX));
+  });
+  report("catalogRead, one 32-record page", read, file.reads / (10000.0 * BENCH_ROUNDS));
+}
+
+// What a directory scan spends per file name on top of listing it
+TEST(CaptureCatalogBench, ScanNames) {
+  std::vector<std::string> names;
+  char path[32];
+  for (uint32_t id = 1; id <= kEntries; id++) {
+    capturePath(path, sizeof(path), id, id % 3 == 0 ? CAPTURE_AUDIO : CAPTURE_PHOTO);
+    names.push_back(path + 1);
+    if (id % 3 != 0) {
+      captureThumbPath(path, sizeof(path), id);
+      names.push_back(path + 1);
+    }
+  }
+  uint32_t highest = 0;
+  double ns = benchNs(names.size(), [&](long i) {
+    uint32_t id = captureIdOf(names[i].c_str());
+    highest = id > highest ? id : highest;
+  });
+  EXPECT_EQ(kEntries, highest);
+  benchReport("captureIdOf", ns, "name");
+}
+
+}  // namespace
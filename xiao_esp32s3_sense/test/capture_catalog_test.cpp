@@ -0,0 +1,184 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "capture_catalog.h"
+
+// The capture catalog over an in-memory file, and the file-name parsing
+// catalogMount() uses to number on from what is already on the card.
+
+namespace {
+
+struct MemoryFile {
+  std::vector<uint8_t> bytes;
+  bool refuse = false;      // writes fail, as on a full or failing card
+
+  CatalogStore store() {
+    return { this, read, write };
+  }
+
+  static bool read(void *ctx, uint32_t offset, uint8_t *buf, size_t len) {
+    MemoryFile *f = (MemoryFile *)ctx;
+    if (offset + len > f->bytes.size()) {
+      return false;
+    }
+    memcpy(buf, f->bytes.data() + offset, len);
+    return true;
+  }
+
+  static bool write(void *ctx, uint32_t offset, const uint8_t *buf, size_t len) {
+    MemoryFile *f = (MemoryFile *)ctx;
+    if (f->refuse) {
+      return false;
+    }
+    if (offset + len > f->bytes.size()) {
+      f->bytes.resize(offset + len);
+    }
+    memcpy(f->bytes.data() + offset, buf, len);
+    return true;
+  }
+};
+
+const uint32_t kNow = 1700000000;
+
+TEST(CaptureCatalog, IdOfCaptureFileNames) {
+  char path[32];
+  for (uint32_t id : { 1u, 42u, 999999u, 1000000u, 4294967295u }) {
+    for (uint8_t type : { CAPTURE_PHOTO, CAPTURE_AUDIO, CAPTURE_VIDEO }) {
+      capturePath(path, sizeof(path), id, type);
+      EXPECT_EQ(id, captureIdOf(path)) << path;
+      EXPECT_EQ(id, captureIdOf(path + 1)) << "without the directory";
+    }
+    captureThumbPath(path, sizeof(path), id);
+    EXPECT_EQ(id, captureIdOf(path));
+  }
+  EXPECT_EQ(17u, captureIdOf("photo_000017.ref"));
+  EXPECT_EQ(17u, captureIdOf("/sub/dir/clip_000017.avi"));
+
+  EXPECT_EQ(0u, captureIdOf("/catalog.idx"));
+  EXPECT_EQ(0u, captureIdOf("/catalog.bad"));
+  EXPECT_EQ(0u, captureIdOf("photo_.jpg"));
+  EXPECT_EQ(0u, captureIdOf("photo_12"));
+  EXPECT_EQ(0u, captureIdOf("photo_12x.jpg"));
+  EXPECT_EQ(0u, captureIdOf("photo_4294967296.jpg"));
+  EXPECT_EQ(0u, captureIdOf("image_000001.jpg"));
+  EXPECT_EQ(0u, captureIdOf("System Volume Information"));
+}
+
+// A new catalog on a card that already holds captures (the old catalog
+// lost or set aside) numbers on after them instead of from 1
+TEST(CaptureCatalog, NewCatalogNumbersOnFromTheCard) {
+  const char *onCard[] = { "photo_000001.jpg", "photo_000001.thm", "audio_000002.wav",
+                           "clip_000007.avi", "photo_000009.ref", "catalog.bad" };
+  uint32_t highest = 0;
+  for (const char *name : onCard) {
+    highest = captureIdOf(name) > highest ? captureIdOf(name) : highest;
+  }
+  ASSERT_EQ(9u, highest);
+
+  MemoryFile file;
+  Catalog c;
+  ASSERT_TRUE(catalogOpen(&c, file.store(), 0, highest + 1));
+  CatalogEntry e;
+  ASSERT_TRUE(catalogAppend(&c, CAPTURE_PHOTO, kNow, &e));
+  EXPECT_EQ(10u, e.id);
+
+  // Reopened, it goes on from its own records
+  Catalog again;
+  ASSERT_TRUE(catalogOpen(&again, file.store(), file.bytes.size(), 1));
+  EXPECT_EQ(10u, again.firstId);
+  EXPECT_EQ(11u, again.nextId);
+  ASSERT_TRUE(catalogGet(&again, 10, &e));
+  EXPECT_EQ(CAPTURE_PHOTO, e.type);
+}
+
+// A header with no records is as good as no file: the seed applies
+TEST(CaptureCatalog, EmptyCatalogTakesTheSeed) {
+  MemoryFile file;
+  Catalog c;
+  ASSERT_TRUE(catalogOpen(&c, file.store(), 0, 1));
+  ASSERT_EQ((size_t)CATALOG_HEADER_SIZE, file.bytes.size());
+  ASSERT_TRUE(catalogOpen(&c, file.store(), file.bytes.size(), 500));
+  EXPECT_EQ(500u, c.nextId);
+}
+
+TEST(CaptureCatalog, TornRecordIsIgnored) {
+  MemoryFile file;
+  Catalog c;
+  ASSERT_TRUE(catalogOpen(&c, file.store(), 0, 1));
+  CatalogEntry e;
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(catalogAppend(&c, CAPTURE_AUDIO, kNow + i, &e));
+  }
+  file.bytes.resize(file.bytes.size() - 5);
+  ASSERT_TRUE(catalogOpen(&c, file.store(), file.bytes.size(), 1));
+  EXPECT_EQ(2u, c.count);
+  EXPECT_EQ(3u, c.nextId);
+}
+
+// Failed appends leave gaps; every filed ID is still found, and none
+// of the missing ones
+TEST(CaptureCatalog, LookupAcrossGaps) {
+  MemoryFile file;
+  Catalog c;
+  ASSERT_TRUE(catalogOpen(&c, file.store(), 0, 5));
+  std::vector<bool> filed(1, false);
+  CatalogEntry e;
+  for (uint32_t i = 0; i < 2000; i++) {
+    file.refuse = i % 37 == 0 || (i > 1500 && i < 1530) || i == 1999;
+    EXPECT_NE(file.refuse, catalogAppend(&c, CAPTURE_PHOTO, kNow + i, &e));
+    filed.resize(e.id + 1, false);
+    filed[e.id] = !file.refuse;
+  }
+  for (uint32_t id = 0; id < c.nextId + 3; id++) {
+    bool expect = id < filed.size() && filed[id];
+    ASSERT_EQ(expect, catalogGet(&c, id, &e)) << id;
+    if (expect) {
+      ASSERT_EQ(id, e.id);
+    }
+  }
+}
+
+TEST(CaptureCatalog, ForeignFileIsRefused) {
+  MemoryFile file;
+  file.bytes.assign(64, 0x5A);
+  Catalog c;
+  EXPECT_FALSE(catalogOpen(&c, file.store(), file.bytes.size(), 1));
+}
+
+// Times never run backwards, and an unset clock repeats the last time
+TEST(CaptureCatalog, TimesStayInOrder) {
+  MemoryFile file;
+  Catalog c;
+  ASSERT_TRUE(catalogOpen(&c, file.store(), 0, 1));
+  CatalogEntry e;
+  ASSERT_TRUE(catalogAppend(&c, CAPTURE_PHOTO, kNow, &e));
+  ASSERT_TRUE(catalogAppend(&c, CAPTURE_PHOTO, kNow - 100, &e));
+  EXPECT_EQ(kNow, e.time);
+  ASSERT_TRUE(catalogAppend(&c, CAPTURE_PHOTO, 5, &e));
+  EXPECT_EQ(kNow, e.time);
+  EXPECT_TRUE(e.flags & CATALOG_FLAG_ESTIMATED);
+  ASSERT_TRUE(catalogAppend(&c, CAPTURE_PHOTO, kNow + 60, &e));
+  EXPECT_EQ(0u, catalogLowerBound(&c, kNow));
+  EXPECT_EQ(3u, catalogLowerBound(&c, kNow + 1));
+  EXPECT_EQ(4u, catalogLowerBound(&c, kNow + 61));
+}
+
+TEST(CaptureCatalog, FinishPatchesSizeAndFlags) {
+  MemoryFile file;
+  Catalog c;
+  ASSERT_TRUE(catalogOpen(&c, file.store(), 0, 1));
+  CatalogEntry e;
+  ASSERT_TRUE(catalogAppend(&c, CAPTURE_VIDEO, kNow, &e));
+  EXPECT_TRUE(e.flags & CATALOG_FLAG_PENDING);
+  e.size = 123456;
+  e.flags = CATALOG_FLAG_SEALED;
+  e.time = 1;   // not rewritten
+  ASSERT_TRUE(catalogUpdate(&c, e));
+  ASSERT_TRUE(catalogGet(&c, e.id, &e));
+  EXPECT_EQ(123456u, e.size);
+  EXPECT_EQ(CATALOG_FLAG_SEALED, e.flags);
+  EXPECT_EQ(kNow, e.time);
+}
+
+}  // namespace
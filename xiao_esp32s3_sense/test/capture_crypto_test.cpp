@@ -0,0 +1,291 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "capture_crypto.h"
+
+// The software AES-256-GCM, HMAC-SHA256 and HKDF behind sealed captures
+// (the path the phone's native library opens them with) against the
+// published known answers, then the sealed format: any split of the
+// data, and what a changed byte or a wrong key does to cryptoOpen().
+
+namespace {
+
+std::vector<uint8_t> hex(const char *s) {
+  std::vector<uint8_t> out;
+  for (size_t i = 0; s[i] && s[i + 1]; i += 2) {
+    out.push_back((uint8_t)std::stoi(std::string(s + i, 2), nullptr, 16));
+  }
+  return out;
+}
+
+std::vector<uint8_t> bytes(const char *s) {
+  return std::vector<uint8_t>(s, s + strlen(s));
+}
+
+std::vector<uint8_t> repeat(uint8_t b, size_t n) {
+  return std::vector<uint8_t>(n, b);
+}
+
+std::vector<uint8_t> counting(uint8_t from, size_t n) {
+  std::vector<uint8_t> out(n);
+  for (size_t i = 0; i < n; i++) {
+    out[i] = (uint8_t)(from + i);
+  }
+  return out;
+}
+
+// Seals data with an explicit key and IV in one call; returns the tag
+std::vector<uint8_t> gcm(const std::vector<uint8_t> &key, const std::vector<uint8_t> &iv,
+                         std::vector<uint8_t> &data, bool decrypt) {
+  CaptureCipher c;
+  EXPECT_TRUE(cryptoBeginKey(&c, key.data(), iv.data(), decrypt));
+  EXPECT_TRUE(cryptoUpdate(&c, data.data(), data.size()));
+  std::vector<uint8_t> tag(CRYPTO_TAG_SIZE);
+  EXPECT_TRUE(cryptoFinish(&c, tag.data()));
+  return tag;
+}
+
+struct GcmVector {
+  const char *name, *key, *iv, *plain, *cipher, *tag;
+};
+
+// The GCM specification's AES-256 cases without additional data (test
+// cases 13-15); the last is case 16's 60-byte plaintext without its AAD,
+// tag from OpenSSL, for a partial final block
+const GcmVector kGcm[] = {
+  { "TC13", "0000000000000000000000000000000000000000000000000000000000000000",
+    "000000000000000000000000", "", "", "530f8afbc74536b9a963b4f1c4cb738b" },
+  { "TC14", "0000000000000000000000000000000000000000000000000000000000000000",
+    "000000000000000000000000", "00000000000000000000000000000000",
+    "cea7403d4d606b6e074ec5d3baf39d18", "d0d1c8a799996bf0265b98b5d48ab919" },
+  { "TC15", "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308",
+    "cafebabefacedbaddecaf888",
+    "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+    "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b391aafd255",
+    "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+    "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662898015ad",
+    "b094dac5d93471bdec1a502270e3cc6c" },
+  { "TC16 text, no AAD", "feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308",
+    "cafebabefacedbaddecaf888",
+    "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+    "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+    "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+    "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662",
+    "eb9f796c8d356fc31a8433884b696f4f" },
+};
+
+TEST(CaptureCrypto, GcmKnownAnswers) {
+  for (const GcmVector &v : kGcm) {
+    SCOPED_TRACE(v.name);
+    std::vector<uint8_t> data = hex(v.plain);
+    EXPECT_EQ(hex(v.tag), gcm(hex(v.key), hex(v.iv), data, false));
+    EXPECT_EQ(hex(v.cipher), data);
+    EXPECT_EQ(hex(v.tag), gcm(hex(v.key), hex(v.iv), data, true));
+    EXPECT_EQ(hex(v.plain), data);
+  }
+}
+
+// RFC 4231 test cases 1-7 (case 5 compares the truncated 128 bits)
+TEST(CaptureCrypto, HmacSha256Rfc4231) {
+  struct {
+    std::vector<uint8_t> key, data;
+    const char *mac;
+  } cases[] = {
+    { repeat(0x0b, 20), bytes("Hi There"),
+      "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7" },
+    { bytes("Jefe"), bytes("what do ya want for nothing?"),
+      "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843" },
+    { repeat(0xaa, 20), repeat(0xdd, 50),
+      "773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe" },
+    { counting(0x01, 25), repeat(0xcd, 50),
+      "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b" },
+    { repeat(0x0c, 20), bytes("Test With Truncation"), "a3b6167473100ee06e0c796c2955552b" },
+    { repeat(0xaa, 131), bytes("Test Using Larger Than Block-Size Key - Hash Key First"),
+      "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54" },
+    { repeat(0xaa, 131),
+      bytes("This is a test using a larger than block-size key and a larger than block-size "
+            "data. The key needs to be hashed before being used by the HMAC algorithm."),
+      "9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2" },
+  };
+  int n = 1;
+  for (const auto &c : cases) {
+    SCOPED_TRACE(n++);
+    uint8_t mac[32];
+    cryptoHmacSha256(c.key.data(), c.key.size(), c.data.data(), c.data.size(), mac);
+    std::vector<uint8_t> expect = hex(c.mac);
+    EXPECT_EQ(expect, std::vector<uint8_t>(mac, mac + expect.size()));
+  }
+}
+
+// RFC 5869 test cases 1-3 (SHA-256)
+TEST(CaptureCrypto, HkdfRfc5869) {
+  struct {
+    std::vector<uint8_t> ikm, salt, info;
+    const char *okm;
+  } cases[] = {
+    { repeat(0x0b, 22), counting(0x00, 13), counting(0xf0, 10),
+      "3cb25f25faacd57a90434f64d0362f2a2d2d0a90cf1a5a4c5db02d56ecc4c5bf"
+      "34007208d5b887185865" },
+    { counting(0x00, 80), counting(0x60, 80), counting(0xb0, 80),
+      "b11e398dc80327a1c8e7f78c596a49344f012eda2d4efad8a050cc4c19afa97c"
+      "59045a99cac7827271cb41c65e590e09da3275600c2f09b8367793a9aca3db71"
+      "cc30c58179ec3e87c14c01d5c1f3434f1d87" },
+    { repeat(0x0b, 22), {}, {},
+      "8da4e775a563c18f715f802a063c5a31b8a11f5c5ee1879ec3454e5f3c738d2d"
+      "9d201395faa4b61a96c8" },
+  };
+  int n = 1;
+  for (const auto &c : cases) {
+    SCOPED_TRACE(n++);
+    std::vector<uint8_t> expect = hex(c.okm);
+    std::vector<uint8_t> okm(expect.size());
+    ASSERT_TRUE(cryptoHkdfSha256(c.salt.data(), c.salt.size(), c.ikm.data(), c.ikm.size(),
+                                 c.info.data(), c.info.size(), okm.data(), okm.size()));
+    EXPECT_EQ(expect, okm);
+  }
+
+  uint8_t okm[32];
+  std::vector<uint8_t> longInfo(CRYPTO_HKDF_INFO_MAX + 1);
+  EXPECT_FALSE(cryptoHkdfSha256(nullptr, 0, okm, sizeof(okm), longInfo.data(), longInfo.size(),
+                                okm, sizeof(okm)));
+}
+
+const uint8_t kMaster[CRYPTO_KEY_SIZE] = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88 };
+
+// Seals plain as the device does: cipher from the master key and a
+// salt, the trailer after the ciphertext
+std::vector<uint8_t> seal(const std::vector<uint8_t> &plain, uint8_t saltByte) {
+  uint8_t salt[CRYPTO_SALT_SIZE];
+  memset(salt, saltByte, sizeof(salt));
+  std::vector<uint8_t> buf(plain);
+  CaptureCipher c;
+  EXPECT_TRUE(cryptoBegin(&c, kMaster, salt, false));
+  EXPECT_TRUE(cryptoUpdate(&c, buf.data(), buf.size()));
+  uint8_t tag[CRYPTO_TAG_SIZE];
+  EXPECT_TRUE(cryptoFinish(&c, tag));
+  buf.resize(plain.size() + CRYPTO_SEAL_SIZE);
+  cryptoWriteTrailer(buf.data() + plain.size(), salt, tag);
+  return buf;
+}
+
+// Camera frames, audio chunks and SD reads arrive in pieces of any size
+TEST(CaptureCrypto, AnySplitGivesTheSameResult) {
+  std::mt19937 rng(39);
+  std::vector<uint8_t> plain(10007);
+  for (uint8_t &b : plain) {
+    b = (uint8_t)rng();
+  }
+  std::vector<uint8_t> whole = seal(plain, 7);
+  uint8_t salt[CRYPTO_SALT_SIZE];
+  memset(salt, 7, sizeof(salt));
+
+  for (int trial = 0; trial < 200; trial++) {
+    for (bool decrypt : { false, true }) {
+      std::vector<uint8_t> buf(decrypt ? std::vector<uint8_t>(whole.begin(), whole.end() - CRYPTO_SEAL_SIZE)
+                                       : plain);
+      CaptureCipher c;
+      ASSERT_TRUE(cryptoBegin(&c, kMaster, salt, decrypt));
+      size_t at = 0;
+      while (at < buf.size()) {
+        // Mostly odd small pieces, some empty, some past a block
+        size_t n = rng() % 4 == 0 ? rng() % 600 : rng() % 40;
+        n = std::min(n, buf.size() - at);
+        ASSERT_TRUE(cryptoUpdate(&c, buf.data() + at, n));
+        at += n;
+      }
+      uint8_t tag[CRYPTO_TAG_SIZE];
+      ASSERT_TRUE(cryptoFinish(&c, tag));
+      const uint8_t *expect = decrypt ? plain.data() : whole.data();
+      ASSERT_EQ(0, memcmp(expect, buf.data(), buf.size())) << "trial " << trial;
+      ASSERT_EQ(0, memcmp(whole.data() + plain.size() + CRYPTO_SALT_SIZE, tag, CRYPTO_TAG_SIZE));
+    }
+  }
+}
+
+TEST(CaptureCrypto, SealedRoundTrip) {
+  for (size_t len : { 0, 1, 15, 16, 17, 4096, 100003 }) {
+    SCOPED_TRACE(len);
+    std::vector<uint8_t> plain(len);
+    for (size_t i = 0; i < len; i++) {
+      plain[i] = (uint8_t)(i * 31 + 5);
+    }
+    std::vector<uint8_t> buf = seal(plain, (uint8_t)len);
+    ASSERT_TRUE(cryptoIsSealed(buf.data(), buf.size()));
+    if (len >= 16) {
+      EXPECT_NE(0, memcmp(plain.data(), buf.data(), 16));
+    }
+    size_t plainLen = 0;
+    ASSERT_TRUE(cryptoOpen(kMaster, buf.data(), buf.size(), &plainLen));
+    ASSERT_EQ(len, plainLen);
+    EXPECT_EQ(0, memcmp(plain.data(), buf.data(), len));
+  }
+  // Two seals of one capture differ: a new salt is a new key and IV
+  std::vector<uint8_t> plain(64, 0x42);
+  EXPECT_NE(seal(plain, 1), seal(plain, 2));
+}
+
+bool allZero(const std::vector<uint8_t> &buf) {
+  for (uint8_t b : buf) {
+    if (b != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Any changed bit in the ciphertext, salt or tag fails the tag, and the
+// buffer is cleared rather than left as unauthenticated plaintext
+TEST(CaptureCrypto, TamperIsRejected) {
+  std::vector<uint8_t> plain(1000);
+  for (size_t i = 0; i < plain.size(); i++) {
+    plain[i] = (uint8_t)(i ^ 0x5A);
+  }
+  const std::vector<uint8_t> sealed = seal(plain, 3);
+  size_t n = plain.size();
+  size_t plainLen = 12345;
+
+  for (size_t at : { (size_t)0, n / 2, n - 1, n, n + CRYPTO_SALT_SIZE - 1, n + CRYPTO_SALT_SIZE,
+                     n + CRYPTO_SALT_SIZE + CRYPTO_TAG_SIZE - 1 }) {
+    for (uint8_t bit : { 0x01, 0x80 }) {
+      SCOPED_TRACE(at);
+      std::vector<uint8_t> buf(sealed);
+      buf[at] ^= bit;
+      EXPECT_FALSE(cryptoOpen(kMaster, buf.data(), buf.size(), &plainLen));
+      EXPECT_TRUE(allZero(buf));
+      EXPECT_EQ(12345u, plainLen);
+    }
+  }
+
+  // Wrong master key
+  uint8_t other[CRYPTO_KEY_SIZE];
+  memcpy(other, kMaster, sizeof(other));
+  other[31] ^= 1;
+  std::vector<uint8_t> buf(sealed);
+  EXPECT_FALSE(cryptoOpen(other, buf.data(), buf.size(), &plainLen));
+  EXPECT_TRUE(allZero(buf));
+
+  // Cut short: the trailer no longer ends the object
+  buf = sealed;
+  buf.pop_back();
+  EXPECT_FALSE(cryptoIsSealed(buf.data(), buf.size()));
+  EXPECT_FALSE(cryptoOpen(kMaster, buf.data(), buf.size(), &plainLen));
+
+  // A block dropped from the middle, trailer intact
+  buf = sealed;
+  buf.erase(buf.begin() + 16, buf.begin() + 32);
+  EXPECT_FALSE(cryptoOpen(kMaster, buf.data(), buf.size(), &plainLen));
+  EXPECT_TRUE(allZero(buf));
+
+  // Without the magic it is not a sealed object at all, and left alone
+  buf = sealed;
+  buf.back() ^= 1;
+  EXPECT_FALSE(cryptoIsSealed(buf.data(), buf.size()));
+  EXPECT_FALSE(cryptoOpen(kMaster, buf.data(), buf.size(), &plainLen));
+  EXPECT_EQ(0, memcmp(sealed.data(), buf.data(), n));
+  EXPECT_FALSE(cryptoIsSealed(buf.data(), CRYPTO_SEAL_SIZE - 1));
+}
+
+}  // namespace
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <vector>
+#include "conn_manager.h"
+
+// decideLinkProfile() on its own and driven the way serviceLinkProfile()
+// in ble_transfer.cpp drives it: once per sender loop pass, with the
+// time since the last bulk activity and since the last switch.
+
+namespace {
+
+TEST(ConnManager, BulkGoesToBurstAtOnce) {
+  EXPECT_EQ(LINK_BURST, decideLinkProfile(LINK_IDLE, true, 0, 0));
+  EXPECT_EQ(LINK_BURST, decideLinkProfile(LINK_BURST, true, 0, 0));
+  // Even right after switching down
+  EXPECT_EQ(LINK_BURST, decideLinkProfile(LINK_IDLE, true, 50000, 1));
+}
+
+TEST(ConnManager, IdleStaysIdle) {
+  for (uint32_t ms : { 0u, 1000u, 100000u }) {
+    EXPECT_EQ(LINK_IDLE, decideLinkProfile(LINK_IDLE, false, ms, ms));
+  }
+}
+
+TEST(ConnManager, BurstHoldsUntilQuietLongEnough) {
+  EXPECT_EQ(LINK_BURST, decideLinkProfile(LINK_BURST, false, LINK_IDLE_AFTER_MS - 1, 60000));
+  EXPECT_EQ(LINK_IDLE, decideLinkProfile(LINK_BURST, false, LINK_IDLE_AFTER_MS, 60000));
+}
+
+TEST(ConnManager, BurstHoldsUntilMinSwitchInterval) {
+  EXPECT_EQ(LINK_BURST, decideLinkProfile(LINK_BURST, false, 60000, LINK_MIN_SWITCH_MS - 1));
+  EXPECT_EQ(LINK_IDLE, decideLinkProfile(LINK_BURST, false, 60000, LINK_MIN_SWITCH_MS));
+}
+
+// serviceLinkProfile() without the radio: a 10 ms loop over a schedule
+// of bulk activity
+struct Link {
+  LinkProfile profile = LINK_IDLE;
+  uint32_t lastBulkMs = 0;
+  uint32_t switchMs = 0;
+  std::vector<uint32_t> switches;   // when each switch happened
+
+  void service(uint32_t now, bool bulkPending) {
+    if (bulkPending) {
+      lastBulkMs = now;
+    }
+    LinkProfile next = decideLinkProfile(profile, bulkPending, now - lastBulkMs, now - switchMs);
+    if (next != profile) {
+      profile = next;
+      switchMs = now;
+      switches.push_back(now);
+    }
+  }
+
+  // busy(t) says whether anything is queued at t
+  template <typename F>
+  void run(uint32_t fromMs, uint32_t toMs, F busy) {
+    for (uint32_t t = fromMs; t < toMs; t += 10) {
+      service(t, busy(t));
+    }
+  }
+};
+
+// A photo every 10 s, 2 s on the link: up at the start of each, down
+// 3 s after its end
+TEST(ConnManager, PeriodicCaptureSwitchesTwicePerPhoto) {
+  Link link;
+  link.run(0, 60000, [](uint32_t t) { return t % 10000 < 2000; });
+  ASSERT_EQ(12u, link.switches.size());
+  for (size_t i = 0; i < link.switches.size(); i += 2) {
+    uint32_t up = link.switches[i], down = link.switches[i + 1];
+    EXPECT_EQ(0u, up % 10000);
+    EXPECT_EQ(up + 2000 - 10 + LINK_IDLE_AFTER_MS, down);
+  }
+  EXPECT_EQ(LINK_IDLE, link.profile);
+}
+
+// Bursts with gaps shorter than the idle delay never drop to idle in
+// between: one switch up, one down after the last
+TEST(ConnManager, ShortGapsDoNotFlap) {
+  Link link;
+  link.run(0, 30000, [](uint32_t t) {
+    return t < 20000 && t % 2500 < 300;   // preview, pause, next preview
+  });
+  ASSERT_EQ(2u, link.switches.size());
+  EXPECT_EQ(0u, link.switches[0]);
+  EXPECT_EQ(17500u + 290 + LINK_IDLE_AFTER_MS, link.switches[1]);
+}
+
+// A blip of bulk right after a switch down goes back to burst at once,
+// then stays there for the full idle delay again
+TEST(ConnManager, BlipAfterSwitchDownGoesBackUp) {
+  Link link;
+  link.run(0, 100, [](uint32_t) { return true; });
+  link.run(100, 3200, [](uint32_t) { return false; });
+  ASSERT_EQ(2u, link.switches.size());
+  uint32_t down = link.switches[1];
+
+  link.service(down + 10, true);
+  EXPECT_EQ(LINK_BURST, link.profile);
+  EXPECT_EQ(down + 10, link.switches[2]);
+
+  link.run(down + 20, down + 10 + LINK_IDLE_AFTER_MS, [](uint32_t) { return false; });
+  EXPECT_EQ(LINK_BURST, link.profile);
+  link.run(down + 10 + LINK_IDLE_AFTER_MS, down + 4000, [](uint32_t) { return false; });
+  EXPECT_EQ(LINK_IDLE, link.profile);
+  EXPECT_EQ(4u, link.switches.size());
+}
+
+// Both profiles are parameters a central accepts (Core spec, LL
+// connection parameters)
+TEST(ConnManager, ProfilesAreValidConnectionParameters) {
+  for (LinkProfile p : { LINK_IDLE, LINK_BURST }) {
+    const LinkParams &lp = linkParamsFor(p);
+    EXPECT_GE(lp.minInterval, 6) << linkProfileName(p);
+    EXPECT_LE(lp.maxInterval, 3200);
+    EXPECT_LE(lp.minInterval, lp.maxInterval);
+    EXPECT_LE(lp.latency, 499);
+    EXPECT_GE(lp.timeout, 10);
+    EXPECT_LE(lp.timeout, 3200);
+    // Supervision timeout > (1 + latency) * interval * 2
+    EXPECT_GT(lp.timeout * 10u, (1u + lp.latency) * lp.maxInterval * 125 / 100 * 2);
+    EXPECT_GE(lp.dataLength, 27);
+    EXPECT_LE(lp.dataLength, 251);
+  }
+  EXPECT_LT(linkParamsFor(LINK_BURST).maxInterval, linkParamsFor(LINK_IDLE).minInterval);
+  EXPECT_TRUE(linkParamsFor(LINK_BURST).phy2M);
+}
+
+}  // namespace
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "crc32.h"
+
+// Verification cost per KB of the host fallback, at the sizes the
+// transfer path checks: one image packet, a KiB, a whole UXGA frame.
+// The device runs the ROM routine instead and reports its own figure as
+// the crc.cycles_per_kb metric.
+
+namespace {
+
+uint32_t crcBitwise(const uint8_t *p, size_t len) {
+  uint32_t c = 0xFFFFFFFFu;
+  while (len--) {
+    c ^= *p++;
+    for (int k = 0; k < 8; k++) {
+      c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+    }
+  }
+  return ~c;
+}
+
+TEST(Crc32Bench, MatchesZlib) {
+  EXPECT_EQ(0xCBF43926u, crc32Update(0, (const uint8_t *)"123456789", 9));
+  EXPECT_EQ(0u, crc32Update(0, nullptr, 0));
+
+  std::mt19937 rng(1);
+  std::vector<uint8_t> data(4096);
+  for (uint8_t &b : data) {
+    b = rng();
+  }
+  uint32_t chained = 0;
+  for (size_t at = 0; at < data.size(); at += 183) {
+    chained = crc32Update(chained, data.data() + at, std::min<size_t>(183, data.size() - at));
+  }
+  EXPECT_EQ(crcBitwise(data.data(), data.size()), chained);
+}
+
+TEST(Crc32Bench, PerKilobyte) {
+  std::vector<uint8_t> data(100 * 1024);
+  std::mt19937 rng(2);
+  for (uint8_t &b : data) {
+    b = rng();
+  }
+
+  struct Case {
+    const char *name;
+    size_t len;
+  } cases[] = {
+    { "crc32Update, one packet (182 B)", 182 },
+    { "crc32Update, 1 KiB", 1024 },
+    { "crc32Update, UXGA frame (100 KiB)", data.size() },
+  };
+  for (const Case &c : cases) {
+    long calls = (long)(20 * 1024 * 1024 / c.len);
+    double ns = benchNs(calls, [&](long i) {
+      size_t at = (i * c.len) % (data.size() - c.len + 1);
+      benchKeep(crc32Update(0, data.data() + at, c.len));
+    });
+    benchReport(c.name, ns * 1024 / c.len, "KiB");
+  }
+  double bitwise = benchNs(20, [&](long) { benchKeep(crcBitwise(data.data(), data.size())); });
+  benchReport("bitwise reference, 100 KiB", bitwise * 1024 / data.size(), "KiB");
+}
+
+}  // namespace
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "content_hash.h"
+#include "dedup_index.h"
+
+// Cost of the index on the capture path (one lookup, one insert per
+// capture) and of hashing a frame as it is copied.
+
+namespace {
+
+TEST(DedupIndexBench, InsertAndLookup) {
+  std::mt19937_64 rng(1);
+  std::vector<uint64_t> keys(1 << 16);
+  for (uint64_t &k : keys) {
+    k = rng();
+  }
+  dedupClear();
+
+  // A full ring: every insert also evicts
+  double insert = benchNs(keys.size(), [&](long i) { dedupInsert(keys[i], 1000, "/photo.jpg"); });
+
+  DedupRecord r;
+  size_t hits = 0;
+  double hit = benchNs(keys.size(), [&](long i) {
+    hits += dedupLookup(keys[keys.size() - 1 - i % DEDUP_RECORDS], 1000, &r);
+  });
+  EXPECT_EQ(keys.size() * BENCH_ROUNDS, hits);
+
+  size_t misses = 0;
+  double miss = benchNs(keys.size(), [&](long i) { misses += !dedupLookup(keys[i], 1000, &r); });
+  EXPECT_EQ((keys.size() - DEDUP_RECORDS) * BENCH_ROUNDS, misses);
+
+  benchReport("dedupInsert (evicting)", insert);
+  benchReport("dedupLookup hit", hit);
+  benchReport("dedupLookup miss", miss);
+}
+
+TEST(DedupIndexBench, HashFrame) {
+  const size_t len = 100 * 1024;   // a UXGA JPEG
+  std::vector<uint8_t> src(len), dst(len);
+  std::mt19937 rng(2);
+  for (uint8_t &b : src) {
+    b = rng();
+  }
+  src[0] = 0xFF;
+  src[1] = 0xD8;
+  uint32_t crc;
+  double copy = benchNs(200, [&](long) { benchKeep(copyAndHashJpeg(dst.data(), src.data(), len, &crc)); });
+  double hash = benchNs(200, [&](long) { benchKeep(hashBuffer(src.data(), len)); });
+  benchReport("copyAndHashJpeg 100 KiB (copy+hash+crc)", copy, "frame");
+  benchReport("hashBuffer 100 KiB", hash, "frame");
+  printf("[   BENCH  ] xxHash64 %.0f MB/s\n", len * 1e3 / hash);
+}
+
+}  // namespace
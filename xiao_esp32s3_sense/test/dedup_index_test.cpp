@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "content_hash.h"
+#include "dedup_index.h"
+
+namespace {
+
+uint64_t hashOf(const char *s) {
+  return hashBuffer((const uint8_t *)s, strlen(s));
+}
+
+// Reference values of XXH64 with seed 0
+TEST(ContentHash, MatchesXxHash64) {
+  EXPECT_EQ(0xEF46DB3751D8E999ull, hashOf(""));
+  EXPECT_EQ(0xD24EC4F1A98C6E5Bull, hashOf("a"));
+  EXPECT_EQ(0x44BC2CF5AD770999ull, hashOf("abc"));
+  EXPECT_EQ(0xFBCEA83C8A378BF1ull, hashOf("Nobody inspects the spammish repetition"));
+}
+
+TEST(ContentHash, StreamingMatchesOneShot) {
+  std::mt19937 rng(1);
+  std::vector<uint8_t> data(5000);
+  for (uint8_t &b : data) {
+    b = rng();
+  }
+  for (size_t len : { 0, 1, 31, 32, 33, 100, 4999 }) {
+    for (size_t piece : { 1, 3, 32, 1000 }) {
+      ContentHash h;
+      hashBegin(&h);
+      for (size_t at = 0; at < len; at += piece) {
+        hashUpdate(&h, data.data() + at, std::min(piece, len - at));
+      }
+      ASSERT_EQ(hashBuffer(data.data(), len), hashEnd(&h)) << len << " in " << piece;
+    }
+  }
+}
+
+TEST(ContentHash, JpegHashCoversScanDataOnly) {
+  // SOI, a 4-byte APP0, SOS with a 2-byte body, then scan data
+  uint8_t a[] = { 0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x04, 0x11, 0x22,
+                  0xFF, 0xDA, 0x00, 0x02, 1, 2, 3, 4, 5, 0xFF, 0xD9 };
+  uint8_t b[sizeof(a)];
+  memcpy(b, a, sizeof(a));
+  b[6] = 0x99;   // header differs, scan data does not
+  ASSERT_EQ(12u, jpegScanOffset(a, sizeof(a)));
+
+  uint8_t copy[sizeof(a)];
+  uint32_t crcA, crcB;
+  uint64_t ha = copyAndHashJpeg(copy, a, sizeof(a), &crcA);
+  EXPECT_EQ(0, memcmp(copy, a, sizeof(a)));
+  uint64_t hb = copyAndHashJpeg(copy, b, sizeof(b), &crcB);
+  EXPECT_EQ(ha, hb);
+  EXPECT_NE(crcA, crcB);
+  EXPECT_EQ(hashBuffer(a + 12, sizeof(a) - 12), ha);
+}
+
+class DedupTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    dedupClear();
+  }
+};
+
+TEST_F(DedupTest, InsertLookupAndDelivery) {
+  DedupRecord r;
+  EXPECT_FALSE(dedupLookup(1, 100, &r));
+  dedupInsert(1, 100, "/photo_000001.jpg");
+  ASSERT_TRUE(dedupLookup(1, 100, &r));
+  EXPECT_STREQ("/photo_000001.jpg", r.path);
+  EXPECT_EQ(0, r.flags);
+  EXPECT_FALSE(dedupLookup(1, 101, &r)) << "length is part of the key";
+
+  EXPECT_TRUE(dedupMarkDelivered(1, 100));
+  ASSERT_TRUE(dedupLookup(1, 100, &r));
+  EXPECT_EQ(DEDUP_DELIVERED, r.flags);
+  EXPECT_FALSE(dedupMarkDelivered(2, 100));
+}
+
+// Same low half (the table tag), different digests
+TEST_F(DedupTest, WholeDigestIsCompared) {
+  dedupInsert(0x0000000112345678ull, 10, "/a");
+  DedupRecord r;
+  EXPECT_FALSE(dedupLookup(0x0000000212345678ull, 10, &r));
+  dedupInsert(0x0000000212345678ull, 10, "/b");
+  ASSERT_TRUE(dedupLookup(0x0000000212345678ull, 10, &r));
+  EXPECT_STREQ("/b", r.path);
+  ASSERT_TRUE(dedupLookup(0x0000000112345678ull, 10, &r));
+  EXPECT_STREQ("/a", r.path);
+}
+
+// The ring keeps the newest DEDUP_RECORDS; evictions must leave every
+// other probe chain intact
+TEST_F(DedupTest, EvictsOldestAndKeepsTheRestFindable) {
+  std::mt19937_64 rng(7);
+  std::vector<uint64_t> keys(DEDUP_RECORDS * 5);
+  for (uint64_t &k : keys) {
+    // Few distinct slots: long chains, lots of backward shifts
+    k = (rng() & ~0xFFull) | (rng() % 8);
+  }
+  for (size_t i = 0; i < keys.size(); i++) {
+    char path[DEDUP_PATH_LEN];
+    snprintf(path, sizeof(path), "/k%zu", i);
+    dedupInsert(keys[i], 1, path);
+    ASSERT_LE(dedupCount(), (size_t)DEDUP_RECORDS);
+
+    size_t oldest = i + 1 > DEDUP_RECORDS ? i + 1 - DEDUP_RECORDS : 0;
+    DedupRecord r;
+    for (size_t j = oldest; j <= i; j++) {
+      ASSERT_TRUE(dedupLookup(keys[j], 1, &r)) << "key " << j << " after " << i;
+    }
+    if (oldest > 0) {
+      ASSERT_FALSE(dedupLookup(keys[oldest - 1], 1, &r));
+    }
+  }
+}
+
+}  // namespace
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "imu_batch.h"
+#include "stream_mux.h"
+#include "wire_format.h"
+
+// Bytes per sample and codec time of the IMU batches against the legacy
+// notification (sendIMUDataViaBLE: six floats and a time, 28 bytes) and
+// against the raw counts (six int16, 12 bytes). Each trace is cut into
+// batches the way the live stream sends them: the longest prefix that
+// fits one MUX frame.
+//
+// No recorded IMU trace exists for this board, so the traces are an
+// MPU6050 model: ±2 g and ±250 dps (16384 LSB/g, 131 LSB/dps), sensor
+// noise from the datasheet densities through the 44 Hz low-pass, the
+// wearer still, walking, or shaking the device.
+
+namespace {
+
+const uint16_t kAccelLsbPerG = 16384;
+const uint16_t kGyroLsbPerDpsX10 = 1310;
+const double kAccelNoiseG = 400e-6;     // per √Hz
+const double kGyroNoiseDps = 0.005;     // per √Hz
+const double kLowPassHz = 44;
+const int kSeconds = 60;
+
+enum Motion { STILL, WALKING, SHAKING };
+
+std::vector<ImuSample> trace(Motion motion, int rateHz, uint32_t seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> gauss(0, 1);
+  // White noise with the density of the sensor, through one pole at the
+  // low-pass cutoff so the filtered noise keeps the datasheet's rms
+  double alpha = 1 - exp(-2 * M_PI * kLowPassHz / rateHz);
+  double bandwidth = kLowPassHz * M_PI / 2;
+  double gain = sqrt((2 - alpha) / alpha);
+  double accelSigma = kAccelNoiseG * sqrt(bandwidth) * gain;
+  double gyroSigma = kGyroNoiseDps * sqrt(bandwidth) * gain;
+  double noise[IMU_AXES] = { 0 };
+
+  std::vector<ImuSample> out;
+  for (int i = 0; i < rateHz * kSeconds; i++) {
+    double t = (double)i / rateHz;
+    double g[3] = { 0.02, -0.05, 1.0 };   // accel, g
+    double w[3] = { 0, 0, 0 };            // gyro, dps
+    if (motion == WALKING) {
+      double step = sin(2 * M_PI * 1.9 * t);
+      g[0] += 0.08 * sin(2 * M_PI * 0.95 * t);
+      g[1] += 0.05 * step;
+      g[2] += 0.25 * step + 0.06 * sin(2 * M_PI * 3.8 * t);
+      w[0] = 12 * sin(2 * M_PI * 0.95 * t);
+      w[1] = 6 * step;
+      w[2] = 18 * sin(2 * M_PI * 0.95 * t + 1);
+    } else if (motion == SHAKING) {
+      double shake = sin(2 * M_PI * 6 * t);
+      g[0] += 1.2 * shake;
+      g[1] += 0.5 * sin(2 * M_PI * 4.3 * t);
+      g[2] += 0.4 * shake;
+      w[0] = 150 * sin(2 * M_PI * 6 * t + 0.5);
+      w[1] = 80 * sin(2 * M_PI * 4.3 * t);
+      w[2] = 40 * shake;
+    }
+    ImuSample s;
+    for (int a = 0; a < IMU_AXES; a++) {
+      double sigma = a < 3 ? accelSigma : gyroSigma;
+      noise[a] += alpha * (sigma * gauss(rng) - noise[a]);
+      double lsb = a < 3 ? (g[a] + noise[a]) * kAccelLsbPerG
+                         : (w[a - 3] + noise[a]) * kGyroLsbPerDpsX10 / 10.0;
+      s.v[a] = (int16_t)fmax(-32768, fmin(32767, round(lsb)));
+    }
+    out.push_back(s);
+  }
+  return out;
+}
+
+struct Batches {
+  std::vector<std::vector<uint8_t>> frames;
+  size_t bytes = 0;
+};
+
+// As the live stream cuts them: one MUX payload each
+Batches encodeAll(const std::vector<ImuSample> &samples, int rateHz) {
+  Batches b;
+  ImuBatchInfo info = { 0, 0, 1000000u / rateHz, kAccelLsbPerG, kGyroLsbPerDpsX10 };
+  for (size_t at = 0; at < samples.size();) {
+    uint8_t out[MUX_PAYLOAD_MAX];
+    size_t n;
+    size_t len = imuBatchEncode(info, &samples[at], samples.size() - at, out, sizeof(out), &n);
+    EXPECT_GT(len, 0u);
+    if (len == 0) {
+      break;
+    }
+    b.frames.emplace_back(out, out + len);
+    b.bytes += len;
+    info.seq++;
+    info.timeMs += (uint32_t)(n * 1000 / rateHz);
+    at += n;
+  }
+  return b;
+}
+
+struct Case {
+  const char *name;
+  Motion motion;
+  int rateHz;
+};
+
+TEST(ImuBatchBench, RatioAndSpeed) {
+  const Case cases[] = {
+    { "still, 100 Hz", STILL, 100 },     { "walking, 100 Hz", WALKING, 100 },
+    { "shaking, 100 Hz", SHAKING, 100 }, { "still, 1 kHz", STILL, 1000 },
+    { "walking, 1 kHz", WALKING, 1000 }, { "shaking, 1 kHz", SHAKING, 1000 },
+  };
+  printf("[   BENCH  ] %-20s %8s %7s %7s %9s %9s %11s\n", "trace", "B/sample", "vs 28B",
+         "vs 12B", "per frame", "enc ns", "dec ns");
+  for (const Case &c : cases) {
+    SCOPED_TRACE(c.name);
+    std::vector<ImuSample> samples = trace(c.motion, c.rateHz, 48);
+    Batches b = encodeAll(samples, c.rateHz);
+
+    // Lossless, and every batch decodes on its own
+    std::vector<ImuSample> decoded(samples.size());
+    size_t at = 0;
+    for (const std::vector<uint8_t> &f : b.frames) {
+      ImuBatchInfo info;
+      int n = imuBatchDecode(f.data(), f.size(), &info, &decoded[at], decoded.size() - at);
+      ASSERT_GT(n, 0);
+      EXPECT_EQ((uint32_t)(1000000 / c.rateHz), info.periodUs);
+      at += n;
+    }
+    ASSERT_EQ(samples.size(), at);
+    ASSERT_EQ(0, memcmp(samples.data(), decoded.data(), samples.size() * sizeof(ImuSample)));
+
+    double perSample = (double)b.bytes / samples.size();
+    double enc = benchNs(1, [&](long) { benchKeep(encodeAll(samples, c.rateHz).bytes); });
+    double dec = benchNs(1, [&](long) {
+      size_t got = 0;
+      for (const std::vector<uint8_t> &f : b.frames) {
+        ImuBatchInfo info;
+        got += imuBatchDecode(f.data(), f.size(), &info, &decoded[got], decoded.size() - got);
+      }
+      benchKeep(got);
+    });
+    printf("[   BENCH  ] %-20s %8.2f %6.1fx %6.1fx %9.1f %9.1f %11.1f\n", c.name, perSample,
+           28 / perSample, 12 / perSample, (double)samples.size() / b.frames.size(),
+           enc / samples.size(), dec / samples.size());
+
+    // The accelerometer's noise, some 56 LSB rms at ±2 g, takes two
+    // bytes per axis at 100 Hz; at 1 kHz the low-pass makes neighbouring
+    // samples close. Fast shaking moves every axis by thousands of LSB a
+    // sample and costs about what the raw counts do.
+    EXPECT_LT(perSample * 2, 28);
+    if (c.motion != SHAKING) {
+      EXPECT_LT(perSample * 2.5, 28);
+      EXPECT_LT(perSample, 11);
+    }
+    if (c.motion != SHAKING && c.rateHz >= 1000) {
+      EXPECT_LT(perSample * 3.5, 28);
+    }
+  }
+}
+
+// The legacy path sent one notification per sample with delay(10)
+// between them: 100 a second at most. Batches at 1 kHz need fewer
+// notifications than that.
+TEST(ImuBatchBench, NotificationsPerSecond) {
+  for (Motion m : { STILL, WALKING, SHAKING }) {
+    Batches b = encodeAll(trace(m, 1000, 7), 1000);
+    double perSecond = (double)b.frames.size() / kSeconds;
+    printf("[   BENCH  ] %-20s %8.1f notifications/s at 1 kHz\n",
+           m == STILL ? "still" : m == WALKING ? "walking" : "shaking", perSecond);
+    EXPECT_LT(perSecond, 100);
+  }
+}
+
+}  // namespace
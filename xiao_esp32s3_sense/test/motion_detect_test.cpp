@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <random>
+#include <vector>
+#include "motion_detect.h"
+
+// Frame sequences as evaluateMotion() sees them: a UXGA shot decoded at
+// 1/8 scale (200x150 big-endian RGB565), reduced to luma and compared
+// with the last kept frame.
+
+namespace {
+
+const int kW = 200, kH = 150;
+
+struct Frame {
+  std::vector<uint8_t> rgb = std::vector<uint8_t>(kW * kH * 2);
+
+  void set(int x, int y, int gray) {
+    gray = gray < 0 ? 0 : gray > 255 ? 255 : gray;
+    uint16_t c = (uint16_t)(((gray >> 3) << 11) | ((gray >> 2) << 5) | (gray >> 3));
+    rgb[(y * kW + x) * 2] = c >> 8;
+    rgb[(y * kW + x) * 2 + 1] = c & 0xFF;
+  }
+
+  std::vector<uint8_t> gray() const {
+    std::vector<uint8_t> g(MOTION_W * MOTION_H);
+    grayFromRgb565(rgb.data(), kW, kH, g.data());
+    return g;
+  }
+};
+
+// A desk scene: shading, a few objects, sensor noise; `dx` pans the
+// camera, `object` puts a 24x24 px thing at that x (negative: none)
+Frame scene(std::mt19937 &rng, int dx, int object, int brightness = 0) {
+  Frame f;
+  std::uniform_int_distribution<int> noise(-3, 3);
+  for (int y = 0; y < kH; y++) {
+    for (int x = 0; x < kW; x++) {
+      int sx = x + dx;
+      int v = 60 + sx / 3 + y / 2;
+      if ((sx / 40 + y / 30) % 3 == 0) {
+        v += 70;
+      }
+      if (object >= 0 && x >= object && x < object + 24 && y >= 60 && y < 84) {
+        v = 240;
+      }
+      f.set(x, y, v + brightness + noise(rng));
+    }
+  }
+  return f;
+}
+
+TEST(MotionDetect, GrayOfAUniformFrame) {
+  Frame f;
+  for (int y = 0; y < kH; y++) {
+    for (int x = 0; x < kW; x++) {
+      f.set(x, y, 128);
+    }
+  }
+  for (uint8_t g : f.gray()) {
+    ASSERT_NEAR(128, g, 2);
+  }
+}
+
+TEST(MotionDetect, IdenticalBlocksHaveNoDifference) {
+  std::vector<uint8_t> a(MOTION_W * MOTION_H, 7), b(a);
+  EXPECT_EQ(0u, sadBlock8(a.data(), b.data(), MOTION_W));
+  b[3 * MOTION_W + 5] = 255;
+  EXPECT_EQ(248u, sadBlock8(a.data(), b.data(), MOTION_W));
+  EXPECT_EQ(248u, sadBlock8Scalar(a.data(), b.data(), MOTION_W));
+}
+
+TEST(MotionDetect, SensorNoiseIsSkipped) {
+  std::mt19937 rng(1);
+  std::vector<uint8_t> ref = scene(rng, 0, -1).gray();
+  for (int i = 0; i < 20; i++) {
+    MotionResult r = compareFrames(ref.data(), scene(rng, 0, -1).gray().data());
+    EXPECT_EQ(MOTION_SKIP, r.decision) << "frame " << i;
+    EXPECT_EQ(0, r.changedBlocks);
+  }
+}
+
+TEST(MotionDetect, SmallObjectDowngrades) {
+  std::mt19937 rng(2);
+  std::vector<uint8_t> ref = scene(rng, 0, -1).gray();
+  MotionResult r = compareFrames(ref.data(), scene(rng, 0, 90).gray().data());
+  EXPECT_EQ(MOTION_DOWNGRADE, r.decision);
+  EXPECT_GT(r.changedBlocks, 0);
+}
+
+TEST(MotionDetect, PanAndLightingChangesAreFull) {
+  std::mt19937 rng(3);
+  std::vector<uint8_t> ref = scene(rng, 0, -1).gray();
+  EXPECT_EQ(MOTION_FULL, compareFrames(ref.data(), scene(rng, 30, -1).gray().data()).decision);
+  EXPECT_EQ(MOTION_FULL, compareFrames(ref.data(), scene(rng, 0, -1, 40).gray().data()).decision);
+}
+
+// The gate keeps its reference on skipped frames only; a sequence of
+// small steps adds up to a capture
+TEST(MotionDetect, SlowDriftEventuallyCaptures) {
+  std::mt19937 rng(4);
+  std::vector<uint8_t> ref = scene(rng, 0, -1).gray();
+  int firstKept = -1;
+  for (int step = 1; step <= 40 && firstKept < 0; step++) {
+    MotionResult r = compareFrames(ref.data(), scene(rng, step, -1).gray().data());
+    if (step == 1) {
+      EXPECT_EQ(MOTION_SKIP, r.decision);
+    }
+    if (r.decision != MOTION_SKIP) {
+      firstKept = step;
+    }
+  }
+  EXPECT_GT(firstKept, 1);
+  EXPECT_LT(firstKept, 40);
+}
+
+}  // namespace
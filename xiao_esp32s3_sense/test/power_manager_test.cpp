@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include "power_manager.h"
+
+// The power ledger on a microsecond clock: which acquires and releases
+// are the edges that wake and idle the chip, how nesting and unbalanced
+// calls are counted, and the charge booked to each state and hold.
+
+namespace {
+
+// Round numbers: busy 45 mA, awake 22, asleep 3; the camera adds 60,
+// the microphone 4, a transfer 25
+const PowerModel kModel = { 45, 22, 3, { 0, 60, 0, 4, 25 } };
+
+TEST(PowerManager, ReleaseWithoutAcquireIsCounted) {
+  PowerLedger l;
+  powerLedgerInit(&l, kModel, 0);
+  EXPECT_FALSE(powerLedgerRelease(&l, POWER_AUDIO, 10));
+  EXPECT_EQ(1u, l.unbalanced);
+  EXPECT_EQ(0u, l.heldMask);
+  EXPECT_EQ(0, l.held[POWER_AUDIO]);
+}
+
+// Only the first lock of any kind and the last release are edges;
+// locks of one holder nest
+TEST(PowerManager, EdgesAndNesting) {
+  PowerLedger l;
+  powerLedgerInit(&l, kModel, 0);
+  EXPECT_TRUE(powerLedgerAcquire(&l, POWER_CAPTURE, 100));
+  EXPECT_FALSE(powerLedgerAcquire(&l, POWER_CAMERA, 200));
+  EXPECT_FALSE(powerLedgerAcquire(&l, POWER_CAMERA, 300));
+  EXPECT_EQ((1u << POWER_CAPTURE) | (1u << POWER_CAMERA), l.heldMask);
+  EXPECT_FALSE(powerLedgerRelease(&l, POWER_CAPTURE, 400));
+  EXPECT_FALSE(powerLedgerRelease(&l, POWER_CAMERA, 500));
+  EXPECT_EQ(1u << POWER_CAMERA, l.heldMask);
+  EXPECT_TRUE(powerLedgerRelease(&l, POWER_CAMERA, 600));
+  EXPECT_EQ(0u, l.heldMask);
+  EXPECT_EQ(0u, l.unbalanced);
+}
+
+// A second asleep, a capture that streams the camera, then a second
+// asleep again: each span is booked at the draw of its state
+TEST(PowerManager, ChargePerStateAndHold) {
+  PowerLedger l;
+  powerLedgerInit(&l, kModel, 0);
+  powerLedgerSleep(&l, true, 0);
+  ASSERT_TRUE(powerLedgerAcquire(&l, POWER_CAPTURE, 1000000));
+  ASSERT_FALSE(powerLedgerAcquire(&l, POWER_CAMERA, 1000000));
+  ASSERT_FALSE(powerLedgerAcquire(&l, POWER_CAMERA, 1000000));
+
+  // 0.5 s busy with the camera on: 45 + 60 mA
+  ASSERT_FALSE(powerLedgerRelease(&l, POWER_CAPTURE, 1500000));
+  EXPECT_EQ(105ull * 500000, l.lastHoldMaUs[POWER_CAPTURE]);
+  EXPECT_EQ(194u, powerChargeToMj(l.lastHoldMaUs[POWER_CAPTURE]));
+  ASSERT_FALSE(powerLedgerRelease(&l, POWER_CAMERA, 2000000));
+  ASSERT_TRUE(powerLedgerRelease(&l, POWER_CAMERA, 2500000));
+  EXPECT_EQ(105ull * 1500000, l.lastHoldMaUs[POWER_CAMERA]);
+  EXPECT_EQ(0u, l.heldMask);
+
+  uint64_t charge = powerLedgerSettle(&l, 3500000);
+  EXPECT_EQ(3ull * 1000000 + 105ull * 1500000 + 3ull * 1000000, charge);
+  EXPECT_EQ(2000000u, l.idleUs);
+  EXPECT_EQ(1500000u, l.busyUs);
+  EXPECT_EQ(6000000u, l.idleChargeMaUs);
+
+  // Awake with no lock: 22 mA, still idle
+  powerLedgerSleep(&l, false, 3500000);
+  powerLedgerSettle(&l, 4500000);
+  EXPECT_EQ(6000000u + 22000000u, l.idleChargeMaUs);
+  EXPECT_EQ(3000000u, l.idleUs);
+
+  // Settling twice at one time books nothing more
+  EXPECT_EQ(powerLedgerSettle(&l, 4500000), powerLedgerSettle(&l, 4500000));
+}
+
+// The nesting count is a byte: the 256th lock is refused and counted
+// with the stray releases, and the 255 taken still release to idle
+TEST(PowerManager, NestingSaturates) {
+  PowerLedger l;
+  powerLedgerInit(&l, kModel, 0);
+  EXPECT_FALSE(powerLedgerRelease(&l, POWER_AUDIO, 0));
+  for (int i = 0; i < 255; i++) {
+    ASSERT_EQ(i == 0, powerLedgerAcquire(&l, POWER_AUDIO, 5000000));
+  }
+  EXPECT_FALSE(powerLedgerAcquire(&l, POWER_AUDIO, 5000000));
+  EXPECT_EQ(2u, l.unbalanced);
+  EXPECT_EQ(255, l.held[POWER_AUDIO]);
+  for (int i = 0; i < 255; i++) {
+    ASSERT_EQ(i == 254, powerLedgerRelease(&l, POWER_AUDIO, 6000000));
+  }
+  EXPECT_EQ(0u, l.heldMask);
+  EXPECT_EQ(49ull * 1000000, l.lastHoldMaUs[POWER_AUDIO]);
+}
+
+}  // namespace
@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <random>
+#include <vector>
+#include "psram_arena.h"
+
+namespace {
+
+const size_t kSlotSize[ARENA_CLASS_COUNT] = {
+  ARENA_BLE_PACKET_SIZE, ARENA_AUDIO_BLOCK_SIZE, ARENA_THUMB_SIZE, ARENA_MEDIA_SIZE,
+};
+const int kSlots[ARENA_CLASS_COUNT] = {
+  ARENA_BLE_PACKET_SLOTS, ARENA_AUDIO_BLOCK_SLOTS, ARENA_THUMB_SLOTS, ARENA_MEDIA_SLOTS,
+};
+
+uint16_t inUse(int c) {
+  ArenaStats st;
+  arenaGetStats((ArenaClass)c, &st);
+  return st.inUse;
+}
+
+class ArenaTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(initArena());
+  }
+  void TearDown() override {
+    for (int c = 0; c < ARENA_CLASS_COUNT; c++) {
+      EXPECT_EQ(0, inUse(c)) << "class " << c << " leaked";
+    }
+  }
+};
+
+TEST_F(ArenaTest, SmallRequestBorrowsOnlyOneClassUp) {
+  ArenaScope scope = arenaBeginScope();
+  for (int i = 0; i < ARENA_BLE_PACKET_SLOTS; i++) {
+    ASSERT_NE(nullptr, arenaAlloc(100, scope));
+  }
+  // BLE class full: the next one lends a slot
+  ASSERT_NE(nullptr, arenaAlloc(100, scope));
+  EXPECT_EQ(1, inUse(ARENA_AUDIO_BLOCK));
+
+  for (int i = 1; i < ARENA_AUDIO_BLOCK_SLOTS; i++) {
+    ASSERT_NE(nullptr, arenaAlloc(ARENA_AUDIO_BLOCK_SIZE, scope));
+  }
+  // Both full: fail rather than take a thumbnail or media slot
+  EXPECT_EQ(nullptr, arenaAlloc(100, scope));
+  EXPECT_EQ(0, inUse(ARENA_THUMB));
+  EXPECT_EQ(0, inUse(ARENA_MEDIA));
+  EXPECT_EQ((size_t)ARENA_MEDIA_SIZE, arenaLargestFree());
+
+  arenaEndScope(scope);
+}
+
+TEST_F(ArenaTest, OversizedAndEmptyRequestsFail) {
+  EXPECT_EQ(nullptr, arenaAlloc(0));
+  EXPECT_EQ(nullptr, arenaAlloc(ARENA_MEDIA_SIZE + 1));
+}
+
+struct Block {
+  size_t len;
+  int cls;
+  ArenaScope scope;
+  uint8_t fill;
+};
+
+// Random sizes, lifetimes and scopes against a model of the slot
+// counts: every request must succeed exactly when its class or the one
+// above has a free slot, blocks must never overlap or be corrupted, and
+// once everything is released the whole arena must be allocatable again.
+void runRandomized(uint32_t seed, int ops) {
+  std::mt19937 rng(seed);
+  std::map<uint8_t *, Block> live;
+  std::vector<ArenaScope> scopes;
+  int used[ARENA_CLASS_COUNT] = { 0 };
+
+  auto release = [&](std::map<uint8_t *, Block>::iterator it) {
+    const Block &b = it->second;
+    bool intact = it->first[b.len - 1] == b.fill;
+    for (size_t i = 0; i < b.len; i += 997) {
+      intact = intact && it->first[i] == b.fill;
+    }
+    EXPECT_TRUE(intact) << "block corrupted, seed " << seed;
+    used[b.cls]--;
+    return live.erase(it);
+  };
+
+  for (int op = 0; op < ops; op++) {
+    uint32_t r = rng() % 100;
+    if (r < 55) {
+      // Mostly small, now and then whole frames
+      int want = rng() % 100;
+      int c = want < 45 ? 0 : want < 75 ? 1 : want < 92 ? 2 : 3;
+      size_t lo = c == 0 ? 1 : kSlotSize[c - 1] + 1;
+      size_t len = lo + rng() % (kSlotSize[c] - lo + 1);
+      ArenaScope scope = ARENA_SCOPE_NONE;
+      if (!scopes.empty() && rng() % 2) {
+        scope = scopes[rng() % scopes.size()];
+      }
+
+      int fit = 0;
+      while (len > kSlotSize[fit]) {
+        fit++;
+      }
+      int expect = used[fit] < kSlots[fit] ? fit
+                   : fit + 1 < ARENA_CLASS_COUNT && used[fit + 1] < kSlots[fit + 1] ? fit + 1
+                   : -1;
+      uint8_t *p = arenaAlloc(len, scope);
+      if (expect < 0) {
+        ASSERT_EQ(nullptr, p) << "op " << op << " seed " << seed;
+        continue;
+      }
+      ASSERT_NE(nullptr, p) << "op " << op << " seed " << seed;
+      ASSERT_EQ(used[expect] + 1, inUse(expect));
+
+      auto next = live.lower_bound(p);
+      ASSERT_TRUE(next == live.end() || p + len <= next->first);
+      if (next != live.begin()) {
+        auto prev = std::prev(next);
+        ASSERT_LE(prev->first + prev->second.len, p);
+      }
+      Block b = { len, expect, scope, (uint8_t)(rng() | 1) };
+      memset(p, b.fill, len);
+      live[p] = b;
+      used[expect]++;
+    } else if (r < 85) {
+      if (live.empty()) {
+        continue;
+      }
+      auto it = std::next(live.begin(), rng() % live.size());
+      arenaFree(it->first);
+      release(it);
+    } else if (r < 93 || scopes.empty()) {
+      scopes.push_back(arenaBeginScope());
+    } else {
+      size_t i = rng() % scopes.size();
+      ArenaScope scope = scopes[i];
+      scopes.erase(scopes.begin() + i);
+      arenaEndScope(scope);
+      for (auto it = live.begin(); it != live.end();) {
+        it = it->second.scope == scope ? release(it) : std::next(it);
+      }
+    }
+    for (int c = 0; c < ARENA_CLASS_COUNT; c++) {
+      ASSERT_EQ(used[c], inUse(c));
+    }
+  }
+
+  for (ArenaScope scope : scopes) {
+    arenaEndScope(scope);
+  }
+  for (auto &kv : live) {
+    arenaFree(kv.first);
+  }
+
+  // No fragmentation: every slot of every class is still there
+  EXPECT_EQ((size_t)ARENA_MEDIA_SIZE, arenaLargestFree());
+  ArenaScope all = arenaBeginScope();
+  for (int c = 0; c < ARENA_CLASS_COUNT; c++) {
+    for (int i = 0; i < kSlots[c]; i++) {
+      ASSERT_NE(nullptr, arenaAlloc(kSlotSize[c], all));
+    }
+    EXPECT_EQ(kSlots[c], inUse(c));
+  }
+  EXPECT_EQ(0u, arenaLargestFree());
+  arenaEndScope(all);
+}
+
+TEST_F(ArenaTest, RandomizedFragmentation) {
+  for (uint32_t seed = 1; seed <= 8; seed++) {
+    runRandomized(seed, 50000);
+    if (HasFatalFailure()) {
+      return;
+    }
+  }
+}
+
+}  // namespace
@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "rate_control.h"
+
+// Replays link traces through the estimator and the planner the way
+// loop() drives them: plan with the current estimates, capture and send
+// at the link and scene of the trace row, feed back what was observed.
+// traces/*.csv hold one row per shot, "<goodput B/s>,<size scale>".
+
+namespace {
+
+struct Shot {
+  uint32_t bps;
+  uint16_t scale;
+};
+
+std::vector<Shot> loadTrace(const char *name) {
+  std::vector<Shot> shots;
+  std::string path = std::string(TRACE_DIR) + "/" + name;
+  FILE *f = fopen(path.c_str(), "r");
+  if (!f) {
+    ADD_FAILURE() << "cannot open " << path;
+    return shots;
+  }
+  char line[128];
+  while (fgets(line, sizeof(line), f)) {
+    unsigned bps, scale;
+    if (line[0] != '#' && sscanf(line, "%u,%u", &bps, &scale) == 2) {
+      shots.push_back({ bps, (uint16_t)scale });
+    }
+  }
+  fclose(f);
+  return shots;
+}
+
+uint32_t transferMs(uint32_t bytes, uint32_t bps) {
+  return (uint32_t)((uint64_t)bytes * 1000 / bps);
+}
+
+struct Replay {
+  std::vector<CapturePlan> plans;
+  std::vector<uint32_t> firstMs;   // what the first image really took
+  int misses = 0;                  // over the budget, from shot `from` on
+  int worseThanOracle = 0;         // a full frame more than one rung smaller
+};
+
+Replay replay(const std::vector<Shot> &trace, uint32_t budgetMs, bool preview, size_t from) {
+  Replay r;
+  rateReset();
+  for (size_t i = 0; i < trace.size(); i++) {
+    const Shot &s = trace[i];
+    CapturePlan plan = planCapture(rateGoodputBps(), budgetMs, rateSizeScale(), preview);
+    CapturePlan oracle = planCapture(s.bps, budgetMs, s.scale, preview);
+
+    uint32_t full = predictJpegBytes(plan.full, s.scale);
+    uint32_t first = plan.sendPreview ? predictThumbnailBytes(plan.full, s.scale) : full;
+    uint32_t ms = transferMs(first, s.bps);
+    r.plans.push_back(plan);
+    r.firstMs.push_back(ms);
+    if (i >= from) {
+      r.misses += ms > budgetMs;
+      // One rung down is at most ~30% fewer bytes; two rungs is more
+      r.worseThanOracle += full * 2 < predictJpegBytes(oracle.full, s.scale);
+    }
+
+    rateObserveFrame(plan.full, full);
+    if (plan.sendPreview) {
+      rateObserveTransfer(first, ms);
+    }
+    rateObserveTransfer(full, transferMs(full, s.bps));
+  }
+  return r;
+}
+
+TEST(RateControl, MoreGoodputNeverPlansASmallerFrame) {
+  for (uint16_t scale : { 500, 1000, 2500 }) {
+    uint32_t prevBytes = 0;
+    for (uint32_t bps = 500; bps <= 200000; bps += 250) {
+      CapturePlan plan = planCapture(bps, RATE_DEFAULT_BUDGET_MS, scale, false);
+      uint32_t bytes = predictJpegBytes(plan.full, scale);
+      ASSERT_GE(bytes, prevBytes) << bps << " B/s, scale " << scale;
+      prevBytes = bytes;
+    }
+  }
+}
+
+TEST(RateControl, PlanFitsTheBudgetWheneverAnyStepDoes) {
+  const CaptureSettings smallest = { RES_QVGA, 20 };
+  for (uint32_t budget : { 1000u, 5000u, 20000u }) {
+    uint32_t target = budget * RATE_BUDGET_SHARE_PCT / 100;
+    for (uint32_t bps = 500; bps <= 200000; bps += 500) {
+      bool fits = transferMs(predictJpegBytes(smallest, 1000), bps) <= target;
+      CapturePlan plan = planCapture(bps, budget, 1000, false);
+      EXPECT_EQ(plan.predictedMs, transferMs(plan.predictedBytes, bps));
+      if (fits) {
+        EXPECT_LE(plan.predictedMs, target) << bps << " B/s";
+      }
+      CapturePlan withPreview = planCapture(bps, budget, 1000, true);
+      if (withPreview.sendPreview) {
+        EXPECT_EQ(RES_UXGA, withPreview.full.res);
+        EXPECT_LT(withPreview.predictedBytes, predictJpegBytes(plan.full, 1000)) << bps << " B/s";
+      }
+    }
+  }
+}
+
+TEST(RateControl, ShortTransfersDoNotMoveTheEstimate) {
+  rateReset();
+  rateObserveTransfer(1023, 1);
+  rateObserveTransfer(50000, 0);
+  EXPECT_EQ((uint32_t)RATE_DEFAULT_GOODPUT_BPS, rateGoodputBps());
+  rateObserveFrame({ RES_VGA, 15 }, 1000000);
+  // Clamped to four times the prediction, then a quarter weight
+  EXPECT_EQ(1000 - 250 + 1000, rateSizeScale());
+}
+
+TEST(RateControl, SteadyLinkMeetsTheBudget) {
+  for (const char *name : { "steady_1m.csv", "burst_2m.csv" }) {
+    std::vector<Shot> trace = loadTrace(name);
+    ASSERT_GE(trace.size(), 40u);
+    for (bool preview : { false, true }) {
+      Replay r = replay(trace, RATE_DEFAULT_BUDGET_MS, preview, 8);
+      EXPECT_LE(r.misses, (int)trace.size() / 10) << name << (preview ? " +preview" : "");
+      EXPECT_LE(r.worseThanOracle, (int)trace.size() / 10) << name;
+    }
+  }
+}
+
+TEST(RateControl, SteadyLinkEstimateConverges) {
+  std::vector<Shot> trace = loadTrace("burst_2m.csv");
+  ASSERT_FALSE(trace.empty());
+  replay(trace, RATE_DEFAULT_BUDGET_MS, false, 0);
+  uint64_t sum = 0;
+  for (const Shot &s : trace) {
+    sum += s.bps;
+  }
+  uint32_t mean = (uint32_t)(sum / trace.size());
+  EXPECT_NEAR(mean, rateGoodputBps(), mean / 8);
+}
+
+// Walking away: the estimate trails the link by a few shots, so a few
+// late frames while it fades, none once it has settled, and back to
+// UXGA once the wearer returns
+TEST(RateControl, FadingLinkRecovers) {
+  std::vector<Shot> trace = loadTrace("walk_away.csv");
+  ASSERT_EQ(70u, trace.size());
+  Replay r = replay(trace, RATE_DEFAULT_BUDGET_MS, false, 0);
+
+  int fadeMisses = 0, settledMisses = 0;
+  for (size_t i = 0; i < trace.size(); i++) {
+    bool late = r.firstMs[i] > RATE_DEFAULT_BUDGET_MS;
+    if (i >= 20 && i < 36) {
+      fadeMisses += late;
+    } else if (i >= 36 && i < 50) {
+      settledMisses += late;
+    }
+  }
+  EXPECT_LE(fadeMisses, 6);
+  EXPECT_LE(settledMisses, 1);
+  EXPECT_LT(r.plans[45].full.res, RES_XGA) << "still planning large frames at the edge";
+  EXPECT_EQ(RES_UXGA, r.plans.back().full.res);
+
+  // A preview arrives in time all the way out
+  Replay p = replay(trace, RATE_DEFAULT_BUDGET_MS, true, 0);
+  EXPECT_LE(p.misses, 2);
+}
+
+// Foliage after a plain wall: the size correction catches up, and the
+// wall again brings the larger frames back
+TEST(RateControl, SceneChangeCorrectsFrameSizes) {
+  std::vector<Shot> trace = loadTrace("scene_change.csv");
+  ASSERT_EQ(70u, trace.size());
+  Replay r = replay(trace, RATE_DEFAULT_BUDGET_MS, false, 0);
+
+  int lateBusy = 0;
+  for (size_t i = 28; i < 50; i++) {
+    lateBusy += r.firstMs[i] > RATE_DEFAULT_BUDGET_MS;
+  }
+  EXPECT_LE(lateBusy, 2);
+  EXPECT_LT(predictJpegBytes(r.plans[45].full, 1000), predictJpegBytes(r.plans[15].full, 1000));
+  // Within a rung of where it was
+  EXPECT_GE(predictJpegBytes(r.plans.back().full, 1000) * 2,
+            predictJpegBytes(r.plans[15].full, 1000));
+}
+
+}  // namespace
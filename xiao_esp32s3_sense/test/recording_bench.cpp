@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#include "adpcm.h"
+#include "audio_corpus.h"
+#include "bench.h"
+#include "voice_detect.h"
+
+// What recordAudio() and liveTask() spend per second of audio on the
+// portable parts: the voice detector over 4 KB blocks, the in-place WAV
+// encode of what was kept, and 20 ms live frames. Host figures; the
+// device reports its own as vad.us_per_s and live.encode_us.
+
+namespace {
+
+const size_t kBlock = 2048;     // samples in an ARENA_AUDIO_BLOCK_SIZE block
+const size_t kLiveFrame = 320;  // LIVE_FRAME_SAMPLES
+
+// All corpus clips back to back
+std::vector<int16_t> allAudio() {
+  std::vector<int16_t> pcm;
+  for (const corpus::Clip &c : corpus::clips()) {
+    pcm.insert(pcm.end(), c.pcm.begin(), c.pcm.end());
+  }
+  return pcm;
+}
+
+// CPU time per second of audio
+double perSecond(double nsPerSample) {
+  return nsPerSample * corpus::kRate;
+}
+
+TEST(RecordingBench, VoiceDetector) {
+  std::vector<int16_t> pcm = allAudio();
+  double ns = benchNs(20, [&](long) {
+    VadState v;
+    vadBegin(&v);
+    int kept = 0;
+    for (size_t at = 0; at < pcm.size(); at += kBlock) {
+      size_t n = pcm.size() - at < kBlock ? pcm.size() - at : kBlock;
+      kept += vadProcess(&v, pcm.data() + at, n);
+    }
+    benchKeep(kept);
+  });
+  benchReport("vadProcess, 4 KB blocks", perSecond(ns / pcm.size()), "s audio");
+}
+
+TEST(RecordingBench, AdpcmWav) {
+  std::vector<int16_t> pcm = allAudio();
+  std::vector<uint8_t> buf(ADPCM_WAV_HEADER_SIZE + pcm.size() * 2);
+  double ns = benchNs(20, [&](long) {
+    memcpy(buf.data() + ADPCM_WAV_HEADER_SIZE, pcm.data(), pcm.size() * 2);
+    benchKeep(adpcmEncodeWavInPlace(buf.data(), ADPCM_WAV_HEADER_SIZE, pcm.size(), corpus::kRate));
+  });
+  benchReport("adpcmEncodeWavInPlace (with the copy in)", perSecond(ns / pcm.size()), "s audio");
+
+  std::vector<int16_t> back(ADPCM_SAMPLES_PER_BLOCK);
+  size_t blocks = pcm.size() / ADPCM_SAMPLES_PER_BLOCK;
+  ns = benchNs(20, [&](long) {
+    for (size_t b = 0; b < blocks; b++) {
+      adpcmDecodeBlock(buf.data() + ADPCM_WAV_HEADER_SIZE + b * ADPCM_BLOCK_ALIGN,
+                       ADPCM_SAMPLES_PER_BLOCK, back.data());
+      benchKeep(back[b % ADPCM_SAMPLES_PER_BLOCK]);
+    }
+  });
+  benchReport("adpcmDecodeBlock", perSecond(ns / (blocks * ADPCM_SAMPLES_PER_BLOCK)), "s audio");
+}
+
+TEST(RecordingBench, LiveFrames) {
+  std::vector<int16_t> pcm = allAudio();
+  uint8_t frame[4 + kLiveFrame / 2];
+  size_t frames = pcm.size() / kLiveFrame;
+  double ns = benchNs(20, [&](long) {
+    AdpcmState s = { 0, 0 };
+    for (size_t f = 0; f < frames; f++) {
+      benchKeep(adpcmEncodeFrame(&s, pcm.data() + f * kLiveFrame, kLiveFrame, frame));
+    }
+  });
+  benchReport("adpcmEncodeFrame, 20 ms frames", ns / frames, "frame");
+}
+
+}  // namespace
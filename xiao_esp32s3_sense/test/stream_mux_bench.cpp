@@ -0,0 +1,243 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "metrics.h"
+#include "stream_mux.h"
+#include "wire_format.h"
+
+// The radio queue under mixed traffic, registered as ble_transfer.cpp
+// does: control and live queued, image (weight 2) and audio (weight 1)
+// pulled in the bulk class. Checks strict class priority, the weighted
+// byte share of the bulk streams, the wait of control and live messages
+// while bulk transfers fill the link, and what a full queue drops.
+//
+// The mux keeps its counters for the life of the process; only
+// MixedTrafficOnTheLink lets messages wait, so the wait_ms figures are
+// its own.
+
+namespace {
+
+// Pulled streams that always have a payload ready, of a set size, and
+// count what they hand over
+struct Bulk {
+  size_t size = MUX_PAYLOAD_MAX;
+  bool ready = true;
+  uint64_t bytes = 0;
+  uint32_t pulls = 0;
+};
+Bulk image, audio;
+
+size_t pullFrom(Bulk &b, uint8_t *out, size_t cap) {
+  if (!b.ready) {
+    return 0;
+  }
+  size_t n = b.size < cap ? b.size : cap;
+  memset(out, 0xB0, n);
+  b.bytes += n;
+  b.pulls++;
+  return n;
+}
+
+size_t pullImage(uint8_t *out, size_t cap) {
+  return pullFrom(image, out, cap);
+}
+
+size_t pullAudio(uint8_t *out, size_t cap) {
+  return pullFrom(audio, out, cap);
+}
+
+void setUp(bool bulk) {
+  muxReset();
+  muxRegister(MUX_CONTROL, MUX_CLASS_CONTROL, 1, nullptr);
+  muxRegister(MUX_LIVE, MUX_CLASS_LIVE, 1, nullptr);
+  muxRegister(MUX_IMAGE, MUX_CLASS_BULK, 2, bulk ? pullImage : nullptr);
+  muxRegister(MUX_AUDIO, MUX_CLASS_BULK, 1, bulk ? pullAudio : nullptr);
+  image = Bulk();
+  audio = Bulk();
+}
+
+uint8_t streamOf(const uint8_t *frame) {
+  return MuxFrame::View{frame}.stream();
+}
+
+// Whatever is queued in a higher class goes before anything lower,
+// however much bulk is waiting
+TEST(StreamMuxBench, StrictClassPriority) {
+  setUp(true);
+  std::mt19937 rng(35);
+  uint8_t frame[MUX_FRAME_MAX];
+  uint8_t msg[MUX_PAYLOAD_MAX] = { 0 };
+  int control = 0, live = 0;
+  for (int i = 0; i < 20000; i++) {
+    if (rng() % 5 == 0 && muxEnqueue(MUX_CONTROL, msg, 1 + rng() % 40, 0)) {
+      control++;
+    }
+    if (rng() % 3 == 0 && muxEnqueue(MUX_LIVE, msg, 1 + rng() % MUX_PAYLOAD_MAX, 0)) {
+      live++;
+    }
+    ASSERT_GT(muxNextFrame(frame, 0), 0u);
+    uint8_t s = streamOf(frame);
+    if (control > 0) {
+      ASSERT_EQ(MUX_CONTROL, s) << "frame " << i;
+      control--;
+    } else if (live > 0) {
+      ASSERT_EQ(MUX_LIVE, s) << "frame " << i;
+      live--;
+    } else {
+      ASSERT_TRUE(s == MUX_IMAGE || s == MUX_AUDIO);
+    }
+  }
+}
+
+// Image and audio both always ready: bytes split 2:1 by weight whatever
+// the payload sizes. A pull past the stream's remaining credit leaves
+// the deficit negative; were that debt forgiven, full 243-byte pulls
+// against the 256-byte quantum would split 3:2 instead.
+TEST(StreamMuxBench, WeightedByteShare) {
+  struct Sizes {
+    size_t image, audio;
+  } cases[] = { { 243, 243 }, { 243, 60 }, { 20, 243 }, { 100, 180 }, { 1, 1 } };
+  for (const Sizes &c : cases) {
+    setUp(true);
+    image.size = c.image;
+    audio.size = c.audio;
+    uint8_t frame[MUX_FRAME_MAX];
+    double worst = 0;
+    for (int i = 0; i < 50000; i++) {
+      ASSERT_GT(muxNextFrame(frame, 0), 0u);
+      // The share stays within a round's credit of 2:1 all along
+      double drift = (double)image.bytes - 2.0 * audio.bytes;
+      worst = fmax(worst, fabs(drift));
+    }
+    double share = (double)image.bytes / (image.bytes + audio.bytes);
+    printf("[   BENCH  ] image %3zu B, audio %3zu B: image share %.4f, worst drift %5.0f B\n",
+           c.image, c.audio, share, worst);
+    EXPECT_NEAR(2.0 / 3, share, 0.005) << c.image << "/" << c.audio;
+    EXPECT_LE(worst, 3.0 * (MUX_QUANTUM + MUX_PAYLOAD_MAX));
+  }
+}
+
+// A stream that went idle does not come back with banked credit
+TEST(StreamMuxBench, IdleStreamBanksNoCredit) {
+  setUp(true);
+  uint8_t frame[MUX_FRAME_MAX];
+  audio.ready = false;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(MUX_IMAGE, (muxNextFrame(frame, 0), streamOf(frame)));
+  }
+  audio.ready = true;
+  int run = 0, longest = 0;
+  for (int i = 0; i < 100; i++) {
+    muxNextFrame(frame, 0);
+    run = streamOf(frame) == MUX_AUDIO ? run + 1 : 0;
+    longest = run > longest ? run : longest;
+  }
+  // One quantum's worth of 243-byte frames, and one on credit
+  EXPECT_LE(longest, 2);
+}
+
+// A link of 7.5 ms connection events with a few notifications each,
+// both bulk streams always ready, control replies at random and a live
+// frame every 20 ms: neither waits past the next connection event
+TEST(StreamMuxBench, MixedTrafficOnTheLink) {
+  setUp(true);
+  std::mt19937 rng(35);
+  uint8_t frame[MUX_FRAME_MAX];
+  uint8_t msg[MUX_PAYLOAD_MAX] = { 0 };
+  const double intervalMs = 7.5;
+  const int perEvent = 4;
+  double nextEvent = 0;
+  uint64_t sent[MUX_STREAMS] = { 0 };
+
+  for (uint32_t now = 0; now < 120000; now++) {
+    if (rng() % 50 == 0) {
+      muxEnqueue(MUX_CONTROL, msg, 1 + rng() % 60, now);
+    }
+    if (now % 20 == 0) {
+      muxEnqueue(MUX_LIVE, msg, 4 + 160, now);    // a 20 ms ADPCM frame
+    }
+    while (nextEvent < now + 1) {
+      for (int i = 0; i < perEvent; i++) {
+        size_t len = muxNextFrame(frame, now);
+        if (len > 0) {
+          sent[streamOf(frame)] += len - MuxFrame::SIZE;
+        }
+      }
+      nextEvent += intervalMs;
+    }
+  }
+
+  muxPublishMetrics();
+  uint32_t controlWait = metricGet("mux.control.wait_ms");
+  uint32_t liveWait = metricGet("mux.live.wait_ms");
+  double seconds = 120;
+  printf("[   BENCH  ] %-10s %8.0f B/s\n", "control", sent[MUX_CONTROL] / seconds);
+  printf("[   BENCH  ] %-10s %8.0f B/s, max wait %u ms\n", "live", sent[MUX_LIVE] / seconds, liveWait);
+  printf("[   BENCH  ] %-10s %8.0f B/s\n", "image", sent[MUX_IMAGE] / seconds);
+  printf("[   BENCH  ] %-10s %8.0f B/s\n", "audio", sent[MUX_AUDIO] / seconds);
+  printf("[   BENCH  ] control max wait %u ms\n", controlWait);
+  EXPECT_LE(controlWait, 8u);
+  EXPECT_LE(liveWait, 8u);
+  EXPECT_EQ(0u, metricGet("mux.dropped"));
+  // What is left of the link is still split 2:1
+  EXPECT_NEAR(2.0, (double)sent[MUX_IMAGE] / sent[MUX_AUDIO], 0.02);
+}
+
+// A queue that is not drained fills, refuses and counts what does not
+// fit, and hands over what it took intact and in order, across the ring
+// wrapping many times
+TEST(StreamMuxBench, FullQueueDrops) {
+  setUp(false);
+  muxPublishMetrics();
+  uint32_t droppedBefore = metricGet("mux.dropped");
+  uint8_t frame[MUX_FRAME_MAX];
+
+  std::mt19937 rng(36);
+  uint32_t accepted = 0, refused = 0;
+  uint8_t nextIn = 0, nextOut = 0;
+  for (int round = 0; round < 200; round++) {
+    // Fill past capacity with messages of odd sizes, each byte a counter
+    for (int i = 0; i < 60; i++) {
+      uint8_t msg[MUX_PAYLOAD_MAX];
+      size_t len = 1 + rng() % 150;
+      msg[0] = nextIn;
+      memset(msg + 1, nextIn, len - 1);
+      if (muxEnqueue(MUX_CONTROL, msg, len, 0)) {
+        nextIn++;
+        accepted++;
+      } else {
+        refused++;
+      }
+    }
+    // Drain part of it, so the ring wraps at a different place each time
+    int drain = round % 5 == 4 ? 1000 : 1 + rng() % 20;
+    for (int i = 0; i < drain; i++) {
+      size_t len = muxNextFrame(frame, 0);
+      if (len == 0) {
+        break;
+      }
+      ASSERT_EQ(MUX_CONTROL, streamOf(frame));
+      for (size_t b = MuxFrame::SIZE; b < len; b++) {
+        ASSERT_EQ(nextOut, frame[b]);
+      }
+      nextOut++;
+    }
+  }
+  muxPublishMetrics();
+  EXPECT_GT(refused, 0u);
+  EXPECT_GT(accepted, 1000u);
+  EXPECT_EQ(refused, metricGet("mux.dropped") - droppedBefore);
+
+  // A pulled stream takes nothing queued, and oversized messages are
+  // refused outright
+  setUp(true);
+  uint8_t big[MUX_PAYLOAD_MAX + 1] = { 0 };
+  EXPECT_FALSE(muxEnqueue(MUX_IMAGE, big, 10, 0));
+  EXPECT_FALSE(muxEnqueue(MUX_CONTROL, big, sizeof(big), 0));
+  EXPECT_FALSE(muxEnqueue(MUX_CONTROL, big, 0, 0));
+  EXPECT_FALSE(muxEnqueue(MUX_STREAMS, big, 10, 0));
+}
+
+}  // namespace
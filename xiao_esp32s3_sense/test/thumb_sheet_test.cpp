@@ -0,0 +1,215 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <vector>
+#include "capture_catalog.h"
+#include "thumb_sheet.h"
+#include "wire_format.h"
+
+// Thumbnail sheets over an in-memory catalog and sidecars: what a sheet
+// holds, parsed back, and that a client following next_id from any
+// THUMBS request reaches the end of the catalog, each photo once.
+
+namespace {
+
+const uint32_t kNow = 1700000000;
+
+struct Card {
+  std::vector<uint8_t> catalogFile;
+  Catalog catalog;
+  std::map<uint32_t, std::vector<uint8_t>> sidecars;
+
+  Card() {
+    catalogOpen(&catalog, { this, fileRead, fileWrite }, 0, 1);
+  }
+  Card(const Card &) = delete;    // the catalog points back at this
+
+  // Appends a capture; photos get a sidecar of `thumbLen` bytes (0: none)
+  uint32_t add(uint8_t type, size_t thumbLen, uint8_t flags = 0) {
+    CatalogEntry e;
+    catalogAppend(&catalog, type, kNow + catalog.count, &e);
+    e.size = 100000;
+    e.flags = flags;
+    catalogUpdate(&catalog, e);
+    if (type == CAPTURE_PHOTO && thumbLen > 0) {
+      std::vector<uint8_t> jpg(thumbLen, (uint8_t)e.id);
+      jpg[0] = 0xFF;
+      jpg[1] = 0xD8;
+      sidecars[e.id] = jpg;
+    }
+    return e.id;
+  }
+
+  ThumbSheetSource source() {
+    return { this, readSidecar, list };
+  }
+
+  static bool fileRead(void *ctx, uint32_t offset, uint8_t *buf, size_t len) {
+    Card *c = (Card *)ctx;
+    if (offset + len > c->catalogFile.size()) {
+      return false;
+    }
+    memcpy(buf, c->catalogFile.data() + offset, len);
+    return true;
+  }
+
+  static bool fileWrite(void *ctx, uint32_t offset, const uint8_t *buf, size_t len) {
+    Card *c = (Card *)ctx;
+    if (offset + len > c->catalogFile.size()) {
+      c->catalogFile.resize(offset + len);
+    }
+    memcpy(c->catalogFile.data() + offset, buf, len);
+    return true;
+  }
+
+  static size_t readSidecar(void *ctx, uint32_t id, uint8_t *buf, size_t cap) {
+    Card *c = (Card *)ctx;
+    auto it = c->sidecars.find(id);
+    if (it == c->sidecars.end()) {
+      return 0;
+    }
+    if (it->second.size() <= cap) {
+      memcpy(buf, it->second.data(), it->second.size());
+    }
+    return it->second.size();
+  }
+
+  // As catalogList()
+  static size_t list(void *ctx, uint32_t fromId, CatalogEntry *out, size_t max) {
+    Card *c = (Card *)ctx;
+    return catalogRead(&c->catalog, catalogLowerBoundId(&c->catalog, fromId), out, max);
+  }
+};
+
+struct Parsed {
+  uint16_t count;
+  uint32_t nextId;
+  std::vector<uint32_t> ids;
+};
+
+Parsed parse(const std::vector<uint8_t> &sheet, size_t len, const Card &card) {
+  Parsed p;
+  EXPECT_GE(len, ThumbSheetHeader::SIZE);
+  ThumbSheetHeader::View h{sheet.data()};
+  p.count = h.count();
+  p.nextId = h.nextId();
+  size_t at = ThumbSheetHeader::SIZE;
+  for (uint16_t i = 0; i < p.count; i++) {
+    EXPECT_LE(at + ThumbSheetEntry::SIZE, len);
+    ThumbSheetEntry::View e{sheet.data() + at};
+    at += ThumbSheetEntry::SIZE;
+    const std::vector<uint8_t> &jpg = card.sidecars.at(e.id());
+    EXPECT_EQ(jpg.size(), e.length());
+    EXPECT_EQ(0, memcmp(jpg.data(), sheet.data() + at, jpg.size()));
+    at += e.length();
+    p.ids.push_back(e.id());
+  }
+  EXPECT_EQ(len, at);
+  return p;
+}
+
+// Follows next_id from fromId to the end; the photos seen, in order
+std::vector<uint32_t> browse(Card &card, uint32_t fromId, uint16_t count, size_t cap,
+                             int *sheets) {
+  std::vector<uint8_t> buf(cap);
+  std::vector<uint32_t> seen;
+  *sheets = 0;
+  uint32_t id = fromId;
+  do {
+    uint16_t n;
+    uint32_t next;
+    size_t len = thumbSheetBuild(card.source(), id, count, buf.data(), cap, &n, &next);
+    Parsed p = parse(buf, len, card);
+    EXPECT_EQ(n, p.count);
+    EXPECT_EQ(next, p.nextId);
+    EXPECT_TRUE(next == 0 || next > id) << "sheet from " << id << " points back to " << next;
+    if (next != 0 && next <= id) {
+      break;
+    }
+    seen.insert(seen.end(), p.ids.begin(), p.ids.end());
+    id = next;
+    (*sheets)++;
+  } while (id != 0 && *sheets < 10000);
+  return seen;
+}
+
+// Photos among other captures, some without a usable sidecar
+void fillMixed(Card &card, std::vector<uint32_t> *photos) {
+  for (int i = 0; i < 300; i++) {
+    if (i % 7 == 3) {
+      card.add(CAPTURE_AUDIO, 0);
+    } else if (i % 11 == 5) {
+      card.add(CAPTURE_PHOTO, 3000, CATALOG_FLAG_DUPLICATE);
+    } else if (i % 13 == 8) {
+      card.add(CAPTURE_PHOTO, 0);   // sidecar never written
+    } else {
+      photos->push_back(card.add(CAPTURE_PHOTO, 2000 + (i * 37) % 5000));
+    }
+  }
+}
+
+// THUMBS:<id>:0 used to return an empty sheet naming <id> again
+TEST(ThumbSheet, CountZeroStillMovesOn) {
+  Card card;
+  std::vector<uint32_t> photos;
+  fillMixed(card, &photos);
+  std::vector<uint8_t> buf(65536);
+  uint16_t n;
+  uint32_t next;
+  size_t len = thumbSheetBuild(card.source(), photos[0], 0, buf.data(), buf.size(), &n, &next);
+  Parsed p = parse(buf, len, card);
+  ASSERT_EQ(1, p.count);
+  EXPECT_EQ(photos[0], p.ids[0]);
+  EXPECT_GT(next, photos[0]);
+
+  int sheets;
+  EXPECT_EQ(photos, browse(card, photos[0], 0, buf.size(), &sheets));
+  EXPECT_EQ((int)photos.size(), sheets);
+}
+
+// From any starting ID and any count, each photo with a sidecar once
+TEST(ThumbSheet, BrowsingReachesTheEnd) {
+  Card card;
+  std::vector<uint32_t> photos;
+  fillMixed(card, &photos);
+  for (uint16_t count : { 1, 5, 32, 33, 128 }) {
+    for (size_t cap : { (size_t)16384, (size_t)65536, (size_t)262144 }) {
+      for (uint32_t from : { 0u, 1u, 150u, photos.back(), photos.back() + 1 }) {
+        int sheets;
+        std::vector<uint32_t> seen = browse(card, from, count, cap, &sheets);
+        std::vector<uint32_t> expect;
+        for (uint32_t id : photos) {
+          if (id >= from) {
+            expect.push_back(id);
+          }
+        }
+        ASSERT_EQ(expect, seen) << "count " << count << " cap " << cap << " from " << from;
+      }
+    }
+  }
+}
+
+// A sidecar too big for any sheet is passed over rather than stalling
+TEST(ThumbSheet, OversizedSidecarIsPassedOver) {
+  Card card;
+  uint32_t a = card.add(CAPTURE_PHOTO, 1000);
+  card.add(CAPTURE_PHOTO, 20000);
+  uint32_t c = card.add(CAPTURE_PHOTO, 1000);
+  int sheets;
+  std::vector<uint32_t> seen = browse(card, a, 128, 8192, &sheets);
+  EXPECT_EQ((std::vector<uint32_t>{ a, c }), seen);
+}
+
+TEST(ThumbSheet, EmptyCatalog) {
+  Card card;
+  std::vector<uint8_t> buf(1024);
+  uint16_t n;
+  uint32_t next;
+  size_t len = thumbSheetBuild(card.source(), 1, 128, buf.data(), buf.size(), &n, &next);
+  EXPECT_EQ((size_t)ThumbSheetHeader::SIZE, len);
+  EXPECT_EQ(0, n);
+  EXPECT_EQ(0u, next);
+}
+
+}  // namespace
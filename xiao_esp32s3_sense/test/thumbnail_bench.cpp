@@ -0,0 +1,224 @@
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include <jpeglib.h>
+#include "bench.h"
+#include "psram_arena.h"
+#include "thumbnail.h"
+
+// makeThumbnailWith() on Linux: a UXGA frame decoded at the scale
+// thumbnailScale() picks, straight to big-endian RGB565 in an arena
+// slot, then re-encoded at THUMB_QUALITY into the thumbnail's budget.
+// The device runs the same code with the camera library's codec
+// (jpg2rgb565, fmt2jpg_cb), which does not build here; libjpeg stands
+// in for it through a ThumbCodec with the same steps (DCT-domain
+// scaling, RGB565 in between), so these figures show the cost of each
+// step and of scaling in the decoder, not the device's times
+// (thumb.decode_us and thumb.encode_us in METRICS).
+
+namespace {
+
+const uint16_t kWidth = 1600;    // UXGA, FRAMESIZE_UXGA
+const uint16_t kHeight = 1200;
+const int kCameraQuality = 85;   // about what the sensor's quality 10-12 gives
+
+// A frame with something in it: gradients, shapes with edges, texture
+std::vector<uint8_t> scene() {
+  std::vector<uint8_t> rgb((size_t)kWidth * kHeight * 3);
+  std::mt19937 rng(47);
+  for (int y = 0; y < kHeight; y++) {
+    for (int x = 0; x < kWidth; x++) {
+      uint8_t *p = &rgb[((size_t)y * kWidth + x) * 3];
+      double r = 120 + 80 * sin(x / 90.0), g = 100 + 60 * cos(y / 70.0), b = 90 + x * 80.0 / kWidth;
+      if ((x / 200 + y / 150) % 3 == 0) {
+        r = 230 - r / 2;
+        g = 40 + g / 3;
+      }
+      double dx = x - 1000, dy = y - 500;
+      if (dx * dx + dy * dy < 250 * 250) {
+        r = 30;
+        g = 170 + 40 * sin((x + y) / 12.0);
+        b = 60;
+      }
+      int noise = (int)(rng() % 17) - 8;
+      p[0] = (uint8_t)fmin(255, fmax(0, r + noise));
+      p[1] = (uint8_t)fmin(255, fmax(0, g + noise));
+      p[2] = (uint8_t)fmin(255, fmax(0, b + noise));
+    }
+  }
+  return rgb;
+}
+
+std::vector<uint8_t> encode(const uint8_t *rgb, uint16_t width, uint16_t height, int quality) {
+  jpeg_compress_struct c;
+  jpeg_error_mgr err;
+  c.err = jpeg_std_error(&err);
+  jpeg_create_compress(&c);
+  unsigned char *out = nullptr;
+  unsigned long outLen = 0;
+  jpeg_mem_dest(&c, &out, &outLen);
+  c.image_width = width;
+  c.image_height = height;
+  c.input_components = 3;
+  c.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&c);
+  jpeg_set_quality(&c, quality, TRUE);
+  jpeg_start_compress(&c, TRUE);
+  while (c.next_scanline < c.image_height) {
+    JSAMPROW row = (JSAMPROW)(rgb + (size_t)c.next_scanline * width * 3);
+    jpeg_write_scanlines(&c, &row, 1);
+  }
+  jpeg_finish_compress(&c);
+  jpeg_destroy_compress(&c);
+  std::vector<uint8_t> jpg(out, out + outLen);
+  free(out);
+  return jpg;
+}
+
+// jpg2rgb565: decoded at 1/scale, packed to big-endian RGB565 in the
+// buffer thumbnailPlan() sized
+bool libjpegDecode(void *, const uint8_t *jpg, size_t len, uint8_t scale, uint8_t *rgb) {
+  jpeg_decompress_struct d;
+  jpeg_error_mgr err;
+  d.err = jpeg_std_error(&err);
+  jpeg_create_decompress(&d);
+  jpeg_mem_src(&d, jpg, len);
+  jpeg_read_header(&d, TRUE);
+  ThumbPlan plan = thumbnailPlan(d.image_width, d.image_height, scale);
+  d.scale_num = 1;
+  d.scale_denom = plan.scale;
+  d.out_color_space = JCS_RGB;
+  jpeg_start_decompress(&d);
+  bool ok = d.output_width == plan.width && d.output_height == plan.height;
+  std::vector<uint8_t> row((size_t)d.output_width * 3);
+  while (ok && d.output_scanline < d.output_height) {
+    size_t y = d.output_scanline;
+    JSAMPROW r = row.data();
+    jpeg_read_scanlines(&d, &r, 1);
+    uint8_t *o = rgb + y * plan.width * 2;
+    for (uint16_t x = 0; x < plan.width; x++) {
+      const uint8_t *p = &row[x * 3];
+      uint16_t v = (p[0] & 0xF8) << 8 | (p[1] & 0xFC) << 3 | p[2] >> 3;
+      o[x * 2] = v >> 8;
+      o[x * 2 + 1] = v & 0xFF;
+    }
+  }
+  if (ok) {
+    jpeg_finish_decompress(&d);
+  }
+  jpeg_destroy_decompress(&d);
+  return ok;
+}
+
+// fmt2jpg_cb from RGB565: expanded to RGB, encoded, and handed over in
+// pieces the way the camera library's encoder flushes its buffer
+bool libjpegEncode(void *, const uint8_t *rgb565, uint16_t width, uint16_t height,
+                   uint8_t quality, ThumbWriteFn write, void *arg) {
+  std::vector<uint8_t> rgb((size_t)width * height * 3);
+  for (size_t i = 0; i < (size_t)width * height; i++) {
+    uint16_t v = rgb565[i * 2] << 8 | rgb565[i * 2 + 1];
+    rgb[i * 3] = (v >> 8) & 0xF8;
+    rgb[i * 3 + 1] = (v >> 3) & 0xFC;
+    rgb[i * 3 + 2] = (v << 3) & 0xF8;
+  }
+  std::vector<uint8_t> jpg = encode(rgb.data(), width, height, quality);
+  const size_t chunk = 1024;
+  for (size_t at = 0; at < jpg.size(); at += chunk) {
+    size_t n = std::min(chunk, jpg.size() - at);
+    if (write(arg, at, jpg.data() + at, n) != n) {
+      return false;
+    }
+  }
+  return true;
+}
+
+const ThumbCodec kLibjpeg = { nullptr, libjpegDecode, libjpegEncode };
+
+uint16_t thumbSlotsInUse() {
+  ArenaStats st;
+  arenaGetStats(ARENA_THUMB, &st);
+  return st.inUse;
+}
+
+TEST(ThumbnailBench, DownscaleAndReencode) {
+  ASSERT_TRUE(initArena());
+  std::vector<uint8_t> rgb = scene();
+  std::vector<uint8_t> frame = encode(rgb.data(), kWidth, kHeight, kCameraQuality);
+  printf("[   INFO   ] frame %ux%u, %zu bytes\n", kWidth, kHeight, frame.size());
+
+  // The whole of makeThumbnail(), arena and budget included
+  Thumbnail thumb;
+  bool ok = true;
+  double whole = benchNs(20, [&](long) {
+    ArenaScope scope = arenaBeginScope();
+    ok = makeThumbnailWith(kLibjpeg, frame.data(), frame.size(), scope, &thumb) && ok;
+    benchKeep(thumb.len);
+    arenaEndScope(scope);
+  });
+  ASSERT_TRUE(ok);
+  EXPECT_EQ(0, thumbSlotsInUse());
+
+  // Its two steps: the decode into an arena slot, the encode into the
+  // thumbnail's budget
+  ArenaScope scope = arenaBeginScope();
+  uint16_t tw = 0, th = 0;
+  double decode = benchNs(20, [&](long) {
+    uint8_t *px = decodeScaledWith(kLibjpeg, frame.data(), frame.size(), thumbnailScale(kWidth),
+                                   scope, &tw, &th);
+    ok = px != nullptr && ok;
+    benchKeep(px ? px[0] : 0);
+    arenaFree(px);
+  });
+  ASSERT_TRUE(ok);
+  ASSERT_EQ(kWidth / 8, tw);
+  ASSERT_EQ(kHeight / 8, th);
+  ASSERT_GE(tw, THUMB_MIN_WIDTH);
+
+  uint8_t *px = decodeScaledWith(kLibjpeg, frame.data(), frame.size(), 8, scope, &tw, &th);
+  uint8_t *dst = arenaAlloc(THUMB_JPEG_MAX, scope);
+  ASSERT_NE(nullptr, px);
+  ASSERT_NE(nullptr, dst);
+  ThumbSink sink = { dst, THUMB_JPEG_MAX, 0, false };
+  double reencode = benchNs(50, [&](long) {
+    sink.len = 0;
+    ok = libjpegEncode(nullptr, px, tw, th, THUMB_QUALITY, thumbSinkWrite, &sink) && ok;
+    benchKeep(sink.len);
+  });
+  ASSERT_TRUE(ok);
+  ASSERT_FALSE(sink.overflow);
+  arenaEndScope(scope);
+
+  // What scaling in the decoder saves over decoding the whole frame;
+  // these sizes are past any arena slot, so straight into a vector
+  double scaled[4];
+  for (uint8_t scale : { 1, 2 }) {
+    std::vector<uint8_t> out(thumbnailPlan(kWidth, kHeight, scale).rgbLen);
+    scaled[scale] = benchNs(10 / scale, [&](long) {
+      ok = libjpegDecode(nullptr, frame.data(), frame.size(), scale, out.data()) && ok;
+      benchKeep(out[0]);
+    });
+  }
+  ASSERT_TRUE(ok);
+
+  benchReport("makeThumbnail", whole, "frame");
+  benchReport("decode 1/8 to RGB565", decode, "frame");
+  benchReport("decode 1/2 to RGB565", scaled[2], "frame");
+  benchReport("decode 1/1 to RGB565", scaled[1], "frame");
+  benchReport("encode thumbnail", reencode, "thumb");
+  printf("[   BENCH  ] thumbnail %ux%u, %zu bytes (%.1f%% of the frame)\n", thumb.width,
+         thumb.height, thumb.len, 100.0 * thumb.len / frame.size());
+
+  // The Huffman decode is the same work at any scale; scaling saves the
+  // IDCT, colour conversion and packing
+  EXPECT_LT(decode * 1.5, scaled[1]);
+  // Small enough for dozens on a sheet, and for 100 to cross the link in
+  // seconds where 100 frames take minutes
+  EXPECT_EQ(sink.len, thumb.len);
+  EXPECT_LT(thumb.len * 10, frame.size());
+}
+
+}  // namespace
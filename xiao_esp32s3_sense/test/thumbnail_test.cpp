@@ -0,0 +1,236 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "metrics.h"
+#include "psram_arena.h"
+#include "thumbnail.h"
+
+// Everything makeThumbnail() does around the codec: the scale and size
+// it plans from the frame header, the RGB565 buffer it decodes into, the
+// size budget the encoded thumbnail is held to and what stays in the
+// arena afterwards. A fake codec stands in for the camera library's; it
+// records what it is asked for and produces output of a set size.
+
+namespace {
+
+// The start of a baseline JPEG of the given size, as far as
+// jpegDimensions() reads
+std::vector<uint8_t> jpegHeader(uint16_t width, uint16_t height) {
+  return { 0xFF, 0xD8,
+           0xFF, 0xE0, 0x00, 0x04, 0x00, 0x00,
+           0xFF, 0xC0, 0x00, 0x11, 0x08,
+           (uint8_t)(height >> 8), (uint8_t)height, (uint8_t)(width >> 8), (uint8_t)width,
+           0x03, 0x01, 0x22, 0x00 };
+}
+
+struct FakeCodec {
+  bool decodeOk = true;
+  size_t outLen = 3000;       // bytes the encoder produces
+  size_t chunk = 512;         // in calls of this size
+  uint8_t scale = 0;          // as asked
+  uint16_t width = 0, height = 0;
+  uint32_t pixelSum = 0;      // of what the encoder was handed
+  size_t stoppedAt = 0;       // where write refused, or outLen
+};
+
+bool fakeDecode(void *ctx, const uint8_t *, size_t, uint8_t scale, uint8_t *rgb) {
+  FakeCodec *f = (FakeCodec *)ctx;
+  f->scale = scale;
+  if (!f->decodeOk) {
+    return false;
+  }
+  // A red pixel and a blue one, big-endian
+  rgb[0] = 0xF8;
+  rgb[1] = 0x00;
+  rgb[2] = 0x00;
+  rgb[3] = 0x1F;
+  return true;
+}
+
+bool fakeEncode(void *ctx, const uint8_t *rgb, uint16_t width, uint16_t height, uint8_t quality,
+                ThumbWriteFn write, void *arg) {
+  FakeCodec *f = (FakeCodec *)ctx;
+  f->width = width;
+  f->height = height;
+  f->pixelSum = rgb[0] + rgb[1] + rgb[2] + rgb[3];
+  EXPECT_EQ(THUMB_QUALITY, quality);
+  std::vector<uint8_t> out(f->outLen);
+  std::vector<uint8_t> head = jpegHeader(width, height);
+  memcpy(out.data(), head.data(), std::min(head.size(), out.size()));
+  for (size_t at = 0; at < out.size(); at += f->chunk) {
+    size_t n = std::min(f->chunk, out.size() - at);
+    if (write(arg, at, out.data() + at, n) != n) {
+      f->stoppedAt = at;
+      return false;
+    }
+  }
+  f->stoppedAt = out.size();
+  return true;
+}
+
+uint16_t thumbSlotsInUse() {
+  ArenaStats st;
+  arenaGetStats(ARENA_THUMB, &st);
+  return st.inUse;
+}
+
+class ThumbnailTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_TRUE(initArena());
+    scope = arenaBeginScope();
+  }
+  void TearDown() override {
+    arenaEndScope(scope);
+    EXPECT_EQ(0, thumbSlotsInUse());
+  }
+
+  FakeCodec fake;
+  ThumbCodec codec = { &fake, fakeDecode, fakeEncode };
+  ArenaScope scope = ARENA_SCOPE_NONE;
+};
+
+// The camera's frame sizes: the largest scale that keeps 160 pixels of
+// width, and pixels that always fit a thumbnail slot
+TEST(ThumbnailPlan, ScaleAndBufferPerFrameSize) {
+  struct {
+    uint16_t w, h;
+    uint8_t scale;
+  } sizes[] = {
+    { 160, 120, 1 }, { 320, 240, 2 }, { 640, 480, 4 }, { 800, 600, 4 }, { 1024, 768, 4 },
+    { 1280, 720, 8 }, { 1280, 1024, 8 }, { 1600, 1200, 8 }, { 2048, 1536, 8 },
+  };
+  for (const auto &s : sizes) {
+    SCOPED_TRACE(std::to_string(s.w) + "x" + std::to_string(s.h));
+    ASSERT_EQ(s.scale, thumbnailScale(s.w));
+    ThumbPlan p = thumbnailPlan(s.w, s.h, thumbnailScale(s.w));
+    EXPECT_EQ(s.scale, p.scale);
+    EXPECT_EQ(s.w / s.scale, p.width);
+    EXPECT_EQ(s.h / s.scale, p.height);
+    EXPECT_GE(p.width, THUMB_MIN_WIDTH);
+    EXPECT_EQ((size_t)p.width * p.height * 2, p.rgbLen);
+    EXPECT_LE(p.rgbLen, (size_t)ARENA_THUMB_SIZE);
+  }
+  // Narrower than the minimum is not scaled at all
+  EXPECT_EQ(1, thumbnailScale(100));
+
+  // Scales the decoder does not have decode whole
+  for (uint8_t scale : { 0, 1, 3, 5, 16 }) {
+    ThumbPlan p = thumbnailPlan(1600, 1200, scale);
+    EXPECT_EQ(1, p.scale) << (int)scale;
+    EXPECT_EQ(1600u * 1200 * 2, p.rgbLen);
+  }
+}
+
+// Output lands at its index whatever the order; the budget is exact
+TEST(ThumbnailSink, HoldsToItsBudget) {
+  uint8_t buf[64];
+  memset(buf, 0, sizeof(buf));
+  ThumbSink sink = { buf, sizeof(buf), 0, false };
+  const uint8_t a[16] = { 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1 };
+  const uint8_t b[16] = { 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 };
+  EXPECT_EQ(16u, thumbSinkWrite(&sink, 16, b, 16));
+  EXPECT_EQ(32u, sink.len);
+  EXPECT_EQ(16u, thumbSinkWrite(&sink, 0, a, 16));
+  EXPECT_EQ(32u, sink.len);
+  EXPECT_EQ(1, buf[15]);
+  EXPECT_EQ(2, buf[16]);
+  EXPECT_EQ(16u, thumbSinkWrite(&sink, 48, b, 16));
+  EXPECT_EQ(64u, sink.len);
+  EXPECT_FALSE(sink.overflow);
+
+  // One byte past the end, or an index that would wrap, is refused and
+  // leaves the buffer as it was
+  EXPECT_EQ(0u, thumbSinkWrite(&sink, 49, a, 16));
+  EXPECT_TRUE(sink.overflow);
+  EXPECT_EQ(2, buf[49]);
+  sink.overflow = false;
+  EXPECT_EQ(0u, thumbSinkWrite(&sink, SIZE_MAX - 4, a, 16));
+  EXPECT_TRUE(sink.overflow);
+  EXPECT_EQ(64u, sink.len);
+}
+
+TEST_F(ThumbnailTest, DecodesAtTheAskedScale) {
+  std::vector<uint8_t> frame = jpegHeader(1600, 1200);
+  uint16_t w = 0, h = 0;
+  uint8_t *rgb = decodeScaledWith(codec, frame.data(), frame.size(), 8, scope, &w, &h);
+  ASSERT_NE(nullptr, rgb);
+  EXPECT_EQ(8, fake.scale);
+  EXPECT_EQ(200, w);
+  EXPECT_EQ(150, h);
+  EXPECT_EQ(0xF8, rgb[0]);
+  EXPECT_EQ(1, thumbSlotsInUse());
+  arenaFree(rgb);
+
+  fake.decodeOk = false;
+  EXPECT_EQ(nullptr, decodeScaledWith(codec, frame.data(), frame.size(), 8, scope, &w, &h));
+  EXPECT_EQ(0, thumbSlotsInUse());
+}
+
+// Success leaves only the JPEG in the caller's scope; the decoded pixels
+// are given back once encoded
+TEST_F(ThumbnailTest, KeepsOnlyTheJpeg) {
+  std::vector<uint8_t> frame = jpegHeader(1600, 1200);
+  Thumbnail thumb;
+  ASSERT_TRUE(makeThumbnailWith(codec, frame.data(), frame.size(), scope, &thumb));
+  EXPECT_EQ(8, fake.scale);
+  EXPECT_EQ(200, fake.width);
+  EXPECT_EQ(150, fake.height);
+  EXPECT_EQ(0xF8u + 0x1F, fake.pixelSum);
+  EXPECT_EQ(200, thumb.width);
+  EXPECT_EQ(150, thumb.height);
+  EXPECT_EQ(fake.outLen, thumb.len);
+  EXPECT_EQ(1, thumbSlotsInUse());
+
+  uint16_t w, h;
+  ASSERT_TRUE(jpegDimensions(thumb.jpg, thumb.len, &w, &h));
+  EXPECT_EQ(200, w);
+  EXPECT_EQ(150, h);
+  EXPECT_EQ(thumb.len, metricGet("thumb.bytes"));
+}
+
+// A thumbnail of exactly the budget is kept; one byte more stops the
+// encoder at the chunk that does not fit and frees everything
+TEST_F(ThumbnailTest, SizeBudget) {
+  std::vector<uint8_t> frame = jpegHeader(640, 480);
+  Thumbnail thumb;
+  fake.outLen = THUMB_JPEG_MAX;
+  fake.chunk = 1000;
+  ASSERT_TRUE(makeThumbnailWith(codec, frame.data(), frame.size(), scope, &thumb));
+  EXPECT_EQ((size_t)THUMB_JPEG_MAX, thumb.len);
+  arenaFree(thumb.jpg);
+
+  fake.outLen = THUMB_JPEG_MAX + 1;
+  EXPECT_FALSE(makeThumbnailWith(codec, frame.data(), frame.size(), scope, &thumb));
+  EXPECT_EQ((size_t)THUMB_JPEG_MAX / fake.chunk * fake.chunk, fake.stoppedAt);
+  EXPECT_EQ(0, thumbSlotsInUse());
+}
+
+TEST_F(ThumbnailTest, FailuresLeaveNothingBehind) {
+  Thumbnail thumb;
+  const uint8_t notJpeg[] = { 0x89, 'P', 'N', 'G', 0, 0, 0, 0 };
+  EXPECT_FALSE(makeThumbnailWith(codec, notJpeg, sizeof(notJpeg), scope, &thumb));
+  EXPECT_EQ(0, fake.scale);
+
+  // Scan data before any frame header
+  const uint8_t noSof[] = { 0xFF, 0xD8, 0xFF, 0xDA, 0x00, 0x02, 0x00, 0x00 };
+  EXPECT_FALSE(makeThumbnailWith(codec, noSof, sizeof(noSof), scope, &thumb));
+  EXPECT_EQ(0, thumbSlotsInUse());
+
+  std::vector<uint8_t> frame = jpegHeader(800, 600);
+  fake.decodeOk = false;
+  EXPECT_FALSE(makeThumbnailWith(codec, frame.data(), frame.size(), scope, &thumb));
+  EXPECT_EQ(4, fake.scale);
+  EXPECT_EQ(0, thumbSlotsInUse());
+
+  // An encoder that reports success without output
+  fake.decodeOk = true;
+  fake.outLen = 0;
+  EXPECT_FALSE(makeThumbnailWith(codec, frame.data(), frame.size(), scope, &thumb));
+  EXPECT_EQ(0, thumbSlotsInUse());
+}
+
+}  // namespace
@@ -0,0 +1,233 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "crc32.h"
+#include "reassembly.h"
+#include "transfer_session.h"
+#include "wire_format.h"
+
+// The sender's session store against the phone's reassembler
+// (phone_app/native/reassembly.cc) over a link that loses packets, loses
+// ACKs, corrupts payloads and drops the connection at random. The device
+// side is driven the way pullImage() drives it; the phone's replies go
+// back through the same parsing as the BLE callbacks.
+
+namespace {
+
+const size_t kChunk = 180;   // IMAGE_CHUNK_SIZE in ble_transfer.cpp
+
+uint16_t parseReply(const std::string &reply, const char *prefix) {
+  return (uint16_t)strtoul(reply.c_str() + strlen(prefix), nullptr, 10);
+}
+
+bool startsWith(const std::string &s, const char *prefix) {
+  return s.compare(0, strlen(prefix), prefix) == 0;
+}
+
+std::string replyOf(Reassembler *r) {
+  return std::string((const char *)reasm_reply(r), reasm_reply_length(r));
+}
+
+TEST(TransferSession, SendsEverythingInOrder) {
+  TransferSession s;
+  sessionBegin(&s, 7, 3);
+  uint16_t seq;
+  for (uint16_t i = 0; i < 3; i++) {
+    ASSERT_TRUE(sessionNext(&s, &seq));
+    EXPECT_EQ(i, seq);
+    EXPECT_FALSE(sessionDone(&s));
+    sessionAck(&s, seq);
+    EXPECT_EQ(i + 1, s.ackedThrough);
+  }
+  EXPECT_FALSE(sessionNext(&s, &seq));
+  EXPECT_TRUE(sessionDone(&s));
+}
+
+TEST(TransferSession, RequestsMergeAndComeFirst) {
+  TransferSession s;
+  sessionBegin(&s, 1, 100);
+  uint16_t seq;
+  for (int i = 0; i < 50; i++) {
+    sessionNext(&s, &seq);
+    sessionAck(&s, seq);
+  }
+  EXPECT_TRUE(sessionRequest(&s, 10, 12));
+  EXPECT_TRUE(sessionRequest(&s, 13, 14));   // adjacent: merged
+  EXPECT_TRUE(sessionRequest(&s, 40, 60));   // clipped to what was sent
+  EXPECT_FALSE(sessionRequest(&s, 100, 120));
+  ASSERT_EQ(2, s.rangeCount);
+  EXPECT_EQ(10, s.ranges[0].from);
+  EXPECT_EQ(14, s.ranges[0].to);
+  EXPECT_EQ(49, s.ranges[1].to);
+  ASSERT_TRUE(sessionNext(&s, &seq));
+  EXPECT_EQ(10, seq);
+}
+
+TEST(TransferSession, AckTimeoutQueuesThePacketAgain) {
+  TransferSession s;
+  sessionBegin(&s, 1, 4);
+  uint16_t seq;
+  EXPECT_FALSE(sessionAckTimeout(&s));
+  sessionNext(&s, &seq);
+  sessionAck(&s, seq);
+  sessionNext(&s, &seq);
+  ASSERT_EQ(1, seq);
+  EXPECT_TRUE(sessionAckTimeout(&s));
+  EXPECT_FALSE(sessionAckTimeout(&s));
+  ASSERT_TRUE(sessionNext(&s, &seq));
+  EXPECT_EQ(1, seq);
+  ASSERT_TRUE(sessionNext(&s, &seq));
+  EXPECT_EQ(2, seq);
+}
+
+TEST(TransferSession, ParsesResumeRanges) {
+  SeqRange r[SESSION_MAX_RANGES];
+  const char *text = "0-4,9,12-300";
+  ASSERT_EQ(3, parseSeqRanges((const uint8_t *)text, strlen(text), r, SESSION_MAX_RANGES));
+  EXPECT_EQ(0, r[0].from);
+  EXPECT_EQ(4, r[0].to);
+  EXPECT_EQ(9, r[1].from);
+  EXPECT_EQ(9, r[1].to);
+  EXPECT_EQ(300, r[2].to);
+  EXPECT_EQ(0, parseSeqRanges((const uint8_t *)"", 0, r, SESSION_MAX_RANGES));
+  EXPECT_EQ(2, parseSeqRanges((const uint8_t *)text, strlen(text), r, 2));
+}
+
+struct LinkOdds {
+  double packetLoss;
+  double ackLoss;
+  double corruption;
+  double disconnect;   // per packet sent
+};
+
+struct Outcome {
+  bool complete = false;
+  int steps = 0;
+  int disconnects = 0;
+  int timeouts = 0;
+};
+
+Outcome runTransfer(uint32_t seed, size_t size, LinkOdds odds) {
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<double> coin(0, 1);
+  std::vector<uint8_t> object(size);
+  for (uint8_t &b : object) {
+    b = rng();
+  }
+  uint16_t packets = (uint16_t)((size + kChunk - 1) / kChunk);
+  Reassembler *phone = reasm_create(size, packets, crc32Update(0, object.data(), size));
+  EXPECT_NE(nullptr, phone);
+
+  TransferSession s;
+  sessionBegin(&s, seed, packets);
+  Outcome out;
+  uint16_t seq;
+  while (out.steps < 100 * packets) {
+    if (!sessionNext(&s, &seq)) {
+      break;
+    }
+    out.steps++;
+
+    // ImagePacket | payload | ImagePacketTrailer, as pullImage() builds it
+    size_t off = (size_t)seq * kChunk;
+    size_t len = size - off < kChunk ? size - off : kChunk;
+    uint8_t *pkt = reasm_staging(phone);
+    ImagePacket::Writer{pkt}.setSeq(seq);
+    memcpy(pkt + ImagePacket::SIZE, object.data() + off, len);
+    ImagePacketTrailer::Writer{pkt + ImagePacket::SIZE + len}.setCrc(
+        crc32Update(0, pkt, ImagePacket::SIZE + len));
+
+    if (coin(rng) < odds.disconnect) {
+      // Drop the link around this packet; on reconnect the phone lists
+      // what it lacks and that replaces the sender's view
+      out.disconnects++;
+      sessionLinkLost(&s);
+      reasm_build_resume(phone, s.objectId);
+      std::string resume = replyOf(phone);
+      size_t colon = resume.find(':', 7);
+      EXPECT_NE(std::string::npos, colon);
+      SeqRange ranges[SESSION_MAX_RANGES];
+      int n = parseSeqRanges((const uint8_t *)resume.c_str() + colon + 1,
+                             resume.size() - colon - 1, ranges, SESSION_MAX_RANGES);
+      sessionResume(&s, ranges, n);
+      continue;
+    }
+
+    if (coin(rng) < odds.packetLoss) {
+      out.timeouts++;
+      sessionAckTimeout(&s);
+      continue;
+    }
+    if (coin(rng) < odds.corruption) {
+      // Anywhere, sequence number and CRC included
+      pkt[rng() % (ImagePacket::SIZE + len + ImagePacketTrailer::SIZE)] ^= 1 << (rng() % 8);
+    }
+    int status = reasm_add_staged(phone, ImagePacket::SIZE + len + ImagePacketTrailer::SIZE);
+    std::string reply = replyOf(phone);
+
+    if (coin(rng) < odds.ackLoss) {
+      out.timeouts++;
+      sessionAckTimeout(&s);
+    } else if (startsWith(reply, "ACK:")) {
+      EXPECT_EQ(seq + 1, parseReply(reply, "ACK:"));
+      sessionAck(&s, seq);
+    } else if (startsWith(reply, "RESEND:")) {
+      // The RESEND handler: the packet in flight and the range go out
+      // again, then new packets
+      sessionAckTimeout(&s);
+      uint16_t from = parseReply(reply, "RESEND:");
+      size_t dash = reply.find('-');
+      uint16_t to = dash == std::string::npos
+                        ? from
+                        : (uint16_t)strtoul(reply.c_str() + dash + 1, nullptr, 10);
+      sessionRequest(&s, from, to);
+    } else {
+      ADD_FAILURE() << "status " << status << " reply '" << reply << "'";
+    }
+
+    // The sender never counts a packet as held that the phone lacks
+    EXPECT_LE(s.ackedThrough, reasm_acked_packets(phone));
+  }
+
+  out.complete = reasm_received(phone) == packets && sessionDone(&s) &&
+                 memcmp(reasm_data(phone), object.data(), size) == 0;
+  reasm_destroy(phone);
+  return out;
+}
+
+TEST(TransferSession, CleanLinkNeedsNoRetransmits) {
+  Outcome o = runTransfer(1, 100000, { 0, 0, 0, 0 });
+  EXPECT_TRUE(o.complete);
+  EXPECT_EQ(556, o.steps);
+}
+
+// Randomized losses and disconnects: every transfer completes, and the
+// overhead stays near what the losses alone cost
+TEST(TransferSession, SurvivesRandomDisconnects) {
+  const LinkOdds odds = { 0.03, 0.03, 0.01, 0.01 };
+  int disconnects = 0;
+  for (uint32_t seed = 1; seed <= 200; seed++) {
+    size_t size = 1000 + seed * 997 % 120000;
+    Outcome o = runTransfer(seed, size, odds);
+    ASSERT_TRUE(o.complete) << "seed " << seed << ", " << size << " bytes";
+    size_t packets = (size + kChunk - 1) / kChunk;
+    EXPECT_LT((size_t)o.steps, packets * 13 / 10 + 20) << "seed " << seed;
+    disconnects += o.disconnects;
+  }
+  EXPECT_GT(disconnects, 500);
+}
+
+// Disconnects often enough to leave more holes than a RESUME can list
+TEST(TransferSession, SurvivesMoreHolesThanResumeRanges) {
+  const LinkOdds odds = { 0.25, 0.1, 0.05, 0.02 };
+  for (uint32_t seed = 1000; seed < 1050; seed++) {
+    Outcome o = runTransfer(seed, 60000, odds);
+    EXPECT_TRUE(o.complete) << "seed " << seed;
+    EXPECT_GT(o.timeouts, 0);
+  }
+}
+
+}  // namespace
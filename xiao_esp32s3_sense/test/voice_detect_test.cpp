@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <vector>
+#include "audio_corpus.h"
+#include "voice_detect.h"
+
+// The detector over the audio corpus (audio_corpus.h), frame by frame
+// and in the 4 KB blocks recordAudio() hands it.
+
+namespace {
+
+const size_t kBlock = 2048;     // samples in an ARENA_AUDIO_BLOCK_SIZE block
+const size_t kHangover = (size_t)VAD_HANGOVER_FRAMES * VAD_FRAME_SAMPLES;
+
+// Whether a segment was open at each frame
+std::vector<bool> segmentFrames(const std::vector<int16_t> &pcm) {
+  VadState v;
+  vadBegin(&v);
+  std::vector<bool> open;
+  for (size_t at = 0; at < pcm.size(); at += VAD_FRAME_SAMPLES) {
+    size_t n = pcm.size() - at < VAD_FRAME_SAMPLES ? pcm.size() - at : VAD_FRAME_SAMPLES;
+    vadProcess(&v, pcm.data() + at, n);
+    open.push_back(v.active);
+  }
+  return open;
+}
+
+int segmentCount(const std::vector<bool> &open) {
+  int n = 0;
+  for (size_t i = 0; i < open.size(); i++) {
+    n += open[i] && (i == 0 || !open[i - 1]);
+  }
+  return n;
+}
+
+TEST(VoiceDetect, BackgroundsNeverOpenASegment) {
+  for (const corpus::Clip &c : corpus::clips()) {
+    if (c.speechTo > 0) {
+      continue;
+    }
+    std::vector<bool> open = segmentFrames(c.pcm);
+    EXPECT_EQ(0, segmentCount(open)) << c.name;
+  }
+}
+
+// One segment per passage: it opens within 100 ms of the first syllable,
+// covers every syllable (pauses are shorter than the hangover) and closes
+// one hangover after the last
+TEST(VoiceDetect, SpeechIsOneSegment) {
+  int clips = 0;
+  for (const corpus::Clip &c : corpus::clips()) {
+    if (c.speechTo == 0) {
+      continue;
+    }
+    clips++;
+    std::vector<bool> open = segmentFrames(c.pcm);
+    EXPECT_EQ(1, segmentCount(open)) << c.name;
+
+    size_t first = open.size(), last = 0, missed = 0, speechFrames = 0;
+    for (size_t f = 0; f < open.size(); f++) {
+      if (open[f]) {
+        first = f < first ? f : first;
+        last = f;
+      }
+      size_t voiced = 0;
+      for (size_t i = f * VAD_FRAME_SAMPLES; i < (f + 1) * VAD_FRAME_SAMPLES && i < c.pcm.size(); i++) {
+        voiced += c.speech[i];
+      }
+      if (voiced > VAD_FRAME_SAMPLES / 2) {
+        speechFrames++;
+        missed += !open[f];
+      }
+    }
+    ASSERT_LT(first, open.size()) << c.name;
+    EXPECT_GE(first * VAD_FRAME_SAMPLES + VAD_FRAME_SAMPLES, c.speechFrom) << c.name;
+    EXPECT_LE(first * VAD_FRAME_SAMPLES, c.speechFrom + corpus::kRate / 10) << c.name;
+    EXPECT_LE(last * VAD_FRAME_SAMPLES, c.speechTo + kHangover) << c.name;
+    EXPECT_GE(last * VAD_FRAME_SAMPLES + VAD_FRAME_SAMPLES, c.speechTo) << c.name;
+    EXPECT_LE(missed * 50, speechFrames) << c.name << ": " << missed << " of " << speechFrames;
+  }
+  EXPECT_EQ(4, clips);
+}
+
+// recordAudio() keeps a whole block when vadProcess() says a segment
+// was open anywhere in it: that is every block holding an open frame
+TEST(VoiceDetect, BlockDecisionCoversItsFrames) {
+  for (const corpus::Clip &c : corpus::clips()) {
+    std::vector<bool> frames = segmentFrames(c.pcm);
+    VadState v;
+    vadBegin(&v);
+    const size_t perBlock = kBlock / VAD_FRAME_SAMPLES;
+    for (size_t at = 0, b = 0; at < c.pcm.size(); at += kBlock, b++) {
+      size_t n = c.pcm.size() - at < kBlock ? c.pcm.size() - at : kBlock;
+      bool any = b > 0 && frames[b * perBlock - 1];
+      for (size_t f = b * perBlock; f < (b + 1) * perBlock && f < frames.size(); f++) {
+        any = any || frames[f];
+      }
+      EXPECT_EQ(any, vadProcess(&v, c.pcm.data() + at, n)) << c.name << " block " << b;
+    }
+  }
+}
+
+// The hiss clip is loud enough; only its crossing rate keeps it out.
+// White noise crosses at about 500 per mille, so now and then a frame
+// falls under the limit, but never two in a row: no segment opens
+TEST(VoiceDetect, HissIsRejectedByCrossingRate) {
+  const std::vector<corpus::Clip> clips = corpus::clips();
+  const corpus::Clip &hiss = clips[1];
+  ASSERT_EQ("hiss", hiss.name);
+  VadState v;
+  vadBegin(&v);
+  v.primed = true;          // a floor far below the hiss
+  int voiced = 0, frames = 0;
+  bool last = false;
+  for (size_t at = 0; at + VAD_FRAME_SAMPLES <= hiss.pcm.size(); at += VAD_FRAME_SAMPLES) {
+    bool now = vadFrameIsVoiced(&v, hiss.pcm.data() + at, VAD_FRAME_SAMPLES);
+    EXPECT_FALSE(now && last) << "frame " << frames;
+    voiced += now;
+    frames++;
+    last = now;
+  }
+  EXPECT_LE(voiced * 50, frames);
+}
+
+TEST(VoiceDetect, EmptyAndShortFrames) {
+  VadState v;
+  vadBegin(&v);
+  int16_t one = 30000;
+  EXPECT_FALSE(vadFrameIsVoiced(&v, &one, 0));
+  EXPECT_FALSE(vadProcess(&v, &one, 1));
+  EXPECT_FALSE(v.active);
+}
+
+}  // namespace
@@ -0,0 +1,101 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "wire_format.h"
+
+// Decoding an image header and a data packet the three ways the code
+// base has done it: the generated in-place View, a memcpy into a packed
+// host struct (the old processImageSend() layout, host-endian), and a
+// copy into a fresh buffer before parsing (what the phone did per
+// notification before the generated codecs).
+
+namespace {
+
+struct __attribute__((packed)) HostHeader {
+  uint8_t magic, kind;
+  uint32_t length;
+  uint16_t packets;
+  uint64_t hash;
+  uint32_t crc, objectId;
+  uint8_t flags;
+};
+static_assert(sizeof(HostHeader) == ImageHeader::SIZE, "same layout as ImageHeader");
+
+const int kFrames = 4096;
+
+// Header, then a 180-byte packet, repeated; each at an odd offset as
+// they sit after the MuxFrame byte in a notification
+std::vector<uint8_t> frames() {
+  std::mt19937 rng(36);
+  std::vector<uint8_t> buf((size_t)kFrames * 256);
+  for (int i = 0; i < kFrames; i++) {
+    uint8_t *p = buf.data() + (size_t)i * 256 + 1;
+    ImageHeader::Writer h{p};
+    h.setMagic(WIRE_IMAGE_MAGIC);
+    h.setKind(WIRE_IMAGE_KIND_FULL);
+    h.setLength(rng());
+    h.setPackets(rng());
+    h.setHash(((uint64_t)rng() << 32) | rng());
+    h.setCrc(rng());
+    h.setObjectId(i);
+    h.setFlags(i & 1);
+  }
+  return buf;
+}
+
+uint64_t viewDecode(const uint8_t *p) {
+  ImageHeader::View h{p};
+  return h.length() + h.packets() + h.hash() + h.crc() + h.objectId() + h.flags();
+}
+
+uint64_t packedDecode(const uint8_t *p) {
+  HostHeader h;
+  memcpy(&h, p, sizeof(h));
+  return h.length + h.packets + h.hash + h.crc + h.objectId + h.flags;
+}
+
+uint64_t copyDecode(const uint8_t *p) {
+  std::vector<uint8_t> copy(p, p + ImageHeader::SIZE);
+  return viewDecode(copy.data());
+}
+
+TEST(WireFormatBench, HeaderDecode) {
+  std::vector<uint8_t> buf = frames();
+  auto frame = [&](long i) { return buf.data() + (size_t)(i % kFrames) * 256 + 1; };
+
+  // Same answers (the test hosts are little-endian, as is the ESP32-S3)
+  for (long i = 0; i < kFrames; i++) {
+    ASSERT_EQ(viewDecode(frame(i)), packedDecode(frame(i)));
+  }
+
+  double view = benchNs(1000000, [&](long i) { benchKeep(viewDecode(frame(i))); });
+  double packed = benchNs(1000000, [&](long i) { benchKeep(packedDecode(frame(i))); });
+  double copy = benchNs(1000000, [&](long i) { benchKeep(copyDecode(frame(i))); });
+  benchReport("ImageHeader::View in place", view, "header");
+  benchReport("memcpy into packed host struct", packed, "header");
+  benchReport("copy to a new buffer, then View", copy, "header");
+  // Zero-copy must not cost more than the unportable memcpy by much
+  EXPECT_LT(view, packed * 2 + 1);
+}
+
+TEST(WireFormatBench, HeaderEncode) {
+  std::vector<uint8_t> buf((size_t)kFrames * 32);
+  double ns = benchNs(1000000, [&](long i) {
+    ImageHeader::Writer h{buf.data() + (size_t)(i % kFrames) * 32 + 1};
+    h.setMagic(WIRE_IMAGE_MAGIC);
+    h.setKind(WIRE_IMAGE_KIND_FULL);
+    h.setLength((uint32_t)i);
+    h.setPackets((uint16_t)i);
+    h.setHash((uint64_t)i * 0x9E3779B97F4A7C15ull);
+    h.setCrc((uint32_t)i);
+    h.setObjectId((uint32_t)i);
+    h.setFlags(0);
+  });
+  benchKeep(buf[1]);
+  benchReport("ImageHeader::Writer, all fields", ns, "header");
+}
+
+}  // namespace
@@ -0,0 +1,209 @@
+#include <gtest/gtest.h>
+#include <stdint.h>
+#include <string.h>
+#include <random>
+#include <vector>
+#include "wire_format.h"
+
+// The generated layouts: every field written through a Writer reads
+// back the same through a View, at an odd address, without touching a
+// byte outside the message; and the byte order is the one the schema
+// names.
+
+namespace {
+
+const size_t kAt = 3;       // deliberately unaligned
+const uint8_t kGuard = 0xA5;
+
+struct Buffer {
+  std::vector<uint8_t> bytes;
+  size_t size;
+
+  explicit Buffer(size_t messageSize) : bytes(messageSize + 2 * kAt, kGuard), size(messageSize) {}
+  uint8_t *at() { return bytes.data() + kAt; }
+
+  bool guardsIntact() const {
+    for (size_t i = 0; i < kAt; i++) {
+      if (bytes[i] != kGuard || bytes[kAt + size + i] != kGuard) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+class WireFormat : public ::testing::Test {
+ protected:
+  std::mt19937_64 rng{36};
+  // Random values plus the edges of each width
+  template <typename T>
+  std::vector<T> values() {
+    std::vector<T> v = { 0, 1, (T)~(T)0, (T)((T)~(T)0 >> 1), (T)((T)1 << (sizeof(T) * 8 - 1)) };
+    for (int i = 0; i < 200; i++) {
+      v.push_back((T)rng());
+    }
+    return v;
+  }
+};
+
+TEST_F(WireFormat, ImageHeaderRoundTrip) {
+  for (uint64_t hash : values<uint64_t>()) {
+    Buffer b(ImageHeader::SIZE);
+    ImageHeader::Writer w{b.at()};
+    uint32_t length = (uint32_t)rng(), crc = (uint32_t)rng(), id = (uint32_t)rng();
+    uint16_t packets = (uint16_t)rng();
+    uint8_t kind = (uint8_t)rng(), flags = (uint8_t)rng();
+    w.setMagic(WIRE_IMAGE_MAGIC);
+    w.setKind(kind);
+    w.setLength(length);
+    w.setPackets(packets);
+    w.setHash(hash);
+    w.setCrc(crc);
+    w.setObjectId(id);
+    w.setFlags(flags);
+
+    ImageHeader::View v{b.at()};
+    ASSERT_EQ(WIRE_IMAGE_MAGIC, v.magic());
+    ASSERT_EQ(kind, v.kind());
+    ASSERT_EQ(length, v.length());
+    ASSERT_EQ(packets, v.packets());
+    ASSERT_EQ(hash, v.hash());
+    ASSERT_EQ(crc, v.crc());
+    ASSERT_EQ(id, v.objectId());
+    ASSERT_EQ(flags, v.flags());
+    ASSERT_TRUE(b.guardsIntact());
+  }
+}
+
+TEST_F(WireFormat, SmallMessagesRoundTrip) {
+  for (uint32_t x : values<uint32_t>()) {
+    uint16_t h = (uint16_t)x;
+    uint8_t c = (uint8_t)x;
+
+    Buffer mux(MuxFrame::SIZE);
+    MuxFrame::Writer{mux.at()}.setStream(c);
+    ASSERT_EQ(c, MuxFrame::View{mux.at()}.stream());
+    ASSERT_TRUE(mux.guardsIntact());
+
+    Buffer pkt(ImagePacket::SIZE);
+    ImagePacket::Writer{pkt.at()}.setSeq(h);
+    ASSERT_EQ(h, ImagePacket::View{pkt.at()}.seq());
+    ASSERT_TRUE(pkt.guardsIntact());
+
+    Buffer trailer(ImagePacketTrailer::SIZE);
+    ImagePacketTrailer::Writer{trailer.at()}.setCrc(x);
+    ASSERT_EQ(x, ImagePacketTrailer::View{trailer.at()}.crc());
+    ASSERT_TRUE(trailer.guardsIntact());
+
+    Buffer chunk(AudioChunk::SIZE);
+    AudioChunk::Writer{chunk.at()}.setOffset(x);
+    ASSERT_EQ(x, AudioChunk::View{chunk.at()}.offset());
+    ASSERT_TRUE(chunk.guardsIntact());
+
+    Buffer audio(AudioHeader::SIZE);
+    AudioHeader::Writer{audio.at()}.setSize(x);
+    AudioHeader::Writer{audio.at()}.setFlags(c);
+    ASSERT_EQ(x, AudioHeader::View{audio.at()}.size());
+    ASSERT_EQ(c, AudioHeader::View{audio.at()}.flags());
+    ASSERT_TRUE(audio.guardsIntact());
+  }
+}
+
+TEST_F(WireFormat, LiveAndImuHeadersRoundTrip) {
+  for (uint32_t x : values<uint32_t>()) {
+    uint32_t y = (uint32_t)rng();
+    Buffer live(LiveAudioFrame::SIZE);
+    LiveAudioFrame::Writer lw{live.at()};
+    lw.setKind(WIRE_LIVE_KIND_AUDIO);
+    lw.setSeq((uint16_t)y);
+    lw.setTimeMs(x);
+    lw.setSamples((uint16_t)(y >> 16));
+    LiveAudioFrame::View lv{live.at()};
+    ASSERT_EQ(WIRE_LIVE_KIND_AUDIO, lv.kind());
+    ASSERT_EQ((uint16_t)y, lv.seq());
+    ASSERT_EQ(x, lv.timeMs());
+    ASSERT_EQ((uint16_t)(y >> 16), lv.samples());
+    ASSERT_TRUE(live.guardsIntact());
+
+    Buffer imu(ImuBatchHeader::SIZE);
+    ImuBatchHeader::Writer iw{imu.at()};
+    iw.setKind(WIRE_LIVE_KIND_IMU);
+    iw.setSeq((uint16_t)x);
+    iw.setTimeMs(y);
+    iw.setPeriodUs(x ^ y);
+    iw.setCount((uint8_t)y);
+    iw.setAccelLsbPerG((uint16_t)(x >> 16));
+    iw.setGyroLsbPerDpsX10((uint16_t)(y >> 8));
+    ImuBatchHeader::View iv{imu.at()};
+    ASSERT_EQ(WIRE_LIVE_KIND_IMU, iv.kind());
+    ASSERT_EQ((uint16_t)x, iv.seq());
+    ASSERT_EQ(y, iv.timeMs());
+    ASSERT_EQ(x ^ y, iv.periodUs());
+    ASSERT_EQ((uint8_t)y, iv.count());
+    ASSERT_EQ((uint16_t)(x >> 16), iv.accelLsbPerG());
+    ASSERT_EQ((uint16_t)(y >> 8), iv.gyroLsbPerDpsX10());
+    ASSERT_TRUE(imu.guardsIntact());
+  }
+}
+
+TEST_F(WireFormat, ThumbSheetRoundTrip) {
+  for (uint32_t x : values<uint32_t>()) {
+    uint32_t y = (uint32_t)rng();
+    Buffer sheet(ThumbSheetHeader::SIZE);
+    ThumbSheetHeader::Writer{sheet.at()}.setCount((uint16_t)y);
+    ThumbSheetHeader::Writer{sheet.at()}.setNextId(x);
+    ASSERT_EQ((uint16_t)y, ThumbSheetHeader::View{sheet.at()}.count());
+    ASSERT_EQ(x, ThumbSheetHeader::View{sheet.at()}.nextId());
+    ASSERT_TRUE(sheet.guardsIntact());
+
+    Buffer entry(ThumbSheetEntry::SIZE);
+    ThumbSheetEntry::Writer ew{entry.at()};
+    ew.setId(x);
+    ew.setTime(y);
+    ew.setFlags((uint8_t)x);
+    ew.setLength(x ^ y);
+    ThumbSheetEntry::View ev{entry.at()};
+    ASSERT_EQ(x, ev.id());
+    ASSERT_EQ(y, ev.time());
+    ASSERT_EQ((uint8_t)x, ev.flags());
+    ASSERT_EQ(x ^ y, ev.length());
+    ASSERT_TRUE(entry.guardsIntact());
+  }
+}
+
+// Byte order as the schema names it, whatever the host's
+TEST_F(WireFormat, ByteOrder) {
+  uint8_t b[ImageHeader::SIZE] = {};
+  ImageHeader::Writer w{b};
+  w.setLength(0x11223344);
+  w.setPackets(0x5566);
+  w.setHash(0x0102030405060708ull);
+  const uint8_t length[] = { 0x44, 0x33, 0x22, 0x11 };
+  const uint8_t packets[] = { 0x66, 0x55 };
+  const uint8_t hash[] = { 8, 7, 6, 5, 4, 3, 2, 1 };
+  EXPECT_EQ(0, memcmp(b + ImageHeader::LENGTH_OFFSET, length, 4));
+  EXPECT_EQ(0, memcmp(b + ImageHeader::PACKETS_OFFSET, packets, 2));
+  EXPECT_EQ(0, memcmp(b + ImageHeader::HASH_OFFSET, hash, 8));
+
+  // The one big-endian field: packet sequence numbers
+  uint8_t seq[ImagePacket::SIZE];
+  ImagePacket::Writer{seq}.setSeq(0x1234);
+  EXPECT_EQ(0x12, seq[0]);
+  EXPECT_EQ(0x34, seq[1]);
+}
+
+// Fields are packed back to back in schema order
+TEST_F(WireFormat, Offsets) {
+  EXPECT_EQ(25u, (size_t)ImageHeader::SIZE);
+  EXPECT_EQ(0u, (size_t)ImageHeader::MAGIC_OFFSET);
+  EXPECT_EQ(2u, (size_t)ImageHeader::LENGTH_OFFSET);
+  EXPECT_EQ(6u, (size_t)ImageHeader::PACKETS_OFFSET);
+  EXPECT_EQ(8u, (size_t)ImageHeader::HASH_OFFSET);
+  EXPECT_EQ(16u, (size_t)ImageHeader::CRC_OFFSET);
+  EXPECT_EQ(20u, (size_t)ImageHeader::OBJECT_ID_OFFSET);
+  EXPECT_EQ(24u, (size_t)ImageHeader::FLAGS_OFFSET);
+  EXPECT_EQ(16u, (size_t)ImuBatchHeader::SIZE);
+  EXPECT_EQ(13u, (size_t)ThumbSheetEntry::SIZE);
+}
+
+}  // namespace
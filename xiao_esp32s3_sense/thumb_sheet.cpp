@@ -0,0 +1,138 @@
+#include "thumb_sheet.h"
+#include "wire_format.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "SD.h"
+#include "sd_card.h"
+#include "metrics.h"
+#endif
+
+// The header is filled in by thumbSheetEnd
+void thumbSheetBegin(ThumbSheet *s, uint8_t *buf, size_t cap) {
+  s->buf = buf;
+  s->cap = cap;
+  s->len = cap >= ThumbSheetHeader::SIZE ? ThumbSheetHeader::SIZE : cap;
+  s->count = 0;
+}
+
+// Captures without a thumbnail (not a photo, unfinished, a duplicate, no
+// sidecar) are passed over. False: the sheet is full and this capture
+// starts the next one. A sidecar too big for even an empty sheet is
+// passed over too, or no sheet could ever get past it.
+bool thumbSheetAdd(ThumbSheet *s, const ThumbSheetSource &src, const CatalogEntry &e) {
+  if (e.type != CAPTURE_PHOTO ||
+      (e.flags & (CATALOG_FLAG_PENDING | CATALOG_FLAG_DUPLICATE))) {
+    return true;
+  }
+  if (s->count == THUMB_SHEET_MAX || s->len + ThumbSheetEntry::SIZE > s->cap) {
+    return false;
+  }
+
+  uint8_t *entry = s->buf + s->len;
+  size_t room = s->cap - s->len - ThumbSheetEntry::SIZE;
+  size_t len = src.read(src.ctx, e.id, entry + ThumbSheetEntry::SIZE, room);
+  if (len == 0) {
+    return true;
+  }
+  if (len > room) {
+    return s->count == 0;
+  }
+
+  ThumbSheetEntry::Writer w{entry};
+  w.setId(e.id);
+  w.setTime(e.time);
+  w.setFlags(e.flags);
+  w.setLength(len);
+  s->len += ThumbSheetEntry::SIZE + len;
+  s->count++;
+  return true;
+}
+
+// Returns the sheet's size; nextId 0 says the catalog ends here
+size_t thumbSheetEnd(ThumbSheet *s, uint32_t nextId) {
+  if (s->cap < ThumbSheetHeader::SIZE) {
+    return 0;
+  }
+  ThumbSheetHeader::Writer w{s->buf};
+  w.setCount(s->count);
+  w.setNextId(nextId);
+  return s->len;
+}
+
+// Sidecars of the photos from catalog ID fromId on, at most maxCount. A
+// count of 0 is taken as 1: a sheet always gets past fromId, or a client
+// following nextId would ask for the same sheet forever.
+size_t thumbSheetBuild(const ThumbSheetSource &src, uint32_t fromId, uint16_t maxCount,
+                       uint8_t *buf, size_t cap, uint16_t *count, uint32_t *nextId) {
+  static CatalogEntry page[CATALOG_QUERY_MAX];
+  ThumbSheet sheet;
+  thumbSheetBegin(&sheet, buf, cap);
+  if (maxCount == 0) {
+    maxCount = 1;
+  }
+
+  uint32_t id = fromId;
+  uint32_t next = 0;
+  while (next == 0) {
+    size_t n = src.list(src.ctx, id, page, CATALOG_QUERY_MAX);
+    if (n == 0) {
+      break;
+    }
+    for (size_t i = 0; i < n && next == 0; i++) {
+      if (sheet.count >= maxCount || !thumbSheetAdd(&sheet, src, page[i])) {
+        next = page[i].id;
+      }
+    }
+    id = page[n - 1].id + 1;
+  }
+
+  *count = sheet.count;
+  *nextId = next;
+  return thumbSheetEnd(&sheet, next);
+}
+
+#ifdef ARDUINO
+
+/* ===== Sidecars on the SD card ===== */
+
+// Sealed like the photo itself when encryption is on
+bool saveThumbSidecar(uint32_t id, const uint8_t *jpg, size_t len) {
+  char path[32];
+  captureThumbPath(path, sizeof(path), id);
+  uint32_t t0 = micros();
+  bool ok = writeFile(SD, path, (uint8_t *)jpg, len) > 0;
+  metricMax("thumb.sidecar_us", micros() - t0);
+  return ok;
+}
+
+static size_t readSidecar(void *ctx, uint32_t id, uint8_t *buf, size_t cap) {
+  char path[32];
+  captureThumbPath(path, sizeof(path), id);
+  File file = SD.open(path, FILE_READ);
+  if (!file) {
+    return 0;
+  }
+  size_t size = file.size();
+  if (size <= cap && file.read(buf, size) != size) {
+    size = 0;
+  }
+  file.close();
+  return size;
+}
+
+static size_t listCatalog(void *ctx, uint32_t fromId, CatalogEntry *out, size_t max) {
+  return catalogList(fromId, out, max);
+}
+
+size_t buildThumbSheet(uint32_t fromId, uint16_t maxCount, uint8_t *buf, size_t cap,
+                       uint16_t *count, uint32_t *nextId) {
+  ThumbSheetSource src = { nullptr, readSidecar, listCatalog };
+  uint32_t t0 = millis();
+  size_t len = thumbSheetBuild(src, fromId, maxCount, buf, cap, count, nextId);
+  metricSet("thumb.sheet_ms", millis() - t0);
+  metricSet("thumb.sheet_count", *count);
+  return len;
+}
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef THUMB_SHEET_H
+#define THUMB_SHEET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "capture_catalog.h"
+
+// Many photo thumbnails in one image transfer, so the phone can show
+// what is on the card without pulling full frames. Every photo gets a
+// thumbnail sidecar (captureThumbPath) when it is saved; a sheet packs
+// the sidecars of consecutive catalog IDs, as stored (sealed ones stay
+// sealed):
+//
+//   ThumbSheetHeader | { ThumbSheetEntry | thumbnail } * count
+//
+// A sheet ends where the next sidecar would not fit; next_id in the
+// header is where the following one starts (0: nothing after it).
+
+#define THUMB_SHEET_MAX  128      // entries per sheet
+
+// read: one capture's sidecar into buf, returning its size. A sidecar
+// larger than cap is left unread; 0 means there is none.
+// list: up to max catalog records from ID fromId on (catalogList)
+struct ThumbSheetSource {
+  void *ctx;
+  size_t (*read)(void *ctx, uint32_t id, uint8_t *buf, size_t cap);
+  size_t (*list)(void *ctx, uint32_t fromId, CatalogEntry *out, size_t max);
+};
+
+struct ThumbSheet {
+  uint8_t *buf;
+  size_t cap;
+  size_t len;
+  uint16_t count;
+};
+
+// Function declarations
+void thumbSheetBegin(ThumbSheet *s, uint8_t *buf, size_t cap);
+bool thumbSheetAdd(ThumbSheet *s, const ThumbSheetSource &src, const CatalogEntry &e);
+size_t thumbSheetEnd(ThumbSheet *s, uint32_t nextId);
+size_t thumbSheetBuild(const ThumbSheetSource &src, uint32_t fromId, uint16_t maxCount,
+                       uint8_t *buf, size_t cap, uint16_t *count, uint32_t *nextId);
+
+#ifdef ARDUINO
+
+bool saveThumbSidecar(uint32_t id, const uint8_t *jpg, size_t len);
+size_t buildThumbSheet(uint32_t fromId, uint16_t maxCount, uint8_t *buf, size_t cap,
+                       uint16_t *count, uint32_t *nextId);
+#endif
+
+#endif
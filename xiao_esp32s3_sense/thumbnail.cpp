@@ -0,0 +1,203 @@
+#include "thumbnail.h"
+
+#include <string.h>
+#include "metrics.h"
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "img_converters.h"
+#endif
+
+// Reads the frame size from the first SOF marker.
+bool jpegDimensions(const uint8_t *jpg, size_t len, uint16_t *width, uint16_t *height) {
+  if (len < 4 || jpg[0] != 0xFF || jpg[1] != 0xD8) {
+    return false;
+  }
+
+  size_t i = 2;
+  while (i + 4 <= len) {
+    if (jpg[i] != 0xFF) {
+      return false;
+    }
+    uint8_t marker = jpg[i + 1];
+    uint16_t segLen = (jpg[i + 2] << 8) | jpg[i + 3];
+
+    if (marker >= 0xC0 && marker <= 0xC2) {
+      if (i + 9 > len) {
+        return false;
+      }
+      *height = (jpg[i + 5] << 8) | jpg[i + 6];
+      *width  = (jpg[i + 7] << 8) | jpg[i + 8];
+      return true;
+    }
+    if (marker == 0xDA) {
+      return false;  // scan data before any SOF
+    }
+    i += 2 + segLen;
+  }
+  return false;
+}
+
+// Largest decoder scale that still leaves at least THUMB_MIN_WIDTH pixels.
+uint8_t thumbnailScale(uint16_t width) {
+  uint8_t scale = 8;
+  while (scale > 1 && width / scale < THUMB_MIN_WIDTH) {
+    scale /= 2;
+  }
+  return scale;
+}
+
+// The decoder only scales by 2, 4 or 8; anything else decodes whole.
+ThumbPlan thumbnailPlan(uint16_t width, uint16_t height, uint8_t scale) {
+  ThumbPlan plan;
+  plan.scale = (scale == 2 || scale == 4 || scale == 8) ? scale : 1;
+  plan.width = width / plan.scale;
+  plan.height = height / plan.scale;
+  plan.rgbLen = (size_t)plan.width * plan.height * 2;
+  return plan;
+}
+
+size_t thumbSinkWrite(void *arg, size_t index, const void *data, size_t len) {
+  ThumbSink *sink = (ThumbSink *)arg;
+  if (index > sink->cap || len > sink->cap - index) {
+    sink->overflow = true;
+    return 0;
+  }
+  memcpy(sink->buf + index, data, len);
+  if (index + len > sink->len) {
+    sink->len = index + len;
+  }
+  return len;
+}
+
+// Decodes a JPEG at 1/scale straight to big-endian RGB565 in an arena
+// slot. Returns nullptr if the frame cannot be parsed or decoded.
+uint8_t* decodeScaledWith(const ThumbCodec &codec, const uint8_t *jpg, size_t len,
+                          uint8_t scale, ArenaScope scope, uint16_t *width, uint16_t *height) {
+  uint16_t w, h;
+  if (!jpegDimensions(jpg, len, &w, &h)) {
+#ifdef ARDUINO
+    Serial.println("Decode: no JPEG frame header");
+#endif
+    return nullptr;
+  }
+
+  ThumbPlan plan = thumbnailPlan(w, h, scale);
+  uint8_t *rgb = arenaAlloc(plan.rgbLen, scope);
+  if (!rgb) {
+#ifdef ARDUINO
+    Serial.println("Decode: arena full");
+#endif
+    return nullptr;
+  }
+  if (!codec.decode(codec.ctx, jpg, len, plan.scale, rgb)) {
+#ifdef ARDUINO
+    Serial.println("Decode: jpg2rgb565 failed");
+#endif
+    arenaFree(rgb);
+    return nullptr;
+  }
+  *width = plan.width;
+  *height = plan.height;
+  return rgb;
+}
+
+// On failure nothing stays allocated in the scope.
+bool makeThumbnailWith(const ThumbCodec &codec, const uint8_t *jpg, size_t len,
+                       ArenaScope scope, Thumbnail *out) {
+  uint16_t w, h;
+  if (!jpegDimensions(jpg, len, &w, &h)) {
+#ifdef ARDUINO
+    Serial.println("Thumbnail: no JPEG frame header");
+#endif
+    return false;
+  }
+
+  uint8_t *dst = arenaAlloc(THUMB_JPEG_MAX, scope);
+  if (!dst) {
+#ifdef ARDUINO
+    Serial.println("Thumbnail: arena full");
+#endif
+    return false;
+  }
+
+#ifdef ARDUINO
+  uint32_t t0 = micros();
+#endif
+  uint8_t *rgb = decodeScaledWith(codec, jpg, len, thumbnailScale(w), scope,
+                                  &out->width, &out->height);
+#ifdef ARDUINO
+  uint32_t t1 = micros();
+#endif
+
+  bool ok = rgb != nullptr;
+  ThumbSink sink = { dst, THUMB_JPEG_MAX, 0, false };
+  if (ok) {
+    ok = codec.encode(codec.ctx, rgb, out->width, out->height, THUMB_QUALITY,
+                      thumbSinkWrite, &sink) && !sink.overflow && sink.len > 0;
+  }
+#ifdef ARDUINO
+  uint32_t t2 = micros();
+#endif
+
+  // The decoded pixels are only needed during encoding
+  arenaFree(rgb);
+
+  if (!ok) {
+#ifdef ARDUINO
+    Serial.println("Thumbnail: encode failed");
+#endif
+    arenaFree(dst);
+    return false;
+  }
+
+  out->jpg = dst;
+  out->len = sink.len;
+#ifdef ARDUINO
+  out->decodeUs = t1 - t0;
+  out->encodeUs = t2 - t1;
+#else
+  out->decodeUs = 0;
+  out->encodeUs = 0;
+#endif
+
+  metricSet("thumb.decode_us", out->decodeUs);
+  metricSet("thumb.encode_us", out->encodeUs);
+  metricSet("thumb.bytes", out->len);
+#ifdef ARDUINO
+  Serial.printf("Thumbnail %ux%u, %u bytes (decode %lu us, encode %lu us)\n",
+                out->width, out->height, (unsigned)out->len,
+                (unsigned long)out->decodeUs, (unsigned long)out->encodeUs);
+#endif
+  return true;
+}
+
+#ifdef ARDUINO
+
+/* ===== The camera library's codec ===== */
+
+static bool cameraDecode(void *ctx, const uint8_t *jpg, size_t len, uint8_t scale, uint8_t *rgb) {
+  jpg_scale_t jscale = scale == 8 ? JPG_SCALE_8X :
+                       scale == 4 ? JPG_SCALE_4X :
+                       scale == 2 ? JPG_SCALE_2X : JPG_SCALE_NONE;
+  return jpg2rgb565(jpg, len, rgb, jscale);
+}
+
+static bool cameraEncode(void *ctx, const uint8_t *rgb, uint16_t width, uint16_t height,
+                         uint8_t quality, ThumbWriteFn write, void *arg) {
+  return fmt2jpg_cb((uint8_t *)rgb, (size_t)width * height * 2, width, height,
+                    PIXFORMAT_RGB565, quality, write, arg);
+}
+
+static const ThumbCodec cameraCodec = { nullptr, cameraDecode, cameraEncode };
+
+uint8_t* decodeScaled(const uint8_t *jpg, size_t len, uint8_t scale, ArenaScope scope,
+                      uint16_t *width, uint16_t *height) {
+  return decodeScaledWith(cameraCodec, jpg, len, scale, scope, width, height);
+}
+
+bool makeThumbnail(const uint8_t *jpg, size_t len, ArenaScope scope, Thumbnail *out) {
+  return makeThumbnailWith(cameraCodec, jpg, len, scope, out);
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef THUMBNAIL_H
+#define THUMBNAIL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "psram_arena.h"
+
+// Small JPEG derived from a full frame: the frame is decoded at 1/2..1/8
+// scale straight to RGB565 and re-encoded. Every buffer comes from the
+// caller's arena scope. The steps around the codec are portable; the
+// codec itself is the camera library's on the device, and host tests
+// hand in their own through the *With() variants.
+
+#define THUMB_MIN_WIDTH 160
+#define THUMB_QUALITY   60    // fmt2jpg scale: higher is better
+#define THUMB_JPEG_MAX  ARENA_THUMB_SIZE  // the encoded thumbnail's budget
+
+// Receives encoder output as fmt2jpg_cb hands it over: len bytes at
+// index. Returns len, or 0 to stop the encoder.
+typedef size_t (*ThumbWriteFn)(void *arg, size_t index, const void *data, size_t len);
+
+struct ThumbCodec {
+  void *ctx;
+  // Decodes at 1/scale (1, 2, 4 or 8) to big-endian RGB565, filling the
+  // plan's rgbLen bytes
+  bool (*decode)(void *ctx, const uint8_t *jpg, size_t len, uint8_t scale, uint8_t *rgb);
+  // Encodes big-endian RGB565 pixels to a JPEG through write
+  bool (*encode)(void *ctx, const uint8_t *rgb, uint16_t width, uint16_t height,
+                 uint8_t quality, ThumbWriteFn write, void *arg);
+};
+
+// Size of a frame decoded at 1/scale
+struct ThumbPlan {
+  uint8_t scale;       // 1, 2, 4 or 8
+  uint16_t width;
+  uint16_t height;
+  size_t rgbLen;       // RGB565, two bytes a pixel
+};
+
+// Collects encoder output into one buffer; anything past cap sets
+// overflow and stops the encoder
+struct ThumbSink {
+  uint8_t *buf;
+  size_t cap;
+  size_t len;
+  bool overflow;
+};
+
+struct Thumbnail {
+  uint8_t *jpg;
+  size_t len;
+  uint16_t width;
+  uint16_t height;
+  uint32_t decodeUs;
+  uint32_t encodeUs;
+};
+
+// Function declarations
+bool jpegDimensions(const uint8_t *jpg, size_t len, uint16_t *width, uint16_t *height);
+uint8_t thumbnailScale(uint16_t width);
+ThumbPlan thumbnailPlan(uint16_t width, uint16_t height, uint8_t scale);
+size_t thumbSinkWrite(void *arg, size_t index, const void *data, size_t len);
+uint8_t* decodeScaledWith(const ThumbCodec &codec, const uint8_t *jpg, size_t len,
+                          uint8_t scale, ArenaScope scope, uint16_t *width, uint16_t *height);
+bool makeThumbnailWith(const ThumbCodec &codec, const uint8_t *jpg, size_t len,
+                       ArenaScope scope, Thumbnail *out);
+uint8_t* decodeScaled(const uint8_t *jpg, size_t len, uint8_t scale, ArenaScope scope,
+                      uint16_t *width, uint16_t *height);
+bool makeThumbnail(const uint8_t *jpg, size_t len, ArenaScope scope, Thumbnail *out);
+
+#endif
@@ -0,0 +1,146 @@
+#include "transfer_session.h"
+
+void sessionBegin(TransferSession *s, uint32_t objectId, uint16_t totalPackets) {
+  s->objectId = objectId;
+  s->totalPackets = totalPackets;
+  s->nextSeq = 0;
+  s->ackedThrough = 0;
+  s->inFlight = SESSION_NO_PACKET;
+  s->rangeCount = 0;
+}
+
+static bool inRange(uint16_t seq, uint16_t from, uint16_t to) {
+  return seq >= from && seq <= to;
+}
+
+// Lowest packet still owed to the receiver
+static uint16_t firstOwed(const TransferSession *s) {
+  uint16_t first = s->nextSeq;
+  for (int i = 0; i < s->rangeCount; i++)
+    if (s->ranges[i].from < first)
+      first = s->ranges[i].from;
+  if (s->inFlight != SESSION_NO_PACKET && s->inFlight < first)
+    first = s->inFlight;
+  return first;
+}
+
+bool sessionRequest(TransferSession *s, uint16_t from, uint16_t to) {
+  if (from >= s->totalPackets || from > to)
+    return false;
+  if (to >= s->totalPackets)
+    to = s->totalPackets - 1;
+
+  // Packets never sent will go out anyway
+  if (from >= s->nextSeq)
+    return true;
+  if (to >= s->nextSeq)
+    to = s->nextSeq - 1;
+
+  if (s->inFlight != SESSION_NO_PACKET && inRange(s->inFlight, from, to))
+    s->inFlight = SESSION_NO_PACKET;
+
+  // Merge with an overlapping or adjacent range
+  for (int i = 0; i < s->rangeCount; i++) {
+    SeqRange &r = s->ranges[i];
+    if (from <= r.to + 1 && to + 1 >= r.from) {
+      if (from < r.from) r.from = from;
+      if (to > r.to) r.to = to;
+      return true;
+    }
+  }
+
+  if (s->rangeCount < SESSION_MAX_RANGES) {
+    s->ranges[s->rangeCount++] = { from, to };
+  } else {
+    // Out of slots: widen the last range rather than lose the request
+    SeqRange &r = s->ranges[SESSION_MAX_RANGES - 1];
+    if (from < r.from) r.from = from;
+    if (to > r.to) r.to = to;
+  }
+  return true;
+}
+
+bool sessionNext(TransferSession *s, uint16_t *seq) {
+  if (s->rangeCount > 0) {
+    SeqRange &r = s->ranges[0];
+    *seq = r.from;
+    if (r.from == r.to) {
+      for (int i = 1; i < s->rangeCount; i++)
+        s->ranges[i - 1] = s->ranges[i];
+      s->rangeCount--;
+    } else {
+      r.from++;
+    }
+  } else if (s->nextSeq < s->totalPackets) {
+    *seq = s->nextSeq++;
+  } else {
+    return false;
+  }
+
+  s->inFlight = *seq;
+  return true;
+}
+
+void sessionAck(TransferSession *s, uint16_t seq) {
+  if (seq == s->inFlight)
+    s->inFlight = SESSION_NO_PACKET;
+  s->ackedThrough = firstOwed(s);
+}
+
+// The packet or its ACK was lost: queue the packet in flight again.
+// False when nothing was in flight.
+bool sessionAckTimeout(TransferSession *s) {
+  if (s->inFlight == SESSION_NO_PACKET)
+    return false;
+  uint16_t seq = s->inFlight;
+  s->inFlight = SESSION_NO_PACKET;
+  sessionRequest(s, seq, seq);
+  return true;
+}
+
+void sessionLinkLost(TransferSession *s) {
+  // The receiver may or may not have the packet in flight; ask again
+  sessionAckTimeout(s);
+}
+
+void sessionResume(TransferSession *s, const SeqRange *missing, int count) {
+  // The receiver's list is authoritative: everything else is held
+  s->nextSeq = s->totalPackets;
+  s->inFlight = SESSION_NO_PACKET;
+  s->rangeCount = 0;
+  for (int i = 0; i < count; i++)
+    sessionRequest(s, missing[i].from, missing[i].to);
+  s->ackedThrough = firstOwed(s);
+}
+
+bool sessionDone(const TransferSession *s) {
+  return s->rangeCount == 0 && s->nextSeq >= s->totalPackets &&
+         s->inFlight == SESSION_NO_PACKET;
+}
+
+static uint32_t parseNumber(const uint8_t *text, size_t len, size_t *pos) {
+  uint32_t v = 0;
+  while (*pos < len && text[*pos] >= '0' && text[*pos] <= '9')
+    v = v * 10 + (text[(*pos)++] - '0');
+  return v;
+}
+
+// "a-b,c,d-e" -> ranges; a lone number is a one-packet range
+int parseSeqRanges(const uint8_t *text, size_t len, SeqRange *out, int max) {
+  int n = 0;
+  size_t pos = 0;
+  while (pos < len && n < max) {
+    if (text[pos] < '0' || text[pos] > '9')
+      break;
+    uint16_t from = parseNumber(text, len, &pos);
+    uint16_t to = from;
+    if (pos < len && text[pos] == '-') {
+      pos++;
+      to = parseNumber(text, len, &pos);
+    }
+    out[n++] = { from, to };
+    if (pos < len && text[pos] == ',')
+      pos++;
+  }
+  return n;
+}
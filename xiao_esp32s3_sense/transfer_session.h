@@ -0,0 +1,41 @@
+#ifndef TRANSFER_SESSION_H
+#define TRANSFER_SESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sender-side state of one object transfer, kept across disconnects.
+// Packets go out in order from nextSeq; ranges the receiver asks for
+// again are queued and served first. After a reconnect the receiver
+// reports what it is missing and that list replaces ours.
+
+#define SESSION_MAX_RANGES 8
+#define SESSION_NO_PACKET  0xFFFF
+
+struct SeqRange {
+  uint16_t from;    // inclusive
+  uint16_t to;      // inclusive
+};
+
+struct TransferSession {
+  uint32_t objectId;
+  uint16_t totalPackets;
+  uint16_t nextSeq;        // first packet never sent
+  uint16_t ackedThrough;   // packets 0..ackedThrough-1 are known received
+  uint16_t inFlight;       // sent, not yet acknowledged
+  SeqRange ranges[SESSION_MAX_RANGES];
+  uint8_t rangeCount;
+};
+
+// Function declarations
+void sessionBegin(TransferSession *s, uint32_t objectId, uint16_t totalPackets);
+bool sessionRequest(TransferSession *s, uint16_t from, uint16_t to);
+bool sessionNext(TransferSession *s, uint16_t *seq);
+void sessionAck(TransferSession *s, uint16_t seq);
+bool sessionAckTimeout(TransferSession *s);
+void sessionLinkLost(TransferSession *s);
+void sessionResume(TransferSession *s, const SeqRange *missing, int count);
+bool sessionDone(const TransferSession *s);
+int parseSeqRanges(const uint8_t *text, size_t len, SeqRange *out, int max);
+
+#endif
@@ -0,0 +1,221 @@
+#include "video_clip.h"
+#include <Arduino.h>
+#include "esp_camera.h"
+#include "esp_timer.h"
+#include "avi_writer.h"
+#include "sd_writer.h"
+#include "sd_card.h"
+#include "capture_catalog.h"
+#include "camera_config.h"
+#include "camera_power.h"
+#include "audio_handler.h"
+#include "ble_transfer.h"
+#include "thumbnail.h"
+#include "psram_arena.h"
+#include "crc32.h"
+#include "capture_crypto.h"
+#include "metrics.h"
+#include "task_topology.h"
+
+static volatile bool recordingVideo = false;
+static volatile TaskHandle_t videoTaskHandle = NULL;
+static uint16_t clipSeconds = 0;
+static uint8_t clipFps = VIDEO_FPS_DEFAULT;
+static bool clipAudio = false;
+static uint32_t clipRate = 0;      // microphone rate, 16-bit PCM in the clip
+
+// One live preview handed from the clip task to loop(), which owns the
+// BLE sender
+static volatile bool livePending = false;
+static uint8_t *liveJpg = nullptr;
+static size_t liveLen = 0;
+static ArenaScope liveScope = ARENA_SCOPE_NONE;
+
+static bool sinkWrite(void *ctx, const uint8_t *head, size_t headLen,
+                      const uint8_t *body, size_t bodyLen, bool droppable) {
+  return sdWriterWrite(head, headLen, body, bodyLen, !droppable);
+}
+
+static bool sinkPatch(void *ctx, uint32_t offset, const uint8_t *data, size_t len) {
+  return sdWriterPatch(offset, data, len);
+}
+
+// Skipped while the previous preview is still waiting for loop()
+static void offerLiveFrame(const camera_fb_t *fb) {
+  if (livePending || !isDeviceConnected()) {
+    return;
+  }
+  ArenaScope scope = arenaBeginScope();
+  Thumbnail thumb;
+  if (!makeThumbnail(fb->buf, fb->len, scope, &thumb)) {
+    arenaEndScope(scope);
+    return;
+  }
+  liveJpg = thumb.jpg;
+  liveLen = thumb.len;
+  liveScope = scope;
+  livePending = true;
+}
+
+// A frame period's worth of microphone audio, in arena-block chunks; the
+// blocking reads pace the clip
+static void recordAudioSlice(AviWriter *avi, uint8_t *block, uint32_t *droppedAudio) {
+  size_t want = clipRate * 2 / clipFps;
+  while (want > 0) {
+    size_t n = readMicrophone(block, min((size_t)ARENA_AUDIO_BLOCK_SIZE, want));
+    if (n == 0) {
+      return;
+    }
+    if (!aviAddAudio(avi, block, n)) {
+      (*droppedAudio)++;
+    }
+    want -= n;
+  }
+}
+
+static void videoTask(void *parameter) {
+  ArenaScope scope = arenaBeginScope();
+  AviIndexEntry *index = (AviIndexEntry *)arenaAlloc(ARENA_THUMB_SIZE, scope);
+  uint8_t *audioBlock = clipAudio ? arenaAlloc(ARENA_AUDIO_BLOCK_SIZE, scope) : nullptr;
+
+  // Filed as pending now, so the catalog keeps its time order while the
+  // clip records; the size is filled in at the end
+  uint32_t captureId = catalogBeginCapture(CAPTURE_VIDEO);
+  char filename[32];
+  capturePath(filename, sizeof(filename), captureId, CAPTURE_VIDEO);
+
+  // The first frame fixes the size written into the header
+  bool awake = cameraWake();
+  applyCaptureSettings({ VIDEO_RESOLUTION, VIDEO_QUALITY });
+  camera_fb_t *fb = awake ? esp_camera_fb_get() : nullptr;
+  uint16_t width = 0, height = 0;
+  bool ok = index && (!clipAudio || audioBlock) && fb &&
+            jpegDimensions(fb->buf, fb->len, &width, &height) &&
+            sdWriterOpen(SD, filename);
+  if (fb) {
+    esp_camera_fb_return(fb);
+  }
+
+  AviWriter avi;
+  AviSink sink = { nullptr, sinkWrite, sinkPatch };
+  const uint32_t periodUs = 1000000 / clipFps;
+  if (ok && !aviBegin(&avi, sink, index, ARENA_THUMB_SIZE / sizeof(AviIndexEntry),
+                      width, height, periodUs, clipAudio ? clipRate : 0)) {
+    sdWriterClose();
+    ok = false;
+  }
+  if (!ok) {
+    Serial.println("Video clip failed to start");
+    catalogFinishCapture(captureId, 0, 0);
+    sendStatusText("VIDEO:FAILED");
+    arenaEndScope(scope);
+    recordingVideo = false;
+    videoTaskHandle = NULL;
+    taskExit(TASK_VIDEO);
+    return;
+  }
+
+  Serial.printf("Video clip %s: %ux%u @ %u fps%s\n", filename, width, height, clipFps,
+                clipAudio ? " + audio" : "");
+  uint32_t frames = 0, droppedFrames = 0, droppedAudio = 0;
+  int64_t firstUs = 0, lastUs = 0;
+  const int64_t stopUs = esp_timer_get_time() + (int64_t)clipSeconds * 1000000;
+  TickType_t wake = xTaskGetTickCount();
+
+  while (recordingVideo && esp_timer_get_time() < stopUs && !aviIndexFull(&avi) &&
+         !sdWriterFailed()) {
+    if (clipAudio) {
+      recordAudioSlice(&avi, audioBlock, &droppedAudio);
+    } else {
+      vTaskDelayUntil(&wake, pdMS_TO_TICKS(periodUs / 1000));
+    }
+
+    cameraWake();            // keeps the camera out of standby
+    fb = esp_camera_fb_get();
+    if (!fb) {
+      break;
+    }
+    int64_t t = esp_timer_get_time();
+    if (aviAddFrame(&avi, fb->buf, fb->len)) {
+      if (frames++ == 0) {
+        firstUs = t;
+      }
+      lastUs = t;
+      if (frames % VIDEO_LIVE_EVERY == 1) {
+        offerLiveFrame(fb);
+      }
+    } else {
+      droppedFrames++;
+    }
+    esp_camera_fb_return(fb);
+  }
+
+  // The measured interval goes in the header, so playback runs at the
+  // rate the card actually kept up with
+  uint32_t usPerFrame = frames > 1 ? (uint32_t)((lastUs - firstUs) / (frames - 1)) : periodUs;
+  bool closed = aviEnd(&avi, usPerFrame);
+  closed = sdWriterClose() && closed;
+  arenaEndScope(scope);
+  catalogFinishCapture(captureId, closed ? avi.pos : 0, 0);
+
+  metricSet("video.fps_milli", usPerFrame ? (uint32_t)(1000000000ULL / usPerFrame) : 0);
+  metricAdd("video.frames", frames);
+  metricAdd("video.dropped_frames", droppedFrames);
+  metricAdd("video.dropped_audio", droppedAudio);
+  Serial.printf("Video clip closed: %lu frames, %lu dropped, %lu us/frame%s\n",
+                (unsigned long)frames, (unsigned long)droppedFrames,
+                (unsigned long)usPerFrame, closed ? "" : " (write failed)");
+
+  char status[48];
+  snprintf(status, sizeof(status), "VIDEO:%s:%lu:%lu", closed ? "DONE" : "FAILED",
+           (unsigned long)frames, (unsigned long)(frames * (uint64_t)usPerFrame / 1000));
+  sendStatusText(status);
+
+  recordingVideo = false;
+  videoTaskHandle = NULL;
+  taskExit(TASK_VIDEO);
+}
+
+// Clips are written in the clear, so none are taken while captures must
+// be sealed; audio needs the microphone free of an audio clip
+bool startVideoClip(uint16_t seconds, uint8_t fps, bool withAudio) {
+  if (recordingVideo || !sdCardMounted() || cryptoEnabled() ||
+      (withAudio && (isRecording() || isLiveAudio()))) {
+    return false;
+  }
+  clipSeconds = seconds == 0 || seconds > VIDEO_SECONDS_MAX ? VIDEO_SECONDS_MAX : seconds;
+  clipFps = fps == 0 ? VIDEO_FPS_DEFAULT : min((uint8_t)VIDEO_FPS_MAX, fps);
+  clipAudio = withAudio;
+  clipRate = audioConfig().sampleRate;
+
+  recordingVideo = true;
+  if (!taskStart(TASK_VIDEO, videoTask, NULL, (TaskHandle_t *)&videoTaskHandle)) {
+    recordingVideo = false;
+    return false;
+  }
+  return true;
+}
+
+void stopVideoClip() {
+  // The task finishes its frame, then writes the index and closes
+  recordingVideo = false;
+  while (videoTaskHandle != NULL) {
+    delay(10);
+  }
+}
+
+bool isRecordingVideo() {
+  return recordingVideo;
+}
+
+// From loop(): sends the preview the clip task left, if any
+void serviceVideoClip() {
+  if (!livePending) {
+    return;
+  }
+  startImageSend(liveJpg, liveLen, liveScope, IMAGE_KIND_PREVIEW, 0,
+                 crc32Update(0, liveJpg, liveLen));
+  liveJpg = nullptr;
+  liveScope = ARENA_SCOPE_NONE;
+  livePending = false;
+}
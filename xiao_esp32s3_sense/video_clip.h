@@ -0,0 +1,28 @@
+#ifndef VIDEO_CLIP_H
+#define VIDEO_CLIP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "rate_control.h"
+
+// Low frame rate MJPEG clips. A task grabs frames at a fixed pace and
+// hands them to the async SD writer as AVI chunks, with the microphone's
+// PCM between frames when asked; the AVI index stays in an arena slot
+// until the clip closes. Every VIDEO_LIVE_EVERY-th frame is shrunk to a
+// thumbnail and offered to the phone as a preview, so the phone sees
+// the clip live at a fraction of the rate without holding it up.
+
+#define VIDEO_FPS_DEFAULT     5
+#define VIDEO_FPS_MAX         15
+#define VIDEO_SECONDS_MAX     600
+#define VIDEO_RESOLUTION      RES_VGA
+#define VIDEO_QUALITY         12
+#define VIDEO_LIVE_EVERY      5
+
+// Function declarations
+bool startVideoClip(uint16_t seconds, uint8_t fps, bool withAudio);
+void stopVideoClip();
+bool isRecordingVideo();
+void serviceVideoClip();
+
+#endif
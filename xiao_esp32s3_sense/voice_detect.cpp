@@ -0,0 +1,81 @@
+#include "voice_detect.h"
+
+void vadBegin(VadState *v) {
+  v->noiseFloor = VAD_MIN_ENERGY;
+  v->voicedRun = 0;
+  v->quietRun = 0;
+  v->active = false;
+  v->primed = false;
+}
+
+// Classifies one frame and lets the noise floor follow the background:
+// down quickly, up slowly, and never on voiced frames.
+bool vadFrameIsVoiced(VadState *v, const int16_t *pcm, size_t n) {
+  if (n == 0)
+    return false;
+
+  int64_t sum = 0;
+  uint64_t sumSq = 0;
+  for (size_t i = 0; i < n; i++) {
+    int32_t s = pcm[i];
+    sum += s;
+    sumSq += (uint64_t)(s * s);
+  }
+  int32_t mean = (int32_t)(sum / (int64_t)n);
+  uint64_t meanSq = sumSq / n;
+  uint64_t dc = (uint64_t)((int64_t)mean * mean);
+  uint32_t energy = meanSq > dc ? (uint32_t)(meanSq - dc) : 0;
+
+  uint32_t crossings = 0;
+  bool wasPositive = pcm[0] >= mean;
+  for (size_t i = 1; i < n; i++) {
+    bool positive = pcm[i] >= mean;
+    crossings += positive != wasPositive;
+    wasPositive = positive;
+  }
+  uint32_t zcrPermille = crossings * 1000 / n;
+
+  if (!v->primed) {
+    v->noiseFloor = energy > VAD_MIN_ENERGY ? energy : VAD_MIN_ENERGY;
+    v->primed = true;
+  }
+
+  bool voiced = energy >= VAD_MIN_ENERGY &&
+                (uint64_t)energy > ((uint64_t)v->noiseFloor << VAD_SNR_SHIFT) &&
+                zcrPermille <= VAD_ZCR_MAX_PERMILLE;
+
+  if (!voiced) {
+    if (energy < v->noiseFloor)
+      v->noiseFloor -= (v->noiseFloor - energy) / 4;
+    else
+      v->noiseFloor += (energy - v->noiseFloor) / 64;
+    if (v->noiseFloor < VAD_MIN_ENERGY)
+      v->noiseFloor = VAD_MIN_ENERGY;
+  }
+  return voiced;
+}
+
+// Runs the detector over a block of any length, frame by frame (a short
+// last frame is classified on its own). Returns true if a segment was
+// open at any point in the block.
+bool vadProcess(VadState *v, const int16_t *pcm, size_t n) {
+  bool any = v->active;
+  for (size_t at = 0; at < n; at += VAD_FRAME_SAMPLES) {
+    size_t len = n - at < VAD_FRAME_SAMPLES ? n - at : VAD_FRAME_SAMPLES;
+    if (vadFrameIsVoiced(v, pcm + at, len)) {
+      v->quietRun = 0;
+      if (v->voicedRun < VAD_ONSET_FRAMES)
+        v->voicedRun++;
+      if (v->voicedRun >= VAD_ONSET_FRAMES)
+        v->active = true;
+    } else {
+      v->voicedRun = 0;
+      if (v->active && ++v->quietRun >= VAD_HANGOVER_FRAMES) {
+        v->active = false;
+        v->quietRun = 0;
+      }
+    }
+    any = any || v->active;
+  }
+  return any;
+}
@@ -0,0 +1,33 @@
+#ifndef VOICE_DETECT_H
+#define VOICE_DETECT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Energy + zero-crossing voice activity detector for 16 kHz mono PCM.
+// Each frame's energy (DC removed) is compared against an adaptive
+// noise floor; frames loud enough but with a hiss-like crossing rate are
+// not counted as voice. A segment opens after a few voiced frames in a
+// row and stays open through short pauses (hangover).
+
+#define VAD_FRAME_SAMPLES      256     // 16 ms at 16 kHz
+#define VAD_ONSET_FRAMES       2       // voiced frames in a row that open a segment
+#define VAD_HANGOVER_FRAMES    25      // 400 ms of quiet closes it
+#define VAD_SNR_SHIFT          2       // voiced: energy above 4x the floor (6 dB)
+#define VAD_MIN_ENERGY         (64 * 64)   // absolute floor, mean square
+#define VAD_ZCR_MAX_PERMILLE   450     // more crossings than this: hiss
+
+struct VadState {
+  uint32_t noiseFloor;     // mean-square energy of the background
+  uint16_t voicedRun;
+  uint16_t quietRun;
+  bool active;             // inside a segment
+  bool primed;             // noiseFloor has been seeded
+};
+
+// Function declarations
+void vadBegin(VadState *v);
+bool vadFrameIsVoiced(VadState *v, const int16_t *pcm, size_t n);
+bool vadProcess(VadState *v, const int16_t *pcm, size_t n);
+
+#endif
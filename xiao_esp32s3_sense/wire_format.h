@@ -0,0 +1,300 @@
+// Generated by protocol/gen_wire.py from protocol/messages.json. Do not edit.
+#ifndef WIRE_FORMAT_H
+#define WIRE_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte-wise loads and stores: alignment- and host-endian-independent;
+// the compiler folds them into single loads on little-endian targets.
+static inline uint16_t wireGet16Le(const uint8_t *p) { return p[0] | (p[1] << 8); }
+static inline uint16_t wireGet16Be(const uint8_t *p) { return (p[0] << 8) | p[1]; }
+static inline uint32_t wireGet32Le(const uint8_t *p) {
+  return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static inline uint32_t wireGet32Be(const uint8_t *p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | (p[2] << 8) | p[3];
+}
+static inline uint64_t wireGet64Le(const uint8_t *p) {
+  return wireGet32Le(p) | ((uint64_t)wireGet32Le(p + 4) << 32);
+}
+static inline void wirePut16Le(uint8_t *p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static inline void wirePut16Be(uint8_t *p, uint16_t v) { p[0] = v >> 8; p[1] = v; }
+static inline void wirePut32Le(uint8_t *p, uint32_t v) {
+  p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+}
+static inline void wirePut32Be(uint8_t *p, uint32_t v) {
+  p[0] = v >> 24; p[1] = v >> 16; p[2] = v >> 8; p[3] = v;
+}
+static inline void wirePut64Le(uint8_t *p, uint64_t v) {
+  wirePut32Le(p, (uint32_t)v); wirePut32Le(p + 4, (uint32_t)(v >> 32));
+}
+
+static constexpr uint32_t WIRE_IMAGE_MAGIC = 0xFF;
+static constexpr uint32_t WIRE_IMAGE_KIND_FULL = 0xFF;
+static constexpr uint32_t WIRE_IMAGE_KIND_PREVIEW = 0xFE;
+static constexpr uint32_t WIRE_IMAGE_KIND_DUPLICATE = 0xFD;
+static constexpr uint32_t WIRE_IMAGE_KIND_SHEET = 0xFC;
+static constexpr uint32_t WIRE_IMAGE_FLAG_SEALED = 0x01;
+static constexpr uint32_t WIRE_AUDIO_FLAG_SEALED = 0x01;
+static constexpr uint32_t WIRE_AUDIO_HEADER_OFFSET = 0xFFFFFFFF;
+static constexpr uint32_t WIRE_AUDIO_WINDOW = 0x800;
+static constexpr uint32_t WIRE_AUDIO_ACK_EVERY = 0x400;
+static constexpr uint32_t WIRE_LIVE_KIND_AUDIO = 0x01;
+static constexpr uint32_t WIRE_LIVE_KIND_IMU = 0x02;
+static constexpr uint32_t WIRE_CAPTURE_PHOTO = 0x01;
+static constexpr uint32_t WIRE_CAPTURE_AUDIO = 0x02;
+static constexpr uint32_t WIRE_CAPTURE_VIDEO = 0x03;
+static constexpr uint32_t WIRE_CATALOG_FLAG_PENDING = 0x01;
+static constexpr uint32_t WIRE_CATALOG_FLAG_ESTIMATED = 0x02;
+static constexpr uint32_t WIRE_CATALOG_FLAG_DUPLICATE = 0x04;
+static constexpr uint32_t WIRE_CATALOG_FLAG_SEALED = 0x08;
+static constexpr uint32_t WIRE_STREAM_CONTROL = 0x00;
+static constexpr uint32_t WIRE_STREAM_LIVE = 0x01;
+static constexpr uint32_t WIRE_STREAM_IMAGE = 0x02;
+static constexpr uint32_t WIRE_STREAM_AUDIO = 0x03;
+
+// Prefix of every notification: the stream the payload belongs to
+struct MuxFrame {
+  static constexpr size_t SIZE = 1;
+  static constexpr size_t STREAM_OFFSET = 0;
+
+  // Read-only view over received bytes (at least SIZE of them)
+  struct View {
+    const uint8_t *p;
+    uint8_t stream() const { return p[STREAM_OFFSET]; }
+  };
+
+  // Writes fields in place into an outgoing buffer
+  struct Writer {
+    uint8_t *p;
+    void setStream(uint8_t v) const { p[STREAM_OFFSET] = v; }
+  };
+};
+
+// Starts an image transfer on the image stream
+struct ImageHeader {
+  static constexpr size_t SIZE = 25;
+  static constexpr size_t MAGIC_OFFSET = 0;
+  static constexpr size_t KIND_OFFSET = 1;
+  static constexpr size_t LENGTH_OFFSET = 2;
+  static constexpr size_t PACKETS_OFFSET = 6;
+  static constexpr size_t HASH_OFFSET = 8;
+  static constexpr size_t CRC_OFFSET = 16;
+  static constexpr size_t OBJECT_ID_OFFSET = 20;
+  static constexpr size_t FLAGS_OFFSET = 24;
+
+  // Read-only view over received bytes (at least SIZE of them)
+  struct View {
+    const uint8_t *p;
+    uint8_t magic() const { return p[MAGIC_OFFSET]; }
+    uint8_t kind() const { return p[KIND_OFFSET]; }
+    uint32_t length() const { return wireGet32Le(p + LENGTH_OFFSET); }
+    uint16_t packets() const { return wireGet16Le(p + PACKETS_OFFSET); }
+    uint64_t hash() const { return wireGet64Le(p + HASH_OFFSET); }
+    uint32_t crc() const { return wireGet32Le(p + CRC_OFFSET); }
+    uint32_t objectId() const { return wireGet32Le(p + OBJECT_ID_OFFSET); }
+    uint8_t flags() const { return p[FLAGS_OFFSET]; }
+  };
+
+  // Writes fields in place into an outgoing buffer
+  struct Writer {
+    uint8_t *p;
+    void setMagic(uint8_t v) const { p[MAGIC_OFFSET] = v; }
+    void setKind(uint8_t v) const { p[KIND_OFFSET] = v; }
+    void setLength(uint32_t v) const { wirePut32Le(p + LENGTH_OFFSET, v); }
+    void setPackets(uint16_t v) const { wirePut16Le(p + PACKETS_OFFSET, v); }
+    void setHash(uint64_t v) const { wirePut64Le(p + HASH_OFFSET, v); }
+    void setCrc(uint32_t v) const { wirePut32Le(p + CRC_OFFSET, v); }
+    void setObjectId(uint32_t v) const { wirePut32Le(p + OBJECT_ID_OFFSET, v); }
+    void setFlags(uint8_t v) const { p[FLAGS_OFFSET] = v; }
+  };
+};
+
+// Prefix of an image data packet; the payload and an ImagePacketTrailer follow
+struct ImagePacket {
+  static constexpr size_t SIZE = 2;
+  static constexpr size_t SEQ_OFFSET = 0;
+
+  // Read-only view over received bytes (at least SIZE of them)
+  struct View {
+    const uint8_t *p;
+    uint16_t seq() const { return wireGet16Be(p + SEQ_OFFSET); }
+  };
+
+  // Writes fields in place into an outgoing buffer
+  struct Writer {
+    uint8_t *p;
+    void setSeq(uint16_t v) const { wirePut16Be(p + SEQ_OFFSET, v); }
+  };
+};
+
+// Ends an image data packet: CRC-32 of the ImagePacket prefix and the payload
+struct ImagePacketTrailer {
+  static constexpr size_t SIZE = 4;
+  static constexpr size_t CRC_OFFSET = 0;
+
+  // Read-only view over received bytes (at least SIZE of them)
+  struct View {
+    const uint8_t *p;
+    uint32_t crc() const { return wireGet32Le(p + CRC_OFFSET); }
+  };
+
+  // Writes fields in place into an outgoing buffer
+  struct Writer {
+    uint8_t *p;
+    void setCrc(uint32_t v) const { wirePut32Le(p + CRC_OFFSET, v); }
+  };
+};
+
+// Prefix of every audio stream payload: the clip offset of the bytes that follow, or AUDIO_HEADER_OFFSET before an AudioHeader. The phone answers AUDIO_ACK:<bytes held> every AUDIO_ACK_EVERY bytes and at the end; the device keeps at most AUDIO_WINDOW bytes unacknowledged
+struct AudioChunk {
+  static constexpr size_t SIZE = 4;
+  static constexpr size_t OFFSET_OFFSET = 0;
+
+  // Read-only view over received bytes (at least SIZE of them)
+  struct View {
+    const uint8_t *p;
+    uint32_t offset() const { return wireGet32Le(p + OFFSET_OFFSET); }
+  };
+
+  // Writes fields in place into an outgoing buffer
+  struct Writer {
+    uint8_t *p;
+    void setOffset(uint32_t v) const { wirePut32Le(p + OFFSET_OFFSET, v); }
+  };
+};
+
+// Starts a recorded clip (IMA ADPCM WAV of the voiced segments) on the audio stream; sent again, from offset 0, after a reconnect
+struct AudioHeader {
+  static constexpr size_t SIZE = 5;
+  static constexpr size_t SIZE_OFFSET = 0;
+  static constexpr size_t FLAGS_OFFSET = 4;
+
+  // Read-only view over received bytes (at least SIZE of them)
+  struct View {
+    const uint8_t *p;
+    uint32_t size() const { return wireGet32Le(p + SIZE_OFFSET); }
+    uint8_t flags() const { return p[FLAGS_OFFSET]; }
+  };
+
+  // Writes fields in place into an outgoing buffer
+  struct Writer {
+    uint8_t *p;
+    void setSize(uint32_t v) const { wirePut32Le(p + SIZE_OFFSET, v); }
+    void setFlags(uint8_t v) const { p[FLAGS_OFFSET] = v; }
+  };
+};
+
+// One live audio frame on the live stream; a single IMA ADPCM block (adpcm.h layout) of `samples` samples follows
+struct LiveAudioFrame {
+  static constexpr size_t SIZE = 9;
+  static constexpr size_t KIND_OFFSET = 0;
+  static constexpr size_t SEQ_OFFSET = 1;
+  static constexpr size_t TIME_MS_OFFSET = 3;
+  static constexpr size_t SAMPLES_OFFSET = 7;
+
+  // Read-only view over received bytes (at least SIZE of them)
+  struct View {
+    const uint8_t *p;
+    uint8_t kind() const { return p[KIND_OFFSET]; }
+    uint16_t seq() const { return wireGet16Le(p + SEQ_OFFSET); }
+    uint32_t timeMs() const { return wireGet32Le(p + TIME_MS_OFFSET); }
+    uint16_t samples() const { return wireGet16Le(p + SAMPLES_OFFSET); }
+  };
+
+  // Writes fields in place into an outgoing buffer
+  struct Writer {
+    uint8_t *p;
+    void setKind(uint8_t v) const { p[KIND_OFFSET] = v; }
+    void setSeq(uint16_t v) const { wirePut16Le(p + SEQ_OFFSET, v); }
+    void setTimeMs(uint32_t v) const { wirePut32Le(p + TIME_MS_OFFSET, v); }
+    void setSamples(uint16_t v) const { wirePut16Le(p + SAMPLES_OFFSET, v); }
+  };
+};
+
+// A batch of IMU samples on the live stream (imu_batch.h): `count` samples `period_us` apart from time_ms, each six raw counts (accel x y z, gyro x y z) as zigzag varint deltas against the previous sample
+struct ImuBatchHeader {
+  static constexpr size_t SIZE = 16;
+  static constexpr size_t KIND_OFFSET = 0;
+  static constexpr size_t SEQ_OFFSET = 1;
+  static constexpr size_t TIME_MS_OFFSET = 3;
+  static constexpr size_t PERIOD_US_OFFSET = 7;
+  static constexpr size_t COUNT_OFFSET = 11;
+  static constexpr size_t ACCEL_LSB_PER_G_OFFSET = 12;
+  static constexpr size_t GYRO_LSB_PER_DPS_X10_OFFSET = 14;
+
+  // Read-only view over received bytes (at least SIZE of them)
+  struct View {
+    const uint8_t *p;
+    uint8_t kind() const { return p[KIND_OFFSET]; }
+    uint16_t seq() const { return wireGet16Le(p + SEQ_OFFSET); }
+    uint32_t timeMs() const { return wireGet32Le(p + TIME_MS_OFFSET); }
+    uint32_t periodUs() const { return wireGet32Le(p + PERIOD_US_OFFSET); }
+    uint8_t count() const { return p[COUNT_OFFSET]; }
+    uint16_t accelLsbPerG() const { return wireGet16Le(p + ACCEL_LSB_PER_G_OFFSET); }
+    uint16_t gyroLsbPerDpsX10() const { return wireGet16Le(p + GYRO_LSB_PER_DPS_X10_OFFSET); }
+  };
+
+  // Writes fields in place into an outgoing buffer
+  struct Writer {
+    uint8_t *p;
+    void setKind(uint8_t v) const { p[KIND_OFFSET] = v; }
+    void setSeq(uint16_t v) const { wirePut16Le(p + SEQ_OFFSET, v); }
+    void setTimeMs(uint32_t v) const { wirePut32Le(p + TIME_MS_OFFSET, v); }
+    void setPeriodUs(uint32_t v) const { wirePut32Le(p + PERIOD_US_OFFSET, v); }
+    void setCount(uint8_t v) const { p[COUNT_OFFSET] = v; }
+    void setAccelLsbPerG(uint16_t v) const { wirePut16Le(p + ACCEL_LSB_PER_G_OFFSET, v); }
+    void setGyroLsbPerDpsX10(uint16_t v) const { wirePut16Le(p + GYRO_LSB_PER_DPS_X10_OFFSET, v); }
+  };
+};
+
+// Starts a thumbnail sheet (image kind SHEET): `count` entries follow, each a ThumbSheetEntry and its thumbnail; the next sheet starts at next_id
+struct ThumbSheetHeader {
+  static constexpr size_t SIZE = 6;
+  static constexpr size_t COUNT_OFFSET = 0;
+  static constexpr size_t NEXT_ID_OFFSET = 2;
+
+  // Read-only view over received bytes (at least SIZE of them)
+  struct View {
+    const uint8_t *p;
+    uint16_t count() const { return wireGet16Le(p + COUNT_OFFSET); }
+    uint32_t nextId() const { return wireGet32Le(p + NEXT_ID_OFFSET); }
+  };
+
+  // Writes fields in place into an outgoing buffer
+  struct Writer {
+    uint8_t *p;
+    void setCount(uint16_t v) const { wirePut16Le(p + COUNT_OFFSET, v); }
+    void setNextId(uint32_t v) const { wirePut32Le(p + NEXT_ID_OFFSET, v); }
+  };
+};
+
+// One thumbnail in a sheet: the capture's catalog record, then `length` bytes of JPEG (sealed when flags has CATALOG_FLAG_SEALED)
+struct ThumbSheetEntry {
+  static constexpr size_t SIZE = 13;
+  static constexpr size_t ID_OFFSET = 0;
+  static constexpr size_t TIME_OFFSET = 4;
+  static constexpr size_t FLAGS_OFFSET = 8;
+  static constexpr size_t LENGTH_OFFSET = 9;
+
+  // Read-only view over received bytes (at least SIZE of them)
+  struct View {
+    const uint8_t *p;
+    uint32_t id() const { return wireGet32Le(p + ID_OFFSET); }
+    uint32_t time() const { return wireGet32Le(p + TIME_OFFSET); }
+    uint8_t flags() const { return p[FLAGS_OFFSET]; }
+    uint32_t length() const { return wireGet32Le(p + LENGTH_OFFSET); }
+  };
+
+  // Writes fields in place into an outgoing buffer
+  struct Writer {
+    uint8_t *p;
+    void setId(uint32_t v) const { wirePut32Le(p + ID_OFFSET, v); }
+    void setTime(uint32_t v) const { wirePut32Le(p + TIME_OFFSET, v); }
+    void setFlags(uint8_t v) const { p[FLAGS_OFFSET] = v; }
+    void setLength(uint32_t v) const { wirePut32Le(p + LENGTH_OFFSET, v); }
+  };
+};
+
+#endif
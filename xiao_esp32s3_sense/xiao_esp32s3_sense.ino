@@ -2,50 +2,454 @@
 #include "sd_card.h"
 #include "ble_transfer.h"
 #include "audio_handler.h"
-
-bool camera_sign = false;
-bool audio_sign = false;
-bool sd_sign = false;
+#include "psram_arena.h"
+#include "rate_control.h"
+#include "thumbnail.h"
+#include "motion_detect.h"
+#include "content_hash.h"
+#include "dedup_index.h"
+#include "metrics.h"
+#include "crc32.h"
+#include "capture_crypto.h"
+#include "boot_status.h"
+#include "camera_power.h"
+#include "video_clip.h"
+#include "capture_catalog.h"
+#include "thumb_sheet.h"
+#include "stream_mux.h"
+#include "power_manager.h"
+#include "task_topology.h"
 
 void setup() {
+  // No wait for USB: the necklace has to boot on battery
   Serial.begin(115200);
-  while (!Serial);
+  initPower();
 
   pinMode(LED_BUILTIN, OUTPUT);
   digitalWrite(LED_BUILTIN, HIGH);
 
-  camera_sign = initCamera();
-  audio_sign  = initAudio();
-  sd_sign     = initSDCard();
+  // BLE first, so the phone can connect while the rest comes up. The
+  // peripherals share no bus and initialize side by side; whatever
+  // fails stays off and the rest runs without it.
+  bool arenaOk = bootRun(BOOT_ARENA, initArena);
+  initCrypto();
+  bootRun(BOOT_BLE, [] { initBLE(); return true; });
+  initTasks();
+
+  if (arenaOk) {
+    bootRunAsync(BOOT_CAMERA, initCamera, TASK_BOOT_CAMERA);
+    bootRunAsync(BOOT_AUDIO, initAudio, TASK_BOOT_AUDIO);
+    bootRunAsync(BOOT_SD, initSDCard, TASK_BOOT_SD);
+  } else {
+    // Without the arena there is nowhere to put a capture
+    bootSkip(BOOT_CAMERA);
+    bootSkip(BOOT_AUDIO);
+    bootSkip(BOOT_SD);
+  }
+  Serial.println("Advertising, peripherals starting");
+}
+
+/* once every subsystem has settled, log and report how boot went */
+static void reportBoot() {
+  static bool reported = false;
+  if (reported || !bootAllSettled()) {
+    return;
+  }
+  reported = true;
+  powerRelease(POWER_BOOT);
+
+  char report[192];
+  formatBootReport(report, sizeof(report));
+  Serial.println(report);
+  bootPublishMetrics();
+  sendStatusText(report);
+}
+
+/* seal an image for sending when encryption is on; 0: must not be sent */
+static size_t sealForSend(uint8_t *buf, size_t len, size_t cap, uint8_t *flags) {
+  *flags = 0;
+  if (!cryptoEnabled()) {
+    return len;
+  }
+  size_t sealed = cryptoSeal(buf, len, cap);
+  if (sealed == 0) {
+    Serial.println("Seal failed, image not sent");
+    return 0;
+  }
+  *flags = IMAGE_FLAG_SEALED;
+  return sealed;
+}
+
+/* answer FETCH: the phone got a reference it cannot resolve; the
+   original goes out again from the card, provided the card still holds
+   exactly that content */
+static void sendOriginal(uint64_t hash, uint32_t len) {
+  DedupRecord original;
+  ArenaScope scope = arenaBeginScope();
+  uint8_t *frame = nullptr;
+  if (dedupLookup(hash, len, &original) && !(original.flags & DEDUP_SEALED)) {
+    frame = arenaAlloc(len + CRYPTO_SEAL_SIZE, scope);
+  }
+  bool intact = frame && readFile(SD, original.path, frame, len) == len;
+  if (intact) {
+    size_t scan = jpegScanOffset(frame, len);
+    intact = hashBuffer(frame + scan, len - scan) == hash;
+  }
+  if (!intact) {
+    arenaEndScope(scope);
+    char reply[48];
+    snprintf(reply, sizeof(reply), "FETCH:GONE:%016llx", (unsigned long long)hash);
+    sendStatusText(reply);
+    metricAdd("dedup.fetch_gone", 1);
+    return;
+  }
+  metricAdd("dedup.fetched", 1);
+
+  uint8_t flags = 0;
+  size_t sendLen = sealForSend(frame, len, len + CRYPTO_SEAL_SIZE, &flags);
+  if (sendLen == 0) {
+    arenaEndScope(scope);
+    return;
+  }
+  startImageSend(frame, sendLen, scope, IMAGE_KIND_FULL, flags ? 0 : hash,
+                 crc32Update(0, frame, sendLen), flags);
+}
+
+/* answer QUERY: a count line, then the page's records a frame at a time */
+static void sendCatalogPage(uint32_t from, uint32_t to, uint32_t skip) {
+  static CatalogEntry page[CATALOG_QUERY_MAX];
+  uint32_t total = 0;
+  size_t n = catalogQuery(from, to, skip, page, CATALOG_QUERY_MAX, &total);
+
+  char line[MUX_PAYLOAD_MAX + 1];
+  snprintf(line, sizeof(line), "CATALOG:%lu:%lu:%u", (unsigned long)total,
+           (unsigned long)skip, (unsigned)n);
+  sendStatusText(line);
+
+  // "CAT:<id>,<time>,<type>,<size>,<flags>;..." never split across frames
+  size_t at = 0;
+  for (size_t i = 0; i < n; i++) {
+    char item[48];
+    int len = snprintf(item, sizeof(item), "%lu,%lu,%u,%lu,%u",
+                       (unsigned long)page[i].id, (unsigned long)page[i].time,
+                       page[i].type, (unsigned long)page[i].size, page[i].flags);
+    if (at > 0 && at + 1 + len > MUX_PAYLOAD_MAX) {
+      sendStatusText(line);
+      at = 0;
+    }
+    at += snprintf(line + at, sizeof(line) - at, "%s%s", at ? ";" : "CAT:", item);
+  }
+  if (at > 0) {
+    sendStatusText(line);
+  }
+}
 
-  if (!camera_sign || !audio_sign || !sd_sign) {
-    Serial.println("Init failed");
-    while (1);
+/* answer TASKS?: each task's placement, CPU share and stack headroom */
+static void sendTaskReport() {
+  char line[MUX_PAYLOAD_MAX + 1];
+  taskSample();
+  int from = 0;
+  while (from < TASK_COUNT) {
+    formatTaskReport(line, sizeof(line), &from);
+    sendStatusText(line);
   }
+}
 
-  initBLE();
-  Serial.println("System ready");
+/* answer THUMBS: the sheet goes out like an image, announced first */
+static void sendThumbSheet(uint32_t fromId, uint16_t maxCount) {
+  ArenaScope scope = arenaBeginScope();
+  uint8_t *sheet = arenaAlloc(ARENA_MEDIA_SIZE, scope);
+  if (!sheet) {
+    arenaEndScope(scope);
+    sendStatusText("THUMBS:BUSY");
+    return;
+  }
+
+  uint16_t count = 0;
+  uint32_t nextId = 0;
+  size_t len = buildThumbSheet(fromId, maxCount, sheet, ARENA_MEDIA_SIZE, &count, &nextId);
+  char note[32];
+  snprintf(note, sizeof(note), "THUMBS:%u:%lu", count, (unsigned long)nextId);
+  sendStatusText(note);
+  startImageSend(sheet, len, scope, IMAGE_KIND_SHEET, 0, crc32Update(0, sheet, len));
+}
+
+/* capture one shot, optionally send its thumbnail first, then the frame */
+static void captureAndSend(const CaptureSettings &settings, bool withPreview,
+                           int64_t commandUs) {
+  if (!cameraWake()) {
+    return;
+  }
+  applyCaptureSettings(settings);
+
+  camera_fb_t *fb = captureFreshPhoto(commandUs);
+  if (!fb) {
+    return;
+  }
+  static bool firstCapture = true;
+  if (firstCapture) {
+    firstCapture = false;
+    metricSet("boot.first_capture_ms", millis());
+  }
+  rateObserveFrame(settings, fb->len);
+
+  // Copy the frame into a per-capture arena scope so the camera
+  // buffer can go straight back to the driver while BLE sends. Room is
+  // left for the seal trailer in case encryption is on.
+  ArenaScope scope = arenaBeginScope();
+  size_t frameCap = fb->len + CRYPTO_SEAL_SIZE;
+  uint8_t *frame = arenaAlloc(frameCap, scope);
+  size_t frameLen = fb->len;
+  uint64_t hash = 0;
+  uint32_t crc = 0;
+  if (frame) {
+    hash = copyAndHashJpeg(frame, fb->buf, fb->len, &crc);
+  } else {
+    Serial.println("Arena full, image not sent");
+    arenaEndScope(scope);
+  }
+
+  // Skip or downgrade shots whose content has not changed
+  bool sendFull = true;
+  if (frame && motionGateEnabled()) {
+    MotionResult motion = evaluateMotion(frame, frameLen);
+    if (motion.decision != MOTION_FULL) {
+      char note[48];
+      snprintf(note, sizeof(note), "%s:%u/%u",
+               motion.decision == MOTION_SKIP ? "SKIP" : "DOWNGRADE",
+               motion.changedBlocks, MOTION_BLOCKS);
+      Serial.printf("Motion gate: %s\n", note);
+      sendStatusText(note);
+    }
+    if (motion.decision == MOTION_SKIP) {
+      arenaEndScope(scope);
+      esp_camera_fb_return(fb);
+      return;
+    }
+    if (motion.decision == MOTION_DOWNGRADE) {
+      withPreview = true;
+      sendFull = false;
+    }
+  }
+
+  // Exact repeats are stored as references to the original, and sent as
+  // one if the phone has the original and it can be fetched again in the
+  // clear
+  DedupRecord original;
+  bool dup = frame && dedupLookup(hash, frameLen, &original);
+  bool sendRef = dup && (original.flags & (DEDUP_DELIVERED | DEDUP_SEALED)) == DEDUP_DELIVERED &&
+                 !cryptoEnabled();
+  uint32_t captureId = catalogBeginCapture(CAPTURE_PHOTO);
+  uint8_t catalogFlags = cryptoEnabled() ? CATALOG_FLAG_SEALED : 0;
+  bool storeThumb = !dup && sdCardMounted();
+
+  if (frame && (withPreview || storeThumb)) {
+    // Every stored photo gets a thumbnail sidecar for browsing the card
+    // (THUMBS); the same thumbnail is the preview. It gets its own scope:
+    // it is released when its own transfer ends, while the full frame is
+    // still queued.
+    ArenaScope thumbScope = arenaBeginScope();
+    Thumbnail thumb;
+    uint8_t flags = 0;
+    size_t thumbLen = 0;
+    if (makeThumbnail(frame, frameLen, thumbScope, &thumb)) {
+      if (storeThumb) {
+        saveThumbSidecar(captureId, thumb.jpg, thumb.len);
+      }
+      if (withPreview) {
+        thumbLen = sealForSend(thumb.jpg, thumb.len, ARENA_THUMB_SIZE, &flags);
+      }
+    }
+    if (thumbLen > 0) {
+      startImageSend(thumb.jpg, thumbLen, thumbScope, IMAGE_KIND_PREVIEW,
+                     0, crc32Update(0, thumb.jpg, thumbLen), flags);
+    } else {
+      arenaEndScope(thumbScope);
+    }
+  }
+
+  char filename[32];
+  capturePath(filename, sizeof(filename), captureId, CAPTURE_PHOTO);
+  if (dup) {
+    Serial.printf("Duplicate of %s (hash %016llx)\n", original.path,
+                  (unsigned long long)hash);
+    metricAdd("dedup.hits", 1);
+    catalogFinishCapture(captureId, saveReference(filename, original.path),
+                         catalogFlags | CATALOG_FLAG_DUPLICATE);
+  } else {
+    size_t stored = savePhoto(filename, fb);
+    catalogFinishCapture(captureId, stored, catalogFlags);
+    if (frame && stored > 0) {
+      dedupInsert(hash, frameLen, filename, cryptoEnabled() ? DEDUP_SEALED : 0);
+    }
+  }
+  esp_camera_fb_return(fb);
+
+  if (frame && sendRef) {
+    arenaEndScope(scope);
+    if (sendFull) {
+      sendImageReference(frameLen, hash);
+    }
+  } else if (frame && sendFull) {
+    // Sealed frames get their CRC over what actually goes on the air
+    uint8_t flags = 0;
+    size_t sendLen = sealForSend(frame, frameLen, frameCap, &flags);
+    if (sendLen == 0) {
+      arenaEndScope(scope);
+      return;
+    }
+    // and no plaintext hash in the header, which would let anyone
+    // listening tell repeated scenes apart
+    if (flags) {
+      crc = crc32Update(0, frame, sendLen);
+    }
+    startImageSend(frame, sendLen, scope, IMAGE_KIND_FULL, flags ? 0 : hash, crc, flags);
+  } else if (frame) {
+    arenaEndScope(scope);
+  }
 }
 
 void loop() {
-  /* handle BLE camera command */
-  if (cameraCommandPending) {
+  reportBoot();
+  if (bootReady(BOOT_CAMERA)) {
+    cameraPowerService(millis());
+  }
+
+  /* handle BLE camera command (held until the camera has come up) */
+  if (cameraCommandPending && bootSettled(BOOT_CAMERA)) {
     cameraCommandPending = false;
+    if (!bootReady(BOOT_CAMERA)) {
+      sendStatusText("CAMERA:UNAVAILABLE");
+    } else if (isRecordingVideo()) {
+      sendStatusText("CAMERA:BUSY");
+    } else {
+      CapturePlan plan = planCapture(rateGoodputBps(), captureBudgetMs,
+                                     rateSizeScale(), capturePreviewEnabled);
+      Serial.printf("Capture plan: res %d q %d%s, ~%u B / ~%u ms\n",
+                    plan.full.res, plan.full.quality,
+                    plan.sendPreview ? " (+preview)" : "",
+                    (unsigned)plan.predictedBytes, (unsigned)plan.predictedMs);
 
-    camera_fb_t *fb = capturePhoto();
-    if (fb) {
-      char filename[32];
-      time_t now = time(nullptr);
-      strftime(filename, sizeof(filename),
-               "/photo_%Y%m%d_%H%M%S.jpg",
-               localtime(&now));
-      savePhoto(filename, fb);
+      powerAcquire(POWER_CAPTURE);
+      captureAndSend(plan.full, plan.sendPreview, cameraCommandUs);
+      powerRelease(POWER_CAPTURE);
+    }
+  }
 
-      startImageSend(fb);
-      esp_camera_fb_return(fb);
+  /* recording runs in its own task; stopping waits for it to save */
+  if (audioStartPending && bootSettled(BOOT_AUDIO)) {
+    audioStartPending = false;
+    if (!bootReady(BOOT_AUDIO)) {
+      sendStatusText("AUDIO:UNAVAILABLE");
+    } else if (isRecordingVideo() || isLiveAudio()) {
+      sendStatusText("AUDIO:BUSY");
+    } else {
+      startRecording();
     }
   }
+  if (audioStopPending) {
+    audioStopPending = false;
+    stopRecording();
+  }
 
-  /* non-blocking BLE sender */
-  processImageSend();
+  /* live audio streams from its own task until turned off */
+  if (liveAudioPending && bootSettled(BOOT_AUDIO)) {
+    liveAudioPending = false;
+    if (!liveAudioOn) {
+      stopLiveAudio();
+      sendStatusText("LIVE_AUDIO:0");
+    } else if (!bootReady(BOOT_AUDIO)) {
+      sendStatusText("AUDIO:UNAVAILABLE");
+    } else if (audioConfig().sampleRate != LIVE_SAMPLE_RATE) {
+      sendStatusText("LIVE_AUDIO:FORMAT");
+    } else if (isRecording() || isRecordingVideo() || !startLiveAudio()) {
+      sendStatusText("AUDIO:BUSY");
+    } else {
+      sendStatusText("LIVE_AUDIO:1");
+    }
+  }
+
+  /* a new capture format only applies while the microphone is idle */
+  if (audioConfigPending && bootSettled(BOOT_AUDIO)) {
+    audioConfigPending = false;
+    if (!bootReady(BOOT_AUDIO)) {
+      sendStatusText("AUDIO:UNAVAILABLE");
+    } else if (isRecording() || isLiveAudio() || isRecordingVideo()) {
+      sendStatusText("AUDIO:BUSY");
+    } else {
+      char reply[16 + AUDIO_CONFIG_TEXT_MAX];
+      strcpy(reply, "AUDIO_CONFIG:");
+      if (applyAudioConfig(pendingAudioConfig)) {
+        formatAudioConfig(audioConfig(), reply + 13, sizeof(reply) - 13);
+      } else {
+        strcpy(reply + 13, "FAILED");
+      }
+      sendStatusText(reply);
+    }
+  }
+
+  /* video clips record in their own task; previews of them go out here */
+  if (videoStartPending && bootSettled(BOOT_CAMERA) && bootSettled(BOOT_SD)) {
+    videoStartPending = false;
+    bool withAudio = videoWithAudio && bootReady(BOOT_AUDIO);
+    if (!bootReady(BOOT_CAMERA) || !bootReady(BOOT_SD)) {
+      sendStatusText("VIDEO:UNAVAILABLE");
+    } else if (cryptoEnabled()) {
+      sendStatusText("VIDEO:SEALED");   // clips cannot be sealed yet
+    } else if (!startVideoClip(videoSeconds, videoFps, withAudio)) {
+      sendStatusText("VIDEO:BUSY");
+    }
+  }
+  if (videoStopPending) {
+    videoStopPending = false;
+    stopVideoClip();
+  }
+  serviceVideoClip();
+
+  /* fetches, catalog queries and thumbnail sheets read the card, so they wait for it */
+  if (fetchPending && bootSettled(BOOT_SD)) {
+    fetchPending = false;
+    sendOriginal(fetchHash, fetchLen);
+  }
+
+  if (queryPending && bootSettled(BOOT_SD)) {
+    queryPending = false;
+    if (!bootReady(BOOT_SD)) {
+      sendStatusText("CATALOG:UNAVAILABLE");
+    } else {
+      sendCatalogPage(queryFrom, queryTo, querySkip);
+    }
+  }
+
+  if (thumbsPending && bootSettled(BOOT_SD)) {
+    thumbsPending = false;
+    if (!bootReady(BOOT_SD)) {
+      sendStatusText("THUMBS:UNAVAILABLE");
+    } else {
+      sendThumbSheet(thumbsFrom, thumbsCount);
+    }
+  }
+
+  if (bootCommandPending) {
+    bootCommandPending = false;
+    char report[192];
+    formatBootReport(report, sizeof(report));
+    bootPublishMetrics();
+    sendStatusText(report);
+  }
+
+  if (tasksCommandPending) {
+    tasksCommandPending = false;
+    sendTaskReport();
+  }
+
+  if (metricsCommandPending) {
+    metricsCommandPending = false;
+    sendMetricsViaBLE();
+  }
+
+  /* non-blocking BLE sender; with nothing to send, idle until woken */
+  if (!processTransmit()) {
+    powerIdleWait(POWER_IDLE_WAIT_MS);
+  }
 }